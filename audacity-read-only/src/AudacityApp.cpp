@@ -88,6 +88,9 @@ It handles initialization and termination by subclassing wxApp.
 #include "SplashDialog.h"
 #include "FFT.h"
 #include "BlockFile.h"
+#include "BlockPrefetcher.h"
+#include "SpectrogramTiles.h"
+#include "ThreadPool.h"
 #include "ondemand/ODManager.h"
 #include "commands/Keyboard.h"
 #include "widgets/ErrorDialog.h"
@@ -1846,6 +1849,9 @@ int AudacityApp::OnExit()
    UnloadEffects();
 
    DeinitFFT();
+   SpectrogramTiler::Deinit();
+   BlockPrefetcher::Deinit();
+   ThreadPool::Deinit();
    BlockFile::Deinit();
 
    DeinitAudioIO();
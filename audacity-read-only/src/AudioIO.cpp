@@ -294,6 +294,7 @@ writing audio.
 
 #include "AudacityApp.h"
 #include "AudioIO.h"
+#include "BlockPrefetcher.h"
 #include "Mix.h"
 #include "MixerBoard.h"
 #include "Resample.h"
@@ -515,11 +516,15 @@ bool AudioIO::ValidateDeviceNames(wxString play, wxString rec)
    return true;
 }
 
-AudioIO::AudioIO()
+AudioIO::AudioIO():
+   mAudioThreadWake(mAudioThreadWakeMutex),
+   mAudioThreadDone(mAudioThreadWakeMutex)
 {
    mAudioThreadShouldCallFillBuffersOnce = false;
    mAudioThreadFillBuffersLoopRunning = false;
    mAudioThreadFillBuffersLoopActive = false;
+   mAudioThreadWakePending = false;
+   mAudioThreadStopping = false;
    mPortStreamV19 = NULL;
 
 #ifdef EXPERIMENTAL_MIDI_OUT
@@ -538,8 +543,6 @@ AudioIO::AudioIO()
 #ifdef AUTOMATED_INPUT_LEVEL_ADJUSTMENT
    mAILAActive = false;
 #endif
-   mSilentBuf = NULL;
-   mLastSilentBufSize = 0;
 
    mStreamToken = 0;
 
@@ -631,11 +634,9 @@ AudioIO::~AudioIO()
    /* Delete is a "graceful" way to stop the thread.
       (Kill is the not-graceful way.) */
    wxTheApp->Yield();
+   StopAudioThread();
    mThread->Delete();
 
-   if(mSilentBuf)
-      DeleteSamples(mSilentBuf);
-
    delete mThread;
 }
 
@@ -1279,6 +1280,8 @@ int AudioIO::StartStream(WaveTrackArray playbackTracks,
       try
       {
          if( mNumPlaybackChannels > 0 ) {
+            BlockPrefetcher::Get().ResetStats();
+
             // Allocate output buffers.  For every output track we allocate
             // a ring buffer of five seconds
             sampleCount playbackBufferSize =
@@ -1373,10 +1376,7 @@ int AudioIO::StartStream(WaveTrackArray playbackTracks,
    // so that they will have data in them when the stream starts.  Having the
    // audio thread call FillBuffers here makes the code more predictable, since
    // FillBuffers will ALWAYS get called from the Audio thread.
-   mAudioThreadShouldCallFillBuffersOnce = true;
-
-   while( mAudioThreadShouldCallFillBuffersOnce == true )
-      wxMilliSleep( 50 );
+   CallFillBuffersOnce(false);
 
 #ifdef EXPERIMENTAL_MIDI_OUT
    // if no playback, reset the midi time to zero to roughly sync
@@ -1717,14 +1717,8 @@ void AudioIO::StopStream()
       // to the target WaveTrack.  To do this, we ask the audio thread to
       // call FillBuffers one last time (it normally would not do so since
       // Pa_GetStreamActive() would now return false
-      mAudioThreadShouldCallFillBuffersOnce = true;
-
-      while( mAudioThreadShouldCallFillBuffersOnce == true )
-      {
-         // LLL:  Experienced recursive yield here...once.
-         wxGetApp().Yield(true); // Pass true for onlyIfNeeded to avoid recursive call error.
-         wxMilliSleep( 50 );
-      }
+      // LLL:  Experienced recursive yield here...once.
+      CallFillBuffersOnce(true);
 
       //
       // Everything is taken care of.  Now, just free all the resources
@@ -1741,6 +1735,14 @@ void AudioIO::StopStream()
 
          delete[] mPlaybackBuffers;
          delete[] mPlaybackMixers;
+
+         wxLongLong hits, late, requests;
+         BlockPrefetcher::Get().GetStats(&hits, &late, &requests);
+         if (hits + late > 0)
+            wxLogDebug(wxT("AudioIO::StopStream(): %s of %s blocks prefetched in time (%s requested)"),
+                       hits.ToString().c_str(),
+                       (hits + late).ToString().c_str(),
+                       requests.ToString().c_str());
       }
 
       //
@@ -2227,7 +2229,13 @@ AudioThread::ExitCode AudioThread::Entry()
       }
       gAudioIO->mAudioThreadFillBuffersLoopActive = false;
 
-      Sleep(10);
+      gAudioIO->NotifyAudioThreadDone();
+
+      // The callback wakes us when the buffers need service; the
+      // timeout is only a safety net, and long when there is no stream
+      if (!gAudioIO->WaitForAudioThreadWake(
+             gAudioIO->mAudioThreadFillBuffersLoopRunning ? 50 : 1000))
+         break;
    }
 
    return 0;
@@ -2324,6 +2332,93 @@ int AudioIO::GetCommonlyAvailCapture()
    return commonlyAvail;
 }
 
+bool AudioIO::AudioThreadHasWork()
+{
+   if (mPlaybackTracks.GetCount() > 0) {
+      // Same tests as FillBuffers()
+      double secsAvail = GetCommonlyAvailPlayback() / mRate;
+      if (secsAvail >= mMaxPlaybackSecsToCopy)
+         return true;
+      if (!mPlayLooped && secsAvail > 0 &&
+          mWarpedTime < mWarpedLength &&
+          mWarpedTime + secsAvail >= mWarpedLength)
+         return true;
+   }
+
+   if (mCaptureTracks.GetCount() > 0 &&
+       GetCommonlyAvailCapture() / mRate >= mMinCaptureSecsToCopy)
+      return true;
+
+   return false;
+}
+
+void AudioIO::WakeAudioThread()
+{
+   // Already on its way; don't take the lock again
+   if (mAudioThreadWakePending)
+      return;
+
+   wxMutexLocker locker(mAudioThreadWakeMutex);
+   mAudioThreadWakePending = true;
+   mAudioThreadWake.Signal();
+}
+
+bool AudioIO::WaitForAudioThreadWake(int ms)
+{
+   wxMutexLocker locker(mAudioThreadWakeMutex);
+
+   // Checked under the mutex, so a StopAudioThread() can't slip in
+   // between the test and the wait and leave us sleeping
+   if (!mAudioThreadWakePending && !mAudioThreadStopping)
+      mAudioThreadWake.WaitTimeout(ms);
+   mAudioThreadWakePending = false;
+
+   return !mAudioThreadStopping;
+}
+
+void AudioIO::StopAudioThread()
+{
+   wxMutexLocker locker(mAudioThreadWakeMutex);
+   mAudioThreadStopping = true;
+   mAudioThreadWake.Signal();
+}
+
+void AudioIO::NotifyAudioThreadDone()
+{
+   wxMutexLocker locker(mAudioThreadWakeMutex);
+   mAudioThreadDone.Broadcast();
+}
+
+void AudioIO::CallFillBuffersOnce(bool yield)
+{
+   mAudioThreadWakeMutex.Lock();
+
+   mAudioThreadShouldCallFillBuffersOnce = true;
+   mAudioThreadWakePending = true;
+   mAudioThreadWake.Signal();
+
+   while (mAudioThreadShouldCallFillBuffersOnce) {
+      if (yield) {
+         mAudioThreadWakeMutex.Unlock();
+         wxGetApp().Yield(true); // Pass true for onlyIfNeeded to avoid recursive call error.
+         mAudioThreadWakeMutex.Lock();
+         if (!mAudioThreadShouldCallFillBuffersOnce)
+            break;
+      }
+      mAudioThreadDone.WaitTimeout(50);
+   }
+
+   mAudioThreadWakeMutex.Unlock();
+}
+
+void AudioIO::WaitForAudioThreadIdle()
+{
+   wxMutexLocker locker(mAudioThreadWakeMutex);
+
+   while (mAudioThreadFillBuffersLoopActive)
+      mAudioThreadDone.WaitTimeout(50);
+}
+
 #if USE_PORTMIXER
 int AudioIO::getRecordSourceIndex(PxMixer *portMixer)
 {
@@ -2765,16 +2860,15 @@ void AudioIO::FillBuffers()
                //if not looping we never start them up again, so its okay to not do anything
                if(processed < lrint(deltat * mRate) && mPlayLooped)
                {
-                  if(mLastSilentBufSize < lrint(deltat * mRate))
-                  {
-                     //delete old if necessary
-                     if(mSilentBuf)
-                        DeleteSamples(mSilentBuf);
-                     mLastSilentBufSize=lrint(deltat * mRate);
-                     mSilentBuf = NewSamples(mLastSilentBufSize, floatSample);
-                     ClearSamples(mSilentBuf, floatSample, 0, mLastSilentBufSize);
-                  }
-                  mPlaybackBuffers[i]->Put(mSilentBuf, floatSample, lrint(deltat * mRate) - processed);
+                  // Write the silence in place
+                  samplePtr regions[2];
+                  int lens[2];
+                  int len = mPlaybackBuffers[i]->AcquireForPut(
+                     lrint(deltat * mRate) - processed,
+                     &regions[0], &lens[0], &regions[1], &lens[1]);
+                  ClearSamples(regions[0], floatSample, 0, lens[0]);
+                  ClearSamples(regions[1], floatSample, 0, lens[1]);
+                  mPlaybackBuffers[i]->CommitPut(len);
                }
             }
 
@@ -3450,10 +3544,7 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
 
             // Pause audio thread and wait for it to finish
             gAudioIO->mAudioThreadFillBuffersLoopRunning = false;
-            while( gAudioIO->mAudioThreadFillBuffersLoopActive == true )
-            {
-               wxMilliSleep( 50 );
-            }
+            gAudioIO->WaitForAudioThreadIdle();
 
             // Calculate the new time position
             gAudioIO->mTime += gAudioIO->mSeek;
@@ -3475,11 +3566,7 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
             }
 
             // Reload the ring buffers
-            gAudioIO->mAudioThreadShouldCallFillBuffersOnce = true;
-            while( gAudioIO->mAudioThreadShouldCallFillBuffersOnce == true )
-            {
-               wxMilliSleep( 50 );
-            }
+            gAudioIO->CallFillBuffersOnce(false);
 
             // Reenable the audio thread
             gAudioIO->mAudioThreadFillBuffersLoopRunning = true;
@@ -3694,6 +3781,27 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
 
          if (len > 0) {
             for( t = 0; t < numCaptureChannels; t++) {
+               RingBuffer *ring = gAudioIO->mCaptureBuffers[t];
+               samplePtr regions[2];
+               unsigned int lens[2];
+
+               // Un-interleave straight into the ring buffer when it
+               // holds the capture format, else into tempBuffer and
+               // convert on the way in
+               bool inPlace = (ring->GetFormat() == gAudioIO->mCaptureFormat);
+               if (inPlace) {
+                  int first, second;
+                  ring->AcquireForPut(len, &regions[0], &first,
+                                      &regions[1], &second);
+                  lens[0] = first;
+                  lens[1] = second;
+               }
+               else {
+                  regions[0] = (samplePtr)tempBuffer;
+                  lens[0] = len;
+                  regions[1] = NULL;
+                  lens[1] = 0;
+               }
 
                // dmazzoni:
                // Un-interleave.  Ugly special-case code required because the
@@ -3701,37 +3809,45 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
                // it'd be nice to be able to call CopySamples, but it can't
                // handle multiplying by the gain and then clipping.  Bummer.
 
-               switch(gAudioIO->mCaptureFormat) {
-               case floatSample: {
-                  float *inputFloats = (float *)inputBuffer;
-                  for( i = 0; i < len; i++)
-                     tempFloats[i] =
-                        inputFloats[numCaptureChannels*i+t];
-               } break;
-               case int24Sample:
-                  // We should never get here. Audacity's int24Sample format
-                  // is different from PortAudio's sample format and so we
-                  // make PortAudio return float samples when recording in
-                  // 24-bit samples.
-                  wxASSERT(false);
-                  break;
-               case int16Sample: {
-                  short *inputShorts = (short *)inputBuffer;
-                  short *tempShorts = (short *)tempBuffer;
-                  for( i = 0; i < len; i++) {
-                     float tmp = inputShorts[numCaptureChannels*i+t];
-                     if (tmp > 32767)
-                        tmp = 32767;
-                     if (tmp < -32768)
-                        tmp = -32768;
-                     tempShorts[i] = (short)(tmp);
-                  }
-               } break;
-               } // switch
+               unsigned int frame = 0;
+               for (int r = 0; r < 2; r++) {
+                  switch(gAudioIO->mCaptureFormat) {
+                  case floatSample: {
+                     float *inputFloats = (float *)inputBuffer;
+                     float *destFloats = (float *)regions[r];
+                     for( i = 0; i < lens[r]; i++)
+                        destFloats[i] =
+                           inputFloats[numCaptureChannels*(frame+i)+t];
+                  } break;
+                  case int24Sample:
+                     // We should never get here. Audacity's int24Sample format
+                     // is different from PortAudio's sample format and so we
+                     // make PortAudio return float samples when recording in
+                     // 24-bit samples.
+                     wxASSERT(false);
+                     break;
+                  case int16Sample: {
+                     short *inputShorts = (short *)inputBuffer;
+                     short *destShorts = (short *)regions[r];
+                     for( i = 0; i < lens[r]; i++) {
+                        float tmp = inputShorts[numCaptureChannels*(frame+i)+t];
+                        if (tmp > 32767)
+                           tmp = 32767;
+                        if (tmp < -32768)
+                           tmp = -32768;
+                        destShorts[i] = (short)(tmp);
+                     }
+                  } break;
+                  } // switch
+                  frame += lens[r];
+               }
 
-               gAudioIO->mCaptureBuffers[t]->Put((samplePtr)tempBuffer,
-                                                 gAudioIO->mCaptureFormat,
-                                                 len);
+               if (inPlace)
+                  ring->CommitPut(frame);
+               else
+                  ring->Put((samplePtr)tempBuffer,
+                            gAudioIO->mCaptureFormat,
+                            len);
             }
          }
       }
@@ -3839,6 +3955,12 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
       gAudioIO->mUpdatingMeters = false;
    }  // end playback VU meter update
 
+   // Have the audio thread refill or drain the buffers as soon as
+   // there is a chunk's worth to do
+   if (gAudioIO->mAudioThreadFillBuffersLoopRunning &&
+       gAudioIO->AudioThreadHasWork())
+      gAudioIO->WakeAudioThread();
+
    return callbackReturn;
 }
 
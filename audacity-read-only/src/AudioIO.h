@@ -385,6 +385,34 @@ private:
     * all record buffers without underflow). */
    int GetCommonlyAvailCapture();
 
+   /** \brief True if FillBuffers() would find enough to do: the playback
+    * buffers have drained below their low-water mark, or the capture
+    * buffers have filled above theirs. */
+   bool AudioThreadHasWork();
+
+   /** \brief Wake the audio thread if it is sleeping.  Cheap when a
+    * wakeup is already pending, so the PortAudio callback can call it. */
+   void WakeAudioThread();
+
+   /// Audio thread: sleep until woken, or for at most ms milliseconds.
+   /// Returns false once StopAudioThread() was called.
+   bool WaitForAudioThreadWake(int ms);
+
+   /// Have the audio thread leave its loop, waking it if it is sleeping.
+   /// Called before deleting the thread, which waits for it.
+   void StopAudioThread();
+
+   /// Audio thread: tell threads waiting in CallFillBuffersOnce() or
+   /// WaitForAudioThreadIdle() that a pass of its loop is done
+   void NotifyAudioThreadDone();
+
+   /** \brief Have the audio thread call FillBuffers() once, and wait until
+    * it has.  If yield, keep the UI responsive meanwhile. */
+   void CallFillBuffersOnce(bool yield);
+
+   /// Wait until the audio thread is out of FillBuffers()
+   void WaitForAudioThreadIdle();
+
    /** \brief get the index of the supplied (named) recording device, or the
     * device selected in the preferences if none given.
     *
@@ -517,6 +545,14 @@ private:
    volatile bool       mAudioThreadFillBuffersLoopRunning;
    volatile bool       mAudioThreadFillBuffersLoopActive;
 
+   // The audio thread sleeps on mAudioThreadWake until there is work
+   // for it, and broadcasts mAudioThreadDone after each pass
+   wxMutex             mAudioThreadWakeMutex;
+   wxCondition         mAudioThreadWake;
+   wxCondition         mAudioThreadDone;
+   volatile bool       mAudioThreadWakePending;
+   bool                mAudioThreadStopping;   // guarded by the mutex
+
 #ifdef EXPERIMENTAL_MIDI_OUT
    volatile bool       mMidiThreadFillBuffersLoopRunning;
    volatile bool       mMidiThreadFillBuffersLoopActive;
@@ -550,9 +586,6 @@ private:
    double              mCutPreviewGapStart;
    double              mCutPreviewGapLen;
 
-   samplePtr mSilentBuf;
-   sampleCount mLastSilentBufSize;
-
    AudioIOListener*    mListener;
 
    friend class AudioThread;
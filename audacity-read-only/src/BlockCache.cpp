@@ -0,0 +1,240 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockCache.cpp
+
+*******************************************************************//**
+
+\class BlockCache
+\brief Keeps recently read BlockFile data in memory, up to a budget
+set by "/Directories/BlockCacheSize" (in MB).
+
+BlockFile::ReadData() and BlockFile::Read256()/Read64K() look here
+before going to disk.  On a miss ReadData() reads the whole block, so
+the rest of a sequential pass over it is served from memory.  All
+methods may be called from any thread.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "BlockCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Prefs.h"
+
+// Key of summary entries; sample formats are never 0
+#define SUMMARY_KIND 0
+
+// Share of the budget the protected segment may grow to, in percent
+#define PROTECTED_SHARE 80
+
+BlockCache & BlockCache::Get()
+{
+   static BlockCache cache;
+   return cache;
+}
+
+BlockCache::BlockCache():
+   mBudget(0),
+   mBytes(0),
+   mProtectedBytes(0),
+   mHits(0),
+   mMisses(0)
+{
+   long mb = gPrefs->Read(wxT("/Directories/BlockCacheSize"), 64L);
+   if (mb < 0)
+      mb = 0;
+   mBudget = (size_t)mb << 20;
+}
+
+BlockCache::~BlockCache()
+{
+   Clear();
+}
+
+BlockCache::Entry *BlockCache::Find(const Key &key)
+{
+   EntryMap::iterator iter = mEntries.find(key);
+   if (iter == mEntries.end())
+      return NULL;
+
+   Entry *entry = iter->second;
+
+   // A second hit moves the entry out of probation
+   if (!entry->isProtected) {
+      mProbation.erase(entry->pos);
+      entry->isProtected = true;
+      mProtectedBytes += entry->bytes;
+   }
+   else
+      mProtected.erase(entry->pos);
+   mProtected.push_front(entry);
+   entry->pos = mProtected.begin();
+
+   // Keep room for new entries on probation
+   while (mProtectedBytes > mBudget / 100 * PROTECTED_SHARE &&
+          mProtected.size() > 1) {
+      Entry *demoted = mProtected.back();
+      mProtected.pop_back();
+      demoted->isProtected = false;
+      mProtectedBytes -= demoted->bytes;
+      mProbation.push_front(demoted);
+      demoted->pos = mProbation.begin();
+   }
+
+   return entry;
+}
+
+void BlockCache::Add(const Key &key, char *data, size_t bytes)
+{
+   if (!CanHold(bytes) || mEntries.find(key) != mEntries.end()) {
+      free(data);
+      return;
+   }
+
+   Entry *entry = new Entry;
+   entry->key = key;
+   entry->data = data;
+   entry->bytes = bytes;
+   entry->isProtected = false;
+   mProbation.push_front(entry);
+   entry->pos = mProbation.begin();
+   mEntries[key] = entry;
+   mBytes += bytes;
+
+   Evict();
+}
+
+void BlockCache::Drop(Entry *entry)
+{
+   if (entry->isProtected) {
+      mProtected.erase(entry->pos);
+      mProtectedBytes -= entry->bytes;
+   }
+   else
+      mProbation.erase(entry->pos);
+
+   mEntries.erase(entry->key);
+   mBytes -= entry->bytes;
+   free(entry->data);
+   delete entry;
+}
+
+void BlockCache::Evict()
+{
+   while (mBytes > mBudget) {
+      if (!mProbation.empty())
+         Drop(mProbation.back());
+      else
+         Drop(mProtected.back());
+   }
+}
+
+bool BlockCache::ReadData(const BlockFile *block, samplePtr data,
+                          sampleFormat format,
+                          sampleCount start, sampleCount len)
+{
+   wxMutexLocker locker(mMutex);
+
+   Entry *entry = Find(Key(block, format));
+   if (!entry) {
+      mMisses++;
+      return false;
+   }
+
+   mHits++;
+   memcpy(data, entry->data + start * SAMPLE_SIZE(format),
+          len * SAMPLE_SIZE(format));
+   return true;
+}
+
+bool BlockCache::HasData(const BlockFile *block, sampleFormat format)
+{
+   wxMutexLocker locker(mMutex);
+
+   return mEntries.find(Key(block, format)) != mEntries.end();
+}
+
+void BlockCache::AddData(const BlockFile *block, samplePtr data,
+                         sampleFormat format, sampleCount len)
+{
+   wxMutexLocker locker(mMutex);
+
+   Add(Key(block, format), (char *)data, len * SAMPLE_SIZE(format));
+}
+
+bool BlockCache::ReadSummary(const BlockFile *block, void *data, int bytes)
+{
+   wxMutexLocker locker(mMutex);
+
+   Entry *entry = Find(Key(block, SUMMARY_KIND));
+   if (!entry || entry->bytes != (size_t)bytes) {
+      mMisses++;
+      return false;
+   }
+
+   mHits++;
+   memcpy(data, entry->data, bytes);
+   return true;
+}
+
+void BlockCache::AddSummary(const BlockFile *block, const void *data, int bytes)
+{
+   char *copy = (char *)malloc(bytes);
+   if (!copy)
+      return;
+   memcpy(copy, data, bytes);
+
+   wxMutexLocker locker(mMutex);
+
+   Add(Key(block, SUMMARY_KIND), copy, bytes);
+}
+
+void BlockCache::Remove(const BlockFile *block)
+{
+   wxMutexLocker locker(mMutex);
+
+   // All keys of block are adjacent in the map
+   EntryMap::iterator iter = mEntries.lower_bound(Key(block, SUMMARY_KIND));
+   while (iter != mEntries.end() && iter->first.first == block) {
+      Entry *entry = iter->second;
+      iter++;
+      Drop(entry);
+   }
+}
+
+void BlockCache::Clear()
+{
+   wxMutexLocker locker(mMutex);
+
+   while (!mEntries.empty())
+      Drop(mEntries.begin()->second);
+}
+
+void BlockCache::SetBudget(size_t bytes)
+{
+   wxMutexLocker locker(mMutex);
+
+   mBudget = bytes;
+   Evict();
+}
+
+void BlockCache::GetStats(wxLongLong *hits, wxLongLong *misses, size_t *bytes)
+{
+   wxMutexLocker locker(mMutex);
+
+   *hits = mHits;
+   *misses = mMisses;
+   *bytes = mBytes;
+}
+
+void BlockCache::ResetStats()
+{
+   wxMutexLocker locker(mMutex);
+
+   mHits = 0;
+   mMisses = 0;
+}
@@ -0,0 +1,99 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCKCACHE__
+#define __AUDACITY_BLOCKCACHE__
+
+#include <list>
+#include <map>
+
+#include <wx/thread.h>
+
+#include "SampleFormat.h"
+#include "Sequence.h"
+
+class BlockFile;
+
+/// Process-wide cache of decoded BlockFile samples and summaries,
+/// bounded by a byte budget.
+///
+/// Entries are whole blocks, keyed by the BlockFile and the format they
+/// were read in (or the summary).  Eviction is segmented LRU: a new entry
+/// starts on probation and is promoted to the protected segment when it
+/// is hit again, so one pass over a long track can't flush the blocks
+/// that are read over and over (previews, scrubbing, drawing).
+class BlockCache {
+ public:
+   static BlockCache & Get();
+
+   /// Copy len samples from start of block's data in format, if cached
+   bool ReadData(const BlockFile *block, samplePtr data, sampleFormat format,
+                 sampleCount start, sampleCount len);
+   /// True if all of block's data in format is cached.  Doesn't count
+   /// as a hit or change the order of eviction.
+   bool HasData(const BlockFile *block, sampleFormat format);
+   /// Take ownership of all of block's data, len samples in format
+   /// (allocated by NewSamples())
+   void AddData(const BlockFile *block, samplePtr data, sampleFormat format,
+                sampleCount len);
+
+   /// Copy block's whole summary (bytes long), if cached
+   bool ReadSummary(const BlockFile *block, void *data, int bytes);
+   void AddSummary(const BlockFile *block, const void *data, int bytes);
+
+   /// Drop everything cached for block
+   void Remove(const BlockFile *block);
+   void Clear();
+
+   /// Budget in bytes; 0 disables the cache
+   void SetBudget(size_t bytes);
+   size_t GetBudget() { return mBudget; }
+   /// Whether an entry of bytes is small enough to be kept.  Larger
+   /// ones would take over the cache, so AddData() drops them.
+   bool CanHold(size_t bytes) { return bytes > 0 && bytes <= mBudget / 8; }
+
+   void GetStats(wxLongLong *hits, wxLongLong *misses, size_t *bytes);
+   void ResetStats();
+
+ private:
+   BlockCache();
+   ~BlockCache();
+
+   struct Entry;
+   typedef std::pair<const BlockFile *, int> Key;
+   typedef std::map<Key, Entry *> EntryMap;
+   typedef std::list<Entry *> EntryList;
+
+   struct Entry {
+      Key key;
+      char *data;
+      size_t bytes;
+      bool isProtected;
+      EntryList::iterator pos;
+   };
+
+   Entry *Find(const Key &key);
+   void Add(const Key &key, char *data, size_t bytes);
+   void Drop(Entry *entry);
+   void Evict();
+
+   wxMutex mMutex;
+
+   EntryMap mEntries;
+   EntryList mProbation;  // front is most recent
+   EntryList mProtected;  // front is most recent
+
+   size_t mBudget;
+   size_t mBytes;
+   size_t mProtectedBytes;
+
+   wxLongLong mHits;
+   wxLongLong mMisses;
+};
+
+#endif
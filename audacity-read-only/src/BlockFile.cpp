@@ -45,13 +45,20 @@ out.
 #include <float.h>
 #include <math.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #include <wx/utils.h>
 #include <wx/filefn.h>
 #include <wx/ffile.h>
 #include <wx/log.h>
 #include <wx/math.h>
+#include <wx/thread.h>
 
 #include "BlockFile.h"
+#include "BlockCache.h"
+#include "BlockPrefetcher.h"
 #include "Internat.h"
 
 // msmeyer: Define this to add debug output via printf()
@@ -86,6 +93,26 @@ SummaryInfo::SummaryInfo(sampleCount samples)
 
 char *BlockFile::fullSummary = 0;
 
+// Guards mStats and mHaveStats of all BlockFiles
+static wxMutex gStatsMutex;
+
+// Blocks are made on worker threads as well as the main one, so the
+// serials are handed out atomically
+static volatile long gNextSerial = 0;
+
+static unsigned long NextSerial()
+{
+#if defined(__ATOMIC_RELAXED)
+   return __atomic_fetch_add(&gNextSerial, 1, __ATOMIC_RELAXED);
+#elif defined(__GNUC__)
+   return __sync_fetch_and_add(&gNextSerial, 1);
+#elif defined(_MSC_VER)
+   return _InterlockedIncrement(&gNextSerial) - 1;
+#else
+   return gNextSerial++;
+#endif
+}
+
 /// Initializes the base BlockFile data.  The block is initially
 /// unlocked and its reference count is 1.
 ///
@@ -99,7 +126,9 @@ char *BlockFile::fullSummary = 0;
 BlockFile::BlockFile(wxFileName fileName, sampleCount samples):
    mLockCount(0),
    mRefCount(1),
+   mSerial(NextSerial()),
    mFileName(fileName),
+   mHaveStats(false),
    mLen(samples),
    mSummaryInfo(samples)
 {
@@ -108,6 +137,8 @@ BlockFile::BlockFile(wxFileName fileName, sampleCount samples):
 
 BlockFile::~BlockFile()
 {
+   BlockCache::Get().Remove(this);
+
    if (!IsLocked() && mFileName.HasName())
       wxRemoveFile(mFileName.GetFullPath());
 }
@@ -173,6 +204,8 @@ bool BlockFile::Deref()
    mRefCount--;
    BLOCKFILE_DEBUG_OUTPUT("Deref", mRefCount);
    if (mRefCount <= 0) {
+      // Wait for an I/O thread that may be reading us
+      BlockPrefetcher::Get().Cancel(this);
       delete this;
       return true;
    } else
@@ -299,6 +332,15 @@ void *BlockFile::CalcSummary(samplePtr buffer, sampleCount len,
    mMax = max;
    mRMS = sqrt(sumsq / sumLen);
 
+   if (len == mLen) {
+      SampleStats stats;
+      stats.Add(fbuffer, len, 0);
+
+      wxMutexLocker locker(gStatsMutex);
+      mStats = stats;
+      mHaveStats = true;
+   }
+
    delete[] fbuffer;
 
    return fullSummary;
@@ -370,6 +412,89 @@ void BlockFile::FixSummary(void *data)
    }
 }
 
+/// Retrieves audio data from this BlockFile.  Blocks that read from
+/// disk go through the BlockCache: on a miss the whole block is read
+/// with ReadDataUncached() and kept, so the rest of a sequential pass
+/// and repeated reads of the same region cost a copy.  Blocks too big
+/// for the cache to keep read only the requested range.
+///
+/// @param data   The buffer where the data will be stored
+/// @param format The format the data will be stored in
+/// @param start  The offset in this block file
+/// @param len    The number of samples to read
+int BlockFile::ReadData(samplePtr data, sampleFormat format,
+                        sampleCount start, sampleCount len)
+{
+   BlockCache &cache = BlockCache::Get();
+
+   if (!UseBlockCache() || !IsDataAvailable() ||
+       !cache.CanHold(mLen * SAMPLE_SIZE(format)) ||
+       start < 0 || len < 0 || start + len > mLen)
+      return ReadDataUncached(data, format, start, len);
+
+   if (cache.ReadData(this, data, format, start, len))
+      return len;
+
+   samplePtr blockData = ReadWholeBlock(format);
+   if (!blockData)
+      return ReadDataUncached(data, format, start, len);
+
+   memcpy(data, blockData + start * SAMPLE_SIZE(format),
+          len * SAMPLE_SIZE(format));
+   cache.AddData(this, blockData, format, mLen);
+
+   return len;
+}
+
+samplePtr BlockFile::ReadWholeBlock(sampleFormat format)
+{
+   samplePtr blockData = NewSamples(mLen, format);
+   if (!blockData ||
+       ReadDataUncached(blockData, format, 0, mLen) != mLen || mSilentLog) {
+      // Don't keep a partial read, or the silence of a missing file
+      DeleteSamples(blockData);
+      return NULL;
+   }
+   return blockData;
+}
+
+void BlockFile::Prefetch(sampleFormat format)
+{
+   BlockCache &cache = BlockCache::Get();
+
+   if (!IsDataAvailable())
+      return;
+
+   if (!UseBlockCache() || !cache.CanHold(mLen * SAMPLE_SIZE(format))) {
+      AdviseWillNeed();
+      return;
+   }
+
+   if (cache.HasData(this, format))
+      return;
+
+   samplePtr blockData = ReadWholeBlock(format);
+   if (blockData)
+      cache.AddData(this, blockData, format, mLen);
+}
+
+bool BlockFile::ReadCachedSummary(void *data)
+{
+   BlockCache &cache = BlockCache::Get();
+
+   if (!UseBlockCache() || !IsSummaryAvailable())
+      return ReadSummary(data);
+
+   if (cache.ReadSummary(this, data, mSummaryInfo.totalSummaryBytes))
+      return true;
+
+   bool result = ReadSummary(data);
+   if (result && !mSilentLog)
+      cache.AddSummary(this, data, mSummaryInfo.totalSummaryBytes);
+
+   return result;
+}
+
 /// Retrieves the minimum, maximum, and maximum RMS of the
 /// specified sample data in this block.
 ///
@@ -442,7 +567,7 @@ bool BlockFile::Read256(float *buffer,
    wxASSERT(start >= 0);
 
    char *summary = new char[mSummaryInfo.totalSummaryBytes];
-   this->ReadSummary(summary);
+   this->ReadCachedSummary(summary);
 
    if (start+len > mSummaryInfo.frames256)
       len = mSummaryInfo.frames256 - start;
@@ -466,6 +591,150 @@ bool BlockFile::Read256(float *buffer,
    return true;
 }
 
+/// Retrieves the frames of one level of the in-memory summary pyramid
+/// of this BlockFile.  Level 0 has a frame for every SUMMARY_LEVEL_BASE
+/// samples, and each level above a frame for every four of the level
+/// below, up to the level with a single frame.  Sequence::GetWaveDisplay()
+/// reads these when a pixel is too wide for the 256 summary to be
+/// worth reading.
+///
+/// @param level   Which level
+/// @param *frames Where the number of frames of the level is stored
+/// @return Three floats per frame: min, max and RMS; or NULL if the
+///         summary isn't available yet
+const float *BlockFile::GetSummaryLevel(int level, sampleCount *frames)
+{
+   if (level < 0)
+      return NULL;
+
+   if (mSummaryLevelStarts.empty() && !MakeSummaryLevels())
+      return NULL;
+
+   // One frame covers the block from the top level on
+   if (level + 1 >= (int)mSummaryLevelStarts.size())
+      level = (int)mSummaryLevelStarts.size() - 2;
+
+   sampleCount start = mSummaryLevelStarts[level];
+   *frames = (mSummaryLevelStarts[level + 1] - start) / 3;
+   return &mSummaryLevels[start];
+}
+
+void BlockFile::SetLength(const sampleCount newLen)
+{
+   mLen = newLen;
+
+   wxMutexLocker locker(gStatsMutex);
+   mHaveStats = false;
+}
+
+bool BlockFile::GetStats(SampleStats *stats, bool compute)
+{
+   {
+      wxMutexLocker locker(gStatsMutex);
+      if (mHaveStats) {
+         *stats = mStats;
+         return true;
+      }
+   }
+
+   if (!compute || !IsDataAvailable() || mLen <= 0)
+      return false;
+
+   // Through the BlockCache, as an analysis pass is likely to be
+   // followed by one that reads the block again.  Two threads may both
+   // get here for a block shared between tracks; they make the same.
+   float *buffer = new float[mLen];
+   bool result =
+      ReadData((samplePtr)buffer, floatSample, 0, mLen) == mLen &&
+      !mSilentLog;
+
+   if (result) {
+      SampleStats made;
+      made.Add(buffer, mLen, 0);
+      *stats = made;
+
+      wxMutexLocker locker(gStatsMutex);
+      mStats = made;
+      mHaveStats = true;
+   }
+
+   delete[] buffer;
+
+   return result;
+}
+
+bool BlockFile::MakeSummaryLevels()
+{
+   if (!IsSummaryAvailable() || mLen <= 0)
+      return false;
+
+   sampleCount frames256 = (mLen + 255) / 256;
+   float *summary = new float[frames256 * 3];
+   if (!Read256(summary, 0, frames256)) {
+      delete[] summary;
+      return false;
+   }
+
+   // Level 0 combines groups of 256 frames, the others groups of
+   // four frames of the level below; RMS is combined weighted by the
+   // samples each frame covers, which is less for the last one
+   sampleCount srcStart = -1; // the 256 summary; else in mSummaryLevels
+   sampleCount srcFrames = frames256;
+   sampleCount srcFrameLen = 256;
+   sampleCount group = SUMMARY_LEVEL_BASE / 256;
+
+   mSummaryLevelStarts.push_back(0);
+
+   for (;;) {
+      sampleCount frameLen = srcFrameLen * group;
+      sampleCount frames = (mLen + frameLen - 1) / frameLen;
+      sampleCount levelStart = mSummaryLevels.size();
+
+      mSummaryLevels.resize(levelStart + frames * 3);
+      const float *src =
+         srcStart < 0 ? summary : &mSummaryLevels[srcStart];
+      float *dst = &mSummaryLevels[levelStart];
+
+      for (sampleCount i = 0; i < frames; i++) {
+         float min = FLT_MAX;
+         float max = -FLT_MAX;
+         double sumsq = 0;
+         sampleCount counted = 0;
+
+         for (sampleCount j = i * group; j < (i + 1) * group && j < srcFrames; j++) {
+            sampleCount len = mLen - j * srcFrameLen;
+            if (len > srcFrameLen)
+               len = srcFrameLen;
+
+            if (src[3 * j] < min)
+               min = src[3 * j];
+            if (src[3 * j + 1] > max)
+               max = src[3 * j + 1];
+            sumsq += (double)src[3 * j + 2] * src[3 * j + 2] * len;
+            counted += len;
+         }
+
+         dst[3 * i] = min;
+         dst[3 * i + 1] = max;
+         dst[3 * i + 2] = counted > 0 ? (float)sqrt(sumsq / counted) : 0.0f;
+      }
+
+      mSummaryLevelStarts.push_back(mSummaryLevels.size());
+
+      if (frames <= 1)
+         break;
+
+      srcStart = levelStart;
+      srcFrames = frames;
+      srcFrameLen = frameLen;
+      group = 4;
+   }
+
+   delete[] summary;
+
+   return true;
+}
+
 /// Retrieves a portion of the 64K summary buffer from this BlockFile.  This
 /// data provides information about the minimum value, the maximum
 /// value, and the maximum RMS value for every group of 64K samples in the
@@ -481,7 +750,7 @@ bool BlockFile::Read64K(float *buffer,
    wxASSERT(start >= 0);
 
    char *summary = new char[mSummaryInfo.totalSummaryBytes];
-   this->ReadSummary(summary);
+   this->ReadCachedSummary(summary);
 
    if (start+len > mSummaryInfo.frames64K)
       len = mSummaryInfo.frames64K - start;
@@ -632,6 +901,7 @@ bool AliasBlockFile::ReadSummary(void *data)
 /// DirManager::EnsureSafeFilename().
 void AliasBlockFile::ChangeAliasedFileName(wxFileName newAliasedFile)
 {
+   BlockCache::Get().Remove(this);
    mAliasedFileName = newAliasedFile;
 }
 
@@ -12,6 +12,8 @@
 #ifndef __AUDACITY_BLOCKFILE__
 #define __AUDACITY_BLOCKFILE__
 
+#include <vector>
+
 #include <wx/string.h>
 #include <wx/ffile.h>
 #include <wx/filename.h>
@@ -22,6 +24,10 @@
 #include "xml/XMLWriter.h"
 
 
+// Frame size of the first level of BlockFile::GetSummaryLevel(); each
+// level above has frames four times as long
+#define SUMMARY_LEVEL_BASE 4096
+
 class SummaryInfo {
  public:
    SummaryInfo(sampleCount samples);
@@ -51,9 +57,12 @@ class BlockFile {
 
    // Reading
 
-   /// Retrieves audio data from this BlockFile
-   virtual int ReadData(samplePtr data, sampleFormat format,
-                        sampleCount start, sampleCount len) = 0;
+   /// Retrieves audio data from this BlockFile, through the BlockCache
+   int ReadData(samplePtr data, sampleFormat format,
+                sampleCount start, sampleCount len);
+   /// Brings the whole block into memory ahead of ReadData() calls in
+   /// format.  Called by the BlockPrefetcher's threads.
+   void Prefetch(sampleFormat format);
 
    // Other Properties
 
@@ -75,7 +84,7 @@ class BlockFile {
    virtual void SetFileName(wxFileName &name);
 
    virtual sampleCount GetLength() { return mLen; }
-   virtual void SetLength(const sampleCount newLen) { mLen = newLen; }
+   virtual void SetLength(const sampleCount newLen);
 
    /// Locks this BlockFile, to prevent it from being moved
    virtual void Lock();
@@ -93,10 +102,28 @@ class BlockFile {
    virtual bool Read256(float *buffer, sampleCount start, sampleCount len);
    /// Returns the 64K summary data block
    virtual bool Read64K(float *buffer, sampleCount start, sampleCount len);
+   /// Min, max and RMS of frames of SUMMARY_LEVEL_BASE << (2 * level)
+   /// samples, as Read256() gives them, for levels up to the one whose
+   /// single frame covers the block; levels above give that one.  Made
+   /// from the 256 summary the first time, then kept in memory.  NULL
+   /// if the summary isn't available yet.
+   const float *GetSummaryLevel(int level, sampleCount *frames);
+   /// SampleStats of the whole block.  Made as CalcSummary() makes the
+   /// summary, or else read from the data the first time if compute,
+   /// then kept in memory; not saved.  False if they aren't known and
+   /// can't be read.  May be called on several threads at once.
+   bool GetStats(SampleStats *stats, bool compute = true);
+
+   /// Unlike its address, which a later BlockFile may reuse, this is
+   /// different for each BlockFile made in a session
+   unsigned long GetSerial() { return mSerial; }
 
    /// Returns TRUE if this block references another disk file
    virtual bool IsAlias() { return false; }
 
+   /// Returns TRUE if this block keeps its data in the project's block pack
+   virtual bool IsPacked() { return false; }
+
    /// Returns TRUE if this block's complete summary has been computed and is ready (for OD)
    virtual bool IsSummaryAvailable(){return true;}
 
@@ -144,12 +171,31 @@ class BlockFile {
    virtual bool Deref();
    virtual int RefCount(){return mRefCount;}
 
+   bool MakeSummaryLevels();
+
+   /// All of the block's data in format, bypassing the BlockCache, or
+   /// NULL if it couldn't all be read.  Free with DeleteSamples().
+   samplePtr ReadWholeBlock(sampleFormat format);
+
  protected:
+   /// Retrieves audio data, bypassing the BlockCache.  Derived classes
+   /// implement.
+   virtual int ReadDataUncached(samplePtr data, sampleFormat format,
+                                sampleCount start, sampleCount len) = 0;
+   /// Whether data and summary reads should go through the BlockCache.
+   /// Blocks that don't read from disk to get them say no.
+   virtual bool UseBlockCache() { return true; }
+   /// Tell the OS this block's file is about to be read, for blocks
+   /// that don't use the BlockCache
+   virtual void AdviseWillNeed() {}
+
    /// Calculate summary data for the given sample data
    virtual void *CalcSummary(samplePtr buffer, sampleCount len,
                              sampleFormat format);
    /// Read the summary section of the file.  Derived classes implement.
    virtual bool ReadSummary(void *data) = 0;
+   /// ReadSummary(), through the BlockCache
+   bool ReadCachedSummary(void *data);
 
    /// Byte-swap the summary data, in case it was saved by a system
    /// on a different platform
@@ -159,6 +205,17 @@ class BlockFile {
    int mLockCount;
    int mRefCount;
 
+   unsigned long mSerial;
+
+   // GetSummaryLevel()'s frames, level after level, and where each
+   // level starts
+   std::vector<float> mSummaryLevels;
+   std::vector<sampleCount> mSummaryLevelStarts;
+
+   // What GetStats() gives, once mHaveStats
+   SampleStats mStats;
+   bool mHaveStats;
+
    static char *fullSummary;
 
  protected:
@@ -197,8 +254,8 @@ class AliasBlockFile : public BlockFile
    // Reading
 
    /// Retrieves audio data from the aliased file.
-   virtual int ReadData(samplePtr data, sampleFormat format,
-                        sampleCount start, sampleCount len) = 0;
+   virtual int ReadDataUncached(samplePtr data, sampleFormat format,
+                                sampleCount start, sampleCount len) = 0;
 
    virtual wxLongLong GetSpaceUsage();
 
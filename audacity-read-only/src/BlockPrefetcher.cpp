@@ -0,0 +1,286 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockPrefetcher.cpp
+
+*******************************************************************//**
+
+\class BlockPrefetcher
+\brief Reads BlockFiles ahead of sequential readers on a small pool of
+I/O threads.
+
+How far ahead is "/AudioIO/PrefetchBlocks" (4 by default, 0 turns it
+off), the number of threads "/AudioIO/PrefetchThreads" (2 by default).
+Several threads let reads of many tracks overlap, which matters most on
+network storage, where each read waits on a round trip.
+
+The threads are started on the first request.  A BlockFile that is
+being read can't be deleted underneath a thread, because
+BlockFile::Deref() calls Cancel() first.
+
+*//****************************************************************//**
+
+\class PrefetchThread
+\brief One I/O thread of the BlockPrefetcher.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "BlockPrefetcher.h"
+
+#include "BlockFile.h"
+#include "Prefs.h"
+
+// Requests beyond this many waiting are dropped; the reader is far
+// behind anyway
+#define MAX_QUEUED_BLOCKS 256
+
+// Completed requests nobody read (playback stopped, or jumped) are
+// forgotten when there are more than this many
+#define MAX_TRACKED_BLOCKS 1024
+
+class PrefetchThread : public wxThread {
+ public:
+   PrefetchThread(BlockPrefetcher *prefetcher):
+      wxThread(wxTHREAD_JOINABLE), mPrefetcher(prefetcher) {}
+   virtual ExitCode Entry()
+   {
+      mPrefetcher->Run();
+      return 0;
+   }
+ private:
+   BlockPrefetcher *mPrefetcher;
+};
+
+BlockPrefetcher & BlockPrefetcher::Get()
+{
+   static BlockPrefetcher prefetcher;
+   return prefetcher;
+}
+
+void BlockPrefetcher::Deinit()
+{
+   BlockPrefetcher &prefetcher = Get();
+
+   prefetcher.mMutex.Lock();
+   prefetcher.mStopping = true;
+   prefetcher.mMutex.Unlock();
+
+   prefetcher.StopThreads();
+}
+
+BlockPrefetcher::BlockPrefetcher():
+   mWorkAvailable(mMutex),
+   mJobFinished(mMutex),
+   mStopping(false),
+   mHits(0),
+   mLate(0),
+   mRequests(0)
+{
+   mDepth = gPrefs->Read(wxT("/AudioIO/PrefetchBlocks"), 4L);
+   if (mDepth < 0)
+      mDepth = 0;
+   mNumThreads = gPrefs->Read(wxT("/AudioIO/PrefetchThreads"), 2L);
+   if (mNumThreads < 1)
+      mNumThreads = 1;
+}
+
+BlockPrefetcher::~BlockPrefetcher()
+{
+   // Deinit() has normally stopped them already
+   mMutex.Lock();
+   mStopping = true;
+   mMutex.Unlock();
+
+   StopThreads();
+}
+
+void BlockPrefetcher::StartThreads()
+{
+   // Called with mMutex locked
+   for (int i = 0; i < mNumThreads; i++) {
+      PrefetchThread *thread = new PrefetchThread(this);
+      if (thread->Create() != wxTHREAD_NO_ERROR) {
+         delete thread;
+         break;
+      }
+      thread->SetPriority(WXTHREAD_DEFAULT_PRIORITY);
+      thread->Run();
+      mThreads.push_back(thread);
+   }
+}
+
+void BlockPrefetcher::StopThreads()
+{
+   mMutex.Lock();
+   std::vector<PrefetchThread *> threads;
+   threads.swap(mThreads);
+   mQueue.clear();
+   mWorkAvailable.Broadcast();
+   mMutex.Unlock();
+
+   for (size_t i = 0; i < threads.size(); i++) {
+      threads[i]->Wait();
+      delete threads[i];
+   }
+
+   mMutex.Lock();
+   mStates.clear();
+   mMutex.Unlock();
+}
+
+void BlockPrefetcher::Run()
+{
+   wxMutexLocker locker(mMutex);
+
+   for (;;) {
+      while (mQueue.empty() && !mStopping)
+         mWorkAvailable.Wait();
+      if (mStopping)
+         return;
+
+      Job job = mQueue.front();
+      mQueue.pop_front();
+      mStates[job.block] = Reading;
+
+      mMutex.Unlock();
+      job.block->Prefetch(job.format);
+      mMutex.Lock();
+
+      std::map<BlockFile *, State>::iterator iter = mStates.find(job.block);
+      if (iter->second == Abandoned)
+         mStates.erase(iter);
+      else
+         iter->second = Done;
+      mJobFinished.Broadcast();
+   }
+}
+
+void BlockPrefetcher::Request(BlockFile *block, sampleFormat format)
+{
+   wxMutexLocker locker(mMutex);
+
+   if (mStopping || mDepth == 0 || mQueue.size() >= MAX_QUEUED_BLOCKS)
+      return;
+   if (mStates.find(block) != mStates.end())
+      return;
+
+   if (mStates.size() >= MAX_TRACKED_BLOCKS) {
+      std::map<BlockFile *, State>::iterator iter = mStates.begin();
+      while (iter != mStates.end()) {
+         if (iter->second == Done)
+            mStates.erase(iter++);
+         else
+            iter++;
+      }
+   }
+
+   if (mThreads.empty())
+      StartThreads();
+   if (mThreads.empty())
+      return;
+
+   Job job;
+   job.block = block;
+   job.format = format;
+   mQueue.push_back(job);
+   mStates[block] = Queued;
+   mRequests++;
+
+   mWorkAvailable.Signal();
+}
+
+void BlockPrefetcher::NoteRead(BlockFile *block)
+{
+   wxMutexLocker locker(mMutex);
+
+   std::map<BlockFile *, State>::iterator iter = mStates.find(block);
+   if (iter == mStates.end())
+      return;
+
+   switch (iter->second) {
+   case Done:
+      mHits++;
+      break;
+   case Queued:
+      // The reader will read it itself
+      for (std::deque<Job>::iterator job = mQueue.begin();
+           job != mQueue.end(); job++) {
+         if (job->block == block) {
+            mQueue.erase(job);
+            break;
+         }
+      }
+      mLate++;
+      break;
+   case Reading:
+      // Keep it until the thread is done, so Cancel() still waits
+      iter->second = Abandoned;
+      mLate++;
+      return;
+   case Abandoned:
+      return;
+   }
+
+   mStates.erase(iter);
+}
+
+void BlockPrefetcher::Cancel(BlockFile *block)
+{
+   wxMutexLocker locker(mMutex);
+
+   for (;;) {
+      std::map<BlockFile *, State>::iterator iter = mStates.find(block);
+      if (iter == mStates.end())
+         return;
+
+      if (iter->second != Reading && iter->second != Abandoned)
+         break;
+
+      // A thread is reading it; it will wake us when it's done
+      mJobFinished.Wait();
+   }
+
+   for (std::deque<Job>::iterator job = mQueue.begin();
+        job != mQueue.end(); job++) {
+      if (job->block == block) {
+         mQueue.erase(job);
+         break;
+      }
+   }
+   mStates.erase(block);
+}
+
+void BlockPrefetcher::SetDepth(int depth)
+{
+   wxMutexLocker locker(mMutex);
+
+   mDepth = depth > 0 ? depth : 0;
+   if (mDepth == 0) {
+      // Waiting requests are of no use now; the threads stay idle
+      while (!mQueue.empty()) {
+         mStates.erase(mQueue.front().block);
+         mQueue.pop_front();
+      }
+   }
+}
+
+void BlockPrefetcher::GetStats(wxLongLong *hits, wxLongLong *late,
+                               wxLongLong *requests)
+{
+   wxMutexLocker locker(mMutex);
+
+   *hits = mHits;
+   *late = mLate;
+   *requests = mRequests;
+}
+
+void BlockPrefetcher::ResetStats()
+{
+   wxMutexLocker locker(mMutex);
+
+   mHits = 0;
+   mLate = 0;
+   mRequests = 0;
+}
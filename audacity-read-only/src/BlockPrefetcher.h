@@ -0,0 +1,97 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockPrefetcher.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCKPREFETCHER__
+#define __AUDACITY_BLOCKPREFETCHER__
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <wx/thread.h>
+
+#include "SampleFormat.h"
+
+class BlockFile;
+class PrefetchThread;
+
+/// Reads BlockFiles on background threads ahead of a sequential reader.
+///
+/// Sequence::Get() notices when a read starts where the previous one
+/// ended and Request()s the next few blocks.  The I/O threads read each
+/// of them whole into the BlockCache (or, for blocks that don't use the
+/// cache, ask the OS to read them ahead), so by the time the reader gets
+/// there the data is in memory.  Counting whether a request had finished
+/// when the reader arrived gives the hit rate.
+class BlockPrefetcher {
+ public:
+   static BlockPrefetcher & Get();
+   /// Stop the I/O threads; called once at exit
+   static void Deinit();
+
+   /// Queue block to be read in format.  Does nothing if it is already
+   /// queued or read.
+   void Request(BlockFile *block, sampleFormat format);
+   /// A reader is about to read block.  Counts a hit if it was
+   /// prefetched, and drops the request if it wasn't started yet.
+   void NoteRead(BlockFile *block);
+   /// Forget block, waiting for a thread that is reading it.  Must be
+   /// called before block is destroyed.
+   void Cancel(BlockFile *block);
+
+   /// Number of blocks to read ahead of a sequential reader; 0 turns
+   /// prefetching off
+   int GetDepth() { return mDepth; }
+   void SetDepth(int depth);
+
+   /// hits: reads of blocks that were prefetched in time;
+   /// late: reads of blocks still queued or being read;
+   /// requests: blocks queued
+   void GetStats(wxLongLong *hits, wxLongLong *late, wxLongLong *requests);
+   void ResetStats();
+
+ private:
+   BlockPrefetcher();
+   ~BlockPrefetcher();
+
+   enum State {
+      Queued,
+      Reading,
+      Abandoned,  // being read, but the reader got there first
+      Done
+   };
+
+   struct Job {
+      BlockFile *block;
+      sampleFormat format;
+   };
+
+   friend class PrefetchThread;
+   /// Body of each I/O thread
+   void Run();
+   void StartThreads();
+   void StopThreads();
+
+   wxMutex mMutex;
+   wxCondition mWorkAvailable;
+   wxCondition mJobFinished;
+
+   std::deque<Job> mQueue;
+   std::map<BlockFile *, State> mStates;
+   std::vector<PrefetchThread *> mThreads;
+   bool mStopping;
+
+   int mDepth;
+   int mNumThreads;
+
+   wxLongLong mHits;
+   wxLongLong mLate;
+   wxLongLong mRequests;
+};
+
+#endif
@@ -94,6 +94,7 @@
 #include "blockfile/PCMAliasBlockFile.h"
 #include "blockfile/ODPCMAliasBlockFile.h"
 #include "blockfile/ODDecodeBlockFile.h"
+#include "blockfile/PackedBlockFile.h"
 #include "DirManager.h"
 #include "Internat.h"
 #include "Project.h"
@@ -320,6 +321,7 @@ bool DirManager::dontDeleteTempFiles = false;
 
 
 DirManager::DirManager()
+: mBlockFileMutex(wxMUTEX_RECURSIVE)
 {
    wxLogDebug(wxT("DirManager: Created new instance."));
 
@@ -350,6 +352,11 @@ DirManager::DirManager()
    mLoadingTarget = NULL;
    mMaxSamples = -1;
 
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   mBlockPack = NULL;
+   gPrefs->Read(wxT("/Directories/PackBlockFiles"), &mPackBlockFiles, false);
+#endif
+
    // toplevel pool hash is fully populated to begin
    {
       int i;
@@ -370,6 +377,11 @@ DirManager::~DirManager()
 {
    wxASSERT(mRef == 0); // MM: Otherwise, we shouldn't delete it
 
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   if (mBlockPack)
+      mBlockPack->Deref();
+#endif
+
    numDirManagers--;
    if (numDirManagers == 0) {
       CleanTempDir();
@@ -442,6 +454,32 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
       saved version of the old project must not be moved,
       otherwise the old project would not be safe.) */
 
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   // The block pack goes as a whole, copied if any of its blocks are
+   // locked; MoveOrCopyToNewProjectDirectory() then only renames its
+   // blocks.
+   wxString oldPackPath;
+   bool copyPack = false;
+   if (mBlockPack) {
+      BlockHash::iterator iter = mBlockFileHash.begin();
+      while ((iter != mBlockFileHash.end()) && !copyPack)
+      {
+         BlockFile *b = iter->second;
+         copyPack = b->IsPacked() && b->IsLocked();
+         iter++;
+      }
+
+      oldPackPath = mBlockPack->GetFullPath();
+      if (!mBlockPack->MoveTo(projFull + wxFILE_SEP_PATH + BLOCKPACK_FILENAME,
+                              copyPack)) {
+         this->projFull = oldFull;
+         this->projPath = oldPath;
+         this->projName = oldName;
+         return false;
+      }
+   }
+#endif
+
    /*i18n-hint: This title appears on a dialog that indicates the progress in doing something.*/
    ProgressDialog *progress = new ProgressDialog(_("Progress"),
                                                  _("Saving project data files"));
@@ -489,6 +527,11 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
          count--;
       }
 
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+      if (mBlockPack)
+         mBlockPack->MoveBack(oldPackPath, copyPack);
+#endif
+
       this->projFull = oldFull;
       this->projPath = oldPath;
       this->projName = oldName;
@@ -867,6 +910,13 @@ BlockFile *DirManager::NewSimpleBlockFile(
                                  sampleFormat format,
                                  bool allowDeferredWrite)
 {
+   wxMutexLocker locker(mBlockFileMutex);
+
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   if (mPackBlockFiles)
+      return NewPackedBlockFile(sampleData, sampleLen, format);
+#endif
+
    wxFileName fileName = MakeBlockFileName();
 
    BlockFile *newBlockFile =
@@ -882,6 +932,8 @@ BlockFile *DirManager::NewAliasBlockFile(
                                  wxString aliasedFile, sampleCount aliasStart,
                                  sampleCount aliasLen, int aliasChannel)
 {
+   wxMutexLocker locker(mBlockFileMutex);
+
    wxFileName fileName = MakeBlockFileName();
 
    BlockFile *newBlockFile =
@@ -898,6 +950,8 @@ BlockFile *DirManager::NewODAliasBlockFile(
                                  wxString aliasedFile, sampleCount aliasStart,
                                  sampleCount aliasLen, int aliasChannel)
 {
+   wxMutexLocker locker(mBlockFileMutex);
+
    wxFileName fileName = MakeBlockFileName();
 
    BlockFile *newBlockFile =
@@ -914,6 +968,8 @@ BlockFile *DirManager::NewODDecodeBlockFile(
                                  wxString aliasedFile, sampleCount aliasStart,
                                  sampleCount aliasLen, int aliasChannel, int decodeType)
 {
+   wxMutexLocker locker(mBlockFileMutex);
+
    wxFileName fileName = MakeBlockFileName();
 
    BlockFile *newBlockFile =
@@ -927,13 +983,74 @@ BlockFile *DirManager::NewODDecodeBlockFile(
    return newBlockFile;
 }
 
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+wxFileName DirManager::MakePackedBlockFileName()
+{
+   // Packed blocks have no file of their own, so the name only has to
+   // be unique among the blocks of this project
+   wxString baseFileName;
+   do {
+      baseFileName.Printf(wxT("p%04x%04x"), rand() & 0xffff, rand() & 0xffff);
+   } while (mBlockFileHash.find(baseFileName) != mBlockFileHash.end());
+
+   wxFileName ret;
+   AssignFile(ret, baseFileName, false);
+   return ret;
+}
+
+BlockPack *DirManager::GetBlockPack()
+{
+   if (!mBlockPack) {
+      wxString dir = GetDataFilesDir();
+      if (!wxDirExists(dir) && !wxFileName::Mkdir(dir, 0777, wxPATH_MKDIR_FULL))
+         wxLogSysError(_("mkdir in DirManager::GetBlockPack failed."));
+
+      mBlockPack = new BlockPack(dir + wxFILE_SEP_PATH + BLOCKPACK_FILENAME);
+   }
+   return mBlockPack;
+}
+
+BlockFile *DirManager::NewPackedBlockFile(
+                                 samplePtr sampleData, sampleCount sampleLen,
+                                 sampleFormat format)
+{
+   BlockPack *pack = GetBlockPack();
+
+   if (pack->IsOk()) {
+      wxFileName fileName = MakePackedBlockFileName();
+
+      PackedBlockFile *newBlockFile =
+          new PackedBlockFile(fileName, pack, sampleData, sampleLen, format);
+
+      if (newBlockFile->IsRecordAvailable()) {
+         mBlockFileHash[fileName.GetName()]=newBlockFile;
+         return newBlockFile;
+      }
+
+      delete newBlockFile;
+   }
+
+   // Pack not writable (or of the other byte order): use a file of its own
+   wxFileName fileName = MakeBlockFileName();
+
+   BlockFile *newBlockFile =
+       new SimpleBlockFile(fileName, sampleData, sampleLen, format);
+
+   mBlockFileHash[fileName.GetName()]=newBlockFile;
+
+   return newBlockFile;
+}
+#endif
+
 bool DirManager::ContainsBlockFile(BlockFile *b)
 {
+   wxMutexLocker locker(mBlockFileMutex);
    return b ? mBlockFileHash[b->GetFileName().GetName()] == b : false;
 }
 
 bool DirManager::ContainsBlockFile(wxString filepath)
 {
+   wxMutexLocker locker(mBlockFileMutex);
    // check what the hash returns in case the blockfile is from a different project
    return mBlockFileHash[filepath] != NULL;
 }
@@ -943,6 +1060,21 @@ bool DirManager::ContainsBlockFile(wxString filepath)
 // the BlockFile.
 BlockFile *DirManager::CopyBlockFile(BlockFile *b)
 {
+   wxMutexLocker locker(mBlockFileMutex);
+
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   if (b->IsPacked() && ((PackedBlockFile *)b)->GetPack() != GetBlockPack()) {
+      // The block belongs to another project, whose pack won't be saved
+      // with this one: copy its record into ours.
+      wxFileName newFile = MakePackedBlockFileName();
+      BlockFile *b2 = ((PackedBlockFile *)b)->CopyTo(newFile, GetBlockPack());
+
+      if (b2)
+         mBlockFileHash[newFile.GetName()]=b2;
+      return b2;
+   }
+#endif
+
    if (!b->IsLocked()) {
       b->Ref();
       //mchinen:July 13 2009 - not sure about this, but it needs to be added to the hash to be able to save if not locked.
@@ -961,6 +1093,15 @@ BlockFile *DirManager::CopyBlockFile(BlockFile *b)
       // Block files with uninitialized filename (i.e. SilentBlockFile)
       // just need an in-memory copy.
       b2 = b->Copy(wxFileName());
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   else if (b->IsPacked())
+   {
+      // Records are never changed, so the copy shares this one's
+      wxFileName newFile = MakePackedBlockFileName();
+      b2 = b->Copy(newFile);
+      mBlockFileHash[newFile.GetName()]=b2;
+   }
+#endif
    else
    {
       wxFileName newFile = MakeBlockFileName();
@@ -1005,6 +1146,10 @@ bool DirManager::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
    }
    else if ( !wxStricmp(tag, wxT("simpleblockfile")) )
       pBlockFile = SimpleBlockFile::BuildFromXML(*this, attrs);
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   else if ( !wxStricmp(tag, wxT("packedblockfile")) )
+      pBlockFile = PackedBlockFile::BuildFromXML(*this, attrs);
+#endif
    else if( !wxStricmp(tag, wxT("pcmaliasblockfile")) )
       pBlockFile = PCMAliasBlockFile::BuildFromXML(*this, attrs);
    else if( !wxStricmp(tag, wxT("odpcmaliasblockfile")) )
@@ -1101,6 +1246,17 @@ bool DirManager::MoveOrCopyToNewProjectDirectory(BlockFile *f, bool copy)
       return true;
    }
 
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   if (f->IsPacked()) {
+      // SetProject() has moved the pack already
+      wxFileName newFileName;
+      if (!this->AssignFile(newFileName, f->GetFileName().GetFullName(), false))
+         return false;
+      f->SetFileName(newFileName);
+      return true;
+   }
+#endif
+
    wxFileName newFileName;
    wxFileName oldFileName=f->GetFileName();
    if (!this->AssignFile(newFileName, f->GetFileName().GetFullName(), false))
@@ -1154,6 +1310,7 @@ bool DirManager::CopyToNewProjectDirectory(BlockFile *f)
 
 void DirManager::Ref(BlockFile * f)
 {
+   wxMutexLocker locker(mBlockFileMutex);
    f->Ref();
    //printf("Ref(%d): %s\n",
    //       f->mRefCount,
@@ -1167,6 +1324,8 @@ int DirManager::GetRefCount(BlockFile * f)
 
 void DirManager::Deref(BlockFile * f)
 {
+   wxMutexLocker locker(mBlockFileMutex);
+
    wxString theFileName = f->GetFileName().GetName();
 
    //printf("Deref(%d): %s\n",
@@ -1332,18 +1491,24 @@ bool DirManager::EnsureSafeFilename(wxFileName fName)
 
 void DirManager::Ref()
 {
+   wxMutexLocker locker(mBlockFileMutex);
    wxASSERT(mRef > 0); // MM: If mRef is smaller, it should have been deleted already
    ++mRef;
 }
 
 void DirManager::Deref()
 {
+   mBlockFileMutex.Lock();
+
    wxASSERT(mRef > 0); // MM: If mRef is smaller, it should have been deleted already
 
    --mRef;
+   bool bDelete = (mRef == 0);
+
+   mBlockFileMutex.Unlock();
 
    // MM: Automatically delete if refcount reaches zero
-   if (mRef == 0)
+   if (bDelete)
       delete this;
 }
 
@@ -1735,6 +1900,19 @@ void DirManager::FindMissingAUs(
    {
       wxString key = iter->first;
       BlockFile *b = iter->second;
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+      if (b->IsPacked())
+      {
+         if (!((PackedBlockFile *)b)->IsRecordAvailable())
+         {
+            missingAUHash[key] = b;
+            wxLogWarning(_("Missing data block '%s' in block pack: '%s'"),
+                           key.c_str(),
+                           ((PackedBlockFile *)b)->GetPack()->GetFullPath().c_str());
+         }
+      }
+      else
+#endif
       if (!b->IsAlias())
       {
          wxFileName fileName = MakeBlockFilePath(key);
@@ -15,11 +15,13 @@
 #include <wx/string.h>
 #include <wx/filename.h>
 #include <wx/hashmap.h>
+#include <wx/thread.h>
 
 #include "WaveTrack.h"
 
 class wxHashTable;
 class BlockFile;
+class BlockPack;
 class SequenceTest;
 
 #define FSCKstatus_CLOSE_REQ 0x1
@@ -70,6 +72,17 @@ class DirManager: public XMLTagHandler {
    BlockFile *NewODDecodeBlockFile( wxString aliasedFile, sampleCount aliasStart,
                                  sampleCount aliasLen, int aliasChannel, int decodeType);
 
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   /// Store the samples in the project's block pack.  Falls back to a
+   /// SimpleBlockFile if the pack can't be written.
+   BlockFile *NewPackedBlockFile(samplePtr sampleData,
+                                 sampleCount sampleLen,
+                                 sampleFormat format);
+
+   /// The pack file of this project, opened or created on first use
+   BlockPack *GetBlockPack();
+#endif
+
    /// Returns true if the blockfile pointed to by b is contained by the DirManager
    bool ContainsBlockFile(BlockFile *b);
    /// Check for existing using filename using complete filename
@@ -159,12 +172,20 @@ class DirManager: public XMLTagHandler {
  private:
 
    wxFileName MakeBlockFileName();
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   wxFileName MakePackedBlockFileName();
+#endif
    wxFileName MakeBlockFilePath(wxString value);
 
    bool MoveOrCopyToNewProjectDirectory(BlockFile *f, bool copy);
 
    int mRef; // MM: Current refcount
 
+   // Held while blockfiles are made, copied, Ref()ed or Deref()ed, and
+   // while mRef changes, so that effects can work on several tracks of
+   // the project at once.  Recursive, as those calls nest.
+   wxMutex mBlockFileMutex;
+
    BlockHash mBlockFileHash; // repository for blockfiles
    DirHash   dirTopPool;    // available toplevel dirs
    DirHash   dirTopFull;    // full toplevel dirs
@@ -190,6 +211,11 @@ class DirManager: public XMLTagHandler {
 
    sampleCount mMaxSamples; // max samples per block
 
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   BlockPack *mBlockPack;
+   bool mPackBlockFiles; // new sample blocks go to mBlockPack
+#endif
+
    static wxString globaltemp;
    wxString mytemp;
    static int numDirManagers;
@@ -27,6 +27,10 @@
   - Triangle dithering
   - Noise-shaped dithering
 
+  Where the CPU has SSE2 or AVX2, conversions and dithers run on the
+  vector kernels of SampleConvert.cpp, a block at a time; only the
+  error feedback of noise shaping stays a loop over single samples.
+
 Dither class. You must construct an instance because it keeps
 state. Call Dither::Apply() to apply the dither. You can call
 Reset() between subsequent dithers to reset the dither state
@@ -208,6 +212,8 @@ Dither::Dither()
 {
     // On startup, initialize dither by resetting values
     Reset();
+
+    InitSampleConvertNoise(mNoiseState, 1);
 }
 
 void Dither::Reset()
@@ -256,6 +262,12 @@ void Dither::Apply(enum DitherType ditherType,
     if (len == 0)
         return; // nothing to do
 
+    // Everything but plain copies can be done on the vector kernels
+    if (destFormat != sourceFormat &&
+        ApplyVector(ditherType, source, sourceFormat, dest, destFormat,
+                    len, sourceStride, destStride))
+        return;
+
     if (destFormat == sourceFormat)
     {
         // No need to dither, because source and destination
@@ -345,6 +357,176 @@ void Dither::Apply(enum DitherType ditherType,
     }
 }
 
+// Samples ApplyVector() converts at a time, in buffers on its stack
+#define VECTOR_BLOCK 1024
+
+// Copy len samples, stride apart in src, to consecutive ones in dst
+template <typename T>
+static void Gather(const T *src, unsigned int stride, T *dst, unsigned int len)
+{
+    for (unsigned int i = 0; i < len; i++, src += stride)
+        dst[i] = *src;
+}
+
+// And back
+template <typename T>
+static void Scatter(const T *src, T *dst, unsigned int stride, unsigned int len)
+{
+    for (unsigned int i = 0; i < len; i++, dst += stride)
+        *dst = src[i];
+}
+
+bool Dither::ApplyVector(enum DitherType ditherType,
+                         const samplePtr source, sampleFormat sourceFormat,
+                         samplePtr dest, sampleFormat destFormat,
+                         unsigned int len,
+                         unsigned int sourceStride,
+                         unsigned int destStride)
+{
+    const SampleConvertKernels *kernels = GetSampleConvertKernels();
+    if (!kernels)
+        return false;
+
+    if ((sourceFormat != int16Sample && sourceFormat != int24Sample &&
+         sourceFormat != floatSample) ||
+        (destFormat != int16Sample && destFormat != int24Sample &&
+         destFormat != floatSample) ||
+        sourceFormat == destFormat)
+        return false;
+
+    bool toFloat = (destFormat == floatSample);
+    bool promote = (sourceFormat == int16Sample && destFormat == int24Sample);
+    bool dither = !toFloat && !promote;
+
+    // Gathering and scattering cost more than these conversions do
+    // one sample at a time
+    if (!dither && (sourceStride != 1 || destStride != 1))
+        return false;
+
+    if (dither)
+    {
+        switch (ditherType)
+        {
+        case none:
+        case rectangle:
+            break;
+        case triangle:
+        case shaped:
+            Reset(); // reset dither filter for this new conversion
+            break;
+        default:
+            return false; // the scalar code complains
+        }
+    }
+
+    // Gathered source samples, and results to scatter
+    union {
+        short int16[VECTOR_BLOCK];
+        int int24[VECTOR_BLOCK];
+        float flt[VECTOR_BLOCK];
+    } in, out;
+    // Samples being dithered, in units of the destination's LSB
+    float samples[VECTOR_BLOCK];
+    // Room for two values per sample, and the one before the block
+    float noise[2 * VECTOR_BLOCK + 1];
+
+    unsigned int sourceStep = SAMPLE_SIZE(sourceFormat) * sourceStride;
+    unsigned int destStep = SAMPLE_SIZE(destFormat) * destStride;
+    unsigned int n, i;
+
+    for (unsigned int done = 0; done < len; done += n)
+    {
+        n = len - done < VECTOR_BLOCK ? len - done : VECTOR_BLOCK;
+
+        char *s = (char *)source + done * sourceStep;
+        char *d = (char *)dest + done * destStep;
+
+        const short *in16 = (const short *)s;
+        const int *in24 = (const int *)s;
+        const float *inFloat = (const float *)s;
+        if (sourceStride != 1)
+        {
+            if (sourceFormat == int16Sample)
+                Gather(in16, sourceStride, in.int16, n);
+            else if (sourceFormat == int24Sample)
+                Gather(in24, sourceStride, in.int24, n);
+            else
+                Gather(inFloat, sourceStride, in.flt, n);
+            in16 = in.int16;
+            in24 = in.int24;
+            inFloat = in.flt;
+        }
+
+        short *out16 = destStride == 1 ? (short *)d : out.int16;
+        int *out24 = destStride == 1 ? (int *)d : out.int24;
+        float *outFloat = destStride == 1 ? (float *)d : out.flt;
+
+        if (toFloat)
+        {
+            if (sourceFormat == int16Sample)
+                kernels->Int16ToFloat(in16, outFloat, n, 1.0f / CONVERT_DIV16);
+            else
+                kernels->Int24ToFloat(in24, outFloat, n, 1.0f / CONVERT_DIV24);
+        } else
+        if (promote)
+            kernels->Int16ToInt24(in16, out24, n);
+        else
+        {
+            // As FROM_... and PROMOTE_TO_... do
+            float scale =
+                destFormat == int16Sample ? CONVERT_DIV16 : CONVERT_DIV24;
+            if (sourceFormat == floatSample)
+                kernels->ClipFloat(inFloat, samples, n, scale);
+            else
+                kernels->Int24ToFloat(in24, samples, n,
+                                      CONVERT_DIV16 / CONVERT_DIV24);
+
+            switch (ditherType)
+            {
+            case none:
+                break;
+            case rectangle:
+                kernels->UniformNoise(mNoiseState, noise, n);
+                kernels->SubtractNoise(samples, noise, n);
+                break;
+            case triangle:
+                noise[0] = mTriangleState;
+                kernels->UniformNoise(mNoiseState, noise + 1, n);
+                kernels->AddHighPassNoise(samples, noise, n);
+                mTriangleState = noise[n];
+                break;
+            case shaped:
+                // The filter feeds back each sample's error into the
+                // next, so only the noise is made in vectors
+                kernels->UniformNoise(mNoiseState, noise, 2 * n);
+                for (i = 0; i < n; i++)
+                    samples[i] = ShapedDither(samples[i],
+                                              noise[2 * i] + noise[2 * i + 1]);
+                break;
+            default:
+                break;
+            }
+
+            if (destFormat == int16Sample)
+                kernels->FloatToInt16(samples, out16, n);
+            else
+                kernels->FloatToInt24(samples, out24, n);
+        }
+
+        if (destStride != 1)
+        {
+            if (destFormat == int16Sample)
+                Scatter(out.int16, (short *)d, destStride, n);
+            else if (destFormat == int24Sample)
+                Scatter(out.int24, (int *)d, destStride, n);
+            else
+                Scatter(out.flt, (float *)d, destStride, n);
+        }
+    }
+
+    return true;
+}
+
 // Dither implementations
 
 // No dither, just return sample
@@ -374,6 +556,13 @@ inline float Dither::ShapedDither(float sample)
 {
     // Generate triangular dither, +-1 LSB, flat psd
     float r = DITHER_NOISE + DITHER_NOISE;
+
+    return ShapedDither(sample, r);
+}
+
+// Shaped dither, given the triangular noise r
+inline float Dither::ShapedDither(float sample, float r)
+{
     if(sample != sample)  // test for NaN
        sample = 0; // and do the best we can with it
 
@@ -11,6 +11,7 @@
 #define __AUDACITY_DITHER_H__
 
 #include "SampleFormat.h"
+#include "SampleConvert.h"
 
 
 class Dither
@@ -37,11 +38,21 @@ public:
                unsigned int destStride = 1);
 
 private:
+    /// Apply() on the kernels of GetSampleConvertKernels(), a block at
+    /// a time; false if there are none and the scalar code must do it
+    bool ApplyVector(DitherType ditherType,
+                     const samplePtr source, sampleFormat sourceFormat,
+                     samplePtr dest, sampleFormat destFormat,
+                     unsigned int len,
+                     unsigned int sourceStride,
+                     unsigned int destStride);
+
     // Dither methods
     float NoDither(float sample);
     float RectangleDither(float sample);
     float TriangleDither(float sample);
     float ShapedDither(float sample);
+    float ShapedDither(float sample, float noise);
 
     // Dither constants
     static const int BUF_SIZE; /* = 8 */
@@ -52,6 +63,10 @@ private:
     int mPhase;
     float mTriangleState;
     float mBuffer[8 /* = BUF_SIZE */];
+
+    // Noise generator of ApplyVector(); not reset by Reset(), so that
+    // each call gets new noise
+    unsigned int mNoiseState[SAMPLE_CONVERT_NOISE_LANES];
 };
 
 #endif /* __AUDACITY_DITHER_H__ */
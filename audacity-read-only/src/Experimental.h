@@ -188,4 +188,12 @@
 
 // Define for new noise reduction effect from Paul Licameli.
 #define EXPERIMENTAL_NOISE_REDUCTION
+
+// Define to allow new sample blocks to go into one memory-mapped pack
+// file per project (blockfile/PackedBlockFile) instead of one .au file
+// each.  Turned on at run time by /Directories/PackBlockFiles.
+// Needs mmap, so not on Windows yet.
+#if !defined(_WIN32)
+#define EXPERIMENTAL_PACKED_BLOCKFILES
+#endif
 #endif
@@ -251,33 +251,7 @@ void FFT(int NumSamples,
 void RealFFT(int NumSamples, float *RealIn, float *RealOut, float *ImagOut)
 {
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   // Remap to RealFFTf() function
-   int i;
-   HFFT hFFT = GetFFT(NumSamples);
-   float *pFFT = new float[NumSamples];
-   // Copy the data into the processing buffer
-   for(i=0; i<NumSamples; i++)
-      pFFT[i] = RealIn[i];
-
-   // Perform the FFT
-   RealFFTf(pFFT, hFFT);
-
-   // Copy the data into the real and imaginary outputs
-   for(i=1;i<(NumSamples/2);i++) {
-      RealOut[i]=pFFT[hFFT->BitReversed[i]  ];
-      ImagOut[i]=pFFT[hFFT->BitReversed[i]+1];
-   }
-   // Handle the (real-only) DC and Fs/2 bins
-   RealOut[0] = pFFT[0];
-   RealOut[i] = pFFT[1];
-   ImagOut[0] = ImagOut[i] = 0;
-   // Fill in the upper half using symmetry properties
-   for(i++ ; i<NumSamples; i++) {
-      RealOut[i] =  RealOut[NumSamples-i];
-      ImagOut[i] = -ImagOut[NumSamples-i];
-   }
-   delete [] pFFT;
-   ReleaseFFT(hFFT);
+   RealFFTBatch(NumSamples, 1, RealIn, RealOut, ImagOut);
 
 #else
 
@@ -345,31 +319,7 @@ void RealFFT(int NumSamples, float *RealIn, float *RealOut, float *ImagOut)
  */
 void InverseRealFFT(int NumSamples, float *RealIn, float *ImagIn, float *RealOut)
 {
-   // Remap to RealFFTf() function
-   int i;
-   HFFT hFFT = GetFFT(NumSamples);
-   float *pFFT = new float[NumSamples];
-   // Copy the data into the processing buffer
-   for(i=0; i<(NumSamples/2); i++)
-      pFFT[2*i  ] = RealIn[i];
-   if(ImagIn == NULL) {
-      for(i=0; i<(NumSamples/2); i++)
-         pFFT[2*i+1] = 0;
-   } else {
-      for(i=0; i<(NumSamples/2); i++)
-         pFFT[2*i+1] = ImagIn[i];
-   }
-   // Put the fs/2 component in the imaginary part of the DC bin
-   pFFT[1] = RealIn[i];
-
-   // Perform the FFT
-   InverseRealFFTf(pFFT, hFFT);
-
-   // Copy the data to the (purely real) output buffer
-   ReorderToTime(hFFT, pFFT, RealOut);
-
-   delete [] pFFT;
-   ReleaseFFT(hFFT);
+   InverseRealFFTBatch(NumSamples, 1, RealIn, ImagIn, RealOut);
 }
 #endif // EXPERIMENTAL_USE_REALFFTF
 
@@ -388,7 +338,8 @@ void InverseRealFFT(int NumSamples, float *RealIn, float *ImagIn, float *RealOut
 void PowerSpectrum(int NumSamples, float *In, float *Out)
 {
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   // Remap to RealFFTf() function
+   // Remap to RealFFTf() function.  Not through PowerSpectrumBatch(),
+   // whose spectra leave out the Fs/2 bin that callers of this one use.
    int i;
    HFFT hFFT = GetFFT(NumSamples);
    float *pFFT = new float[NumSamples];
@@ -478,6 +429,125 @@ void PowerSpectrum(int NumSamples, float *In, float *Out)
 #endif // EXPERIMENTAL_USE_REALFFTF
 }
 
+/*
+ * Batches
+ *
+ * These compute the same as the functions above for count
+ * buffers one after another, handing them all to RealFFTf at
+ * once so it can transform several together.
+ */
+
+void RealFFTBatch(int NumSamples, int count,
+                  float *RealIn, float *RealOut, float *ImagOut)
+{
+#ifdef EXPERIMENTAL_USE_REALFFTF
+   int i, b;
+   HFFT hFFT = GetFFT(NumSamples);
+   float *pFFT = new float[NumSamples * count];
+   // Copy the data into the processing buffers
+   for(i=0; i<NumSamples*count; i++)
+      pFFT[i] = RealIn[i];
+
+   // Perform the FFTs
+   RealFFTfBatch(pFFT, count, hFFT);
+
+   for(b=0; b<count; b++) {
+      float *buffer = pFFT + b*NumSamples;
+      float *re = RealOut + b*NumSamples;
+      float *im = ImagOut + b*NumSamples;
+      // Copy the data into the real and imaginary outputs
+      for(i=1;i<(NumSamples/2);i++) {
+         re[i]=buffer[hFFT->BitReversed[i]  ];
+         im[i]=buffer[hFFT->BitReversed[i]+1];
+      }
+      // Handle the (real-only) DC and Fs/2 bins
+      re[0] = buffer[0];
+      re[i] = buffer[1];
+      im[0] = im[i] = 0;
+      // Fill in the upper half using symmetry properties
+      for(i++ ; i<NumSamples; i++) {
+         re[i] =  re[NumSamples-i];
+         im[i] = -im[NumSamples-i];
+      }
+   }
+   delete [] pFFT;
+   ReleaseFFT(hFFT);
+#else
+   for (int b = 0; b < count; b++)
+      RealFFT(NumSamples, RealIn + b * NumSamples,
+              RealOut + b * NumSamples, ImagOut + b * NumSamples);
+#endif
+}
+
+#ifdef EXPERIMENTAL_USE_REALFFTF
+void InverseRealFFTBatch(int NumSamples, int count,
+                         float *RealIn, float *ImagIn, float *RealOut)
+{
+   int i, b;
+   HFFT hFFT = GetFFT(NumSamples);
+   float *pFFT = new float[NumSamples * count];
+   for(b=0; b<count; b++) {
+      float *buffer = pFFT + b*NumSamples;
+      float *re = RealIn + b*NumSamples;
+      // Copy the data into the processing buffer
+      for(i=0; i<(NumSamples/2); i++)
+         buffer[2*i  ] = re[i];
+      if(ImagIn == NULL) {
+         for(i=0; i<(NumSamples/2); i++)
+            buffer[2*i+1] = 0;
+      } else {
+         float *im = ImagIn + b*NumSamples;
+         for(i=0; i<(NumSamples/2); i++)
+            buffer[2*i+1] = im[i];
+      }
+      // Put the fs/2 component in the imaginary part of the DC bin
+      buffer[1] = re[i];
+   }
+
+   // Perform the FFTs
+   InverseRealFFTfBatch(pFFT, count, hFFT);
+
+   // Copy the data to the (purely real) output buffers
+   for(b=0; b<count; b++)
+      ReorderToTime(hFFT, pFFT + b*NumSamples, RealOut + b*NumSamples);
+
+   delete [] pFFT;
+   ReleaseFFT(hFFT);
+}
+#endif // EXPERIMENTAL_USE_REALFFTF
+
+void PowerSpectrumBatch(int NumSamples, int count, float *In, float *Out)
+{
+#ifdef EXPERIMENTAL_USE_REALFFTF
+   int i, b;
+   HFFT hFFT = GetFFT(NumSamples);
+   float *pFFT = new float[NumSamples * count];
+   // Copy the data into the processing buffers
+   for(i=0; i<NumSamples*count; i++)
+      pFFT[i] = In[i];
+
+   // Perform the FFTs
+   RealFFTfBatch(pFFT, count, hFFT);
+
+   for(b=0; b<count; b++) {
+      float *buffer = pFFT + b*NumSamples;
+      float *out = Out + b*(NumSamples/2);
+      for(i=1;i<NumSamples/2;i++) {
+         out[i]= (buffer[hFFT->BitReversed[i]  ]*buffer[hFFT->BitReversed[i]  ])
+            + (buffer[hFFT->BitReversed[i]+1]*buffer[hFFT->BitReversed[i]+1]);
+      }
+      // Handle the (real-only) DC bin; the Fs/2 bin would be the next
+      // buffer's first
+      out[0] = buffer[0]*buffer[0];
+   }
+   delete [] pFFT;
+   ReleaseFFT(hFFT);
+#else
+   for (int b = 0; b < count; b++)
+      PowerSpectrum(NumSamples, In + b * NumSamples, Out + b * (NumSamples / 2));
+#endif
+}
+
 /*
  * Windowing Functions
  */
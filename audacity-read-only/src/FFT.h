@@ -77,6 +77,26 @@ void InverseRealFFT(int NumSamples,
              float *RealIn, float *ImagIn, float *RealOut);
 #endif
 
+/*
+ * The same as PowerSpectrum(), RealFFT() and InverseRealFFT() on
+ * count buffers of NumSamples, one after another, which is faster
+ * than one at a time.  Each power spectrum is NumSamples/2 values,
+ * without the Fs/2 bin; the other outputs are NumSamples apart.
+ */
+
+/* Buffers worth handing the batch functions at once */
+#define FFT_BATCH 8
+
+void PowerSpectrumBatch(int NumSamples, int count, float *In, float *Out);
+
+void RealFFTBatch(int NumSamples, int count,
+                  float *RealIn, float *RealOut, float *ImagOut);
+
+#ifdef EXPERIMENTAL_USE_REALFFTF
+void InverseRealFFTBatch(int NumSamples, int count,
+                         float *RealIn, float *ImagIn, float *RealOut);
+#endif
+
 /*
  * Computes a FFT of complex input and returns complex output.
  * Currently this is the only function here that supports the
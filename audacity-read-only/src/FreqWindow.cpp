@@ -1063,10 +1063,10 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
    for (i = 0; i < mWindowSize; i++)
       mProcessed[i] = float(0.0);
 
-   float *in = new float[mWindowSize];
+   float *in = new float[mWindowSize * FFT_BATCH];
    float *in2 = new float[mWindowSize];
-   float *out = new float[mWindowSize];
-   float *out2 = new float[mWindowSize];
+   float *out = new float[mWindowSize * FFT_BATCH];
+   float *out2 = new float[mWindowSize * FFT_BATCH];
    float *win = new float[mWindowSize];
 
    // initialize the window
@@ -1085,16 +1085,25 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
 
    int start = 0;
    int windows = 0;
+   int b;
    while (start + mWindowSize <= dataLen) {
-      for (i = 0; i < mWindowSize; i++)
-         in[i] = win[i] * data[start + i];
+      // Transform the windows a batch at a time
+      int count = 0;
+      while (count < FFT_BATCH && start + count * half + mWindowSize <= dataLen) {
+         float *window = in + count * mWindowSize;
+         for (i = 0; i < mWindowSize; i++)
+            window[i] = win[i] * data[start + count * half + i];
+         count++;
+      }
+      int len = mWindowSize * count;
 
    switch (alg) {
       case Spectrum:
-         PowerSpectrum(mWindowSize, in, out);
+         PowerSpectrumBatch(mWindowSize, count, in, out);
 
-         for (i = 0; i < half; i++)
-            mProcessed[i] += out[i];
+         for (b = 0; b < count; b++)
+            for (i = 0; i < half; i++)
+               mProcessed[i] += out[b * half + i];
          break;
 
       case Autocorrelation:
@@ -1103,16 +1112,18 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
 
          // Take FFT
 #ifdef EXPERIMENTAL_USE_REALFFTF
-         RealFFT(mWindowSize, in, out, out2);
+         RealFFTBatch(mWindowSize, count, in, out, out2);
 #else
-         FFT(mWindowSize, false, in, NULL, out, out2);
+         for (b = 0; b < count; b++)
+            FFT(mWindowSize, false, in + b * mWindowSize, NULL,
+                out + b * mWindowSize, out2 + b * mWindowSize);
 #endif
          // Compute power
-         for (i = 0; i < mWindowSize; i++)
+         for (i = 0; i < len; i++)
             in[i] = (out[i] * out[i]) + (out2[i] * out2[i]);
 
          if (alg == Autocorrelation) {
-            for (i = 0; i < mWindowSize; i++)
+            for (i = 0; i < len; i++)
                in[i] = sqrt(in[i]);
          }
          if (alg == CubeRootAutocorrelation ||
@@ -1120,26 +1131,31 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
             // Tolonen and Karjalainen recommend taking the cube root
             // of the power, instead of the square root
 
-            for (i = 0; i < mWindowSize; i++)
+            for (i = 0; i < len; i++)
                in[i] = pow(in[i], 1.0f / 3.0f);
          }
          // Take FFT
 #ifdef EXPERIMENTAL_USE_REALFFTF
-         RealFFT(mWindowSize, in, out, out2);
+         RealFFTBatch(mWindowSize, count, in, out, out2);
 #else
-         FFT(mWindowSize, false, in, NULL, out, out2);
+         for (b = 0; b < count; b++)
+            FFT(mWindowSize, false, in + b * mWindowSize, NULL,
+                out + b * mWindowSize, out2 + b * mWindowSize);
 #endif
 
          // Take real part of result
-         for (i = 0; i < half; i++)
-            mProcessed[i] += out[i];
+         for (b = 0; b < count; b++)
+            for (i = 0; i < half; i++)
+               mProcessed[i] += out[b * mWindowSize + i];
          break;
 
       case Cepstrum:
 #ifdef EXPERIMENTAL_USE_REALFFTF
-         RealFFT(mWindowSize, in, out, out2);
+         RealFFTBatch(mWindowSize, count, in, out, out2);
 #else
-         FFT(mWindowSize, false, in, NULL, out, out2);
+         for (b = 0; b < count; b++)
+            FFT(mWindowSize, false, in + b * mWindowSize, NULL,
+                out + b * mWindowSize, out2 + b * mWindowSize);
 #endif
 
          // Compute log power
@@ -1147,7 +1163,7 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
          {
             float power;
             float minpower = 1e-20*mWindowSize*mWindowSize;
-            for (i = 0; i < mWindowSize; i++)
+            for (i = 0; i < len; i++)
             {
                power = (out[i] * out[i]) + (out2[i] * out2[i]);
                if(power < minpower)
@@ -1157,14 +1173,17 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
             }
             // Take IFFT
 #ifdef EXPERIMENTAL_USE_REALFFTF
-            InverseRealFFT(mWindowSize, in, NULL, out);
+            InverseRealFFTBatch(mWindowSize, count, in, NULL, out);
 #else
-            FFT(mWindowSize, true, in, NULL, out, out2);
+            for (b = 0; b < count; b++)
+               FFT(mWindowSize, true, in + b * mWindowSize, NULL,
+                   out + b * mWindowSize, out2 + b * mWindowSize);
 #endif
 
             // Take real part of result
-            for (i = 0; i < half; i++)
-               mProcessed[i] += out[i];
+            for (b = 0; b < count; b++)
+               for (i = 0; i < half; i++)
+                  mProcessed[i] += out[b * mWindowSize + i];
          }
 
          break;
@@ -1174,13 +1193,13 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
          break;
       }                         //switch
 
-      start += half;
-      windows++;
-      // only update the progress dialogue infrequently to reduce its overhead
-      // If we do it every time, it spends as much time updating X11 as doing
-      // the calculations. 10 seems a reasonable compromise on Linux that
-      // doesn't make it unresponsive, but avoids the slowdown.
-      if (progress && (windows % 10) == 0)
+      start += count * half;
+      windows += count;
+      // only update the progress dialogue once a batch, to reduce its
+      // overhead.  If we do it every window, it spends as much time
+      // updating X11 as doing the calculations; FFT_BATCH windows is
+      // about the 10 that was found a reasonable compromise on Linux.
+      if (progress)
          progress->Update(1 - static_cast<float>(dataLen - start) / dataLen);
    }
 
@@ -27,6 +27,11 @@
 
 #include <math.h>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MIX_USE_SSE
+#endif
+
 #include <wx/textctrl.h>
 #include <wx/msgdlg.h>
 #include <wx/progdlg.h>
@@ -40,8 +45,24 @@
 #include "Prefs.h"
 #include "Project.h"
 #include "Resample.h"
+#include "ThreadPool.h"
 #include "float_cast.h"
 
+/// Renders each input track of a Mixer into its own buffer, on the
+/// ThreadPool
+class MixTracksJob : public ParallelJob {
+ public:
+   MixTracksJob(Mixer *mixer): mMixer(mixer) {}
+   virtual void RunItem(int index, int slot)
+   {
+      mMixer->mTrackOut[index] =
+         mMixer->MixTrack(index, mMixer->mTrackBuffer[index],
+                          mMixer->mThreadEnvValues[slot]);
+   }
+ private:
+   Mixer *mMixer;
+};
+
 //TODO-MB: wouldn't it make more sense to delete the time track after 'mix and render'?
 bool MixAndRender(TrackList *tracks, TrackFactory *trackFactory,
                   double rate, sampleFormat format,
@@ -303,6 +324,13 @@ Mixer::Mixer(int numInputTracks, WaveTrack **inputTracks,
    if (mQueueMaxLen > envLen)
       envLen = mQueueMaxLen;
    mEnvValues = new double[envLen];
+
+   // Buffers for mixing on several threads are made when first needed
+   mNumThreads = 0;
+   mTrackBuffer = NULL;
+   mTrackOut = NULL;
+   mThreadEnvValues = NULL;
+   mNumThreadEnvValues = 0;
 }
 
 Mixer::~Mixer()
@@ -329,6 +357,67 @@ Mixer::~Mixer()
    delete[] mSampleQueue;
    delete[] mQueueStart;
    delete[] mQueueLen;
+
+   FreeThreadBuffers();
+}
+
+void Mixer::SetNumThreads(int threads)
+{
+   mNumThreads = threads;
+}
+
+void Mixer::FreeThreadBuffers()
+{
+   if (mTrackBuffer) {
+      for (int i = 0; i < mNumInputTracks; i++)
+         delete[] mTrackBuffer[i];
+      delete[] mTrackBuffer;
+      delete[] mTrackOut;
+      mTrackBuffer = NULL;
+      mTrackOut = NULL;
+   }
+
+   // Slot 0 is mEnvValues
+   for (int i = 1; i < mNumThreadEnvValues; i++)
+      delete[] mThreadEnvValues[i];
+   delete[] mThreadEnvValues;
+   mThreadEnvValues = NULL;
+   mNumThreadEnvValues = 0;
+}
+
+int Mixer::PrepareThreads()
+{
+   int threads = mNumThreads;
+   if (threads <= 0 || threads > ThreadPool::Get().GetMaxThreads())
+      threads = ThreadPool::Get().GetMaxThreads();
+   if (threads > mNumInputTracks)
+      threads = mNumInputTracks;
+   if (threads <= 1)
+      return 1;
+
+   if (!mTrackBuffer) {
+      mTrackBuffer = new float *[mNumInputTracks];
+      mTrackOut = new sampleCount[mNumInputTracks];
+      for (int i = 0; i < mNumInputTracks; i++)
+         mTrackBuffer[i] = new float[mInterleavedBufferSize];
+   }
+
+   if (mNumThreadEnvValues < threads) {
+      int envLen = mInterleavedBufferSize;
+      if (mQueueMaxLen > envLen)
+         envLen = mQueueMaxLen;
+
+      double **envValues = new double *[threads];
+      envValues[0] = mEnvValues;
+      for (int i = 1; i < threads; i++)
+         envValues[i] = i < mNumThreadEnvValues ?
+            mThreadEnvValues[i] : new double[envLen];
+      delete[] mThreadEnvValues;
+      mThreadEnvValues = envValues;
+      mNumThreadEnvValues = threads;
+   }
+
+   return threads;
 }
 
 void Mixer::ApplyTrackGains(bool apply)
@@ -347,6 +436,32 @@ void MixBuffers(int numChannels, int *channelFlags, float *gains,
                 samplePtr src, samplePtr *dests,
                 int len, bool interleaved)
 {
+   float *temp = (float *)src;
+
+#ifdef MIX_USE_SSE
+   // Stereo into interleaved output: each source sample goes to both
+   // channels, with their gains, four output samples at a time
+   if (interleaved && numChannels == 2 && channelFlags[0] && channelFlags[1]) {
+      float *dest = (float *)dests[0];
+      __m128 g = _mm_setr_ps(gains[0], gains[1], gains[0], gains[1]);
+      int j = 0;
+      for (; j + 4 <= len; j += 4) {
+         __m128 s = _mm_loadu_ps(&temp[j]);
+         __m128 lo = _mm_unpacklo_ps(s, s);
+         __m128 hi = _mm_unpackhi_ps(s, s);
+         _mm_storeu_ps(&dest[2 * j],
+                       _mm_add_ps(_mm_loadu_ps(&dest[2 * j]), _mm_mul_ps(lo, g)));
+         _mm_storeu_ps(&dest[2 * j + 4],
+                       _mm_add_ps(_mm_loadu_ps(&dest[2 * j + 4]), _mm_mul_ps(hi, g)));
+      }
+      for (; j < len; j++) {
+         dest[2 * j] += temp[j] * gains[0];
+         dest[2 * j + 1] += temp[j] * gains[1];
+      }
+      return;
+   }
+#endif
+
    for (int c = 0; c < numChannels; c++) {
       if (!channelFlags[c])
          continue;
@@ -364,18 +479,33 @@ void MixBuffers(int numChannels, int *channelFlags, float *gains,
 
       float gain = gains[c];
       float *dest = (float *)destPtr;
-      float *temp = (float *)src;
-      for (int j = 0; j < len; j++) {
+      int j = 0;
+
+#ifdef MIX_USE_SSE
+      // Same multiply and add per sample as below, so the same result
+      if (skip == 1) {
+         __m128 g = _mm_set1_ps(gain);
+         for (; j + 4 <= len; j += 4) {
+            _mm_storeu_ps(&dest[j],
+                          _mm_add_ps(_mm_loadu_ps(&dest[j]),
+                                     _mm_mul_ps(_mm_loadu_ps(&temp[j]), g)));
+         }
+         dest += j;
+      }
+#endif
+
+      for (; j < len; j++) {
          *dest += temp[j] * gain;   // the actual mixing process
          dest += skip;
       }
    }
 }
 
-sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
+sampleCount Mixer::MixVariableRates(WaveTrack *track,
                                     sampleCount *pos, float *queue,
                                     int *queueStart, int *queueLen,
-                                    Resample * pResample)
+                                    Resample * pResample,
+                                    float *floatBuffer, double *envValues)
 {
    double trackRate = track->GetRate();
    double initialWarp = mRate / trackRate;
@@ -425,13 +555,13 @@ sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
                        *pos,
                        getLen);
 
-            track->GetEnvelopeValues(mEnvValues,
+            track->GetEnvelopeValues(envValues,
                                      getLen,
                                      (*pos) / trackRate,
                                      tstep);
 
             for (int i = 0; i < getLen; i++) {
-               queue[(*queueLen) + i] *= mEnvValues[i];
+               queue[(*queueLen) + i] *= envValues[i];
             }
 
             *queueLen += getLen;
@@ -462,7 +592,7 @@ sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
                                       thisProcessLen,
                                       last,
                                       &input_used,
-                                      &mFloatBuffer[out],
+                                      &floatBuffer[out],
                                       mMaxOut - out);
 
       if (outgen < 0) {
@@ -479,31 +609,13 @@ sampleCount Mixer::MixVariableRates(int *channelFlags, WaveTrack *track,
       }
    }
 
-   for (int c = 0; c < mNumChannels; c++) {
-      if (mApplyTrackGains) {
-         mGains[c] = track->GetChannelGain(c);
-      }
-      else {
-         mGains[c] = 1.0;
-      }
-   }
-
-   MixBuffers(mNumChannels,
-              channelFlags,
-              mGains,
-              (samplePtr)mFloatBuffer,
-              mTemp,
-              out,
-              mInterleaved);
-
    return out;
 }
 
-sampleCount Mixer::MixSameRate(int *channelFlags, WaveTrack *track,
-                               sampleCount *pos)
+sampleCount Mixer::MixSameRate(WaveTrack *track, sampleCount *pos,
+                               float *floatBuffer, double *envValues)
 {
    int slen = mMaxOut;
-   int c;
    double t = *pos / track->GetRate();
    double trackEndTime = track->GetEndTime();
    double tEnd = trackEndTime > mT1 ? mT1 : trackEndTime;
@@ -518,23 +630,70 @@ sampleCount Mixer::MixSameRate(int *channelFlags, WaveTrack *track,
    if (slen > mMaxOut)
       slen = mMaxOut;
 
-   track->Get((samplePtr)mFloatBuffer, floatSample, *pos, slen);
-   track->GetEnvelopeValues(mEnvValues, slen, t, 1.0 / mRate);
+   track->Get((samplePtr)floatBuffer, floatSample, *pos, slen);
+   track->GetEnvelopeValues(envValues, slen, t, 1.0 / mRate);
    for(int i=0; i<slen; i++)
-      mFloatBuffer[i] *= mEnvValues[i]; // Track gain control will go here?
+      floatBuffer[i] *= envValues[i]; // Track gain control will go here?
+
+   *pos += slen;
+
+   return slen;
+}
+
+sampleCount Mixer::MixTrack(int i, float *floatBuffer, double *envValues)
+{
+   WaveTrack *track = mInputTrack[i];
 
-   for(c=0; c<mNumChannels; c++)
+   if (mTimeTrack || track->GetRate() != mRate)
+      return MixVariableRates(track,
+                              &mSamplePos[i], mSampleQueue[i],
+                              &mQueueStart[i], &mQueueLen[i], mResample[i],
+                              floatBuffer, envValues);
+   else
+      return MixSameRate(track, &mSamplePos[i], floatBuffer, envValues);
+}
+
+void Mixer::AddTrack(int i, float *floatBuffer, sampleCount out,
+                     int *channelFlags)
+{
+   WaveTrack *track = mInputTrack[i];
+   int j;
+
+   for(j=0; j<mNumChannels; j++)
+      channelFlags[j] = 0;
+
+   if( mMixerSpec ) {
+      //ignore left and right when downmixing is not required
+      for( j = 0; j < mNumChannels; j++ )
+         channelFlags[ j ] = mMixerSpec->mMap[ i ][ j ] ? 1 : 0;
+   }
+   else {
+      switch(track->GetChannel()) {
+      case Track::MonoChannel:
+      default:
+         for(j=0; j<mNumChannels; j++)
+            channelFlags[j] = 1;
+         break;
+      case Track::LeftChannel:
+         channelFlags[0] = 1;
+         break;
+      case Track::RightChannel:
+         if (mNumChannels >= 2)
+            channelFlags[1] = 1;
+         else
+            channelFlags[0] = 1;
+         break;
+      }
+   }
+
+   for(j=0; j<mNumChannels; j++)
       if (mApplyTrackGains)
-         mGains[c] = track->GetChannelGain(c);
+         mGains[j] = track->GetChannelGain(j);
       else
-         mGains[c] = 1.0;
+         mGains[j] = 1.0;
 
    MixBuffers(mNumChannels, channelFlags, mGains,
-              (samplePtr)mFloatBuffer, mTemp, slen, mInterleaved);
-
-   *pos += slen;
-
-   return slen;
+              (samplePtr)floatBuffer, mTemp, out, mInterleaved);
 }
 
 sampleCount Mixer::Process(sampleCount maxToProcess)
@@ -544,49 +703,36 @@ sampleCount Mixer::Process(sampleCount maxToProcess)
    //if (mT >= mT1)
    //   return 0;
 
-   int i, j;
+   int i;
    sampleCount out;
    sampleCount maxOut = 0;
    int *channelFlags = new int[mNumChannels];
 
    mMaxOut = maxToProcess;
 
+   // Tracks are rendered on several threads, but always added up in
+   // the same order, so the mix doesn't depend on the number of threads
+   int threads = PrepareThreads();
+   if (threads > 1) {
+      MixTracksJob job(this);
+      ThreadPool::Get().Run(job, mNumInputTracks, threads);
+   }
+
    Clear();
    for(i=0; i<mNumInputTracks; i++) {
       WaveTrack *track = mInputTrack[i];
-      for(j=0; j<mNumChannels; j++)
-         channelFlags[j] = 0;
+      float *floatBuffer;
 
-      if( mMixerSpec ) {
-         //ignore left and right when downmixing is not required
-         for( j = 0; j < mNumChannels; j++ )
-            channelFlags[ j ] = mMixerSpec->mMap[ i ][ j ] ? 1 : 0;
+      if (threads > 1) {
+         floatBuffer = mTrackBuffer[i];
+         out = mTrackOut[i];
       }
       else {
-         switch(track->GetChannel()) {
-         case Track::MonoChannel:
-         default:
-            for(j=0; j<mNumChannels; j++)
-               channelFlags[j] = 1;
-            break;
-         case Track::LeftChannel:
-            channelFlags[0] = 1;
-            break;
-         case Track::RightChannel:
-            if (mNumChannels >= 2)
-               channelFlags[1] = 1;
-            else
-               channelFlags[0] = 1;
-            break;
-         }
+         floatBuffer = mFloatBuffer;
+         out = MixTrack(i, floatBuffer, mEnvValues);
       }
 
-      if (mTimeTrack || track->GetRate() != mRate)
-         out = MixVariableRates(channelFlags, track,
-                                &mSamplePos[i], mSampleQueue[i],
-                                &mQueueStart[i], &mQueueLen[i], mResample[i]);
-      else
-         out = MixSameRate(channelFlags, track, &mSamplePos[i]);
+      AddTrack(i, floatBuffer, out, channelFlags);
 
       if (out > maxOut)
          maxOut = out;
@@ -86,6 +86,11 @@ class AUDACITY_DLL_API Mixer {
 
    void ApplyTrackGains(bool apply = true); // True by default
 
+   /// Render input tracks on up to this many threads of the ThreadPool;
+   /// 0 (the default) uses all of them, 1 mixes on the calling thread
+   /// only.  The output is the same for any number.
+   void SetNumThreads(int threads);
+
    //
    // Processing
    //
@@ -116,14 +121,28 @@ class AUDACITY_DLL_API Mixer {
 
  private:
 
+   friend class MixTracksJob;
+
    void Clear();
-   sampleCount MixSameRate(int *channelFlags, WaveTrack *src,
-                           sampleCount *pos);
+   sampleCount MixSameRate(WaveTrack *src, sampleCount *pos,
+                           float *floatBuffer, double *envValues);
 
-   sampleCount MixVariableRates(int *channelFlags, WaveTrack *track,
+   sampleCount MixVariableRates(WaveTrack *track,
                                 sampleCount *pos, float *queue,
                                 int *queueStart, int *queueLen,
-                                Resample * pResample);
+                                Resample * pResample,
+                                float *floatBuffer, double *envValues);
+
+   /// Render input track i, with its envelope, into floatBuffer
+   sampleCount MixTrack(int i, float *floatBuffer, double *envValues);
+   /// Add out samples of track i from floatBuffer into mTemp, with gain
+   /// and panning
+   void AddTrack(int i, float *floatBuffer, sampleCount out,
+                 int *channelFlags);
+
+   /// Number of threads to render on, allocating their buffers
+   int PrepareThreads();
+   void FreeThreadBuffers();
 
  private:
    // Input
@@ -158,6 +177,13 @@ class AUDACITY_DLL_API Mixer {
    float           *mFloatBuffer;
    double           mRate;
    bool             mHighQuality;
+
+   // Rendering on several threads
+   int              mNumThreads;
+   float          **mTrackBuffer;  // one per input track
+   sampleCount     *mTrackOut;
+   double         **mThreadEnvValues;  // one per thread; [0] is mEnvValues
+   int              mNumThreadEnvValues;
 };
 
 #endif
@@ -128,6 +128,7 @@ scroll information.  It also has some status flags.
 #include "export/Export.h"
 #include "FileNames.h"
 #include "BlockFile.h"
+#include "SpectrogramTiles.h"
 #include "ondemand/ODManager.h"
 #include "ondemand/ODTask.h"
 #include "ondemand/ODComputeSummaryTask.h"
@@ -728,6 +729,7 @@ BEGIN_EVENT_TABLE(AudacityProject, wxFrame)
    //mchinen:multithreaded calls - may not be threadsafe with CommandEvent: may have to change.
    EVT_COMMAND(wxID_ANY, EVT_ODTASK_UPDATE, AudacityProject::OnODTaskUpdate)
    EVT_COMMAND(wxID_ANY, EVT_ODTASK_COMPLETE, AudacityProject::OnODTaskComplete)
+   EVT_COMMAND(wxID_ANY, EVT_SPECTROGRAM_TILES, AudacityProject::OnSpectrogramTiles)
 END_EVENT_TABLE()
 
 AudacityProject::AudacityProject(wxWindow * parent, wxWindowID id,
@@ -1744,6 +1746,13 @@ void AudacityProject::OnODTaskComplete(wxCommandEvent & WXUNUSED(event))
       mTrackPanel->Refresh(false);
  }
 
+//redraws spectrograms as their tiles are computed in the background.
+void AudacityProject::OnSpectrogramTiles(wxCommandEvent & WXUNUSED(event))
+{
+   if(mTrackPanel)
+      mTrackPanel->Refresh(false);
+}
+
 void AudacityProject::OnScroll(wxScrollEvent & WXUNUSED(event))
 {
    wxInt64 hlast = mViewInfo.sbarH;
@@ -271,6 +271,7 @@ class AUDACITY_DLL_API AudacityProject:  public wxFrame,
    void OnReleaseKeyboard(wxCommandEvent & event);
    void OnODTaskUpdate(wxCommandEvent & event);
    void OnODTaskComplete(wxCommandEvent & event);
+   void OnSpectrogramTiles(wxCommandEvent & event);
    void OnTrackListUpdated(wxCommandEvent & event);
    bool HandleKeyDown(wxKeyEvent & event);
    bool HandleChar(wxKeyEvent & event);
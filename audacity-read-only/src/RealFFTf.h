@@ -22,5 +22,16 @@ void InverseRealFFTf(fft_type *,HFFT);
 void ReorderToTime(HFFT hFFT, fft_type *buffer, fft_type *TimeOut);
 void ReorderToFreq(HFFT hFFT, fft_type *buffer, fft_type *RealOut, fft_type *ImagOut);
 
+/* count transforms of 2*h->Points samples each, stored one after another,
+   with the same results as RealFFTf() / InverseRealFFTf() on each one */
+void RealFFTfBatch(fft_type *buffers, int count, HFFT h);
+void InverseRealFFTfBatch(fft_type *buffers, int count, HFFT h);
+/* Transforms the batch functions run at once for h's size: 1, or 4 or 8
+   in vector registers, whichever was fastest here */
+int GetRealFFTfBatchLanes(HFFT h);
+/* Run lanes transforms at once for every size, for comparing them; 0
+   goes back to timing each size.  Lowered to what this CPU can do. */
+void SetRealFFTfBatchLanes(int lanes);
+
 #endif
 
@@ -0,0 +1,591 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  RealFFTfBatch.cpp
+
+*******************************************************************//**
+
+\file RealFFTfBatch.cpp
+\brief RealFFTfBatch() and InverseRealFFTfBatch(): several transforms
+of one size at once.
+
+The buffers of a batch are interleaved, so that each lane of a vector
+register holds one of them, and then go through the butterflies of
+RealFFTf() together.  The arithmetic is the same, in the same order,
+so the results are exactly those of RealFFTf() on each buffer.
+
+Whether one transform at a time, 4 (SSE2) or 8 (AVX2) is fastest
+depends on the size, as the interleaved buffer outgrows the caches, so
+the first batch of each size times them and the fastest is kept for
+that size from then on.  Buffers left over from a batch that doesn't
+divide evenly into lanes are transformed one at a time.
+
+*//*******************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wx/defs.h>
+#include <wx/thread.h>
+
+#if defined(__WXMSW__)
+#include <windows.h>
+#elif defined(__WXMAC__)
+#include <mach/mach_time.h>
+#endif
+
+#include "RealFFTf.h"
+#include "SampleConvert.h"
+#include "VectorTargets.h"
+
+// Floats each trial of a size transforms when timing the lanes
+#define TIMING_SAMPLES (1 << 20)
+
+#if defined(VECTOR_SSE2)
+
+//
+// SSE2: RealFFTf() and InverseRealFFTf() with each float a vector of
+// 4 of them
+//
+
+static void RealFFTfSSE2(__m128 *buffer, HFFT h)
+{
+   __m128 *A,*B;
+   const fft_type *sptr;
+   __m128 *endptr1,*endptr2;
+   int *br1,*br2;
+   __m128 HRplus,HRminus,HIplus,HIminus;
+   __m128 v1,v2,sin,cos;
+   const __m128 two = _mm_set1_ps(2.0f);
+   const __m128 half = _mm_set1_ps(0.5f);
+   const __m128 sign = _mm_set1_ps(-0.0f);
+
+   int ButterfliesPerGroup=h->Points/2;
+
+   endptr1=buffer+h->Points*2;
+
+   while(ButterfliesPerGroup>0)
+   {
+      A=buffer;
+      B=buffer+ButterfliesPerGroup*2;
+      sptr=h->SinTable;
+
+      while(A<endptr1)
+      {
+         sin=_mm_set1_ps(*sptr);
+         cos=_mm_set1_ps(*(sptr+1));
+         endptr2=B;
+         while(A<endptr2)
+         {
+            v1=_mm_add_ps(_mm_mul_ps(B[0],cos), _mm_mul_ps(B[1],sin));
+            v2=_mm_sub_ps(_mm_mul_ps(B[0],sin), _mm_mul_ps(B[1],cos));
+            B[0]=_mm_add_ps(A[0],v1);
+            A[0]=_mm_sub_ps(B[0],_mm_mul_ps(two,v1));
+            B[1]=_mm_sub_ps(A[1],v2);
+            A[1]=_mm_add_ps(B[1],_mm_mul_ps(two,v2));
+            A+=2;
+            B+=2;
+         }
+         A=B;
+         B+=ButterfliesPerGroup*2;
+         sptr+=2;
+      }
+      ButterfliesPerGroup >>= 1;
+   }
+   /* Massage output to get the output for a real input sequence. */
+   br1=h->BitReversed+1;
+   br2=h->BitReversed+h->Points-1;
+
+   while(br1<br2)
+   {
+      sin=_mm_set1_ps(h->SinTable[*br1]);
+      cos=_mm_set1_ps(h->SinTable[*br1+1]);
+      A=buffer+*br1;
+      B=buffer+*br2;
+      HRminus=_mm_sub_ps(A[0],B[0]);
+      HRplus=_mm_add_ps(HRminus,_mm_mul_ps(B[0],two));
+      HIminus=_mm_sub_ps(A[1],B[1]);
+      HIplus=_mm_add_ps(HIminus,_mm_mul_ps(B[1],two));
+      v1=_mm_sub_ps(_mm_mul_ps(sin,HRminus),_mm_mul_ps(cos,HIplus));
+      v2=_mm_add_ps(_mm_mul_ps(cos,HRminus),_mm_mul_ps(sin,HIplus));
+      A[0]=_mm_mul_ps(_mm_add_ps(HRplus,v1),half);
+      B[0]=_mm_sub_ps(A[0],v1);
+      A[1]=_mm_mul_ps(_mm_add_ps(HIminus,v2),half);
+      B[1]=_mm_sub_ps(A[1],HIminus);
+
+      br1++;
+      br2--;
+   }
+   /* Handle the center bin (just need a conjugate) */
+   A=buffer+*br1+1;
+   A[0]=_mm_xor_ps(A[0],sign);
+   /* Handle DC and Fs/2 bins separately */
+   /* Put the Fs/2 value into the imaginary part of the DC bin */
+   v1=_mm_sub_ps(buffer[0],buffer[1]);
+   buffer[0]=_mm_add_ps(buffer[0],buffer[1]);
+   buffer[1]=v1;
+}
+
+static void InverseRealFFTfSSE2(__m128 *buffer, HFFT h)
+{
+   __m128 *A,*B;
+   const fft_type *sptr;
+   __m128 *endptr1,*endptr2;
+   int *br1;
+   __m128 HRplus,HRminus,HIplus,HIminus;
+   __m128 v1,v2,sin,cos;
+   const __m128 two = _mm_set1_ps(2.0f);
+   const __m128 half = _mm_set1_ps(0.5f);
+   const __m128 sign = _mm_set1_ps(-0.0f);
+
+   int ButterfliesPerGroup=h->Points/2;
+
+   /* Massage input to get the input for a real output sequence. */
+   A=buffer+2;
+   B=buffer+h->Points*2-2;
+   br1=h->BitReversed+1;
+   while(A<B)
+   {
+      sin=_mm_set1_ps(h->SinTable[*br1]);
+      cos=_mm_set1_ps(h->SinTable[*br1+1]);
+      HRminus=_mm_sub_ps(A[0],B[0]);
+      HRplus=_mm_add_ps(HRminus,_mm_mul_ps(B[0],two));
+      HIminus=_mm_sub_ps(A[1],B[1]);
+      HIplus=_mm_add_ps(HIminus,_mm_mul_ps(B[1],two));
+      v1=_mm_add_ps(_mm_mul_ps(sin,HRminus),_mm_mul_ps(cos,HIplus));
+      v2=_mm_sub_ps(_mm_mul_ps(cos,HRminus),_mm_mul_ps(sin,HIplus));
+      A[0]=_mm_mul_ps(_mm_add_ps(HRplus,v1),half);
+      B[0]=_mm_sub_ps(A[0],v1);
+      A[1]=_mm_mul_ps(_mm_sub_ps(HIminus,v2),half);
+      B[1]=_mm_sub_ps(A[1],HIminus);
+
+      A+=2;
+      B-=2;
+      br1++;
+   }
+   /* Handle center bin (just need conjugate) */
+   A[1]=_mm_xor_ps(A[1],sign);
+   /* Handle DC and Fs/2 bins specially */
+   v1=_mm_mul_ps(half,_mm_add_ps(buffer[0],buffer[1]));
+   v2=_mm_mul_ps(half,_mm_sub_ps(buffer[0],buffer[1]));
+   buffer[0]=v1;
+   buffer[1]=v2;
+
+   endptr1=buffer+h->Points*2;
+
+   while(ButterfliesPerGroup>0)
+   {
+      A=buffer;
+      B=buffer+ButterfliesPerGroup*2;
+      sptr=h->SinTable;
+
+      while(A<endptr1)
+      {
+         sin=_mm_set1_ps(*(sptr++));
+         cos=_mm_set1_ps(*(sptr++));
+         endptr2=B;
+         while(A<endptr2)
+         {
+            v1=_mm_sub_ps(_mm_mul_ps(B[0],cos),_mm_mul_ps(B[1],sin));
+            v2=_mm_add_ps(_mm_mul_ps(B[0],sin),_mm_mul_ps(B[1],cos));
+            B[0]=_mm_mul_ps(_mm_add_ps(A[0],v1),half);
+            A[0]=_mm_sub_ps(B[0],v1);
+            B[1]=_mm_mul_ps(_mm_add_ps(A[1],v2),half);
+            A[1]=_mm_sub_ps(B[1],v2);
+            A+=2;
+            B+=2;
+         }
+         A=B;
+         B+=ButterfliesPerGroup*2;
+      }
+      ButterfliesPerGroup >>= 1;
+   }
+}
+
+#endif // VECTOR_SSE2
+
+#if defined(VECTOR_AVX2)
+
+//
+// AVX2: the same, with vectors of 8
+//
+
+AVX2_TARGET
+static void RealFFTfAVX2(__m256 *buffer, HFFT h)
+{
+   __m256 *A,*B;
+   const fft_type *sptr;
+   __m256 *endptr1,*endptr2;
+   int *br1,*br2;
+   __m256 HRplus,HRminus,HIplus,HIminus;
+   __m256 v1,v2,sin,cos;
+   const __m256 two = _mm256_set1_ps(2.0f);
+   const __m256 half = _mm256_set1_ps(0.5f);
+   const __m256 sign = _mm256_set1_ps(-0.0f);
+
+   int ButterfliesPerGroup=h->Points/2;
+
+   endptr1=buffer+h->Points*2;
+
+   while(ButterfliesPerGroup>0)
+   {
+      A=buffer;
+      B=buffer+ButterfliesPerGroup*2;
+      sptr=h->SinTable;
+
+      while(A<endptr1)
+      {
+         sin=_mm256_set1_ps(*sptr);
+         cos=_mm256_set1_ps(*(sptr+1));
+         endptr2=B;
+         while(A<endptr2)
+         {
+            v1=_mm256_add_ps(_mm256_mul_ps(B[0],cos), _mm256_mul_ps(B[1],sin));
+            v2=_mm256_sub_ps(_mm256_mul_ps(B[0],sin), _mm256_mul_ps(B[1],cos));
+            B[0]=_mm256_add_ps(A[0],v1);
+            A[0]=_mm256_sub_ps(B[0],_mm256_mul_ps(two,v1));
+            B[1]=_mm256_sub_ps(A[1],v2);
+            A[1]=_mm256_add_ps(B[1],_mm256_mul_ps(two,v2));
+            A+=2;
+            B+=2;
+         }
+         A=B;
+         B+=ButterfliesPerGroup*2;
+         sptr+=2;
+      }
+      ButterfliesPerGroup >>= 1;
+   }
+   /* Massage output to get the output for a real input sequence. */
+   br1=h->BitReversed+1;
+   br2=h->BitReversed+h->Points-1;
+
+   while(br1<br2)
+   {
+      sin=_mm256_set1_ps(h->SinTable[*br1]);
+      cos=_mm256_set1_ps(h->SinTable[*br1+1]);
+      A=buffer+*br1;
+      B=buffer+*br2;
+      HRminus=_mm256_sub_ps(A[0],B[0]);
+      HRplus=_mm256_add_ps(HRminus,_mm256_mul_ps(B[0],two));
+      HIminus=_mm256_sub_ps(A[1],B[1]);
+      HIplus=_mm256_add_ps(HIminus,_mm256_mul_ps(B[1],two));
+      v1=_mm256_sub_ps(_mm256_mul_ps(sin,HRminus),_mm256_mul_ps(cos,HIplus));
+      v2=_mm256_add_ps(_mm256_mul_ps(cos,HRminus),_mm256_mul_ps(sin,HIplus));
+      A[0]=_mm256_mul_ps(_mm256_add_ps(HRplus,v1),half);
+      B[0]=_mm256_sub_ps(A[0],v1);
+      A[1]=_mm256_mul_ps(_mm256_add_ps(HIminus,v2),half);
+      B[1]=_mm256_sub_ps(A[1],HIminus);
+
+      br1++;
+      br2--;
+   }
+   /* Handle the center bin (just need a conjugate) */
+   A=buffer+*br1+1;
+   A[0]=_mm256_xor_ps(A[0],sign);
+   /* Handle DC and Fs/2 bins separately */
+   /* Put the Fs/2 value into the imaginary part of the DC bin */
+   v1=_mm256_sub_ps(buffer[0],buffer[1]);
+   buffer[0]=_mm256_add_ps(buffer[0],buffer[1]);
+   buffer[1]=v1;
+}
+
+AVX2_TARGET
+static void InverseRealFFTfAVX2(__m256 *buffer, HFFT h)
+{
+   __m256 *A,*B;
+   const fft_type *sptr;
+   __m256 *endptr1,*endptr2;
+   int *br1;
+   __m256 HRplus,HRminus,HIplus,HIminus;
+   __m256 v1,v2,sin,cos;
+   const __m256 two = _mm256_set1_ps(2.0f);
+   const __m256 half = _mm256_set1_ps(0.5f);
+   const __m256 sign = _mm256_set1_ps(-0.0f);
+
+   int ButterfliesPerGroup=h->Points/2;
+
+   /* Massage input to get the input for a real output sequence. */
+   A=buffer+2;
+   B=buffer+h->Points*2-2;
+   br1=h->BitReversed+1;
+   while(A<B)
+   {
+      sin=_mm256_set1_ps(h->SinTable[*br1]);
+      cos=_mm256_set1_ps(h->SinTable[*br1+1]);
+      HRminus=_mm256_sub_ps(A[0],B[0]);
+      HRplus=_mm256_add_ps(HRminus,_mm256_mul_ps(B[0],two));
+      HIminus=_mm256_sub_ps(A[1],B[1]);
+      HIplus=_mm256_add_ps(HIminus,_mm256_mul_ps(B[1],two));
+      v1=_mm256_add_ps(_mm256_mul_ps(sin,HRminus),_mm256_mul_ps(cos,HIplus));
+      v2=_mm256_sub_ps(_mm256_mul_ps(cos,HRminus),_mm256_mul_ps(sin,HIplus));
+      A[0]=_mm256_mul_ps(_mm256_add_ps(HRplus,v1),half);
+      B[0]=_mm256_sub_ps(A[0],v1);
+      A[1]=_mm256_mul_ps(_mm256_sub_ps(HIminus,v2),half);
+      B[1]=_mm256_sub_ps(A[1],HIminus);
+
+      A+=2;
+      B-=2;
+      br1++;
+   }
+   /* Handle center bin (just need conjugate) */
+   A[1]=_mm256_xor_ps(A[1],sign);
+   /* Handle DC and Fs/2 bins specially */
+   v1=_mm256_mul_ps(half,_mm256_add_ps(buffer[0],buffer[1]));
+   v2=_mm256_mul_ps(half,_mm256_sub_ps(buffer[0],buffer[1]));
+   buffer[0]=v1;
+   buffer[1]=v2;
+
+   endptr1=buffer+h->Points*2;
+
+   while(ButterfliesPerGroup>0)
+   {
+      A=buffer;
+      B=buffer+ButterfliesPerGroup*2;
+      sptr=h->SinTable;
+
+      while(A<endptr1)
+      {
+         sin=_mm256_set1_ps(*(sptr++));
+         cos=_mm256_set1_ps(*(sptr++));
+         endptr2=B;
+         while(A<endptr2)
+         {
+            v1=_mm256_sub_ps(_mm256_mul_ps(B[0],cos),_mm256_mul_ps(B[1],sin));
+            v2=_mm256_add_ps(_mm256_mul_ps(B[0],sin),_mm256_mul_ps(B[1],cos));
+            B[0]=_mm256_mul_ps(_mm256_add_ps(A[0],v1),half);
+            A[0]=_mm256_sub_ps(B[0],v1);
+            B[1]=_mm256_mul_ps(_mm256_add_ps(A[1],v2),half);
+            A[1]=_mm256_sub_ps(B[1],v2);
+            A+=2;
+            B+=2;
+         }
+         A=B;
+         B+=ButterfliesPerGroup*2;
+      }
+      ButterfliesPerGroup >>= 1;
+   }
+}
+
+#endif // VECTOR_AVX2
+
+//
+// Running a batch
+//
+
+// Most lanes this CPU can run
+static int MaxLanes()
+{
+   SampleConvertPath path = GetBestSampleConvertPath();
+#if defined(VECTOR_AVX2)
+   if (path >= convertAVX2)
+      return 8;
+#endif
+#if defined(VECTOR_SSE2)
+   if (path >= convertSSE2)
+      return 4;
+#endif
+   (void)path;
+   return 1;
+}
+
+// Transform count buffers, lanes at a time in scratch, which holds
+// 2 * h->Points * lanes floats, aligned for the vectors
+static void RunBatch(fft_type *buffers, int count, HFFT h, int lanes,
+                     bool inverse, float *scratch)
+{
+   int len = h->Points * 2;
+   int b = 0;
+
+   if (lanes > 1) {
+      for (; b + lanes <= count; b += lanes) {
+         float *first = buffers + b * len;
+         int i, lane;
+
+         for (i = 0; i < len; i++)
+            for (lane = 0; lane < lanes; lane++)
+               scratch[i * lanes + lane] = first[lane * len + i];
+
+#if defined(VECTOR_AVX2)
+         if (lanes == 8) {
+            if (inverse)
+               InverseRealFFTfAVX2((__m256 *)scratch, h);
+            else
+               RealFFTfAVX2((__m256 *)scratch, h);
+         }
+#endif
+#if defined(VECTOR_SSE2)
+         if (lanes == 4) {
+            if (inverse)
+               InverseRealFFTfSSE2((__m128 *)scratch, h);
+            else
+               RealFFTfSSE2((__m128 *)scratch, h);
+         }
+#endif
+
+         for (i = 0; i < len; i++)
+            for (lane = 0; lane < lanes; lane++)
+               first[lane * len + i] = scratch[i * lanes + lane];
+      }
+   }
+
+   for (; b < count; b++) {
+      if (inverse)
+         InverseRealFFTf(buffers + b * len, h);
+      else
+         RealFFTf(buffers + b * len, h);
+   }
+}
+
+// 32-byte aligned, as __m256 must be
+static float *NewScratch(int floats, void **block)
+{
+   *block = malloc(floats * sizeof(float) + 31);
+   return (float *)(((size_t)*block + 31) & ~(size_t)31);
+}
+
+// Lanes for each size, by log2 of its Points; 0 until timed
+static int sLanes[32];
+// Lanes SetRealFFTfBatchLanes() chose for all sizes, or 0
+static int sForcedLanes = 0;
+static wxMutex sLanesMutex;
+
+static int Log2(int n)
+{
+   int bits = 0;
+   while ((1 << bits) < n)
+      bits++;
+   return bits;
+}
+
+// Seconds on a monotonic clock; clock() counts the CPU time of every
+// thread of the process, so other work would be charged to the trial
+static double Now()
+{
+#if defined(__WXMSW__)
+   LARGE_INTEGER count, frequency;
+   QueryPerformanceCounter(&count);
+   QueryPerformanceFrequency(&frequency);
+   return count.QuadPart / (double)frequency.QuadPart;
+#elif defined(__WXMAC__)
+   static mach_timebase_info_data_t timebase;
+   if (timebase.denom == 0)
+      mach_timebase_info(&timebase);
+   return mach_absolute_time() * 1e-9 * timebase.numer / timebase.denom;
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Seconds to run a batch of maxLanes transforms of h's size on lanes,
+// enough times to take about TIMING_SAMPLES floats through
+static double TimeLanes(HFFT h, int lanes, int maxLanes,
+                        float *buffers, float *scratch)
+{
+   int len = h->Points * 2;
+   int repeats = TIMING_SAMPLES / (len * maxLanes);
+   if (repeats < 1)
+      repeats = 1;
+
+   double best = -1;
+   for (int trial = 0; trial < 3; trial++) {
+      double start = Now();
+      for (int r = 0; r < repeats; r++)
+         RunBatch(buffers, maxLanes, h, lanes, false, scratch);
+      double seconds = Now() - start;
+      if (best < 0 || seconds < best)
+         best = seconds;
+   }
+   return best;
+}
+
+int GetRealFFTfBatchLanes(HFFT h)
+{
+   int bits = Log2(h->Points);
+
+   sLanesMutex.Lock();
+   int lanes = sForcedLanes ? sForcedLanes : sLanes[bits];
+   sLanesMutex.Unlock();
+   if (lanes)
+      return lanes;
+
+   // Timed without the lock, so that batches of other sizes go on
+   // meanwhile; two threads may both time a size, and agree on it
+   // closely enough
+   int maxLanes = MaxLanes();
+   int len = h->Points * 2;
+   lanes = 1;
+
+   if (maxLanes > 1) {
+      // Time each on the same noise, which takes the same path through
+      // the arithmetic as real signals do.  It comes from a generator of
+      // its own, as rand()'s sequence belongs to the rest of the program.
+      float *buffers = new float[len * maxLanes];
+      unsigned int seed = 1;
+      for (int i = 0; i < len * maxLanes; i++) {
+         seed = seed * 1664525u + 1013904223u;
+         buffers[i] = (seed >> 8) / (float)(1 << 24) - 0.5f;
+      }
+      void *block;
+      float *scratch = NewScratch(len * maxLanes, &block);
+
+      double best = TimeLanes(h, 1, maxLanes, buffers, scratch);
+      for (int candidate = 4; candidate <= maxLanes; candidate *= 2) {
+         double seconds = TimeLanes(h, candidate, maxLanes, buffers, scratch);
+         if (seconds < best) {
+            best = seconds;
+            lanes = candidate;
+         }
+      }
+
+      free(block);
+      delete[] buffers;
+   }
+
+   sLanesMutex.Lock();
+   if (!sLanes[bits])
+      sLanes[bits] = lanes;
+   lanes = sForcedLanes ? sForcedLanes : sLanes[bits];
+   sLanesMutex.Unlock();
+
+   return lanes;
+}
+
+void SetRealFFTfBatchLanes(int lanes)
+{
+   wxMutexLocker locker(sLanesMutex);
+
+   int maxLanes = MaxLanes();
+   if (lanes > maxLanes)
+      lanes = maxLanes;
+   if (lanes != 0 && lanes != 1 && lanes != 4 && lanes != 8)
+      lanes = 1;
+   sForcedLanes = lanes;
+}
+
+static void Batch(fft_type *buffers, int count, HFFT h, bool inverse)
+{
+   int lanes = (count > 1) ? GetRealFFTfBatchLanes(h) : 1;
+
+   if (lanes == 1 || count < lanes) {
+      RunBatch(buffers, count, h, 1, inverse, NULL);
+      return;
+   }
+
+   void *block;
+   float *scratch = NewScratch(h->Points * 2 * lanes, &block);
+   RunBatch(buffers, count, h, lanes, inverse, scratch);
+   free(block);
+}
+
+void RealFFTfBatch(fft_type *buffers, int count, HFFT h)
+{
+   Batch(buffers, count, h, false);
+}
+
+void InverseRealFFTfBatch(fft_type *buffers, int count, HFFT h)
+{
+   Batch(buffers, count, h, true);
+}
@@ -19,11 +19,63 @@
   AvailForPut and AvailForGet may underestimate but will never
   overestimate.
 
+  Each side publishes its index with release ordering after touching
+  the samples, and reads the other side's index with acquire ordering
+  before touching them, so neither sees samples that aren't completely
+  written (or overwrites samples not yet read), also on CPUs that
+  reorder memory accesses.  The indices are kept on separate cache
+  lines so the two threads don't contend for one.
+
+  Put() and Get() convert between formats; when the format is the
+  buffer's own they are a plain copy.  AcquireForPut() / CommitPut()
+  and AcquireForGet() / CommitGet() let either side work on the
+  samples in place instead.
+
 *//*******************************************************************/
 
 
 #include "RingBuffer.h"
 
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static inline int LoadAcquire(volatile const int *index)
+{
+#if defined(__ATOMIC_ACQUIRE)
+   return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+#elif defined(__GNUC__)
+   int value = *index;
+   __sync_synchronize();
+   return value;
+#elif defined(_MSC_VER)
+   // Volatile reads have acquire semantics in Visual C++
+   int value = *index;
+   _ReadWriteBarrier();
+   return value;
+#else
+   return *index;
+#endif
+}
+
+static inline void StoreRelease(volatile int *index, int value)
+{
+#if defined(__ATOMIC_RELEASE)
+   __atomic_store_n(index, value, __ATOMIC_RELEASE);
+#elif defined(__GNUC__)
+   __sync_synchronize();
+   *index = value;
+#elif defined(_MSC_VER)
+   // Volatile writes have release semantics in Visual C++
+   _ReadWriteBarrier();
+   *index = value;
+#else
+   *index = value;
+#endif
+}
+
 RingBuffer::RingBuffer(sampleFormat format, int size)
 {
    mFormat = format;
@@ -40,7 +92,8 @@ RingBuffer::~RingBuffer()
 
 int RingBuffer::Len()
 {
-   return (mEnd + mBufferSize - mStart) % mBufferSize;
+   return (LoadAcquire(&mEnd) + mBufferSize - LoadAcquire(&mStart)) %
+      mBufferSize;
 }
 
 //
@@ -52,38 +105,51 @@ int RingBuffer::AvailForPut()
    return (mBufferSize-4) - Len();
 }
 
-int RingBuffer::Put(samplePtr buffer, sampleFormat format,
-                    int samplesToCopy)
+int RingBuffer::AcquireForPut(int samples,
+                              samplePtr *first, int *firstLen,
+                              samplePtr *second, int *secondLen)
 {
-   samplePtr src;
-   int block;
-   int copied;
-   int pos;
-   int len = Len();
-
-   if (samplesToCopy > (mBufferSize-4) - len)
-      samplesToCopy = (mBufferSize-4) - len;
-
-   src = buffer;
-   copied = 0;
-   pos = mEnd;
-
-   while(samplesToCopy) {
-      block = samplesToCopy;
-      if (block > mBufferSize - pos)
-         block = mBufferSize - pos;
+   int avail = AvailForPut();
+   int pos = mEnd;
+
+   if (samples > avail)
+      samples = avail;
+   if (samples < 0)
+      samples = 0;
+
+   *first = mBuffer + pos * SAMPLE_SIZE(mFormat);
+   *firstLen = samples;
+   if (*firstLen > mBufferSize - pos)
+      *firstLen = mBufferSize - pos;
+   *second = mBuffer;
+   *secondLen = samples - *firstLen;
+
+   return samples;
+}
 
-      CopySamples(src, format,
-                  mBuffer + pos * SAMPLE_SIZE(mFormat), mFormat,
-                  block);
+void RingBuffer::CommitPut(int samples)
+{
+   StoreRelease(&mEnd, (mEnd + samples) % mBufferSize);
+}
 
-      src += block * SAMPLE_SIZE(format);
-      pos = (pos + block) % mBufferSize;
-      samplesToCopy -= block;
-      copied += block;
+int RingBuffer::Put(samplePtr buffer, sampleFormat format,
+                    int samplesToCopy)
+{
+   samplePtr regions[2];
+   int lens[2];
+   int copied = AcquireForPut(samplesToCopy,
+                              &regions[0], &lens[0], &regions[1], &lens[1]);
+   samplePtr src = buffer;
+
+   for (int i = 0; i < 2; i++) {
+      if (format == mFormat)
+         memcpy(regions[i], src, lens[i] * SAMPLE_SIZE(format));
+      else
+         CopySamples(src, format, regions[i], mFormat, lens[i]);
+      src += lens[i] * SAMPLE_SIZE(format);
    }
 
-   mEnd = pos;
+   CommitPut(copied);
 
    return copied;
 }
@@ -97,35 +163,52 @@ int RingBuffer::AvailForGet()
    return Len();
 }
 
-int RingBuffer::Get(samplePtr buffer, sampleFormat format,
-                    int samplesToCopy)
+int RingBuffer::AcquireForGet(int samples,
+                              samplePtr *first, int *firstLen,
+                              samplePtr *second, int *secondLen)
 {
-   samplePtr dest;
-   int block;
-   int copied;
-   int len = Len();
-
-   if (samplesToCopy > len)
-      samplesToCopy = len;
-
-   dest = buffer;
-   copied = 0;
-
-   while(samplesToCopy) {
-      block = samplesToCopy;
-      if (block > mBufferSize - mStart)
-         block = mBufferSize - mStart;
+   int avail = AvailForGet();
+   int pos = mStart;
+
+   if (samples > avail)
+      samples = avail;
+   if (samples < 0)
+      samples = 0;
+
+   *first = mBuffer + pos * SAMPLE_SIZE(mFormat);
+   *firstLen = samples;
+   if (*firstLen > mBufferSize - pos)
+      *firstLen = mBufferSize - pos;
+   *second = mBuffer;
+   *secondLen = samples - *firstLen;
+
+   return samples;
+}
 
-      CopySamples(mBuffer + mStart * SAMPLE_SIZE(mFormat), mFormat,
-                  dest, format,
-                  block);
+void RingBuffer::CommitGet(int samples)
+{
+   StoreRelease(&mStart, (mStart + samples) % mBufferSize);
+}
 
-      dest += block * SAMPLE_SIZE(format);
-      mStart = (mStart + block) % mBufferSize;
-      samplesToCopy -= block;
-      copied += block;
+int RingBuffer::Get(samplePtr buffer, sampleFormat format,
+                    int samplesToCopy)
+{
+   samplePtr regions[2];
+   int lens[2];
+   int copied = AcquireForGet(samplesToCopy,
+                              &regions[0], &lens[0], &regions[1], &lens[1]);
+   samplePtr dest = buffer;
+
+   for (int i = 0; i < 2; i++) {
+      if (format == mFormat)
+         memcpy(dest, regions[i], lens[i] * SAMPLE_SIZE(format));
+      else
+         CopySamples(regions[i], mFormat, dest, format, lens[i]);
+      dest += lens[i] * SAMPLE_SIZE(format);
    }
 
+   CommitGet(copied);
+
    return copied;
 }
 
@@ -136,7 +219,7 @@ int RingBuffer::Discard(int samplesToDiscard)
    if (samplesToDiscard > len)
       samplesToDiscard = len;
 
-   mStart = (mStart + samplesToDiscard) % mBufferSize;
+   CommitGet(samplesToDiscard);
 
    return samplesToDiscard;
 }
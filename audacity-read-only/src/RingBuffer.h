@@ -13,11 +13,16 @@
 
 #include "SampleFormat.h"
 
+// Room for the indices to sit on cache lines of their own
+#define RINGBUFFER_CACHE_LINE 64
+
 class RingBuffer {
  public:
    RingBuffer(sampleFormat format, int size);
    ~RingBuffer();
 
+   sampleFormat GetFormat() { return mFormat; }
+
    //
    // For the writer only:
    //
@@ -25,6 +30,16 @@ class RingBuffer {
    int AvailForPut();
    int Put(samplePtr buffer, sampleFormat format, int samples);
 
+   /// Free space to write into in place, in GetFormat(): up to
+   /// samples, as one region, or two if it wraps around the end (else
+   /// *secondLen is 0).  Returns *firstLen + *secondLen.  Nothing is
+   /// visible to the reader until CommitPut().
+   int AcquireForPut(int samples,
+                     samplePtr *first, int *firstLen,
+                     samplePtr *second, int *secondLen);
+   /// Publish samples written into the acquired regions
+   void CommitPut(int samples);
+
    //
    // For the reader only:
    //
@@ -33,14 +48,27 @@ class RingBuffer {
    int Get(samplePtr buffer, sampleFormat format, int samples);
    int Discard(int samples);
 
+   /// Samples to read in place, in GetFormat(), as AcquireForPut() does
+   /// for writing.  They stay valid until CommitGet().
+   int AcquireForGet(int samples,
+                     samplePtr *first, int *firstLen,
+                     samplePtr *second, int *secondLen);
+   /// Release samples read from the acquired regions to the writer
+   void CommitGet(int samples);
+
  private:
    int Len();
 
    sampleFormat  mFormat;
-   int           mStart;
-   int           mEnd;
    int           mBufferSize;
    samplePtr     mBuffer;
+
+   // Written only by the reader, and by the writer, respectively
+   char          mPadStart[RINGBUFFER_CACHE_LINE];
+   volatile int  mStart;
+   char          mPadEnd[RINGBUFFER_CACHE_LINE - sizeof(int)];
+   volatile int  mEnd;
+   char          mPadAfter[RINGBUFFER_CACHE_LINE - sizeof(int)];
 };
 
 #endif /*  __AUDACITY_RING_BUFFER__ */
@@ -0,0 +1,551 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleConvert.cpp
+
+*******************************************************************//**
+
+\struct SampleConvertKernels
+\brief SSE2 and AVX2 loops that Dither::Apply() converts and dithers
+samples with.
+
+Which set runs is decided once, from what the CPU reports, and can be
+changed with SetSampleConvertPath(), which tests and benchmarks use to
+compare the paths with each other and with the scalar code in Dither.
+
+Conversions without dither give exactly the results the scalar code
+does: the scale factors are powers of two, and rounding uses the
+current rounding mode as lrintf() does.  Clipping is done on the float
+before rounding, which gives the same ints as clipping after it, since
+the bounds are whole numbers.  NaNs are stored as 0, which is what
+lrintf() comes to where long is 64 bits wide.  Dither noise comes from
+xorshift generators, one per lane, instead of rand(), so it differs
+from the scalar path's, but has the same distribution.
+
+*//*******************************************************************/
+
+// Erik de Castro Lopo's header file that
+// makes sure that we have lrint and lrintf
+// (Note: this file should be included first)
+#include "float_cast.h"
+
+#include "SampleConvert.h"
+
+#include <string.h>
+
+#include "VectorTargets.h"
+
+#if defined(_MSC_VER) && defined(VECTOR_X86)
+#include <intrin.h>
+#endif
+
+// Bounds of the int formats, in the LSB units floats are stored from
+#define INT16_MIN_F -32768.0f
+#define INT16_MAX_F 32767.0f
+#define INT24_MIN_F -8388608.0f
+#define INT24_MAX_F 8388607.0f
+
+//
+// Scalar steps, for the samples at the ends of the vector loops
+//
+
+// Zero NaNs, clip, and round, as the vector stores do
+static inline int RoundClipped(float x, float lo, float hi)
+{
+   x = x == x ? x : 0.0f;
+   x = x > lo ? x : lo;
+   x = x < hi ? x : hi;
+   return lrintf(x);
+}
+
+// Clip as FROM_FLOAT in Dither does, NaNs passing through
+static inline float ClipUnit(float x)
+{
+   x = -1.0f > x ? -1.0f : x;
+   return 1.0f < x ? 1.0f : x;
+}
+
+#if defined(VECTOR_SSE2)
+
+//
+// SSE2
+//
+
+static void Int16ToFloatSSE2(const short *src, float *dst, int len, float scale)
+{
+   const __m128 vscale = _mm_set1_ps(scale);
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+      _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+   }
+   for (; i < len; i++)
+      dst[i] = src[i] * scale;
+}
+
+static void Int24ToFloatSSE2(const int *src, float *dst, int len, float scale)
+{
+   const __m128 vscale = _mm_set1_ps(scale);
+   int i = 0;
+
+   for (; i + 4 <= len; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), vscale));
+   }
+   for (; i < len; i++)
+      dst[i] = src[i] * scale;
+}
+
+static void Int16ToInt24SSE2(const short *src, int *dst, int len)
+{
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_slli_epi32(lo, 8));
+      _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_slli_epi32(hi, 8));
+   }
+   for (; i < len; i++)
+      dst[i] = ((int)src[i]) << 8;
+}
+
+static void ClipFloatSSE2(const float *src, float *dst, int len, float scale)
+{
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 minusOne = _mm_set1_ps(-1.0f);
+   const __m128 vscale = _mm_set1_ps(scale);
+   int i = 0;
+
+   for (; i + 4 <= len; i += 4) {
+      __m128 x = _mm_loadu_ps(src + i);
+      x = _mm_min_ps(one, _mm_max_ps(minusOne, x));
+      _mm_storeu_ps(dst + i, _mm_mul_ps(x, vscale));
+   }
+   for (; i < len; i++)
+      dst[i] = ClipUnit(src[i]) * scale;
+}
+
+// Zero NaNs, and clip
+static inline __m128 ClampSSE2(__m128 x, __m128 lo, __m128 hi)
+{
+   x = _mm_and_ps(x, _mm_cmpord_ps(x, x));
+   return _mm_min_ps(_mm_max_ps(x, lo), hi);
+}
+
+static void FloatToInt16SSE2(const float *src, short *dst, int len)
+{
+   const __m128 lo = _mm_set1_ps(INT16_MIN_F);
+   const __m128 hi = _mm_set1_ps(INT16_MAX_F);
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m128 a = ClampSSE2(_mm_loadu_ps(src + i), lo, hi);
+      __m128 b = ClampSSE2(_mm_loadu_ps(src + i + 4), lo, hi);
+      __m128i v = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+      _mm_storeu_si128((__m128i *)(dst + i), v);
+   }
+   for (; i < len; i++)
+      dst[i] = (short)RoundClipped(src[i], INT16_MIN_F, INT16_MAX_F);
+}
+
+static void FloatToInt24SSE2(const float *src, int *dst, int len)
+{
+   const __m128 lo = _mm_set1_ps(INT24_MIN_F);
+   const __m128 hi = _mm_set1_ps(INT24_MAX_F);
+   int i = 0;
+
+   for (; i + 4 <= len; i += 4) {
+      __m128 x = ClampSSE2(_mm_loadu_ps(src + i), lo, hi);
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_cvtps_epi32(x));
+   }
+   for (; i < len; i++)
+      dst[i] = RoundClipped(src[i], INT24_MIN_F, INT24_MAX_F);
+}
+
+static inline __m128 NoiseStepSSE2(__m128i &x)
+{
+   x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+   x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+   x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+
+   __m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9),
+                               _mm_set1_epi32(0x3f800000));
+   return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.5f));
+}
+
+// Uses the first four lanes of the state
+static void UniformNoiseSSE2(unsigned int *state, float *dst, int len)
+{
+   __m128i x = _mm_loadu_si128((const __m128i *)state);
+   int i = 0;
+
+   for (; i + 4 <= len; i += 4)
+      _mm_storeu_ps(dst + i, NoiseStepSSE2(x));
+   if (i < len) {
+      float rest[4];
+      _mm_storeu_ps(rest, NoiseStepSSE2(x));
+      memcpy(dst + i, rest, (len - i) * sizeof(float));
+   }
+
+   _mm_storeu_si128((__m128i *)state, x);
+}
+
+static void SubtractNoiseSSE2(float *samples, const float *noise, int len)
+{
+   int i = 0;
+
+   for (; i + 4 <= len; i += 4)
+      _mm_storeu_ps(samples + i, _mm_sub_ps(_mm_loadu_ps(samples + i),
+                                            _mm_loadu_ps(noise + i)));
+   for (; i < len; i++)
+      samples[i] = samples[i] - noise[i];
+}
+
+static void AddHighPassNoiseSSE2(float *samples, const float *noise, int len)
+{
+   int i = 0;
+
+   for (; i + 4 <= len; i += 4) {
+      __m128 x = _mm_add_ps(_mm_loadu_ps(samples + i),
+                            _mm_loadu_ps(noise + i + 1));
+      _mm_storeu_ps(samples + i, _mm_sub_ps(x, _mm_loadu_ps(noise + i)));
+   }
+   for (; i < len; i++)
+      samples[i] = samples[i] + noise[i + 1] - noise[i];
+}
+
+static const SampleConvertKernels sKernelsSSE2 = {
+   Int16ToFloatSSE2,
+   Int24ToFloatSSE2,
+   Int16ToInt24SSE2,
+   ClipFloatSSE2,
+   FloatToInt16SSE2,
+   FloatToInt24SSE2,
+   UniformNoiseSSE2,
+   SubtractNoiseSSE2,
+   AddHighPassNoiseSSE2
+};
+
+#endif // VECTOR_SSE2
+
+#if defined(VECTOR_AVX2)
+
+//
+// AVX2
+//
+
+AVX2_TARGET
+static void Int16ToFloatAVX2(const short *src, float *dst, int len, float scale)
+{
+   const __m256 vscale = _mm256_set1_ps(scale);
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m256i v = _mm256_cvtepi16_epi32(
+         _mm_loadu_si128((const __m128i *)(src + i)));
+      _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), vscale));
+   }
+   for (; i < len; i++)
+      dst[i] = src[i] * scale;
+}
+
+AVX2_TARGET
+static void Int24ToFloatAVX2(const int *src, float *dst, int len, float scale)
+{
+   const __m256 vscale = _mm256_set1_ps(scale);
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+      _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), vscale));
+   }
+   for (; i < len; i++)
+      dst[i] = src[i] * scale;
+}
+
+AVX2_TARGET
+static void Int16ToInt24AVX2(const short *src, int *dst, int len)
+{
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m256i v = _mm256_cvtepi16_epi32(
+         _mm_loadu_si128((const __m128i *)(src + i)));
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_slli_epi32(v, 8));
+   }
+   for (; i < len; i++)
+      dst[i] = ((int)src[i]) << 8;
+}
+
+AVX2_TARGET
+static void ClipFloatAVX2(const float *src, float *dst, int len, float scale)
+{
+   const __m256 one = _mm256_set1_ps(1.0f);
+   const __m256 minusOne = _mm256_set1_ps(-1.0f);
+   const __m256 vscale = _mm256_set1_ps(scale);
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m256 x = _mm256_loadu_ps(src + i);
+      x = _mm256_min_ps(one, _mm256_max_ps(minusOne, x));
+      _mm256_storeu_ps(dst + i, _mm256_mul_ps(x, vscale));
+   }
+   for (; i < len; i++)
+      dst[i] = ClipUnit(src[i]) * scale;
+}
+
+AVX2_TARGET
+static inline __m256 ClampAVX2(__m256 x, __m256 lo, __m256 hi)
+{
+   x = _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+   return _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+}
+
+AVX2_TARGET
+static void FloatToInt16AVX2(const float *src, short *dst, int len)
+{
+   const __m256 lo = _mm256_set1_ps(INT16_MIN_F);
+   const __m256 hi = _mm256_set1_ps(INT16_MAX_F);
+   int i = 0;
+
+   for (; i + 16 <= len; i += 16) {
+      __m256 a = ClampAVX2(_mm256_loadu_ps(src + i), lo, hi);
+      __m256 b = ClampAVX2(_mm256_loadu_ps(src + i + 8), lo, hi);
+      // The pack works within 128-bit halves; put them back in order
+      __m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(a),
+                                     _mm256_cvtps_epi32(b));
+      v = _mm256_permute4x64_epi64(v, 0xD8);
+      _mm256_storeu_si256((__m256i *)(dst + i), v);
+   }
+   for (; i < len; i++)
+      dst[i] = (short)RoundClipped(src[i], INT16_MIN_F, INT16_MAX_F);
+}
+
+AVX2_TARGET
+static void FloatToInt24AVX2(const float *src, int *dst, int len)
+{
+   const __m256 lo = _mm256_set1_ps(INT24_MIN_F);
+   const __m256 hi = _mm256_set1_ps(INT24_MAX_F);
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m256 x = ClampAVX2(_mm256_loadu_ps(src + i), lo, hi);
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_cvtps_epi32(x));
+   }
+   for (; i < len; i++)
+      dst[i] = RoundClipped(src[i], INT24_MIN_F, INT24_MAX_F);
+}
+
+AVX2_TARGET
+static inline __m256 NoiseStepAVX2(__m256i &x)
+{
+   x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+   x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+   x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+
+   __m256i bits = _mm256_or_si256(_mm256_srli_epi32(x, 9),
+                                  _mm256_set1_epi32(0x3f800000));
+   return _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.5f));
+}
+
+AVX2_TARGET
+static void UniformNoiseAVX2(unsigned int *state, float *dst, int len)
+{
+   __m256i x = _mm256_loadu_si256((const __m256i *)state);
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8)
+      _mm256_storeu_ps(dst + i, NoiseStepAVX2(x));
+   if (i < len) {
+      float rest[8];
+      _mm256_storeu_ps(rest, NoiseStepAVX2(x));
+      memcpy(dst + i, rest, (len - i) * sizeof(float));
+   }
+
+   _mm256_storeu_si256((__m256i *)state, x);
+}
+
+AVX2_TARGET
+static void SubtractNoiseAVX2(float *samples, const float *noise, int len)
+{
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8)
+      _mm256_storeu_ps(samples + i, _mm256_sub_ps(_mm256_loadu_ps(samples + i),
+                                                  _mm256_loadu_ps(noise + i)));
+   for (; i < len; i++)
+      samples[i] = samples[i] - noise[i];
+}
+
+AVX2_TARGET
+static void AddHighPassNoiseAVX2(float *samples, const float *noise, int len)
+{
+   int i = 0;
+
+   for (; i + 8 <= len; i += 8) {
+      __m256 x = _mm256_add_ps(_mm256_loadu_ps(samples + i),
+                               _mm256_loadu_ps(noise + i + 1));
+      _mm256_storeu_ps(samples + i, _mm256_sub_ps(x, _mm256_loadu_ps(noise + i)));
+   }
+   for (; i < len; i++)
+      samples[i] = samples[i] + noise[i + 1] - noise[i];
+}
+
+static const SampleConvertKernels sKernelsAVX2 = {
+   Int16ToFloatAVX2,
+   Int24ToFloatAVX2,
+   Int16ToInt24AVX2,
+   ClipFloatAVX2,
+   FloatToInt16AVX2,
+   FloatToInt24AVX2,
+   UniformNoiseAVX2,
+   SubtractNoiseAVX2,
+   AddHighPassNoiseAVX2
+};
+
+#endif // VECTOR_AVX2
+
+//
+// Choosing a path
+//
+
+#if defined(VECTOR_X86)
+
+static void CallCpuid(int info[4], int function)
+{
+#if defined(_MSC_VER)
+   __cpuidex(info, function, 0);
+#else
+   __asm__ __volatile__ (
+      "cpuid":
+      "=a" (info[0]),
+      "=b" (info[1]),
+      "=c" (info[2]),
+      "=d" (info[3]) :
+      "a" (function),
+      "c" (0)
+      );
+#endif
+}
+
+// Which register states the OS saves on a context switch
+static unsigned int GetEnabledStates()
+{
+#if defined(_MSC_VER)
+   return (unsigned int)_xgetbv(0);
+#else
+   unsigned int eax, edx;
+   // xgetbv, spelled out for assemblers that don't know it
+   __asm__ __volatile__ (
+      ".byte 0x0f, 0x01, 0xd0":
+      "=a" (eax),
+      "=d" (edx) :
+      "c" (0)
+      );
+   return eax;
+#endif
+}
+
+#endif // VECTOR_X86
+
+static SampleConvertPath DetectPath()
+{
+   SampleConvertPath path = convertScalar;
+
+#if defined(VECTOR_SSE2)
+   int info[4];
+
+   CallCpuid(info, 0);
+   int nIds = info[0];
+   if (nIds < 1)
+      return path;
+
+   CallCpuid(info, 1);
+   if (info[3] & (1 << 26))
+      path = convertSSE2;
+
+#if defined(VECTOR_AVX2)
+   // AVX2 needs the OS to save the YMM registers, too
+   bool osxsave = (info[2] & (1 << 27)) != 0;
+   bool avx = (info[2] & (1 << 28)) != 0;
+   if (path == convertSSE2 && osxsave && avx && nIds >= 7 &&
+       (GetEnabledStates() & 6) == 6) {
+      CallCpuid(info, 7);
+      if (info[1] & (1 << 5))
+         path = convertAVX2;
+   }
+#endif
+#endif
+
+   return path;
+}
+
+static bool sBestPathDetected = false;
+static SampleConvertPath sBestPath = convertScalar;
+static bool sPathSet = false;
+static SampleConvertPath sPath = convertScalar;
+
+SampleConvertPath GetBestSampleConvertPath()
+{
+   if (!sBestPathDetected) {
+      sBestPath = DetectPath();
+      sBestPathDetected = true;
+   }
+   return sBestPath;
+}
+
+SampleConvertPath GetSampleConvertPath()
+{
+   if (!sPathSet) {
+      sPath = GetBestSampleConvertPath();
+      sPathSet = true;
+   }
+   return sPath;
+}
+
+void SetSampleConvertPath(SampleConvertPath path)
+{
+   if (path > GetBestSampleConvertPath())
+      path = GetBestSampleConvertPath();
+   sPath = path;
+   sPathSet = true;
+}
+
+const SampleConvertKernels *GetSampleConvertKernels()
+{
+   switch (GetSampleConvertPath()) {
+#if defined(VECTOR_AVX2)
+   case convertAVX2:
+      return &sKernelsAVX2;
+#endif
+#if defined(VECTOR_SSE2)
+   case convertSSE2:
+      return &sKernelsSSE2;
+#endif
+   default:
+      return NULL;
+   }
+}
+
+void InitSampleConvertNoise(unsigned int *state, unsigned int seed)
+{
+   for (int i = 0; i < SAMPLE_CONVERT_NOISE_LANES; i++) {
+      // Scatter the lanes over the generator's cycle, so that none
+      // repeats another a few samples later (MurmurHash3's finalizer)
+      unsigned int x = seed + (i + 1) * 0x9E3779B9;
+      x ^= x >> 16;
+      x *= 0x85EBCA6B;
+      x ^= x >> 13;
+      x *= 0xC2B2AE35;
+      x ^= x >> 16;
+      // xorshift never leaves, nor reaches, zero
+      state[i] = x ? x : 0x9E3779B9;
+   }
+}
@@ -0,0 +1,58 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleConvert.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_CONVERT__
+#define __AUDACITY_SAMPLE_CONVERT__
+
+/// Instruction sets the conversion kernels can run on
+enum SampleConvertPath {
+   convertScalar = 0,
+   convertSSE2 = 1,
+   convertAVX2 = 2
+};
+
+/// Lanes of the noise generator state that UniformNoise() keeps
+#define SAMPLE_CONVERT_NOISE_LANES 8
+
+/// Vector loops behind Dither::Apply().  Floats that go to an int
+/// format are in units of its LSB.  Stores round to nearest and
+/// saturate, as lrintf() and the clipping in Dither do.
+struct SampleConvertKernels {
+   /// dst = src * scale
+   void (*Int16ToFloat)(const short *src, float *dst, int len, float scale);
+   void (*Int24ToFloat)(const int *src, float *dst, int len, float scale);
+   /// dst = src << 8
+   void (*Int16ToInt24)(const short *src, int *dst, int len);
+   /// dst = src clipped to [-1, 1], times scale; NaNs pass through
+   void (*ClipFloat)(const float *src, float *dst, int len, float scale);
+   void (*FloatToInt16)(const float *src, short *dst, int len);
+   void (*FloatToInt24)(const float *src, int *dst, int len);
+
+   /// Fill dst with white noise in [-0.5, 0.5), advancing state
+   void (*UniformNoise)(unsigned int *state, float *dst, int len);
+   /// samples[i] -= noise[i]
+   void (*SubtractNoise)(float *samples, const float *noise, int len);
+   /// samples[i] += noise[i + 1] - noise[i]
+   void (*AddHighPassNoise)(float *samples, const float *noise, int len);
+};
+
+/// Fastest path this CPU supports
+SampleConvertPath GetBestSampleConvertPath();
+/// Path Dither::Apply() uses; the best one unless set otherwise
+SampleConvertPath GetSampleConvertPath();
+/// Choose the path, for comparing them; it is lowered to the best one
+/// if this CPU can't run it
+void SetSampleConvertPath(SampleConvertPath path);
+
+/// Kernels of the current path, or NULL for the scalar one
+const SampleConvertKernels *GetSampleConvertKernels();
+
+/// Seed the state of UniformNoise()
+void InitSampleConvertNoise(unsigned int *state, unsigned int seed);
+
+#endif
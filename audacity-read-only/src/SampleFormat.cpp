@@ -35,6 +35,7 @@
 *//*******************************************************************/
 
 #include <wx/intl.h>
+#include <wx/thread.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -47,6 +48,9 @@
 static Dither::DitherType gLowQualityDither = Dither::none;
 static Dither::DitherType gHighQualityDither = Dither::none;
 static Dither gDitherAlgorithm;
+// Dithering carries state from one call to the next, so threads take
+// turns; plain conversions don't need it
+static wxMutex gDitherMutex;
 
 void InitDitherers()
 {
@@ -99,9 +103,21 @@ void CopySamples(samplePtr src, sampleFormat srcFormat,
                  unsigned int srcStride /* = 1 */,
                  unsigned int dstStride /* = 1 */)
 {
+   Dither::DitherType ditherType =
+      highQuality ? gHighQualityDither : gLowQualityDither;
+
+   // Only conversions to the integer formats dither; to float, the
+   // samples are only scaled
+   if (ditherType == Dither::none || srcFormat == dstFormat ||
+       (dstFormat != int16Sample && dstFormat != int24Sample)) {
+      gDitherAlgorithm.Apply(
+         ditherType, src, srcFormat, dst, dstFormat, len, srcStride, dstStride);
+      return;
+   }
+
+   wxMutexLocker locker(gDitherMutex);
    gDitherAlgorithm.Apply(
-      highQuality ? gHighQualityDither : gLowQualityDither,
-      src, srcFormat, dst, dstFormat, len, srcStride, dstStride);
+      ditherType, src, srcFormat, dst, dstFormat, len, srcStride, dstStride);
 }
 
 void CopySamplesNoDither(samplePtr src, sampleFormat srcFormat,
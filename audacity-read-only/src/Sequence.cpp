@@ -41,13 +41,94 @@
 
 #include "Sequence.h"
 
+#include "AudacityApp.h"
 #include "BlockFile.h"
+#include "BlockPrefetcher.h"
 #include "blockfile/ODDecodeBlockFile.h"
 #include "DirManager.h"
 
 #include "blockfile/SimpleBlockFile.h"
 #include "blockfile/SilentBlockFile.h"
 
+// SampleStats methods
+SampleStats::SampleStats():
+   len(0), sum(0.0), sumsq(0.0), min(FLT_MAX), max(-FLT_MAX),
+   clipped(0), peak(-1)
+{
+}
+
+void SampleStats::Add(const float *buffer, sampleCount len,
+                      sampleCount offset)
+{
+   double sum = 0.0;
+   double sumsq = 0.0;
+   float min = this->min;
+   float max = this->max;
+   sampleCount clipped = 0;
+   float peakValue = this->peak >= 0 ? wxMax(-this->min, this->max) : 0;
+   sampleCount peak = -1;
+
+   for (sampleCount i = 0; i < len; i++) {
+      float v = buffer[i];
+      sum += v;
+      sumsq += v * v;
+      if (v < min)
+         min = v;
+      if (v > max)
+         max = v;
+
+      float a = fabs(v);
+      if (a >= MAX_AUDIO)
+         clipped++;
+      if (a > peakValue) {
+         peakValue = a;
+         peak = i;
+      }
+   }
+
+   this->len += len;
+   this->sum += sum;
+   this->sumsq += sumsq;
+   this->min = min;
+   this->max = max;
+   this->clipped += clipped;
+   if (peak >= 0)
+      this->peak = offset + peak;
+}
+
+void SampleStats::Add(const SampleStats &other, sampleCount offset)
+{
+   // Runs may come in any order
+   if (other.peak >= 0) {
+      float peakValue = peak >= 0 ? wxMax(-min, max) : 0;
+      float otherPeakValue = wxMax(-other.min, other.max);
+
+      if (otherPeakValue > peakValue ||
+          (otherPeakValue == peakValue && offset + other.peak < peak))
+         peak = offset + other.peak;
+   }
+
+   len += other.len;
+   sum += other.sum;
+   sumsq += other.sumsq;
+   if (other.min < min)
+      min = other.min;
+   if (other.max > max)
+      max = other.max;
+   clipped += other.clipped;
+}
+
+void SampleStats::AddSilence(sampleCount len)
+{
+   this->len += len;
+   if (len > 0) {
+      if (min > 0)
+         min = 0;
+      if (max < 0)
+         max = 0;
+   }
+}
+
 int Sequence::sMaxDiskBlockSize = 1048576;
 
 // Sequence methods
@@ -62,6 +143,10 @@ Sequence::Sequence(DirManager * projDirManager, sampleFormat format)
    mMinSamples = sMaxDiskBlockSize / SAMPLE_SIZE(mSampleFormat) / 2;
    mMaxSamples = mMinSamples * 2;
    mErrorOpening = false;
+   mNextGetStart = -1;
+   mPrefetchedBlock = -1;
+   mDisplayBuffer = NULL;
+   mDisplayBufferLen = 0;
 }
 
 Sequence::Sequence(const Sequence &orig, DirManager *projDirManager)
@@ -77,6 +162,10 @@ Sequence::Sequence(const Sequence &orig, DirManager *projDirManager)
    mMaxSamples = orig.mMaxSamples;
    mMinSamples = orig.mMinSamples;
    mErrorOpening = false;
+   mNextGetStart = -1;
+   mPrefetchedBlock = -1;
+   mDisplayBuffer = NULL;
+   mDisplayBufferLen = 0;
 
    mBlock = new BlockArray();
 
@@ -95,6 +184,8 @@ Sequence::~Sequence()
 
    delete mBlock;
    mDirManager->Deref();
+
+   delete[] mDisplayBuffer;
 }
 
 sampleCount Sequence::GetMaxBlockSize() const
@@ -154,6 +245,8 @@ bool Sequence::ConvertToSampleFormat(sampleFormat format, bool* pbChanged)
    if (format == mSampleFormat)
       return true;
 
+   ResetPrefetch();
+
    if (mBlock->GetCount() == 0)
    {
       mSampleFormat = format;
@@ -356,15 +449,21 @@ bool Sequence::GetRMS(sampleCount start, sampleCount len,
 
    // First calculate the rms of the blocks in the middle of this region;
    // this is very fast because we have the rms of every entire block
-   // already in memory.
+   // already in memory.  Their SampleStats, where known, are exact.
    unsigned int b;
 
    for (b = block0 + 1; b < block1; b++) {
-      float blockMin, blockMax, blockRMS;
-      mBlock->Item(b)->f->GetMinMax(&blockMin, &blockMax, &blockRMS);
+      BlockFile *f = mBlock->Item(b)->f;
+      SampleStats stats;
 
-      sumsq += blockRMS * blockRMS * mBlock->Item(block0)->f->GetLength();
-      length += mBlock->Item(block0)->f->GetLength();
+      if (f->GetStats(&stats, false))
+         sumsq += stats.sumsq;
+      else {
+         float blockMin, blockMax, blockRMS;
+         f->GetMinMax(&blockMin, &blockMax, &blockRMS);
+         sumsq += blockRMS * blockRMS * f->GetLength();
+      }
+      length += f->GetLength();
    }
 
    // Now we take the first and last blocks into account, noting that the
@@ -398,6 +497,45 @@ bool Sequence::GetRMS(sampleCount start, sampleCount len,
    return true;
 }
 
+bool Sequence::GetStats(sampleCount start, sampleCount len,
+                        SampleStats *stats) const
+{
+   *stats = SampleStats();
+
+   if (len <= 0 || mBlock->GetCount() == 0)
+      return true;
+
+   if (start < 0 || start + len > mNumSamples)
+      return false;
+
+   float *buffer = NULL;
+   sampleCount s = start;
+
+   while (s < start + len) {
+      SeqBlock *b = mBlock->Item(FindBlock(s));
+      sampleCount blockStart = s - b->start;
+      sampleCount blockLen = b->f->GetLength() - blockStart;
+      if (blockLen > start + len - s)
+         blockLen = start + len - s;
+
+      SampleStats blockStats;
+      if (blockLen == b->f->GetLength() && b->f->GetStats(&blockStats))
+         stats->Add(blockStats, s - start);
+      else {
+         if (!buffer)
+            buffer = new float[mMaxSamples];
+         Read((samplePtr)buffer, floatSample, b, blockStart, blockLen);
+         stats->Add(buffer, blockLen, s - start);
+      }
+
+      s += blockLen;
+   }
+
+   delete[] buffer;
+
+   return true;
+}
+
 bool Sequence::Copy(sampleCount s0, sampleCount s1, Sequence **dest)
 {
    *dest = 0;
@@ -474,6 +612,8 @@ bool Sequence::Paste(sampleCount s, const Sequence *src)
       return false;
    }
 
+   ResetPrefetch();
+
    if (src->mSampleFormat != mSampleFormat)
    {
       wxLogError(
@@ -728,6 +868,8 @@ bool Sequence::AppendAlias(wxString fullPath,
    if (((double)mNumSamples) + ((double)len) > wxLL(9223372036854775807))
       return false;
 
+   ResetPrefetch();
+
    SeqBlock *newBlock = new SeqBlock();
 
    newBlock->start = mNumSamples;
@@ -747,6 +889,8 @@ bool Sequence::AppendCoded(wxString fName, sampleCount start,
    if (((double)mNumSamples) + ((double)len) > wxLL(9223372036854775807))
       return false;
 
+   ResetPrefetch();
+
    SeqBlock *newBlock = new SeqBlock();
 
    newBlock->start = mNumSamples;
@@ -763,6 +907,8 @@ bool Sequence::AppendBlock(SeqBlock * b)
    if (((double)mNumSamples) + ((double)b->f->GetLength()) > wxLL(9223372036854775807))
       return false;
 
+   ResetPrefetch();
+
    SeqBlock *newBlock = new SeqBlock();
    newBlock->start = mNumSamples;
    newBlock->f = mDirManager->CopyBlockFile(b->f);
@@ -955,6 +1101,8 @@ void Sequence::HandleXMLEndTag(const wxChar *tag)
    if (wxStrcmp(tag, wxT("sequence")) != 0)
       return;
 
+   ResetPrefetch();
+
    // Make sure that the sequence is valid.
    // First, replace missing blockfiles with SilentBlockFiles
    unsigned int b;
@@ -1153,6 +1301,14 @@ bool Sequence::CopyWrite(samplePtr buffer, SeqBlock *b,
    return true;
 }
 
+void Sequence::ResetPrefetch()
+{
+   mPrefetchMutex.Lock();
+   mNextGetStart = -1;
+   mPrefetchedBlock = -1;
+   mPrefetchMutex.Unlock();
+}
+
 bool Sequence::Get(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len) const
 {
@@ -1161,6 +1317,22 @@ bool Sequence::Get(samplePtr buffer, sampleFormat format,
       return false;
    int b = FindBlock(start);
 
+   // A read that starts where the last one ended is part of a
+   // sequential pass; have the blocks ahead of it read in the background
+   BlockPrefetcher &prefetcher = BlockPrefetcher::Get();
+   int depth = prefetcher.GetDepth();
+   mPrefetchMutex.Lock();
+   if (depth > 0 && start == mNextGetStart) {
+      int last = wxMin(b + depth, (int)mBlock->GetCount() - 1);
+      for (int i = wxMax(b, mPrefetchedBlock) + 1; i <= last; i++)
+         prefetcher.Request(mBlock->Item(i)->f, format);
+      mPrefetchedBlock = wxMax(last, mPrefetchedBlock);
+   }
+   else
+      mPrefetchedBlock = b;
+   mNextGetStart = start + len;
+   mPrefetchMutex.Unlock();
+
    while (len) {
       sampleCount blen =
           mBlock->Item(b)->start + mBlock->Item(b)->f->GetLength() - start;
@@ -1168,6 +1340,10 @@ bool Sequence::Get(samplePtr buffer, sampleFormat format,
          blen = len;
       sampleCount bstart = (start - (mBlock->Item(b)->start));
 
+      // A sequential pass enters each block at its start
+      if (depth > 0 && bstart == 0)
+         prefetcher.NoteRead(mBlock->Item(b)->f);
+
       Read(buffer, format, mBlock->Item(b), bstart, blen);
 
       len -= blen;
@@ -1187,6 +1363,8 @@ bool Sequence::Set(samplePtr buffer, sampleFormat format,
        start+len > mNumSamples)
       return false;
 
+   ResetPrefetch();
+
    samplePtr temp = NULL;
    if (format != mSampleFormat) {
       temp = NewSamples(mMaxSamples, mSampleFormat);
@@ -1258,9 +1436,23 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms,int* bl,
    if (s0 >= mNumSamples)
       return false;
 
+   // Pixels of a block or more are drawn from the block pyramid
+   if (samplesPerPixel >= mMaxSamples)
+      return GetWaveDisplayByBlocks(min, max, rms, bl, len, where);
+
+   // Otherwise, from the samples, the 256 summary, or the level of the
+   // blocks' summary pyramids with frames as wide as can fit in a
+   // pixel, so that a pixel never takes more than a few frames
    int divisor;
-   if (samplesPerPixel >= 65536)
-      divisor = 65536;
+   int level = -1;
+   if (samplesPerPixel >= SUMMARY_LEVEL_BASE) {
+      divisor = SUMMARY_LEVEL_BASE;
+      level = 0;
+      while (divisor * 4.0 <= samplesPerPixel) {
+         divisor *= 4;
+         level++;
+      }
+   }
    else if (samplesPerPixel >= 256)
       divisor = 256;
    else
@@ -1273,7 +1465,14 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms,int* bl,
 
    unsigned int block0 = FindBlock(s0);
 
-   float *temp = new float[mMaxSamples];
+   if (mDisplayBufferLen < mMaxSamples) {
+      delete[] mDisplayBuffer;
+      mDisplayBuffer = new float[mMaxSamples];
+      mDisplayBufferLen = mMaxSamples;
+   }
+   float *temp = mDisplayBuffer;
+   // Where the frames of the current block are, temp or a summary level
+   const float *src = temp;
 
    int pixel = 0;
    float theMin = 0.0;
@@ -1294,15 +1493,15 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms,int* bl,
       if (num > (s1 - srcX + divisor - 1) / divisor)
          num = (s1 - srcX + divisor - 1) / divisor;
 
-      switch (divisor) {
-      default:
-      case 1:
+      src = temp;
+
+      if (divisor == 1) {
          Read((samplePtr)temp, floatSample, mBlock->Item(b),
               srcX - mBlock->Item(b)->start, num);
 
          blockStatus=b;
-         break;
-      case 256:
+      }
+      else if (divisor == 256) {
          //check to see if summary data has been computed
          if(mBlock->Item(b)->f->IsSummaryAvailable())
          {
@@ -1315,20 +1514,21 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms,int* bl,
             //otherwise, mark the display as not yet computed
             blockStatus=-1-b;
          }
-         break;
-      case 65536:
-         //check to see if summary data has been computed
-         if(mBlock->Item(b)->f->IsSummaryAvailable())
-         {
-            mBlock->Item(b)->f->Read64K(temp,
-                 (srcX - mBlock->Item(b)->start) / divisor, num);
+      }
+      else {
+         // The level is in memory, or made from the 256 summary once
+         sampleCount frames;
+         const float *frameData =
+            mBlock->Item(b)->f->GetSummaryLevel(level, &frames);
+         if (frameData) {
+            src = frameData +
+               3 * ((srcX - mBlock->Item(b)->start) / divisor);
             blockStatus=b;
          }
          else
          {
             blockStatus=-1-b;
          }
-         break;
       }
 
       // Get min/max/rms of samples for each pixel we can
@@ -1336,12 +1536,12 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms,int* bl,
 
       if (b==block0) {
          if (divisor > 1) {
-            theMin = temp[0];
-            theMax = temp[1];
+            theMin = src[0];
+            theMax = src[1];
          }
          else {
-            theMin = temp[0];
-            theMax = temp[0];
+            theMin = src[0];
+            theMax = src[0];
          }
          sumsq = float(0.0);
          jcount = 0;
@@ -1375,32 +1575,28 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms,int* bl,
          if (stop > num)
             stop = num;
 
-         switch (divisor) {
-         default:
-         case 1:
+         if (divisor == 1) {
             while (x < stop) {
-               if (temp[x] < theMin)
-                  theMin = temp[x];
-               if (temp[x] > theMax)
-                  theMax = temp[x];
-               sumsq += ((float)temp[x]) * ((float)temp[x]);
+               if (src[x] < theMin)
+                  theMin = src[x];
+               if (src[x] > theMax)
+                  theMax = src[x];
+               sumsq += ((float)src[x]) * ((float)src[x]);
                x++;
                jcount++;
             }
-            break;
-         case 256:
-         case 65536:
+         }
+         else {
+            // Frames of min, max and RMS
             while (x < stop) {
-               if (temp[3 * x] < theMin)
-                  theMin = temp[3 * x];
-               if (temp[3 * x + 1] > theMax)
-                  theMax = temp[3 * x + 1];
-               sumsq += ((float)temp[3*x+2]) * ((float)temp[3*x+2]);
+               if (src[3 * x] < theMin)
+                  theMin = src[3 * x];
+               if (src[3 * x + 1] > theMax)
+                  theMax = src[3 * x + 1];
+               sumsq += ((float)src[3*x+2]) * ((float)src[3*x+2]);
                x++;
                jcount++;
             }
-
-            break;
          }
       }
 
@@ -1436,11 +1632,190 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms,int* bl,
       pixel++;
    }
 
-   delete[] temp;
+   return true;
+}
+
+bool Sequence::GetWaveDisplayByBlocks(float *min, float *max, float *rms,
+                                      int* bl, int len, sampleCount *where)
+{
+   UpdateBlockPyramid();
+
+   int numBlocks = mBlock->GetCount();
+   if (numBlocks == 0)
+      return false;
+
+   // Each pixel takes the blocks that start in it, and the first one
+   // also the block it starts in.  Pixels a block is too long to start
+   // in repeat the one before.
+   int b = FindBlock(where[0]);
+   float theMin = 0.0f;
+   float theMax = 0.0f;
+   float theRMS = 0.0f;
+   int blockStatus = b;
+
+   for (int pixel = 0; pixel < len; pixel++) {
+      int b1 = b;
+      while (b1 < numBlocks && mBlock->Item(b1)->start < where[pixel + 1])
+         b1++;
+
+      if (b1 > b) {
+         BlockSummary summary = SummarizeBlocks(b, b1);
+         if (summary.len > 0) {
+            theMin = summary.min;
+            theMax = summary.max;
+            theRMS = (float)sqrt(summary.sumsq / summary.len);
+         }
+         else {
+            theMin = theMax = theRMS = 0.0f;
+         }
+         blockStatus = summary.unavailable ? -1 - b : b1 - 1;
+         b = b1;
+      }
+
+      min[pixel] = theMin;
+      max[pixel] = theMax;
+      rms[pixel] = theRMS;
+      bl[pixel] = blockStatus;
+   }
 
    return true;
 }
 
+// Level 0 of the pyramid is checked against the blocks on each call,
+// and remade from the first block that differs, or whose summary has
+// become available since; groups above are remade from there too.  So
+// appending only adds to the pyramid, and drawing never reads more than
+// the blocks the sequence has.
+void Sequence::UpdateBlockPyramid()
+{
+   int numBlocks = mBlock->GetCount();
+   int oldBlocks = mPyramidBlocks.size();
+
+   int valid = 0;
+   while (valid < numBlocks && valid < oldBlocks) {
+      BlockFile *f = mBlock->Item(valid)->f;
+      if (f != mPyramidBlocks[valid] ||
+          f->GetSerial() != mPyramidSerials[valid])
+         break;
+      if (mBlockPyramid[0][valid].unavailable && f->IsSummaryAvailable())
+         break;
+      valid++;
+   }
+
+   if (valid == numBlocks && valid == oldBlocks)
+      return;
+
+   mPyramidBlocks.resize(numBlocks);
+   mPyramidSerials.resize(numBlocks);
+   if (mBlockPyramid.empty())
+      mBlockPyramid.resize(1);
+   mBlockPyramid[0].resize(numBlocks);
+
+   for (int i = valid; i < numBlocks; i++) {
+      BlockFile *f = mBlock->Item(i)->f;
+      BlockSummary &summary = mBlockPyramid[0][i];
+
+      mPyramidBlocks[i] = f;
+      mPyramidSerials[i] = f->GetSerial();
+
+      if (f->IsSummaryAvailable()) {
+         float blockMin, blockMax, blockRMS;
+         f->GetMinMax(&blockMin, &blockMax, &blockRMS);
+         summary.min = blockMin;
+         summary.max = blockMax;
+         summary.len = f->GetLength();
+         summary.sumsq = (double)blockRMS * blockRMS * summary.len;
+         summary.unavailable = 0;
+      }
+      else {
+         summary.min = FLT_MAX;
+         summary.max = -FLT_MAX;
+         summary.len = 0;
+         summary.sumsq = 0;
+         summary.unavailable = 1;
+      }
+   }
+
+   unsigned int level = 1;
+   int first = valid;
+   int count = numBlocks;
+   while (count > 1) {
+      first /= 4;
+      count = (count + 3) / 4;
+      if (mBlockPyramid.size() <= level)
+         mBlockPyramid.resize(level + 1);
+
+      const std::vector<BlockSummary> &below = mBlockPyramid[level - 1];
+      std::vector<BlockSummary> &groups = mBlockPyramid[level];
+      groups.resize(count);
+
+      for (int i = first; i < count; i++) {
+         BlockSummary &group = groups[i];
+         group.min = FLT_MAX;
+         group.max = -FLT_MAX;
+         group.sumsq = 0;
+         group.len = 0;
+         group.unavailable = 0;
+         for (int j = 4 * i; j < 4 * i + 4 && j < (int)below.size(); j++) {
+            if (below[j].min < group.min)
+               group.min = below[j].min;
+            if (below[j].max > group.max)
+               group.max = below[j].max;
+            group.sumsq += below[j].sumsq;
+            group.len += below[j].len;
+            group.unavailable += below[j].unavailable;
+         }
+      }
+
+      level++;
+   }
+   mBlockPyramid.resize(level);
+}
+
+Sequence::BlockSummary Sequence::SummarizeBlocks(int b0, int b1)
+{
+   BlockSummary result;
+   result.min = FLT_MAX;
+   result.max = -FLT_MAX;
+   result.sumsq = 0;
+   result.len = 0;
+   result.unavailable = 0;
+
+   // Take the whole groups the range covers from the highest level they
+   // are on, and the blocks or groups at its ends from the levels below
+   for (unsigned int level = 0; b0 < b1 && level < mBlockPyramid.size();
+        level++) {
+      const std::vector<BlockSummary> &summaries = mBlockPyramid[level];
+      bool top = (level + 1 == mBlockPyramid.size());
+
+      while (b0 < b1 && (top || b0 % 4 != 0)) {
+         const BlockSummary &s = summaries[b0++];
+         if (s.min < result.min)
+            result.min = s.min;
+         if (s.max > result.max)
+            result.max = s.max;
+         result.sumsq += s.sumsq;
+         result.len += s.len;
+         result.unavailable += s.unavailable;
+      }
+      while (b0 < b1 && b1 % 4 != 0) {
+         const BlockSummary &s = summaries[--b1];
+         if (s.min < result.min)
+            result.min = s.min;
+         if (s.max > result.max)
+            result.max = s.max;
+         result.sumsq += s.sumsq;
+         result.len += s.len;
+         result.unavailable += s.unavailable;
+      }
+
+      b0 /= 4;
+      b1 /= 4;
+   }
+
+   return result;
+}
+
 sampleCount Sequence::GetIdealAppendLen()
 {
    int numBlocks = mBlock->GetCount();
@@ -1464,6 +1839,8 @@ bool Sequence::Append(samplePtr buffer, sampleFormat format,
    if (((double)mNumSamples) + ((double)len) > wxLL(9223372036854775807))
       return false;
 
+   ResetPrefetch();
+
    // If the last block is not full, we need to add samples to it
    int numBlocks = mBlock->GetCount();
    if (numBlocks > 0 && mBlock->Item(numBlocks - 1)->f->GetLength() < mMinSamples) {
@@ -1592,6 +1969,8 @@ bool Sequence::Delete(sampleCount start, sampleCount len)
    if (len < 0 || start < 0 || start >= mNumSamples)
       return false;
 
+   ResetPrefetch();
+
    //TODO: add a ref-deref mechanism to SeqBlock/BlockArray so we don't have to make this a critical section.
    //On-demand threads iterate over the mBlocks and the GUI thread deletes them, so for now put a mutex here over
    //both functions,
@@ -1880,6 +2259,8 @@ int Sequence::GetMaxDiskBlockSize()
 
 void Sequence::AppendBlockFile(BlockFile* blockFile)
 {
+   ResetPrefetch();
+
    SeqBlock *w = new SeqBlock();
    w->start = mNumSamples;
    w->f = blockFile;
@@ -11,6 +11,8 @@
 #ifndef __AUDACITY_SEQUENCE__
 #define __AUDACITY_SEQUENCE__
 
+#include <vector>
+
 #include <wx/string.h>
 #include <wx/dynarray.h>
 
@@ -30,6 +32,29 @@ typedef wxLongLong_t sampleCount; /** < A native 64-bit integer type, because
 class BlockFile;
 class DirManager;
 
+/// What analysis passes want of a run of samples.  BlockFile keeps one
+/// for each block, so that whole blocks needn't be read for it.
+class SampleStats {
+ public:
+   SampleStats();
+
+   /// Add len samples, the first of which is sample offset of the run
+   void Add(const float *buffer, sampleCount len, sampleCount offset);
+   /// Add the samples other counts, the first of which is sample offset
+   void Add(const SampleStats &other, sampleCount offset);
+   /// Add len samples of silence
+   void AddSilence(sampleCount len);
+
+   sampleCount len;
+   double      sum;      // for the DC offset
+   double      sumsq;
+   float       min;      // FLT_MAX and -FLT_MAX if len is 0
+   float       max;
+   sampleCount clipped;  // samples of magnitude MAX_AUDIO or more
+   sampleCount peak;     // first sample of the greatest magnitude, or
+                         // -1 if all are 0
+};
+
 // This is an internal data structure!  For advanced use only.
 class SeqBlock {
  public:
@@ -151,6 +176,10 @@ class Sequence: public XMLTagHandler {
                   float * min, float * max) const;
    bool GetRMS(sampleCount start, sampleCount len,
                   float * outRMS) const;
+   /// Reads only the blocks start and start + len cut, and any whose
+   /// SampleStats aren't known yet; peak is from start
+   bool GetStats(sampleCount start, sampleCount len,
+                 SampleStats *stats) const;
 
    //
    // Getting block size information
@@ -194,9 +223,37 @@ class Sequence: public XMLTagHandler {
 
    bool          mErrorOpening;
 
+   // Where the next Get() of a sequential pass would start, and the
+   // last block the BlockPrefetcher was asked to read for it; Get() is
+   // called from several threads at once, so both are guarded by
+   // mPrefetchMutex
+   mutable sampleCount mNextGetStart;
+   mutable int   mPrefetchedBlock;
+   mutable ODLock mPrefetchMutex;
+
    ///To block the Delete() method against the ODCalcSummaryTask::Update() method
    ODLock   mDeleteUpdateMutex;
 
+   // Where GetWaveDisplay() reads samples and summaries into, kept from
+   // one call to the next
+   float        *mDisplayBuffer;
+   sampleCount   mDisplayBufferLen;
+
+   // What GetWaveDisplay() draws whole blocks from
+   struct BlockSummary {
+      float min;
+      float max;
+      double sumsq;
+      sampleCount len;  // samples counted, of blocks with a summary
+      int unavailable;  // blocks without a summary yet
+   };
+   // Level 0 summarizes each block, level k each group of 4^k blocks;
+   // see UpdateBlockPyramid()
+   std::vector< std::vector<BlockSummary> > mBlockPyramid;
+   // The blocks level 0 was made from
+   std::vector<BlockFile *> mPyramidBlocks;
+   std::vector<unsigned long> mPyramidSerials;
+
    //
    // Private methods
    //
@@ -225,6 +282,18 @@ class Sequence: public XMLTagHandler {
 
    BlockArray *Blockify(samplePtr buffer, sampleCount len);
 
+   // Forget the sequential pass Get() was following; called before
+   // anything that changes mBlock, whose indices it holds
+   void ResetPrefetch();
+
+   // GetWaveDisplay() when each pixel spans a block or more
+   bool GetWaveDisplayByBlocks(float *min, float *max, float *rms, int* bl,
+                               int len, sampleCount *where);
+   // Bring mBlockPyramid up to date with mBlock
+   void UpdateBlockPyramid();
+   // Summary of blocks [b0, b1)
+   BlockSummary SummarizeBlocks(int b0, int b1);
+
  public:
 
    //
@@ -0,0 +1,703 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrogramTiles.cpp
+
+*******************************************************************//**
+
+\class SpectrogramTiles
+\brief Cache of the columns of a WaveClip's spectrogram, in tiles that
+stay good as the view scrolls.
+
+The samples of a tile are read on the drawing thread when it is first
+shown, since a Sequence can't be read while it is being edited; only
+the windowing, FFTs and logarithms, which are most of the work, are
+done in the background.
+
+*//****************************************************************//**
+
+\class SpectrogramTiler
+\brief Computes SpectrogramTile%s on a background thread.
+
+The tiles are done in the order they were queued, the columns of each
+on the ThreadPool.  A tile that is being computed can't be deleted
+underneath the thread, because SpectrogramTiles calls Cancel() first.
+
+*//****************************************************************//**
+
+\class SpectrogramThread
+\brief The thread of the SpectrogramTiler.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "SpectrogramTiles.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <wx/utils.h>
+
+#include "FFT.h"
+#include "Project.h"
+#include "RealFFTf.h"
+#include "Sequence.h"
+#include "Spectrum.h"
+#include "ThreadPool.h"
+
+DEFINE_EVENT_TYPE(EVT_SPECTROGRAM_TILES)
+
+// Floats of columns and samples all clips together keep tiles of,
+// besides those of the view being drawn; 64 MB
+#define SPECTROGRAM_TILES_BUDGET (16 * 1024 * 1024)
+
+// Least time between redraws as tiles are done, in ms; there is always
+// one when the queue empties
+#define SPECTROGRAM_POST_INTERVAL 100
+
+// What a column not yet computed is drawn as: the floor of the spectrum
+#define SPECTROGRAM_SILENCE -160.0f
+
+// Every SpectrogramTiles, for eviction across clips, and the count of
+// Get() calls that stamps the tiles each one draws; guarded by
+// sTilesMutex, as are the tiles of all clips
+static std::vector<SpectrogramTiles *> sAllTiles;
+static unsigned long sGeneration = 0;
+static wxMutex sTilesMutex;
+
+static sampleCount FloorDiv(sampleCount a, sampleCount b)
+{
+   return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+// Convert a transformed column of hFFT->Points * 2 samples to
+// hFFT->Points dB values
+static void SpectrumToDB(const float *buffer, HFFT hFFT, float *out)
+{
+   int i;
+   // Handle the (real-only) DC
+   float power = buffer[0]*buffer[0];
+   if(power <= 0)
+      out[0] = -160.0;
+   else
+      out[0] = 10.0*log10(power);
+   for(i=1;i<hFFT->Points;i++) {
+      power = (buffer[hFFT->BitReversed[i]  ]*buffer[hFFT->BitReversed[i]  ])
+            + (buffer[hFFT->BitReversed[i]+1]*buffer[hFFT->BitReversed[i]+1]);
+      if(power <= 0)
+         out[i] = -160.0;
+      else
+         out[i] = 10.0*log10f(power);
+   }
+}
+
+//
+// SpectrogramKey
+//
+
+SpectrogramKey::SpectrogramKey():
+   rate(0),
+   pixelsPerSecond(0),
+   windowSize(0),
+   windowType(0),
+   frequencyGain(0),
+   fftSkipPoints(0),
+   autocorrelation(false),
+   dirty(0)
+{
+}
+
+bool SpectrogramKey::operator==(const SpectrogramKey &other) const
+{
+   return rate == other.rate &&
+      pixelsPerSecond == other.pixelsPerSecond &&
+      windowSize == other.windowSize &&
+      windowType == other.windowType &&
+      frequencyGain == other.frequencyGain &&
+      fftSkipPoints == other.fftSkipPoints &&
+      autocorrelation == other.autocorrelation &&
+      dirty == other.dirty;
+}
+
+//
+// SpectrogramTile
+//
+
+SpectrogramTile::SpectrogramTile(const SpectrogramKey &key, sampleCount index):
+   key(key),
+   index(index),
+   state(Pending),
+   lastUsed(0),
+   samples(NULL),
+   freq(NULL)
+{
+}
+
+SpectrogramTile::~SpectrogramTile()
+{
+   delete[] samples;
+   delete[] freq;
+}
+
+//
+// SpectrogramTiles
+//
+
+SpectrogramTiles::SpectrogramTiles():
+   mLastFirst(0),
+   mLastNumPixels(0),
+   mLastComplete(false)
+{
+   wxMutexLocker locker(sTilesMutex);
+   sAllTiles.push_back(this);
+}
+
+SpectrogramTiles::~SpectrogramTiles()
+{
+   sTilesMutex.Lock();
+   sAllTiles.erase(std::find(sAllTiles.begin(), sAllTiles.end(), this));
+   sTilesMutex.Unlock();
+
+   Clear();
+}
+
+void SpectrogramTiles::Clear()
+{
+   wxMutexLocker locker(sTilesMutex);
+
+   for (size_t i = 0; i < mTiles.size(); i++) {
+      SpectrogramTiler::Get().Cancel(mTiles[i]);
+      delete mTiles[i];
+   }
+   mTiles.clear();
+   mLastComplete = false;
+}
+
+SpectrogramTile *SpectrogramTiles::Find(const SpectrogramKey &key,
+                                        sampleCount index)
+{
+   for (size_t i = 0; i < mTiles.size(); i++)
+      if (mTiles[i]->index == index && mTiles[i]->key == key)
+         return mTiles[i];
+   return NULL;
+}
+
+SpectrogramTile *SpectrogramTiles::Request(Sequence *sequence,
+                                           const SpectrogramKey &key,
+                                           sampleCount index)
+{
+   SpectrogramTiler &tiler = SpectrogramTiler::Get();
+
+   SpectrogramTile *tile = Find(key, index);
+   if (tile) {
+      tile->lastUsed = sGeneration;
+      if (tiler.GetState(tile) == SpectrogramTile::Pending)
+         tiler.Request(tile);
+      return tile;
+   }
+
+   tile = new SpectrogramTile(key, index);
+   tile->lastUsed = sGeneration;
+
+   int windowSize = key.windowSize;
+   int skip1 = key.fftSkipPoints + 1;
+   sampleCount numSamples = sequence->GetNumSamples();
+   sampleCount x;
+
+   for (x = 0; x <= SPECTROGRAM_TILE_COLUMNS; x++) {
+      // purposely offset the display 1/2 bin to the left (as compared
+      // to waveform display to properly center response of the FFT
+      double column = (double)(index * SPECTROGRAM_TILE_COLUMNS + x);
+      tile->where[x] =
+         (sampleCount)floor(column * key.rate / key.pixelsPerSecond + 1.);
+   }
+
+   tile->samples = new float[SPECTROGRAM_TILE_COLUMNS * windowSize];
+   float *skipped = (skip1 > 1) ? new float[windowSize * skip1] : NULL;
+
+   for (x = 0; x < SPECTROGRAM_TILE_COLUMNS; x++) {
+      sampleCount start = tile->where[x];
+      sampleCount len = windowSize;
+      sampleCount i;
+      float *buffer = &tile->samples[x * windowSize];
+
+      tile->inClip[x] = (start > 0 && start < numSamples);
+      if (!tile->inClip[x])
+         continue;
+
+      float *adj = buffer;
+      start -= windowSize >> 1;
+
+      if (start < 0) {
+         for (i = start; i < 0; i++)
+            *adj++ = 0;
+         len += start;
+         start = 0;
+      }
+      if (start + len * skip1 > numSamples) {
+         int newlen = (numSamples - start) / skip1;
+         for (i = newlen; i < len; i++)
+            adj[i] = 0;
+         len = newlen;
+      }
+
+      if (len > 0) {
+         if (skipped) {
+            sequence->Get((samplePtr)skipped, floatSample, start, len * skip1);
+            for (i = 0; i < len; i++)
+               adj[i] = skipped[i * skip1];
+         }
+         else
+            sequence->Get((samplePtr)adj, floatSample, start, len);
+      }
+   }
+
+   delete[] skipped;
+
+   mTiles.push_back(tile);
+   tiler.Request(tile);
+
+   return tile;
+}
+
+bool SpectrogramTiles::Get(Sequence *sequence, const SpectrogramKey &key,
+                           double t0, int numPixels,
+                           float *freq, sampleCount *where)
+{
+   wxMutexLocker locker(sTilesMutex);
+   SpectrogramTiler &tiler = SpectrogramTiler::Get();
+   int half = key.windowSize / 2;
+
+   // The view's columns are on the clip's grid of columns, which moves
+   // them by less than half a pixel
+   sampleCount first = (sampleCount)floor(t0 * key.pixelsPerSecond + 0.5);
+   sampleCount firstTile = FloorDiv(first, SPECTROGRAM_TILE_COLUMNS);
+   sampleCount lastTile =
+      FloorDiv(first + numPixels - 1, SPECTROGRAM_TILE_COLUMNS);
+
+   sGeneration++;
+
+   // Tiles queued for an earlier view wait for this one's
+   for (size_t i = 0; i < mTiles.size(); i++) {
+      SpectrogramTile *tile = mTiles[i];
+      if (tile->key != key ||
+          tile->index < firstTile - 1 || tile->index > lastTile + 1)
+         tiler.Unqueue(tile);
+   }
+
+   bool complete = true;
+
+   for (sampleCount t = firstTile; t <= lastTile; t++) {
+      SpectrogramTile *tile = Request(sequence, key, t);
+      bool done = (tiler.GetState(tile) == SpectrogramTile::Done);
+
+      sampleCount c0 = t * SPECTROGRAM_TILE_COLUMNS;
+      sampleCount c1 = c0 + SPECTROGRAM_TILE_COLUMNS;
+      if (c0 < first)
+         c0 = first;
+      if (c1 > first + numPixels)
+         c1 = first + numPixels;
+
+      for (sampleCount c = c0; c < c1; c++) {
+         int x = (int)(c - first);
+         int column = (int)(c - t * SPECTROGRAM_TILE_COLUMNS);
+
+         where[x] = tile->where[column];
+         if (done)
+            memcpy(&freq[half * x], &tile->freq[half * column],
+                   half * sizeof(float));
+         else
+            for (int i = 0; i < half; i++)
+               freq[half * x + i] = SPECTROGRAM_SILENCE;
+      }
+
+      if (!done)
+         complete = false;
+   }
+   where[numPixels] = (sampleCount)
+      floor((double)(first + numPixels) * key.rate / key.pixelsPerSecond + 1.);
+
+   // Then those either side, for scrolling
+   Request(sequence, key, firstTile - 1);
+   Request(sequence, key, lastTile + 1);
+
+   Evict(key);
+
+   bool same = mLastComplete &&
+      mLastKey == key &&
+      mLastFirst == first &&
+      mLastNumPixels == numPixels;
+
+   mLastKey = key;
+   mLastFirst = first;
+   mLastNumPixels = numPixels;
+   mLastComplete = complete;
+
+   return !same;
+}
+
+void SpectrogramTiles::Delete(size_t i)
+{
+   SpectrogramTiler::Get().Cancel(mTiles[i]);
+   delete mTiles[i];
+   mTiles.erase(mTiles.begin() + i);
+}
+
+void SpectrogramTiles::Evict(const SpectrogramKey &key)
+{
+   SpectrogramTiler &tiler = SpectrogramTiler::Get();
+
+   // Tiles of samples since changed are no use again
+   size_t i = 0;
+   while (i < mTiles.size()) {
+      if (mTiles[i]->key.dirty != key.dirty)
+         Delete(i);
+      else
+         i++;
+   }
+
+   // Then the least recently used of all clips, but never those of
+   // this view
+   size_t size = 0;
+   std::vector<SpectrogramTiles *>::iterator iter;
+   for (iter = sAllTiles.begin(); iter != sAllTiles.end(); iter++)
+      for (i = 0; i < (*iter)->mTiles.size(); i++) {
+         SpectrogramTile *tile = (*iter)->mTiles[i];
+         if (tiler.GetState(tile) == SpectrogramTile::Done)
+            size += SPECTROGRAM_TILE_COLUMNS * (tile->key.windowSize / 2);
+         else
+            size += SPECTROGRAM_TILE_COLUMNS * tile->key.windowSize;
+      }
+
+   while (size > SPECTROGRAM_TILES_BUDGET) {
+      SpectrogramTiles *owner = NULL;
+      size_t oldest = 0;
+      for (iter = sAllTiles.begin(); iter != sAllTiles.end(); iter++)
+         for (i = 0; i < (*iter)->mTiles.size(); i++) {
+            SpectrogramTile *tile = (*iter)->mTiles[i];
+            if (tile->lastUsed != sGeneration &&
+                (!owner || tile->lastUsed < owner->mTiles[oldest]->lastUsed)) {
+               owner = *iter;
+               oldest = i;
+            }
+         }
+
+      if (!owner)
+         break;
+
+      SpectrogramTile *tile = owner->mTiles[oldest];
+      if (tiler.GetState(tile) == SpectrogramTile::Done)
+         size -= SPECTROGRAM_TILE_COLUMNS * (tile->key.windowSize / 2);
+      else
+         size -= SPECTROGRAM_TILE_COLUMNS * tile->key.windowSize;
+      owner->Delete(oldest);
+      // Its next Get() can't be the same as its last
+      owner->mLastComplete = false;
+   }
+}
+
+//
+// SpectrogramTiler
+//
+
+/// Computes the columns of one tile, each on whichever thread takes it
+class SpectrogramTileJob : public ParallelJob {
+ public:
+   SpectrogramTileJob(SpectrogramTile *tile, HFFT hFFT,
+                      const float *window, const float *gainFactor,
+                      int threads):
+      mTile(tile), mHFFT(hFFT), mWindow(window), mGainFactor(gainFactor),
+      mScratch(threads * FFT_BATCH * tile->key.windowSize)
+   {
+   }
+
+   // Columns index * FFT_BATCH on, so that their FFTs go together
+   virtual void RunItem(int index, int slot)
+   {
+      int windowSize = mTile->key.windowSize;
+      int half = windowSize / 2;
+      float *buffers = &mScratch[slot * FFT_BATCH * windowSize];
+      int columns[FFT_BATCH];
+      int count = 0;
+      int x, i;
+
+      for (x = index * FFT_BATCH; x < (index + 1) * FFT_BATCH; x++) {
+         float *out = &mTile->freq[half * x];
+         float *samples = &mTile->samples[x * windowSize];
+
+         if (!mTile->inClip[x]) {
+            for (i = 0; i < half; i++)
+               out[i] = 0;
+         }
+         else if (mTile->key.autocorrelation) {
+            ComputeSpectrum(samples, windowSize, windowSize,
+                            mTile->key.rate, out,
+                            true, mTile->key.windowType);
+         }
+         else {
+            float *buffer = &buffers[count * windowSize];
+            for (i = 0; i < windowSize; i++)
+               buffer[i] = samples[i] * mWindow[i];
+            columns[count++] = x;
+         }
+      }
+
+      RealFFTfBatch(buffers, count, mHFFT);
+      for (i = 0; i < count; i++)
+         SpectrumToDB(&buffers[i * windowSize], mHFFT,
+                      &mTile->freq[half * columns[i]]);
+
+      if (mGainFactor) {
+         // Apply a frequency-dependant gain factor
+         for (x = index * FFT_BATCH; x < (index + 1) * FFT_BATCH; x++) {
+            if (!mTile->inClip[x])
+               continue;
+            float *out = &mTile->freq[half * x];
+            for (i = 0; i < half; i++)
+               out[i] += mGainFactor[i];
+         }
+      }
+   }
+
+ private:
+   SpectrogramTile *mTile;
+   HFFT mHFFT;
+   const float *mWindow;
+   const float *mGainFactor;
+   std::vector<float> mScratch;
+};
+
+class SpectrogramThread : public wxThread {
+ public:
+   SpectrogramThread(SpectrogramTiler *tiler):
+      wxThread(wxTHREAD_JOINABLE), mTiler(tiler) {}
+   virtual ExitCode Entry()
+   {
+      mTiler->Run();
+      return 0;
+   }
+ private:
+   SpectrogramTiler *mTiler;
+};
+
+SpectrogramTiler & SpectrogramTiler::Get()
+{
+   static SpectrogramTiler tiler;
+   return tiler;
+}
+
+void SpectrogramTiler::Deinit()
+{
+   SpectrogramTiler &tiler = Get();
+
+   tiler.mMutex.Lock();
+   tiler.mStopping = true;
+   tiler.mMutex.Unlock();
+
+   tiler.StopThread();
+}
+
+SpectrogramTiler::SpectrogramTiler():
+   mWorkAvailable(mMutex),
+   mTileFinished(mMutex),
+   mThread(NULL),
+   mStopping(false),
+   mLastPost(0)
+{
+}
+
+SpectrogramTiler::~SpectrogramTiler()
+{
+   // Deinit() has normally stopped it already
+   mMutex.Lock();
+   mStopping = true;
+   mMutex.Unlock();
+
+   StopThread();
+}
+
+void SpectrogramTiler::StartThread()
+{
+   // Called with mMutex locked
+   SpectrogramThread *thread = new SpectrogramThread(this);
+   if (thread->Create() != wxTHREAD_NO_ERROR) {
+      delete thread;
+      return;
+   }
+   thread->SetPriority(WXTHREAD_DEFAULT_PRIORITY);
+   thread->Run();
+   mThread = thread;
+}
+
+void SpectrogramTiler::StopThread()
+{
+   mMutex.Lock();
+   SpectrogramThread *thread = mThread;
+   mThread = NULL;
+   while (!mQueue.empty()) {
+      mQueue.front()->state = SpectrogramTile::Pending;
+      mQueue.pop_front();
+   }
+   mWorkAvailable.Broadcast();
+   mMutex.Unlock();
+
+   if (thread) {
+      thread->Wait();
+      delete thread;
+   }
+}
+
+void SpectrogramTiler::Run()
+{
+   wxMutexLocker locker(mMutex);
+
+   for (;;) {
+      while (mQueue.empty() && !mStopping)
+         mWorkAvailable.Wait();
+      if (mStopping)
+         return;
+
+      SpectrogramTile *tile = mQueue.front();
+      mQueue.pop_front();
+      tile->state = SpectrogramTile::Computing;
+
+      mMutex.Unlock();
+      Compute(tile);
+      mMutex.Lock();
+
+      tile->state = SpectrogramTile::Done;
+      mTileFinished.Broadcast();
+
+      wxLongLong now = wxGetLocalTimeMillis();
+      if (mQueue.empty() || now - mLastPost >= SPECTROGRAM_POST_INTERVAL) {
+         mLastPost = now;
+         mMutex.Unlock();
+         PostUpdate();
+         mMutex.Lock();
+      }
+   }
+}
+
+void SpectrogramTiler::Compute(SpectrogramTile *tile)
+{
+   int windowSize = tile->key.windowSize;
+   int half = windowSize / 2;
+   int i;
+
+   // Create the requested window function
+   float *window = new float[windowSize];
+   for (i = 0; i < windowSize; i++)
+      window[i] = 1.0;
+   WindowFunc(tile->key.windowType, windowSize, window);
+   // Scale the window function to give 0dB spectrum for 0dB sine tone
+   double ws = 0;
+   for (i = 0; i < windowSize; i++)
+      ws += window[i];
+   if (ws > 0) {
+      ws = 2.0 / ws;
+      for (i = 0; i < windowSize; i++)
+         window[i] *= ws;
+   }
+
+   float *gainFactor = NULL;
+   if (tile->key.frequencyGain > 0) {
+      // Compute a frequency-dependant gain factor
+      // scaled such that 1000 Hz gets a gain of 0dB
+      double factor = 0.001 * tile->key.rate / (double)windowSize;
+      gainFactor = new float[half];
+      for (i = 0; i < half; i++)
+         gainFactor[i] = tile->key.frequencyGain * log10(factor * i);
+   }
+
+   // GetFFT() and ReleaseFFT() lock the table of FFT set-ups they share
+   // with the drawing thread and effects
+   HFFT hFFT = GetFFT(windowSize);
+
+   // Leave a CPU for drawing and playback
+   ThreadPool &pool = ThreadPool::Get();
+   int threads = pool.GetMaxThreads() - 1;
+   if (threads < 1)
+      threads = 1;
+
+   tile->freq = new float[SPECTROGRAM_TILE_COLUMNS * half];
+
+   SpectrogramTileJob job(tile, hFFT, window, gainFactor, threads);
+   pool.Run(job, SPECTROGRAM_TILE_COLUMNS / FFT_BATCH, threads);
+
+   delete[] tile->samples;
+   tile->samples = NULL;
+
+   ReleaseFFT(hFFT);
+   delete[] gainFactor;
+   delete[] window;
+}
+
+void SpectrogramTiler::PostUpdate()
+{
+   wxCommandEvent event(EVT_SPECTROGRAM_TILES);
+   AudacityProject::AllProjectsDeleteLock();
+   AudacityProject *proj = GetActiveProject();
+   if (proj)
+      proj->GetEventHandler()->AddPendingEvent(event);
+   AudacityProject::AllProjectsDeleteUnlock();
+}
+
+void SpectrogramTiler::Request(SpectrogramTile *tile)
+{
+   wxMutexLocker locker(mMutex);
+
+   if (tile->state != SpectrogramTile::Pending)
+      return;
+
+   if (!mThread && !mStopping)
+      StartThread();
+
+   if (!mThread) {
+      // No thread to do it: do it now
+      tile->state = SpectrogramTile::Computing;
+      mMutex.Unlock();
+      Compute(tile);
+      mMutex.Lock();
+      tile->state = SpectrogramTile::Done;
+      return;
+   }
+
+   tile->state = SpectrogramTile::Queued;
+   mQueue.push_back(tile);
+   mWorkAvailable.Signal();
+}
+
+void SpectrogramTiler::Unqueue(SpectrogramTile *tile)
+{
+   wxMutexLocker locker(mMutex);
+
+   if (tile->state != SpectrogramTile::Queued)
+      return;
+
+   for (std::deque<SpectrogramTile *>::iterator iter = mQueue.begin();
+        iter != mQueue.end(); iter++) {
+      if (*iter == tile) {
+         mQueue.erase(iter);
+         break;
+      }
+   }
+   tile->state = SpectrogramTile::Pending;
+}
+
+void SpectrogramTiler::Cancel(SpectrogramTile *tile)
+{
+   Unqueue(tile);
+
+   wxMutexLocker locker(mMutex);
+   while (tile->state == SpectrogramTile::Computing)
+      mTileFinished.Wait();
+}
+
+SpectrogramTile::State SpectrogramTiler::GetState(SpectrogramTile *tile)
+{
+   wxMutexLocker locker(mMutex);
+   return tile->state;
+}
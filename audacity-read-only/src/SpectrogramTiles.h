@@ -0,0 +1,168 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrogramTiles.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SPECTROGRAMTILES__
+#define __AUDACITY_SPECTROGRAMTILES__
+
+#include <deque>
+#include <vector>
+
+#include <wx/event.h>
+#include <wx/longlong.h>
+#include <wx/thread.h>
+
+#include "Audacity.h"
+#include "SampleFormat.h"
+
+class Sequence;
+class SpectrogramThread;
+
+/// Sent to the active project as tiles are computed, so it redraws
+DECLARE_EXPORTED_EVENT_TYPE(AUDACITY_DLL_API, EVT_SPECTROGRAM_TILES, -1)
+
+/// Columns in a tile
+#define SPECTROGRAM_TILE_COLUMNS 64
+
+/// What the columns of a clip's spectrogram depend on, besides its
+/// samples.  Gain and range only colour them, so they aren't in it.
+struct SpectrogramKey {
+   SpectrogramKey();
+
+   double rate;
+   double pixelsPerSecond;
+   int windowSize;
+   int windowType;
+   int frequencyGain;
+   int fftSkipPoints;
+   bool autocorrelation;
+   /// WaveClip::mDirty of the samples
+   int dirty;
+
+   bool operator==(const SpectrogramKey &other) const;
+   bool operator!=(const SpectrogramKey &other) const
+      { return !(*this == other); }
+};
+
+/// SPECTROGRAM_TILE_COLUMNS columns of a clip's spectrogram.  Tiles
+/// are numbered from the start of the clip, so the same tile is good
+/// wherever the view is scrolled to.
+class SpectrogramTile {
+ public:
+   enum State {
+      Pending,    // has its samples, waiting to be queued
+      Queued,
+      Computing,
+      Done
+   };
+
+   SpectrogramTile(const SpectrogramKey &key, sampleCount index);
+   ~SpectrogramTile();
+
+   SpectrogramKey key;
+   /// Its first column is column index * SPECTROGRAM_TILE_COLUMNS
+   sampleCount index;
+   /// Changed only with the SpectrogramTiler's lock held
+   State state;
+   /// SpectrogramTiles::Get() call, of any clip, that last drew or
+   /// queued it
+   unsigned long lastUsed;
+
+   /// Sample each column is centred on, as WaveClip::GetSpectrogram()
+   /// gives them
+   sampleCount where[SPECTROGRAM_TILE_COLUMNS + 1];
+   /// Columns outside the clip are 0 rather than computed
+   bool inClip[SPECTROGRAM_TILE_COLUMNS];
+   /// windowSize samples for each column, until it is computed
+   float *samples;
+   /// windowSize / 2 dB values for each column, once it is Done
+   float *freq;
+};
+
+/// The tiles of one WaveClip's spectrogram.  Tiles of the view that
+/// aren't computed yet are queued on the SpectrogramTiler and drawn as
+/// silence until they are, so drawing never waits for the FFTs.  The
+/// tiles of all clips share one budget, the least recently drawn of
+/// any clip going first.
+class SpectrogramTiles {
+ public:
+   SpectrogramTiles();
+   ~SpectrogramTiles();
+
+   /// Fill numPixels columns of windowSize / 2 values from time t0 on,
+   /// and where each column is centred, as WaveClip::GetSpectrogram()
+   /// does.  Returns false if that's exactly what the last call gave.
+   bool Get(Sequence *sequence, const SpectrogramKey &key,
+            double t0, int numPixels, float *freq, sampleCount *where);
+
+   /// Forget all tiles, waiting for any being computed
+   void Clear();
+
+ private:
+   SpectrogramTile *Find(const SpectrogramKey &key, sampleCount index);
+   /// Find the tile, or make it and gather its samples from sequence;
+   /// queue it if it isn't already
+   SpectrogramTile *Request(Sequence *sequence, const SpectrogramKey &key,
+                            sampleCount index);
+   /// Drop this clip's tiles of samples since changed, then tiles of
+   /// any clip until all fit the budget, never those of this view
+   void Evict(const SpectrogramKey &key);
+   void Delete(size_t i);
+
+   std::vector<SpectrogramTile *> mTiles;
+
+   // What the last Get() gave
+   SpectrogramKey mLastKey;
+   sampleCount mLastFirst;
+   int mLastNumPixels;
+   bool mLastComplete;
+};
+
+/// Computes SpectrogramTiles on a background thread, each one's columns
+/// spread over the ThreadPool.  The thread is started on the first
+/// request.
+class SpectrogramTiler {
+ public:
+   static SpectrogramTiler & Get();
+   /// Stop the thread; called once at exit
+   static void Deinit();
+
+   /// Queue a Pending tile to be computed
+   void Request(SpectrogramTile *tile);
+   /// Take tile off the queue, back to Pending, if it isn't started yet
+   void Unqueue(SpectrogramTile *tile);
+   /// Forget tile, waiting if it's being computed.  Must be called
+   /// before tile is destroyed.
+   void Cancel(SpectrogramTile *tile);
+
+   SpectrogramTile::State GetState(SpectrogramTile *tile);
+
+ private:
+   SpectrogramTiler();
+   ~SpectrogramTiler();
+
+   friend class SpectrogramThread;
+   /// Body of the thread
+   void Run();
+   void StartThread();
+   void StopThread();
+   /// Compute the columns of tile, which is Computing
+   void Compute(SpectrogramTile *tile);
+   void PostUpdate();
+
+   wxMutex mMutex;
+   wxCondition mWorkAvailable;
+   wxCondition mTileFinished;
+
+   std::deque<SpectrogramTile *> mQueue;
+   SpectrogramThread *mThread;
+   bool mStopping;
+
+   wxLongLong mLastPost;
+};
+
+#endif
@@ -36,52 +36,68 @@ bool ComputeSpectrum(float * data, int width,
       processed[i] = float(0.0);
    int half = windowSize / 2;
 
-   float *in = new float[windowSize];
-   float *out = new float[windowSize];
-   float *out2 = new float[windowSize];
+   float *in = new float[windowSize * FFT_BATCH];
+   float *out = new float[windowSize * FFT_BATCH];
+   float *out2 = new float[windowSize * FFT_BATCH];
 
    int start = 0;
    int windows = 0;
+   int b;
    while (start + windowSize <= width) {
-      for (i = 0; i < windowSize; i++)
-         in[i] = data[start + i];
+      // Transform the windows a batch at a time
+      int count = 0;
+      while (count < FFT_BATCH && start + count * half + windowSize <= width) {
+         float *window = in + count * windowSize;
+         for (i = 0; i < windowSize; i++)
+            window[i] = data[start + count * half + i];
 
-      WindowFunc(windowFunc, windowSize, in);
+         WindowFunc(windowFunc, windowSize, window);
+         count++;
+      }
 
       if (autocorrelation) {
          // Take FFT
 #ifdef EXPERIMENTAL_USE_REALFFTF
-         RealFFT(windowSize, in, out, out2);
+         RealFFTBatch(windowSize, count, in, out, out2);
 #else
-         FFT(windowSize, false, in, NULL, out, out2);
+         for (b = 0; b < count; b++)
+            FFT(windowSize, false, in + b * windowSize, NULL,
+                out + b * windowSize, out2 + b * windowSize);
 #endif
          // Compute power
-         for (i = 0; i < windowSize; i++)
+         for (i = 0; i < windowSize * count; i++)
             in[i] = (out[i] * out[i]) + (out2[i] * out2[i]);
 
          // Tolonen and Karjalainen recommend taking the cube root
          // of the power, instead of the square root
 
-         for (i = 0; i < windowSize; i++)
+         for (i = 0; i < windowSize * count; i++)
             in[i] = powf(in[i], 1.0f / 3.0f);
 
          // Take FFT
 #ifdef EXPERIMENTAL_USE_REALFFTF
-         RealFFT(windowSize, in, out, out2);
+         RealFFTBatch(windowSize, count, in, out, out2);
 #else
-         FFT(windowSize, false, in, NULL, out, out2);
+         for (b = 0; b < count; b++)
+            FFT(windowSize, false, in + b * windowSize, NULL,
+                out + b * windowSize, out2 + b * windowSize);
 #endif
 
+         // Take real part of result
+         for (b = 0; b < count; b++)
+            for (i = 0; i < half; i++)
+               processed[i] += out[b * windowSize + i];
       }
-      else
-         PowerSpectrum(windowSize, in, out);
+      else {
+         PowerSpectrumBatch(windowSize, count, in, out);
 
-      // Take real part of result
-      for (i = 0; i < half; i++)
-        processed[i] += out[i];
+         for (b = 0; b < count; b++)
+            for (i = 0; i < half; i++)
+               processed[i] += out[b * half + i];
+      }
 
-      start += half;
-      windows++;
+      start += count * half;
+      windows += count;
    }
 
    if (autocorrelation) {
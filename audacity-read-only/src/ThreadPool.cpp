@@ -0,0 +1,191 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ThreadPool.cpp
+
+*******************************************************************//**
+
+\class ThreadPool
+\brief Runs ParallelJob items on a pool of threads started once, at
+first use, so that jobs which run many times a second (mixing a
+buffer, say) don't pay for creating threads.
+
+The pool has one thread per CPU but the first, "/Performance/Threads"
+minus one if that is set.  The caller of Run() works on the job too,
+and takes items until none are left; then it waits for items that pool
+threads are still running.
+
+*//****************************************************************//**
+
+\class PoolThread
+\brief One worker thread of the ThreadPool.
+
+*//****************************************************************//**
+
+\class ParallelJob
+\brief Interface of work that ThreadPool::Run() can split up.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+#include "Prefs.h"
+
+class PoolThread : public wxThread {
+ public:
+   PoolThread(ThreadPool *pool):
+      wxThread(wxTHREAD_JOINABLE), mPool(pool) {}
+   virtual ExitCode Entry()
+   {
+      mPool->Work();
+      return 0;
+   }
+ private:
+   ThreadPool *mPool;
+};
+
+ThreadPool & ThreadPool::Get()
+{
+   static ThreadPool pool;
+   return pool;
+}
+
+void ThreadPool::Deinit()
+{
+   Get().Stop();
+}
+
+ThreadPool::ThreadPool():
+   mWorkAvailable(mMutex),
+   mItemDone(mMutex),
+   mStopping(false)
+{
+   long threads = gPrefs->Read(wxT("/Performance/Threads"), 0L);
+   if (threads <= 0)
+      threads = wxThread::GetCPUCount();
+
+   wxMutexLocker locker(mMutex);
+   for (long i = 1; i < threads; i++) {
+      PoolThread *thread = new PoolThread(this);
+      if (thread->Create() != wxTHREAD_NO_ERROR) {
+         delete thread;
+         break;
+      }
+      mThreads.push_back(thread);
+      mThreadIds.push_back(thread->GetId());
+      thread->Run();
+   }
+}
+
+ThreadPool::~ThreadPool()
+{
+   // Deinit() has normally stopped them already
+   Stop();
+}
+
+void ThreadPool::Stop()
+{
+   mMutex.Lock();
+   mStopping = true;
+   mWorkAvailable.Broadcast();
+   mMutex.Unlock();
+
+   for (size_t i = 0; i < mThreads.size(); i++) {
+      mThreads[i]->Wait();
+      delete mThreads[i];
+   }
+   mThreads.clear();
+   mThreadIds.clear();
+}
+
+bool ThreadPool::IsPoolThread()
+{
+   unsigned long id = wxThread::GetCurrentId();
+
+   return std::find(mThreadIds.begin(), mThreadIds.end(), id) !=
+      mThreadIds.end();
+}
+
+void ThreadPool::Work()
+{
+   wxMutexLocker locker(mMutex);
+
+   for (;;) {
+      if (mStopping)
+         return;
+
+      // The oldest batch that still has items and a free slot
+      Batch *batch = NULL;
+      for (size_t i = 0; i < mBatches.size(); i++) {
+         if (mBatches[i]->next < mBatches[i]->count &&
+             !mBatches[i]->freeSlots.empty()) {
+            batch = mBatches[i];
+            break;
+         }
+      }
+      if (!batch) {
+         mWorkAvailable.Wait();
+         continue;
+      }
+
+      int index = batch->next++;
+      int slot = batch->freeSlots.back();
+      batch->freeSlots.pop_back();
+
+      mMutex.Unlock();
+      batch->job->RunItem(index, slot);
+      mMutex.Lock();
+
+      batch->freeSlots.push_back(slot);
+      batch->done++;
+      if (batch->done == batch->count)
+         mItemDone.Broadcast();
+   }
+}
+
+void ThreadPool::Run(ParallelJob &job, int count, int threads)
+{
+   if (threads <= 0 || threads > GetMaxThreads())
+      threads = GetMaxThreads();
+   if (threads > count)
+      threads = count;
+
+   if (threads <= 1 || IsPoolThread()) {
+      for (int i = 0; i < count; i++)
+         job.RunItem(i, 0);
+      return;
+   }
+
+   Batch batch;
+   batch.job = &job;
+   batch.count = count;
+   batch.next = 0;
+   batch.done = 0;
+   // Slot 0 is the caller's
+   for (int slot = threads - 1; slot > 0; slot--)
+      batch.freeSlots.push_back(slot);
+
+   wxMutexLocker locker(mMutex);
+
+   mBatches.push_back(&batch);
+   mWorkAvailable.Broadcast();
+
+   while (batch.next < batch.count) {
+      int index = batch.next++;
+
+      mMutex.Unlock();
+      job.RunItem(index, 0);
+      mMutex.Lock();
+
+      batch.done++;
+   }
+
+   mBatches.erase(std::find(mBatches.begin(), mBatches.end(), &batch));
+
+   while (batch.done < batch.count)
+      mItemDone.Wait();
+}
@@ -0,0 +1,80 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ThreadPool.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_THREADPOOL__
+#define __AUDACITY_THREADPOOL__
+
+#include <vector>
+
+#include <wx/thread.h>
+
+class PoolThread;
+
+/// Work that can be split into independent items, run by ThreadPool::Run()
+class ParallelJob {
+ public:
+   virtual ~ParallelJob() {}
+
+   /// Do item index.  slot is in [0, threads) for the threads argument
+   /// given to Run(), and no two items running at the same time have the
+   /// same slot, so it can index per-thread scratch space.
+   virtual void RunItem(int index, int slot) = 0;
+};
+
+/// Process-wide pool of worker threads, one per CPU but the first.
+///
+/// Run() hands the items of a job out to the pool and the calling
+/// thread, and returns when they are all done.  Several threads may
+/// Run() jobs at once; a job run from inside a pool thread runs
+/// serially on that thread.
+class ThreadPool {
+ public:
+   static ThreadPool & Get();
+   /// Stop the pool threads; called once at exit
+   static void Deinit();
+
+   /// Number of threads a job can run on, counting the caller's
+   int GetMaxThreads() { return (int)mThreads.size() + 1; }
+
+   /// Run items [0, count) of job on up to threads threads, counting
+   /// the caller's (0 means GetMaxThreads()).  Items are started in
+   /// order but may finish in any order.
+   void Run(ParallelJob &job, int count, int threads = 0);
+
+   /// Whether the calling thread is one of the pool's, where Run()
+   /// would run serially
+   bool IsPoolThread();
+
+ private:
+   ThreadPool();
+   ~ThreadPool();
+
+   struct Batch {
+      ParallelJob *job;
+      int count;
+      int next;
+      int done;
+      std::vector<int> freeSlots;
+   };
+
+   friend class PoolThread;
+   /// Body of each pool thread
+   void Work();
+   void Stop();
+
+   wxMutex mMutex;
+   wxCondition mWorkAvailable;
+   wxCondition mItemDone;
+
+   std::vector<Batch *> mBatches;
+   std::vector<PoolThread *> mThreads;
+   std::vector<unsigned long> mThreadIds;
+   bool mStopping;
+};
+
+#endif
@@ -68,7 +68,9 @@ wxLongLong UndoManager::CalculateSpaceUsage(int index)
          for (i = 0; i < blocks->GetCount(); i++)
          {
             BlockFile* pBlockFile = blocks->Item(i)->f;
-            if (pBlockFile->GetFileName().FileExists())
+            // Packed blocks have no file of their own
+            if (pBlockFile->IsPacked() ||
+                pBlockFile->GetFileName().FileExists())
                cur[pBlockFile] = pBlockFile->GetSpaceUsage();
          }
       }
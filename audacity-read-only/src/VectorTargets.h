@@ -0,0 +1,44 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  VectorTargets.h
+
+  Which vector instruction sets the compiler can build for, and the
+  intrinsics headers for them.  Whether the CPU running the program has
+  them is for the code using them to find out.
+
+**********************************************************************/
+
+#ifndef __AUDACITY_VECTOR_TARGETS__
+#define __AUDACITY_VECTOR_TARGETS__
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VECTOR_X86
+#endif
+
+#if defined(VECTOR_X86) && \
+   (defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define VECTOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 functions are compiled for that target one by one, so the rest
+// of the program still runs on CPUs without it
+#if defined(VECTOR_SSE2)
+#if defined(__clang__) || \
+   (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define VECTOR_AVX2
+#define AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1800
+#define VECTOR_AVX2
+#define AVX2_TARGET
+#endif
+#endif
+
+#if defined(VECTOR_AVX2)
+#include <immintrin.h>
+#endif
+
+#endif
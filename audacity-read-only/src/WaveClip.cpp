@@ -30,6 +30,7 @@ drawing).  Cache's the Spectrogram frequency samples.
 #include <wx/log.h>
 
 #include "Spectrum.h"
+#include "SpectrogramTiles.h"
 #include "Prefs.h"
 #include "WaveClip.h"
 #include "Envelope.h"
@@ -261,35 +262,6 @@ public:
    float       *freq;
 };
 
-#ifdef EXPERIMENTAL_USE_REALFFTF
-#include "FFT.h"
-static void ComputeSpectrumUsingRealFFTf(float *buffer, HFFT hFFT, float *window, int len, float *out)
-{
-   int i;
-   if(len > hFFT->Points*2)
-      len = hFFT->Points*2;
-   for(i=0; i<len; i++)
-      buffer[i] *= window[i];
-   for( ; i<(hFFT->Points*2); i++)
-      buffer[i]=0; // zero pad as needed
-   RealFFTf(buffer, hFFT);
-   // Handle the (real-only) DC
-   float power = buffer[0]*buffer[0];
-   if(power <= 0)
-      out[0] = -160.0;
-   else
-      out[0] = 10.0*log10(power);
-   for(i=1;i<hFFT->Points;i++) {
-      power = (buffer[hFFT->BitReversed[i]  ]*buffer[hFFT->BitReversed[i]  ])
-            + (buffer[hFFT->BitReversed[i]+1]*buffer[hFFT->BitReversed[i]+1]);
-      if(power <= 0)
-         out[i] = -160.0;
-      else
-         out[i] = 10.0*log10f(power);
-   }
-}
-#endif // EXPERIMENTAL_USE_REALFFTF
-
 WaveClip::WaveClip(DirManager *projDirManager, sampleFormat format, int rate)
 {
    mOffset = 0;
@@ -298,10 +270,7 @@ WaveClip::WaveClip(DirManager *projDirManager, sampleFormat format, int rate)
    mEnvelope = new Envelope();
    mWaveCache = new WaveCache(1);
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   mWindowType = -1;
-   mWindowSize = -1;
-   hFFT = NULL;
-   mWindow = NULL;
+   mSpecTiles = new SpectrogramTiles;
 #endif
    mSpecCache = new SpecCache(1, 1, false);
    mSpecPxCache = new SpecPxCache(1);
@@ -326,10 +295,7 @@ WaveClip::WaveClip(WaveClip& orig, DirManager *projDirManager)
    mEnvelope->SetTrackLen(((double)orig.mSequence->GetNumSamples()) / orig.mRate);
    mWaveCache = new WaveCache(1);
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   mWindowType = -1;
-   mWindowSize = -1;
-   hFFT = NULL;
-   mWindow = NULL;
+   mSpecTiles = new SpectrogramTiles;
 #endif
    mSpecCache = new SpecCache(1, 1, false);
    mSpecPxCache = new SpecPxCache(1);
@@ -354,10 +320,7 @@ WaveClip::~WaveClip()
    delete mSpecCache;
    delete mSpecPxCache;
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   if(hFFT != NULL)
-      EndFFT(hFFT);
-   if(mWindow != NULL)
-      delete[] mWindow;
+   delete mSpecTiles;
 #endif
 
    if (mAppendBuffer)
@@ -379,6 +342,12 @@ bool WaveClip::GetSamples(samplePtr buffer, sampleFormat format,
    return mSequence->Get(buffer, format, start, len);
 }
 
+bool WaveClip::GetStats(SampleStats *stats,
+                        sampleCount start, sampleCount len) const
+{
+   return mSequence->GetStats(start, len, stats);
+}
+
 bool WaveClip::SetSamples(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len)
 {
@@ -725,47 +694,37 @@ bool WaveClip::GetSpectrogram(float *freq, sampleCount *where,
                                double t0, double pixelsPerSecond,
                                bool autocorrelation)
 {
-   int minFreq = gPrefs->Read(wxT("/Spectrum/MinFreq"), 0L);
-   int maxFreq = gPrefs->Read(wxT("/Spectrum/MaxFreq"), 8000L);
-   int range = gPrefs->Read(wxT("/Spectrum/Range"), 80L);
-   int gain = gPrefs->Read(wxT("/Spectrum/Gain"), 20L);
    int frequencygain = gPrefs->Read(wxT("/Spectrum/FrequencyGain"), 0L);
    int windowType;
    int windowSize = gPrefs->Read(wxT("/Spectrum/FFTSize"), 256);
 #ifdef EXPERIMENTAL_FFT_SKIP_POINTS
    int fftSkipPoints = gPrefs->Read(wxT("/Spectrum/FFTSkipPoints"), 0L);
-   int fftSkipPoints1 = fftSkipPoints+1;
 #endif //EXPERIMENTAL_FFT_SKIP_POINTS
-   int half = windowSize/2;
    gPrefs->Read(wxT("/Spectrum/WindowType"), &windowType, 3);
 
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   // Update the FFT and window if necessary
-   if((mWindowType != windowType) || (mWindowSize != windowSize)
-      || (hFFT == NULL) || (mWindow == NULL) || (mWindowSize != hFFT->Points*2) ) {
-      mWindowType = windowType;
-      mWindowSize = windowSize;
-      if(hFFT != NULL)
-         EndFFT(hFFT);
-      hFFT = InitializeFFT(mWindowSize);
-      if(mWindow != NULL) delete[] mWindow;
-      // Create the requested window function
-      mWindow = new float[mWindowSize];
-      int i;
-      for(i=0; i<windowSize; i++)
-         mWindow[i]=1.0;
-      WindowFunc(mWindowType, mWindowSize, mWindow);
-      // Scale the window function to give 0dB spectrum for 0dB sine tone
-      double ws=0;
-      for(i=0; i<windowSize; i++)
-         ws += mWindow[i];
-      if(ws > 0) {
-         ws = 2.0/ws;
-         for(i=0; i<windowSize; i++)
-            mWindow[i] *= ws;
-      }
-   }
-#endif // EXPERIMENTAL_USE_REALFFTF
+   SpectrogramKey key;
+   key.rate = mRate;
+   key.pixelsPerSecond = pixelsPerSecond;
+   key.windowSize = windowSize;
+   key.windowType = windowType;
+   key.frequencyGain = frequencygain;
+#ifdef EXPERIMENTAL_FFT_SKIP_POINTS
+   key.fftSkipPoints = fftSkipPoints;
+#endif //EXPERIMENTAL_FFT_SKIP_POINTS
+   key.autocorrelation = autocorrelation;
+   key.dirty = mDirty;
+
+   return mSpecTiles->Get(mSequence, key, t0, numPixels, freq, where);
+#else // EXPERIMENTAL_USE_REALFFTF
+   int minFreq = gPrefs->Read(wxT("/Spectrum/MinFreq"), 0L);
+   int maxFreq = gPrefs->Read(wxT("/Spectrum/MaxFreq"), 8000L);
+   int range = gPrefs->Read(wxT("/Spectrum/Range"), 80L);
+   int gain = gPrefs->Read(wxT("/Spectrum/Gain"), 20L);
+#ifdef EXPERIMENTAL_FFT_SKIP_POINTS
+   int fftSkipPoints1 = fftSkipPoints+1;
+#endif //EXPERIMENTAL_FFT_SKIP_POINTS
+   int half = windowSize/2;
 
    if (mSpecCache &&
        mSpecCache->minFreqOld == minFreq &&
@@ -922,19 +881,9 @@ bool WaveClip::GetSpectrogram(float *freq, sampleCount *where,
                mSequence->Get((samplePtr)adj, floatSample, start, len);
 #endif //EXPERIMENTAL_FFT_SKIP_POINTS
 
-#ifdef EXPERIMENTAL_USE_REALFFTF
-            if(autocorrelation) {
-               ComputeSpectrum(buffer, windowSize, windowSize,
-                               mRate, &mSpecCache->freq[half * x],
-                               autocorrelation, windowType);
-            } else {
-               ComputeSpectrumUsingRealFFTf(buffer, hFFT, mWindow, mWindowSize, &mSpecCache->freq[half * x]);
-            }
-#else  // EXPERIMENTAL_USE_REALFFTF
            ComputeSpectrum(buffer, windowSize, windowSize,
                            mRate, &mSpecCache->freq[half * x],
                            autocorrelation, windowType);
-#endif // EXPERIMENTAL_USE_REALFFTF
            if(gainfactor) {
               // Apply a frequency-dependant gain factor
               for(i=0; i<half; i++)
@@ -953,6 +902,7 @@ bool WaveClip::GetSpectrogram(float *freq, sampleCount *where,
    memcpy(freq, mSpecCache->freq, numPixels*half*sizeof(float));
    memcpy(where, mSpecCache->where, (numPixels+1)*sizeof(sampleCount));
    return true;
+#endif // EXPERIMENTAL_USE_REALFFTF
 }
 
 bool WaveClip::GetMinMax(float *min, float *max,
@@ -1612,6 +1562,9 @@ bool WaveClip::Resample(int rate, ProgressDialog *progress)
       if (mSpecCache)
          delete mSpecCache;
       mSpecCache = new SpecCache(1, 1, false);
+#ifdef EXPERIMENTAL_USE_REALFFTF
+      mSpecTiles->Clear();
+#endif
    }
 
    return !error;
@@ -32,6 +32,7 @@
 class Envelope;
 class WaveCache;
 class SpecCache;
+class SpectrogramTiles;
 
 class SpecPxCache {
 public:
@@ -117,6 +118,9 @@ public:
 
    bool GetSamples(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len) const;
+   /// SampleStats of the samples GetSamples() would give
+   bool GetStats(SampleStats *stats,
+                 sampleCount start, sampleCount len) const;
    bool SetSamples(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len);
 
@@ -249,11 +253,8 @@ protected:
    ODLock       mWaveCacheMutex;
    SpecCache    *mSpecCache;
 #ifdef EXPERIMENTAL_USE_REALFFTF
-   // Variables used for computing the spectrum
-   HFFT          hFFT;
-   float         *mWindow;
-   int           mWindowType;
-   int           mWindowSize;
+   // Columns of the spectrogram, computed in the background
+   SpectrogramTiles *mSpecTiles;
 #endif
    samplePtr     mAppendBuffer;
    sampleCount   mAppendBufferLen;
@@ -1367,7 +1367,9 @@ sampleCount WaveTrack::GetBestBlockSize(sampleCount s)
       sampleCount endSample = startSample + clip->GetNumSamples();
       if (s >= startSample && s < endSample)
       {
-         bestBlockSize = clip->GetSequence()->GetMaxBlockSize();
+         // The rest of the block s is in, so that whole blocks are
+         // read, and their SampleStats can stand for them
+         bestBlockSize = clip->GetSequence()->GetBestBlockSize(s - startSample);
          break;
       }
    }
@@ -1804,6 +1806,49 @@ bool WaveTrack::Get(samplePtr buffer, sampleFormat format,
    return true;
 }
 
+bool WaveTrack::GetStats(SampleStats *stats,
+                         sampleCount start, sampleCount len)
+{
+   *stats = SampleStats();
+
+   // As Get() does
+   for (WaveClipList::compatibility_iterator it=GetClipIterator(); it; it=it->GetNext())
+   {
+      WaveClip *clip = it->GetData();
+
+      sampleCount clipStart = clip->GetStartSample();
+      sampleCount clipEnd = clip->GetEndSample();
+
+      if (clipEnd > start && clipStart < start+len)
+      {
+         sampleCount samplesToCopy = start+len - clipStart;
+         if (samplesToCopy > clip->GetNumSamples())
+            samplesToCopy = clip->GetNumSamples();
+         sampleCount inclipDelta = 0;
+         sampleCount startDelta = clipStart - start;
+         if (startDelta < 0)
+         {
+            inclipDelta = -startDelta; // make positive value
+            samplesToCopy -= inclipDelta;
+            startDelta = 0;
+         }
+
+         SampleStats clipStats;
+         if (!clip->GetStats(&clipStats, inclipDelta, samplesToCopy))
+         {
+            wxASSERT(false); // should always work
+            return false;
+         }
+         stats->Add(clipStats, startDelta);
+      }
+   }
+
+   // Get() gives zeros where there are no clips
+   stats->AddSilence(len - stats->len);
+
+   return true;
+}
+
 bool WaveTrack::Set(samplePtr buffer, sampleFormat format,
                     sampleCount start, sampleCount len)
 {
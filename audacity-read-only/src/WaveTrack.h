@@ -234,6 +234,10 @@ class AUDACITY_DLL_API WaveTrack: public Track {
                    sampleCount start, sampleCount len, fillFormat fill=fillZero);
    bool Set(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len);
+   /// SampleStats of the samples Get() would give, counting the space
+   /// between clips as silence; peak is from start.  Only the blocks
+   /// start and start + len cut need be read, once the rest have theirs.
+   bool GetStats(SampleStats *stats, sampleCount start, sampleCount len);
    void GetEnvelopeValues(double *buffer, int bufferLen,
                          double t0, double tstep);
    bool GetMinMax(float *min, float *max,
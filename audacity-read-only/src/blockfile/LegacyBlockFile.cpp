@@ -180,8 +180,8 @@ bool LegacyBlockFile::ReadSummary(void *data)
 /// @param format The format the data will be stored in
 /// @param start  The offset in this block file
 /// @param len    The number of samples to read
-int LegacyBlockFile::ReadData(samplePtr data, sampleFormat format,
-                              sampleCount start, sampleCount len)
+int LegacyBlockFile::ReadDataUncached(samplePtr data, sampleFormat format,
+                                      sampleCount start, sampleCount len)
 {
    SF_INFO info;
 
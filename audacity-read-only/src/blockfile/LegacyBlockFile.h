@@ -50,8 +50,8 @@ class LegacyBlockFile : public BlockFile {
    /// Read the summary section of the disk file
    virtual bool ReadSummary(void *data);
    /// Read the data section of the disk file
-   virtual int ReadData(samplePtr data, sampleFormat format,
-                        sampleCount start, sampleCount len);
+   virtual int ReadDataUncached(samplePtr data, sampleFormat format,
+                                sampleCount start, sampleCount len);
 
    /// Create a new block file identical to this one
    virtual BlockFile *Copy(wxFileName newFileName);
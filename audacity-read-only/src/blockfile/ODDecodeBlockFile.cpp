@@ -524,13 +524,13 @@ void *ODDecodeBlockFile::CalcSummary(samplePtr buffer, sampleCount len,
 /// @param format The format to convert the data into
 /// @param start  The offset within the block to begin reading
 /// @param len    The number of samples to read
-int ODDecodeBlockFile::ReadData(samplePtr data, sampleFormat format,
-                                sampleCount start, sampleCount len)
+int ODDecodeBlockFile::ReadDataUncached(samplePtr data, sampleFormat format,
+                                        sampleCount start, sampleCount len)
 {
    int ret;
    LockRead();
    if(IsSummaryAvailable())
-      ret= SimpleBlockFile::ReadData(data,format,start,len);
+      ret= SimpleBlockFile::ReadDataUncached(data,format,start,len);
    else
    {
       //we should do an ODRequest to start processing the data here, and wait till it finishes. and just do a SimpleBlockFIle
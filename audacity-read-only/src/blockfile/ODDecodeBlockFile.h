@@ -108,8 +108,8 @@ class ODDecodeBlockFile : public SimpleBlockFile
    //Below calls are overrided just so we can take wxlog calls out, which are not threadsafe.
 
    /// Reads the specified data from the aliased file using libsndfile
-   virtual int ReadData(samplePtr data, sampleFormat format,
-                        sampleCount start, sampleCount len);
+   virtual int ReadDataUncached(samplePtr data, sampleFormat format,
+                                sampleCount start, sampleCount len);
 
    /// Read the summary into a buffer
    virtual bool ReadSummary(void *data);
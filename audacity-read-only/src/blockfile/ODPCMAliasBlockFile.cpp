@@ -592,8 +592,8 @@ void *ODPCMAliasBlockFile::CalcSummary(samplePtr buffer, sampleCount len,
 /// @param format The format to convert the data into
 /// @param start  The offset within the block to begin reading
 /// @param len    The number of samples to read
-int ODPCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
-                                sampleCount start, sampleCount len)
+int ODPCMAliasBlockFile::ReadDataUncached(samplePtr data, sampleFormat format,
+                                          sampleCount start, sampleCount len)
 {
 
    LockRead();
@@ -70,8 +70,8 @@ PCMAliasBlockFile::~PCMAliasBlockFile()
 /// @param format The format to convert the data into
 /// @param start  The offset within the block to begin reading
 /// @param len    The number of samples to read
-int PCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
-                                sampleCount start, sampleCount len)
+int PCMAliasBlockFile::ReadDataUncached(samplePtr data, sampleFormat format,
+                                        sampleCount start, sampleCount len)
 {
    SF_INFO info;
 
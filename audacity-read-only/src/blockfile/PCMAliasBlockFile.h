@@ -37,8 +37,8 @@ class PCMAliasBlockFile : public AliasBlockFile
    virtual ~PCMAliasBlockFile();
 
    /// Reads the specified data from the aliased file using libsndfile
-   virtual int ReadData(samplePtr data, sampleFormat format,
-                        sampleCount start, sampleCount len);
+   virtual int ReadDataUncached(samplePtr data, sampleFormat format,
+                                sampleCount start, sampleCount len);
 
    virtual void SaveXML(XMLWriter &xmlFile);
    virtual BlockFile *Copy(wxFileName fileName);
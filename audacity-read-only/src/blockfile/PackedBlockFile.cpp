@@ -0,0 +1,867 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockFile.cpp
+
+*******************************************************************//**
+
+\class BlockPack
+\brief One file per project holding the data of all its
+PackedBlockFiles, read through mmap.
+
+A pack is a 32 byte header ("AudacityBlockPck" and a byte order mark)
+followed by records, each aligned to 16 bytes:
+
+   PackRecordHeader (magic, sample format, sample count, summary size,
+                     block name)
+   summary data, as BlockFile::CalcSummary makes it
+   sample data, in the block's sample format
+
+A record never crosses a BLOCKPACK_SEGMENT_SIZE boundary (the writer
+skips to the next segment instead), so a record is always inside one
+mapping.  Segments are mapped on first read and only unmapped when the
+pack is destroyed.
+
+The space of records no block refers to any more is reused.  Where a
+new record leaves part of such space over, a gap header (magic "APKG",
+len the size of the gap in bytes) follows it, so the pack can still be
+walked from record to record.
+
+*//****************************************************************//**
+
+\class PackedBlockFile
+\brief A BlockFile that keeps its data in the project's BlockPack.
+
+Writing a block is one append to an already open file; reading it is a
+copy out of the mapping.  Sequential playback and effects thus read the
+pack front to back without opening a file per block.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#include "PackedBlockFile.h"
+
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <wx/filefn.h>
+#include <wx/log.h>
+
+#include "../Internat.h"
+#include "../xml/XMLTagHandler.h"
+
+#define PACK_HEADER_SIZE 32
+#define PACK_RECORD_ALIGN 16
+#define PACK_NAME_LEN 16
+
+static const char packTag[16] = {
+   'A', 'u', 'd', 'a', 'c', 'i', 't', 'y',
+   'B', 'l', 'o', 'c', 'k', 'P', 'c', 'k' };
+static const wxUint32 packByteOrder = 0x01020304;
+static const wxUint32 packRecordMagic = 0x41504b52; // "APKR"
+static const wxUint32 packGapMagic = 0x41504b47; // "APKG"
+
+struct PackRecordHeader {
+   wxUint32 magic;
+   wxUint32 format;
+   wxUint32 len;
+   wxUint32 summaryBytes;
+   char name[PACK_NAME_LEN];
+};
+
+static void SwapSamples(samplePtr buffer, sampleFormat format,
+                        sampleCount len)
+{
+   sampleCount i;
+
+   if (format == int16Sample) {
+      wxUint16 *p = (wxUint16 *)buffer;
+      for (i = 0; i < len; i++)
+         p[i] = wxUINT16_SWAP_ALWAYS(p[i]);
+   }
+   else {
+      wxUint32 *p = (wxUint32 *)buffer;
+      for (i = 0; i < len; i++)
+         p[i] = wxUINT32_SWAP_ALWAYS(p[i]);
+   }
+}
+
+BlockPack::BlockPack(wxString fullPath):
+   mRefCount(1),
+   mLength(0),
+   mSwapped(false),
+   mWalked(false)
+{
+   memset(mSegments, 0, sizeof(mSegments));
+   Open(fullPath);
+}
+
+BlockPack::~BlockPack()
+{
+   Close();
+
+   for (size_t i = 0; i < mRetired.size(); i++)
+      munmap(mRetired[i], BLOCKPACK_SEGMENT_SIZE);
+   mRetired.clear();
+}
+
+void BlockPack::Ref()
+{
+   mLock.Lock();
+   mRefCount++;
+   mLock.Unlock();
+}
+
+void BlockPack::Deref()
+{
+   mLock.Lock();
+   int count = --mRefCount;
+   mLock.Unlock();
+
+   if (count <= 0)
+      delete this;
+}
+
+wxFileOffset BlockPack::GetLength()
+{
+   mLock.Lock();
+   wxFileOffset length = mLength;
+   mLock.Unlock();
+
+   return length;
+}
+
+bool BlockPack::IsSwapped()
+{
+   mLock.Lock();
+   bool swapped = mSwapped;
+   mLock.Unlock();
+
+   return swapped;
+}
+
+/// Opens an existing pack, or creates an empty one.  On failure the
+/// pack is left closed (!IsOk()): appends fail and reads find nothing.
+bool BlockPack::Open(wxString fullPath)
+{
+   char header[PACK_HEADER_SIZE];
+
+   mFullPath = fullPath;
+   mLength = 0;
+   mSwapped = false;
+
+   if (!wxFileExists(fullPath)) {
+      wxFile create;
+      if (!create.Create(fullPath))
+         return false;
+
+      memset(header, 0, PACK_HEADER_SIZE);
+      memcpy(header, packTag, sizeof(packTag));
+      memcpy(header + sizeof(packTag), &packByteOrder, sizeof(packByteOrder));
+      if (create.Write(header, PACK_HEADER_SIZE) != PACK_HEADER_SIZE) {
+         create.Close();
+         wxRemoveFile(fullPath);
+         return false;
+      }
+   }
+
+   // mmap needs a descriptor opened for reading
+   if (!mFile.Open(fullPath, wxFile::read_write))
+      return false;
+
+   if (mFile.Read(header, PACK_HEADER_SIZE) != PACK_HEADER_SIZE ||
+       memcmp(header, packTag, sizeof(packTag))) {
+      wxLogError(_("'%s' is not an Audacity block pack."), fullPath.c_str());
+      mFile.Close();
+      return false;
+   }
+
+   wxUint32 order;
+   memcpy(&order, header + sizeof(packTag), sizeof(order));
+   mSwapped = (order != packByteOrder);
+
+   mLength = mFile.Length();
+   // Drop a partial record left by a failed write
+   mLength -= (mLength - PACK_HEADER_SIZE) % PACK_RECORD_ALIGN;
+
+   return true;
+}
+
+void BlockPack::Close()
+{
+   for (int i = 0; i < BLOCKPACK_MAX_SEGMENTS; i++) {
+      if (mSegments[i]) {
+         munmap(mSegments[i], BLOCKPACK_SEGMENT_SIZE);
+         mSegments[i] = NULL;
+      }
+   }
+
+   if (mFile.IsOpened())
+      mFile.Close();
+}
+
+wxFileOffset BlockPack::RecordSize(sampleCount sampleLen,
+                                   sampleFormat format, int summaryBytes)
+{
+   wxFileOffset size = sizeof(PackRecordHeader) + summaryBytes +
+      (wxFileOffset)sampleLen * SAMPLE_SIZE(format);
+
+   return (size + PACK_RECORD_ALIGN - 1) & ~(wxFileOffset)(PACK_RECORD_ALIGN - 1);
+}
+
+wxFileOffset BlockPack::Append(wxString name, sampleFormat format,
+                               samplePtr sampleData, sampleCount sampleLen,
+                               void *summaryData, int summaryBytes)
+{
+   wxFileOffset size = RecordSize(sampleLen, format, summaryBytes);
+   size_t sampleBytes = sampleLen * SAMPLE_SIZE(format);
+   size_t padBytes = size - sizeof(PackRecordHeader) - summaryBytes - sampleBytes;
+   char pad[PACK_RECORD_ALIGN];
+   PackRecordHeader header;
+
+   if (size > BLOCKPACK_SEGMENT_SIZE)
+      return -1;
+
+   memset(&header, 0, sizeof(header));
+   header.magic = packRecordMagic;
+   header.format = format;
+   header.len = sampleLen;
+   header.summaryBytes = summaryBytes;
+   strncpy(header.name, name.mb_str(), PACK_NAME_LEN);
+   memset(pad, 0, sizeof(pad));
+
+   mLock.Lock();
+
+   if (!mFile.IsOpened() || mSwapped) {
+      // Records of the other byte order can be read but we don't mix
+      mLock.Unlock();
+      return -1;
+   }
+
+   if (!mWalked) {
+      // By now the project is loaded and its blocks have counted their
+      // references
+      FreeUnreferenced();
+      mWalked = true;
+   }
+
+   wxFileOffset offset = Allocate(size);
+   bool reused = (offset >= 0);
+   if (!reused) {
+      offset = mLength;
+      wxFileOffset inSegment = offset % BLOCKPACK_SEGMENT_SIZE;
+      if (inSegment + size > BLOCKPACK_SEGMENT_SIZE)
+         offset += BLOCKPACK_SEGMENT_SIZE - inSegment;
+   }
+
+   if (offset / BLOCKPACK_SEGMENT_SIZE >= BLOCKPACK_MAX_SEGMENTS ||
+       mFile.Seek(offset) == wxInvalidOffset ||
+       mFile.Write(&header, sizeof(header)) != sizeof(header) ||
+       mFile.Write(summaryData, summaryBytes) != (size_t)summaryBytes ||
+       mFile.Write(sampleData, sampleBytes) != sampleBytes ||
+       mFile.Write(pad, padBytes) != padBytes) {
+      if (reused)
+         Free(offset, size);
+      mLock.Unlock();
+      return -1;
+   }
+
+   if (!reused)
+      mLength = offset + size;
+   mRecordRefs[offset] = 1;
+
+   mLock.Unlock();
+
+   return offset;
+}
+
+/// Called with mLock held.  First fit: takes the free extent of lowest
+/// offset that holds size bytes, leaving either nothing or room for a
+/// gap header.  Returns -1 if none does.
+wxFileOffset BlockPack::Allocate(wxFileOffset size)
+{
+   std::map<wxFileOffset, wxFileOffset>::iterator iter;
+   for (iter = mFree.begin(); iter != mFree.end(); ++iter) {
+      wxFileOffset offset = iter->first;
+      wxFileOffset rest = iter->second - size;
+      if (rest != 0 && rest < (wxFileOffset)sizeof(PackRecordHeader))
+         continue;
+
+      mFree.erase(iter);
+      if (rest > 0) {
+         // If the gap header can't be written, the pack can't be walked
+         // past the new record: leave the space alone
+         if (!WriteGap(offset + size, rest)) {
+            mFree[offset] = size + rest;
+            return -1;
+         }
+         mFree[offset + size] = rest;
+      }
+      return offset;
+   }
+
+   return -1;
+}
+
+/// Called with mLock held.  Adds the extent to the free list, joined
+/// with its neighbours when they are in the same segment, as records
+/// written into it must be.
+void BlockPack::Free(wxFileOffset offset, wxFileOffset size)
+{
+   wxFileOffset segment = offset / BLOCKPACK_SEGMENT_SIZE;
+
+   std::map<wxFileOffset, wxFileOffset>::iterator next =
+      mFree.lower_bound(offset);
+   if (next != mFree.end() && next->first == offset + size &&
+       next->first / BLOCKPACK_SEGMENT_SIZE == segment) {
+      size += next->second;
+      mFree.erase(next++);
+   }
+
+   if (next != mFree.begin()) {
+      std::map<wxFileOffset, wxFileOffset>::iterator prev = next;
+      --prev;
+      if (prev->first + prev->second == offset &&
+          prev->first / BLOCKPACK_SEGMENT_SIZE == segment) {
+         prev->second += size;
+         return;
+      }
+   }
+
+   mFree[offset] = size;
+}
+
+/// Called with mLock held
+bool BlockPack::WriteGap(wxFileOffset offset, wxFileOffset size)
+{
+   PackRecordHeader header;
+
+   memset(&header, 0, sizeof(header));
+   header.magic = packGapMagic;
+   header.len = size;
+
+   return mFile.Seek(offset) != wxInvalidOffset &&
+          mFile.Write(&header, sizeof(header)) == sizeof(header);
+}
+
+/// Called with mLock held.  Walks the pack record by record and frees
+/// the records no block refers to, and the gaps, left by earlier
+/// sessions: the project file they were saved with no longer needs
+/// them.  Where there is neither a record nor a gap header, the writer
+/// skipped to the next segment.
+void BlockPack::FreeUnreferenced()
+{
+   wxFileOffset offset = PACK_HEADER_SIZE;
+
+   while (offset + (wxFileOffset)sizeof(PackRecordHeader) <= mLength) {
+      wxFileOffset segment = offset / BLOCKPACK_SEGMENT_SIZE;
+      wxFileOffset inSegment = offset % BLOCKPACK_SEGMENT_SIZE;
+      wxFileOffset nextSegment = (segment + 1) * BLOCKPACK_SEGMENT_SIZE;
+
+      if (inSegment + (wxFileOffset)sizeof(PackRecordHeader) > BLOCKPACK_SEGMENT_SIZE) {
+         offset = nextSegment;
+         continue;
+      }
+
+      const char *base = MapSegment(segment);
+      if (!base)
+         return;
+
+      PackRecordHeader header;
+      memcpy(&header, base + inSegment, sizeof(header));
+
+      wxFileOffset size = 0;
+      bool isFree = false;
+      if (header.magic == packRecordMagic &&
+          XMLValueChecker::IsValidSampleFormat(header.format)) {
+         size = RecordSize(header.len, (sampleFormat)header.format,
+                           header.summaryBytes);
+         isFree = (mRecordRefs.find(offset) == mRecordRefs.end());
+      }
+      else if (header.magic == packGapMagic &&
+               header.len % PACK_RECORD_ALIGN == 0) {
+         size = header.len;
+         isFree = true;
+      }
+
+      if (size < (wxFileOffset)sizeof(PackRecordHeader) ||
+          inSegment + size > BLOCKPACK_SEGMENT_SIZE ||
+          offset + size > mLength) {
+         offset = nextSegment;
+         continue;
+      }
+
+      if (isFree)
+         Free(offset, size);
+      offset += size;
+   }
+}
+
+void BlockPack::RefRecord(wxFileOffset offset)
+{
+   if (offset < PACK_HEADER_SIZE)
+      return;
+
+   mLock.Lock();
+   mRecordRefs[offset]++;
+   mLock.Unlock();
+}
+
+void BlockPack::DerefRecord(wxFileOffset offset, bool reclaim)
+{
+   mLock.Lock();
+
+   std::map<wxFileOffset, int>::iterator iter = mRecordRefs.find(offset);
+   if (iter != mRecordRefs.end() && --iter->second <= 0) {
+      mRecordRefs.erase(iter);
+
+      sampleFormat format;
+      sampleCount sampleLen;
+      int summaryBytes;
+      if (reclaim && !mSwapped &&
+          FindRecord(offset, &format, &sampleLen, &summaryBytes))
+         Free(offset, RecordSize(sampleLen, format, summaryBytes));
+   }
+
+   mLock.Unlock();
+}
+
+int BlockPack::GetRecordRefs(wxFileOffset offset)
+{
+   mLock.Lock();
+   std::map<wxFileOffset, int>::iterator iter = mRecordRefs.find(offset);
+   int refs = (iter == mRecordRefs.end()) ? 0 : iter->second;
+   mLock.Unlock();
+
+   return refs;
+}
+
+/// Called with mLock held
+const char *BlockPack::MapSegment(int segment)
+{
+   if (!mSegments[segment] && mFile.IsOpened()) {
+      void *p = mmap(NULL, BLOCKPACK_SEGMENT_SIZE, PROT_READ, MAP_SHARED,
+                     mFile.fd(), (off_t)segment * BLOCKPACK_SEGMENT_SIZE);
+      if (p != MAP_FAILED) {
+         madvise(p, BLOCKPACK_SEGMENT_SIZE, MADV_SEQUENTIAL);
+         mSegments[segment] = (char *)p;
+      }
+      else
+         wxLogSysError(_("Could not map block pack '%s'."), mFullPath.c_str());
+   }
+
+   return mSegments[segment];
+}
+
+const char *BlockPack::MapRecord(wxFileOffset offset,
+                                 sampleFormat *format, sampleCount *sampleLen,
+                                 int *summaryBytes)
+{
+   // Append() and MoveTo() change the length, the mappings and the byte
+   // order; the record itself isn't rewritten while the caller's block
+   // refers to it, so only finding it needs the lock
+   mLock.Lock();
+   const char *record = FindRecord(offset, format, sampleLen, summaryBytes);
+   mLock.Unlock();
+
+   return record;
+}
+
+/// Called with mLock held
+const char *BlockPack::FindRecord(wxFileOffset offset,
+                                  sampleFormat *format, sampleCount *sampleLen,
+                                  int *summaryBytes)
+{
+   if (offset < PACK_HEADER_SIZE ||
+       offset + (wxFileOffset)sizeof(PackRecordHeader) > mLength)
+      return NULL;
+
+   wxFileOffset segment = offset / BLOCKPACK_SEGMENT_SIZE;
+   wxFileOffset inSegment = offset % BLOCKPACK_SEGMENT_SIZE;
+   if (segment >= BLOCKPACK_MAX_SEGMENTS ||
+       inSegment + (wxFileOffset)sizeof(PackRecordHeader) > BLOCKPACK_SEGMENT_SIZE)
+      return NULL;
+
+   const char *base = MapSegment(segment);
+   if (!base)
+      return NULL;
+
+   const char *record = base + inSegment;
+   PackRecordHeader header;
+   memcpy(&header, record, sizeof(header));
+   if (mSwapped) {
+      header.magic = wxUINT32_SWAP_ALWAYS(header.magic);
+      header.format = wxUINT32_SWAP_ALWAYS(header.format);
+      header.len = wxUINT32_SWAP_ALWAYS(header.len);
+      header.summaryBytes = wxUINT32_SWAP_ALWAYS(header.summaryBytes);
+   }
+
+   if (header.magic != packRecordMagic ||
+       !XMLValueChecker::IsValidSampleFormat(header.format))
+      return NULL;
+
+   wxFileOffset size = RecordSize(header.len, (sampleFormat)header.format,
+                                  header.summaryBytes);
+   if (offset + size > mLength || inSegment + size > BLOCKPACK_SEGMENT_SIZE)
+      return NULL;
+
+   *format = (sampleFormat)header.format;
+   *sampleLen = header.len;
+   *summaryBytes = header.summaryBytes;
+
+   return record;
+}
+
+/// Called with mLock held
+bool BlockPack::Reopen(wxString fullPath)
+{
+   // Readers may still be copying out of the old mappings; keep them
+   // until the pack goes away.  After a copy they also no longer show
+   // what is appended, so map the file afresh.
+   for (int i = 0; i < BLOCKPACK_MAX_SEGMENTS; i++) {
+      if (mSegments[i]) {
+         mRetired.push_back(mSegments[i]);
+         mSegments[i] = NULL;
+      }
+   }
+   mFile.Close();
+
+   return Open(fullPath);
+}
+
+bool BlockPack::MoveTo(wxString newFullPath, bool copy)
+{
+   mLock.Lock();
+
+   wxString oldFullPath = mFullPath;
+   if (newFullPath == oldFullPath) {
+      mLock.Unlock();
+      return true;
+   }
+
+   bool success = copy ?
+      wxCopyFile(oldFullPath, newFullPath) :
+      wxRenameFile(oldFullPath, newFullPath);
+
+   if (success) {
+      success = Reopen(newFullPath);
+      if (!success) {
+         // Go on with the file where it was
+         if (copy)
+            wxRemoveFile(newFullPath);
+         else
+            wxRenameFile(newFullPath, oldFullPath);
+         Reopen(oldFullPath);
+      }
+   }
+
+   mLock.Unlock();
+
+   return success;
+}
+
+bool BlockPack::MoveBack(wxString oldFullPath, bool copied)
+{
+   if (!copied)
+      return MoveTo(oldFullPath, false);
+
+   mLock.Lock();
+
+   wxString copyFullPath = mFullPath;
+   if (copyFullPath == oldFullPath) {
+      mLock.Unlock();
+      return true;
+   }
+
+   bool success = Reopen(oldFullPath);
+   if (success)
+      wxRemoveFile(copyFullPath);
+
+   mLock.Unlock();
+
+   return success;
+}
+
+/// Write the summary and samples to the end of the pack.  If that fails
+/// the block refers to no record (see IsRecordAvailable()) and reads as
+/// silence.
+PackedBlockFile::PackedBlockFile(wxFileName baseFileName, BlockPack *pack,
+                                 samplePtr sampleData, sampleCount sampleLen,
+                                 sampleFormat format):
+   BlockFile(baseFileName, sampleLen),
+   mPack(pack),
+   mOffset(-1),
+   mFormat(format)
+{
+   mPack->Ref();
+
+   void *summaryData = BlockFile::CalcSummary(sampleData, sampleLen, format);
+   mOffset = mPack->Append(mFileName.GetName(), format, sampleData, sampleLen,
+                           summaryData, mSummaryInfo.totalSummaryBytes);
+}
+
+/// Construct a PackedBlockFile memory structure that will point to an
+/// existing record of the pack.
+PackedBlockFile::PackedBlockFile(wxFileName existingFile, BlockPack *pack,
+                                 wxFileOffset offset, sampleCount len,
+                                 sampleFormat format,
+                                 float min, float max, float rms):
+   BlockFile(existingFile, len),
+   mPack(pack),
+   mOffset(offset),
+   mFormat(format)
+{
+   mPack->Ref();
+   mPack->RefRecord(mOffset);
+
+   mMin = min;
+   mMax = max;
+   mRMS = rms;
+}
+
+PackedBlockFile::~PackedBlockFile()
+{
+   // There is no file of this name to delete
+   mFileName.Clear();
+
+   // The saved project still needs the records of locked blocks
+   mPack->DerefRecord(mOffset, !IsLocked());
+   mPack->Deref();
+}
+
+const char *PackedBlockFile::GetRecord(int *summaryBytes)
+{
+   sampleFormat format;
+   sampleCount len;
+
+   const char *record = mPack->MapRecord(mOffset, &format, &len, summaryBytes);
+   if (!record || format != mFormat || len != mLen ||
+       *summaryBytes != mSummaryInfo.totalSummaryBytes)
+      return NULL;
+
+   return record;
+}
+
+void PackedBlockFile::AdviseWillNeed()
+{
+   int summaryBytes;
+   const char *record = GetRecord(&summaryBytes);
+
+   if (!record)
+      return;
+
+   // Segments are mapped at page boundaries, so this stays inside the
+   // record's segment
+   long pageSize = sysconf(_SC_PAGESIZE);
+   const char *end = record + BlockPack::RecordSize(mLen, mFormat, summaryBytes);
+   record -= (size_t)record % (size_t)pageSize;
+
+   madvise((void *)record, end - record, MADV_WILLNEED);
+}
+
+bool PackedBlockFile::IsRecordAvailable()
+{
+   int summaryBytes;
+
+   return GetRecord(&summaryBytes) != NULL;
+}
+
+bool PackedBlockFile::ReadSummary(void *data)
+{
+   int summaryBytes;
+   const char *record = GetRecord(&summaryBytes);
+
+   if (!record) {
+      // Same as a missing .au file; ProjectFSCK() reports it
+      memset(data, 0, (size_t)mSummaryInfo.totalSummaryBytes);
+      return true;
+   }
+
+   memcpy(data, record + sizeof(PackRecordHeader), (size_t)summaryBytes);
+
+   FixSummary(data);
+
+   return true;
+}
+
+/// Copy the samples out of the mapped record, converting to the given
+/// format if it is not already.
+///
+/// @param data   The buffer where the data will be stored
+/// @param format The format the data will be stored in
+/// @param start  The offset in this block file
+/// @param len    The number of samples to read
+int PackedBlockFile::ReadDataUncached(samplePtr data, sampleFormat format,
+                                      sampleCount start, sampleCount len)
+{
+   int summaryBytes;
+   const char *record = GetRecord(&summaryBytes);
+
+   if (!record) {
+      ClearSamples(data, format, 0, len);
+      return len;
+   }
+
+   if (start >= mLen)
+      return 0;
+   if (len > mLen - start)
+      len = mLen - start;
+
+   samplePtr src = (samplePtr)(record + sizeof(PackRecordHeader) +
+                               summaryBytes + start * SAMPLE_SIZE(mFormat));
+
+   if (mPack->IsSwapped()) {
+      samplePtr buffer = NewSamples(len, mFormat);
+      memcpy(buffer, src, len * SAMPLE_SIZE(mFormat));
+      SwapSamples(buffer, mFormat, len);
+      CopySamples(buffer, mFormat, data, format, len);
+      DeleteSamples(buffer);
+   }
+   else
+      CopySamples(src, mFormat, data, format, len);
+
+   return len;
+}
+
+void PackedBlockFile::SaveXML(XMLWriter &xmlFile)
+{
+   xmlFile.StartTag(wxT("packedblockfile"));
+
+   xmlFile.WriteAttr(wxT("filename"), mFileName.GetFullName());
+   xmlFile.WriteAttr(wxT("offset"), (long long)mOffset);
+   xmlFile.WriteAttr(wxT("len"), mLen);
+   xmlFile.WriteAttr(wxT("format"), (int)mFormat);
+   xmlFile.WriteAttr(wxT("min"), mMin);
+   xmlFile.WriteAttr(wxT("max"), mMax);
+   xmlFile.WriteAttr(wxT("rms"), mRMS);
+
+   xmlFile.EndTag(wxT("packedblockfile"));
+}
+
+// BuildFromXML methods should always return a BlockFile, not NULL,
+// even if the result is flawed (e.g., refers to nonexistent file),
+// as testing will be done in DirManager::ProjectFSCK().
+/// static
+BlockFile *PackedBlockFile::BuildFromXML(DirManager &dm, const wxChar **attrs)
+{
+   wxFileName fileName;
+   float min = 0.0f, max = 0.0f, rms = 0.0f;
+   sampleCount len = 0;
+   wxLongLong_t offset = -1;
+   sampleFormat format = int16Sample;
+   double dblValue;
+   long nValue;
+   wxLongLong_t llValue;
+
+   while(*attrs)
+   {
+      const wxChar *attr =  *attrs++;
+      const wxChar *value = *attrs++;
+      if (!value)
+         break;
+
+      const wxString strValue = value;
+      if (!wxStricmp(attr, wxT("filename")) &&
+            XMLValueChecker::IsGoodFileString(strValue) &&
+            (strValue.Length() + 1 + dm.GetProjectDataDir().Length() <= PLATFORM_MAX_PATH))
+      {
+         if (!dm.AssignFile(fileName, strValue, false))
+            // Make sure fileName is back to uninitialized state so we can detect problem later.
+            fileName.Clear();
+      }
+      else if (!wxStricmp(attr, wxT("offset")) &&
+               XMLValueChecker::IsGoodInt64(strValue) && strValue.ToLongLong(&llValue) &&
+               llValue >= 0)
+         offset = llValue;
+      else if (!wxStrcmp(attr, wxT("len")) &&
+               XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+               nValue > 0)
+         len = nValue;
+      else if (!wxStrcmp(attr, wxT("format")) &&
+               XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+               XMLValueChecker::IsValidSampleFormat(nValue))
+         format = (sampleFormat)nValue;
+      else if (XMLValueChecker::IsGoodString(strValue) && Internat::CompatibleToDouble(strValue, &dblValue))
+      {  // double parameters
+         if (!wxStricmp(attr, wxT("min")))
+            min = dblValue;
+         else if (!wxStricmp(attr, wxT("max")))
+            max = dblValue;
+         else if (!wxStricmp(attr, wxT("rms")) && (dblValue >= 0.0))
+            rms = dblValue;
+      }
+   }
+
+   return new PackedBlockFile(fileName, dm.GetBlockPack(), offset, len, format,
+                              min, max, rms);
+}
+
+/// Create a copy of this BlockFile under another name.  A record isn't
+/// changed while blocks refer to it, so the copy shares this one's.
+BlockFile *PackedBlockFile::Copy(wxFileName newFileName)
+{
+   BlockFile *newBlockFile = new PackedBlockFile(newFileName, mPack, mOffset,
+                                                 mLen, mFormat,
+                                                 mMin, mMax, mRMS);
+
+   return newBlockFile;
+}
+
+/// Create a copy of this BlockFile with its own record in another pack
+/// (for pasting into another project).  Returns NULL on failure.
+BlockFile *PackedBlockFile::CopyTo(wxFileName newFileName, BlockPack *pack)
+{
+   if (!IsRecordAvailable())
+      return NULL;
+
+   samplePtr buffer = NewSamples(mLen, mFormat);
+   ReadData(buffer, mFormat, 0, mLen);
+
+   PackedBlockFile *newBlockFile =
+      new PackedBlockFile(newFileName, pack, buffer, mLen, mFormat);
+
+   DeleteSamples(buffer);
+
+   if (!newBlockFile->IsRecordAvailable()) {
+      delete newBlockFile;
+      return NULL;
+   }
+
+   return newBlockFile;
+}
+
+/// Blocks sharing a record each count their part of it, so that
+/// together they count it once.
+wxLongLong PackedBlockFile::GetSpaceUsage()
+{
+   wxLongLong size =
+      BlockPack::RecordSize(mLen, mFormat, mSummaryInfo.totalSummaryBytes);
+   int refs = mPack->GetRecordRefs(mOffset);
+
+   return refs > 1 ? size / refs : size;
+}
+
+/// The record is missing or damaged: append silence in its place.
+void PackedBlockFile::Recover()
+{
+   samplePtr buffer = NewSamples(mLen, mFormat);
+   ClearSamples(buffer, mFormat, 0, mLen);
+
+   void *summaryData = BlockFile::CalcSummary(buffer, mLen, mFormat);
+   wxFileOffset offset = mPack->Append(mFileName.GetName(), mFormat, buffer, mLen,
+                                       summaryData, mSummaryInfo.totalSummaryBytes);
+   if (offset >= 0) {
+      // The old record is damaged; don't hand it out again
+      mPack->DerefRecord(mOffset, false);
+      mOffset = offset;
+   }
+
+   DeleteSamples(buffer);
+}
+
+#endif // EXPERIMENTAL_PACKED_BLOCKFILES
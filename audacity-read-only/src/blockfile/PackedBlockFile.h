@@ -0,0 +1,209 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2014 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   PackedBlockFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PACKED_BLOCKFILE__
+#define __AUDACITY_PACKED_BLOCKFILE__
+
+#include "../Experimental.h"
+
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+
+#include <map>
+#include <vector>
+
+#include <wx/string.h>
+#include <wx/filename.h>
+#include <wx/file.h>
+
+#include "../BlockFile.h"
+#include "../DirManager.h"
+#include "../xml/XMLWriter.h"
+#include "../ondemand/ODTaskThread.h"
+
+/// Name of the pack file inside the project data directory
+#define BLOCKPACK_FILENAME wxT("blocks.aupk")
+
+/// Unit of mapping: 64 MB, up to 256 GB per pack
+#define BLOCKPACK_SEGMENT_SIZE (64 * 1024 * 1024)
+#define BLOCKPACK_MAX_SEGMENTS 4096
+
+/// One append-only file holding the summary and sample data of many
+/// PackedBlockFiles, read back through mmap.
+///
+/// The file starts with a small header, followed by records of
+/// (record header, summary, samples).  Records never move and never
+/// cross a segment boundary, so each segment is mapped once when first
+/// touched and stays mapped until the pack is destroyed; readers on
+/// other threads never see a mapping go away.  The offset of each
+/// record is kept by its PackedBlockFile and saved in the project
+/// file, which is what indexes the pack.
+///
+/// A record is not changed while any block refers to it, so copies of
+/// a block within one project share its record.  Once no block refers
+/// to a record, and the saved project doesn't either, its space goes
+/// on a free list that later appends are written into.
+class BlockPack {
+ public:
+
+   /// Open the pack at fullPath, creating it if it doesn't exist
+   BlockPack(wxString fullPath);
+
+   bool IsOk() { return mFile.IsOpened(); }
+   wxString GetFullPath() { return mFullPath; }
+   wxFileOffset GetLength();
+
+   void Ref();
+   void Deref();
+
+   /// Write one record, into free space if there is some that fits, or
+   /// else at the end; returns its offset or -1 on failure.  The record
+   /// starts with one reference, the caller's.  name is stored with the
+   /// record only to help recovering a damaged project.
+   wxFileOffset Append(wxString name, sampleFormat format,
+                       samplePtr sampleData, sampleCount sampleLen,
+                       void *summaryData, int summaryBytes);
+
+   /// Address of the record at offset, or NULL if there is no valid
+   /// record there.  The record stays mapped for the lifetime of the
+   /// pack.
+   const char *MapRecord(wxFileOffset offset,
+                         sampleFormat *format, sampleCount *sampleLen,
+                         int *summaryBytes);
+
+   /// Count one more block referring to the record at offset
+   void RefRecord(wxFileOffset offset);
+   /// Count one block less referring to the record at offset.  When
+   /// none is left and reclaim is true, its space is freed for reuse;
+   /// reclaim is false for blocks of the saved project.
+   void DerefRecord(wxFileOffset offset, bool reclaim);
+   /// How many blocks refer to the record at offset
+   int GetRecordRefs(wxFileOffset offset);
+
+   /// Rename (or copy, for a Save As that must leave the old project
+   /// intact) the pack file to newFullPath and continue there.  If the
+   /// new file can't be opened the pack stays where it was.
+   bool MoveTo(wxString newFullPath, bool copy);
+
+   /// Undo MoveTo(): rename the pack back to oldFullPath, or if it was
+   /// copied, continue with the original there and delete the copy.
+   bool MoveBack(wxString oldFullPath, bool copied);
+
+   /// True if sample data was written on a machine of the other
+   /// byte order
+   bool IsSwapped();
+
+   static wxFileOffset RecordSize(sampleCount sampleLen,
+                                  sampleFormat format, int summaryBytes);
+
+ private:
+   ~BlockPack();
+
+   bool Open(wxString fullPath);
+   bool Reopen(wxString fullPath);
+   void Close();
+   const char *MapSegment(int segment);
+   const char *FindRecord(wxFileOffset offset,
+                          sampleFormat *format, sampleCount *sampleLen,
+                          int *summaryBytes);
+   wxFileOffset Allocate(wxFileOffset size);
+   void Free(wxFileOffset offset, wxFileOffset size);
+   bool WriteGap(wxFileOffset offset, wxFileOffset size);
+   void FreeUnreferenced();
+
+   ODLock mLock;
+   int mRefCount;
+
+   wxString mFullPath;
+   wxFile mFile;
+   wxFileOffset mLength;
+   bool mSwapped;
+
+   // Indexed by segment, mapped on first use; guarded by mLock, as are
+   // mLength and mSwapped
+   char *mSegments[BLOCKPACK_MAX_SEGMENTS];
+   // Mappings of the file before it was moved, kept for readers that
+   // already hold pointers into them
+   std::vector<char *> mRetired;
+
+   // Blocks referring to each record, by offset, and the free space,
+   // as sizes by offset; guarded by mLock.  Records left unreferenced
+   // by earlier sessions are only known after the first append has
+   // walked the pack (mWalked).
+   std::map<wxFileOffset, int> mRecordRefs;
+   std::map<wxFileOffset, wxFileOffset> mFree;
+   bool mWalked;
+};
+
+/// A BlockFile whose summary and samples are one record of the
+/// project's BlockPack.
+///
+/// Its file name is not a file on disk: the name identifies the block
+/// in DirManager's hash and in the project file, the path is the data
+/// directory.  Reads are a copy (and format conversion) out of the
+/// mapped pack, with no open or seek per block.
+class PackedBlockFile : public BlockFile {
+ public:
+
+   // Constructor / Destructor
+
+   /// Append summary and sample data to the pack
+   PackedBlockFile(wxFileName baseFileName, BlockPack *pack,
+                   samplePtr sampleData, sampleCount sampleLen,
+                   sampleFormat format);
+   /// Refer to a record already in the pack
+   PackedBlockFile(wxFileName existingFile, BlockPack *pack,
+                   wxFileOffset offset, sampleCount len, sampleFormat format,
+                   float min, float max, float rms);
+
+   virtual ~PackedBlockFile();
+
+   // Reading
+
+   /// Read the summary section of the record
+   virtual bool ReadSummary(void *data);
+   /// Read the data section of the record
+   virtual int ReadDataUncached(samplePtr data, sampleFormat format,
+                                sampleCount start, sampleCount len);
+
+   /// Create a new block file identical to this one, sharing the record
+   virtual BlockFile *Copy(wxFileName newFileName);
+   /// Create a new block file with its own copy of the record in pack
+   BlockFile *CopyTo(wxFileName newFileName, BlockPack *pack);
+   /// Write an XML representation of this file
+   virtual void SaveXML(XMLWriter &xmlFile);
+
+   virtual wxLongLong GetSpaceUsage();
+   virtual void Recover();
+
+   virtual bool IsPacked() { return true; }
+
+   BlockPack *GetPack() { return mPack; }
+   /// True if the pack holds the record this block refers to
+   bool IsRecordAvailable();
+
+   static BlockFile *BuildFromXML(DirManager &dm, const wxChar **attrs);
+
+ protected:
+   // Reading from the mapped pack is already a copy
+   virtual bool UseBlockCache() { return false; }
+   /// Fault the record's pages in before they are copied from
+   virtual void AdviseWillNeed();
+
+ private:
+   const char *GetRecord(int *summaryBytes);
+
+   BlockPack *mPack;
+   wxFileOffset mOffset;
+   sampleFormat mFormat;
+};
+
+#endif // EXPERIMENTAL_PACKED_BLOCKFILES
+
+#endif
@@ -29,8 +29,8 @@ bool SilentBlockFile::ReadSummary(void *data)
    return true;
 }
 
-int SilentBlockFile::ReadData(samplePtr data, sampleFormat format,
-                              sampleCount WXUNUSED(start), sampleCount len)
+int SilentBlockFile::ReadDataUncached(samplePtr data, sampleFormat format,
+                                      sampleCount WXUNUSED(start), sampleCount len)
 {
    ClearSamples(data, format, 0, len);
 
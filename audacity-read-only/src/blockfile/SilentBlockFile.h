@@ -35,8 +35,8 @@ class SilentBlockFile : public BlockFile {
    /// Read the summary section of the disk file
    virtual bool ReadSummary(void *data);
    /// Read the data section of the disk file
-   virtual int ReadData(samplePtr data, sampleFormat format,
-                        sampleCount start, sampleCount len);
+   virtual int ReadDataUncached(samplePtr data, sampleFormat format,
+                                sampleCount start, sampleCount len);
 
    /// Create a new block file identical to this one
    virtual BlockFile *Copy(wxFileName newFileName);
@@ -46,6 +46,9 @@ class SilentBlockFile : public BlockFile {
    virtual void Recover() { };
 
    static BlockFile *BuildFromXML(DirManager &dm, const wxChar **attrs);
+
+ protected:
+   virtual bool UseBlockCache() { return false; }
 };
 
 #endif
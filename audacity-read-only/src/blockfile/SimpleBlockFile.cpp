@@ -63,6 +63,11 @@ to get its definition, rather than rolling our own.
 #include <wx/utils.h>
 #include <wx/log.h>
 
+#ifndef __WXMSW__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "../Prefs.h"
 
 #include "SimpleBlockFile.h"
@@ -304,7 +309,7 @@ void SimpleBlockFile::FillCache()
 
    // Read samples into cache
    mCache.sampleData = new char[mLen * SAMPLE_SIZE(mCache.format)];
-   if (ReadData(mCache.sampleData, mCache.format, 0, mLen) != mLen)
+   if (ReadDataUncached(mCache.sampleData, mCache.format, 0, mLen) != mLen)
    {
       // Could not read all samples
       delete mCache.sampleData;
@@ -323,6 +328,22 @@ void SimpleBlockFile::FillCache()
    //wxLogDebug("SimpleBlockFile::FillCache(): Succesfully read simple block file into cache.");
 }
 
+/// Hint that the disk file is about to be read, for the BlockPrefetcher.
+void SimpleBlockFile::AdviseWillNeed()
+{
+#ifdef POSIX_FADV_WILLNEED
+   if (mCache.active)
+      return;
+
+   // Starts the kernel's read-ahead of the whole file without waiting
+   int fd = open(mFileName.GetFullPath().fn_str(), O_RDONLY);
+   if (fd < 0)
+      return;
+   posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+   close(fd);
+#endif
+}
+
 /// Read the summary section of the disk file.
 ///
 /// @param *data The buffer to write the data to.  It must be at least
@@ -376,8 +397,8 @@ bool SimpleBlockFile::ReadSummary(void *data)
 /// @param format The format the data will be stored in
 /// @param start  The offset in this block file
 /// @param len    The number of samples to read
-int SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
-                        sampleCount start, sampleCount len)
+int SimpleBlockFile::ReadDataUncached(samplePtr data, sampleFormat format,
+                                      sampleCount start, sampleCount len)
 {
    if (mCache.active)
    {
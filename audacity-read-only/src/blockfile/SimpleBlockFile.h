@@ -64,8 +64,8 @@ class SimpleBlockFile : public BlockFile {
    /// Read the summary section of the disk file
    virtual bool ReadSummary(void *data);
    /// Read the data section of the disk file
-   virtual int ReadData(samplePtr data, sampleFormat format,
-                        sampleCount start, sampleCount len);
+   virtual int ReadDataUncached(samplePtr data, sampleFormat format,
+                                sampleCount start, sampleCount len);
 
    /// Create a new block file identical to this one
    virtual BlockFile *Copy(wxFileName newFileName);
@@ -90,6 +90,10 @@ class SimpleBlockFile : public BlockFile {
    static bool GetCache();
    void ReadIntoCache();
 
+   // Blocks held in mCache never go to disk
+   virtual bool UseBlockCache() { return !mCache.active; }
+   virtual void AdviseWillNeed();
+
    SimpleBlockFileCache mCache;
 };
 
@@ -120,12 +120,23 @@ bool EffectClickRemoval::TransferParameters( Shuttle & shuttle )
    return true;
 }
 
+// The sep that RemoveClicks() leaves behind: it rounds sep up to a
+// power of two, so a sep of 2049 serves the first window only
+static int RoundedSep(int sep)
+{
+   int i;
+   for(i=1; i < sep; i *= 2)
+      ;
+   return i;
+}
+
 bool EffectClickRemoval::Process()
 {
    this->CopyInputTracks(); // Set up mOutputTracks.
    bool bGoodResult = true;
    mbDidSomething = false;
 
+   mJobs.clear();
    SelectedTrackListOfKindIterator iter(Track::Wave, mOutputTracks);
    WaveTrack *track = (WaveTrack *) iter.First();
    int count = 0;
@@ -140,16 +151,43 @@ bool EffectClickRemoval::Process()
          sampleCount end = track->TimeToLongSamples(t1);
          sampleCount len = (sampleCount)(end - start);
 
-         if (!ProcessOne(count, track, start, len))
+         // Checked here rather than by the items, which can't show a
+         // message
+         if (len <= windowSize/2)
          {
+            wxMessageBox(
+               wxString::Format(_("Selection must be larger than %d samples."), windowSize/2),
+               this->GetEffectName(),
+               wxOK | wxICON_ERROR);
             bGoodResult = false;
             break;
          }
+
+         Job job;
+         job.track = track;
+         job.count = count;
+         job.start = start;
+         job.len = len;
+         // As when the tracks were done one after another, only the very
+         // first window starts from sep as it was
+         job.sep = mJobs.empty() ? sep : RoundedSep(sep);
+         job.didSomething = false;
+         mJobs.push_back(job);
       }
 
       track = (WaveTrack *) iter.Next();
       count++;
    }
+
+   if (bGoodResult)
+      bGoodResult = ProcessItems((int)mJobs.size());
+   if (!mJobs.empty())
+      sep = RoundedSep(sep);
+
+   for (size_t i = 0; i < mJobs.size(); i++)
+      mbDidSomething |= mJobs[i].didSomething;
+   mJobs.clear();
+
    if (bGoodResult && !mbDidSomething) // Processing successful, but ineffective.
       wxMessageBox(
          wxString::Format(_("Algorithm not effective on this audio. Nothing changed.")),
@@ -160,21 +198,117 @@ bool EffectClickRemoval::Process()
    return bGoodResult && mbDidSomething;
 }
 
-bool EffectClickRemoval::ProcessOne(int count, WaveTrack * track, sampleCount start, sampleCount len)
+bool EffectClickRemoval::ProcessItem(int index)
+{
+   Job &job = mJobs[index];
+   return ProcessOne(job.count, job.track, job.start, job.len, job.sep,
+                     &job.didSomething);
+}
+
+// Blocks of a track in ProcessOne() are independent: no window spans
+// two of them, and each reads only its own samples.  So segments of whole
+// blocks need no warm-up, and come out as they would one at a time.
+class EffectClickRemoval::Segments : public EffectSegmentWork
 {
-   if (len <= windowSize/2)
+public:
+   Segments(EffectClickRemoval *effect, int count, WaveTrack *track,
+            sampleCount start, sampleCount len,
+            sampleCount blockLen, int sep, bool *didSomething)
+      : mEffect(effect), mCount(count), mTrack(track)
+      , mStart(start), mLen(len), mBlockLen(blockLen)
+      , mSep(sep), mDidSomething(didSomething)
+      , mFirstChanged((len + blockLen - 1) / blockLen)
+      , mProcessedEnd((len + blockLen - 1) / blockLen)
    {
-      wxMessageBox(
-         wxString::Format(_("Selection must be larger than %d samples."), windowSize/2),
-         this->GetEffectName(),
-         wxOK | wxICON_ERROR);
-      return false;
    }
 
+   virtual bool ProcessSegment(sampleCount WXUNUSED(readStart),
+                               sampleCount start, sampleCount len, float *out)
+   {
+      const int windowSize = mEffect->windowSize;
+      int index = (start - mStart) / mBlockLen;
+      float *datawindow = new float[windowSize];
+      // Only the first block starts from the job's sep
+      int sep = index == 0 ? mSep : RoundedSep(mSep);
+
+      // As ProcessOne() does, but for one block
+      sampleCount s = start - mStart;
+      sampleCount firstChanged = -1;
+      if ((s < mLen)  &&  ((mLen - s) > windowSize/2))
+      {
+         sampleCount block = len;
+
+         mTrack->Get((samplePtr) out, floatSample, mStart + s, block);
+
+         if (mEffect->ProcessBlock(out, block, datawindow, sep))
+            firstChanged = s;
+
+         s += block;
+      }
+
+      mFirstChanged[index] = firstChanged;
+      mProcessedEnd[index] = s;
+
+      delete[] datawindow;
+      return true;
+   }
+
+   virtual bool WriteSegment(sampleCount start, sampleCount len, float *out)
+   {
+      int index = (start - mStart) / mBlockLen;
+      sampleCount s = start - mStart;
+      sampleCount end = mProcessedEnd[index];
+
+      // From the first block that RemoveClicks() did something in, the
+      // blocks are written back, as ProcessOne() does
+      sampleCount from = end;
+      if (*mDidSomething)
+         from = s;
+      else if (mFirstChanged[index] >= 0) {
+         from = mFirstChanged[index];
+         *mDidSomething = true;
+      }
+      if (from < end)
+         mTrack->Set((samplePtr) (out + (from - s)), floatSample,
+                     mStart + from, end - from);
+
+      return !mEffect->TrackProgress(mCount, (s + len) / (double) mLen);
+   }
+
+   virtual bool Progress(double frac)
+   {
+      return mEffect->TrackProgress(mCount, frac);
+   }
+
+private:
+   EffectClickRemoval *mEffect;
+   int mCount;
+   WaveTrack *mTrack;
+   sampleCount mStart;
+   sampleCount mLen;
+   sampleCount mBlockLen;
+   int mSep;
+   bool *mDidSomething;
+
+   // For each segment, relative to mStart
+   std::vector<sampleCount> mFirstChanged;
+   std::vector<sampleCount> mProcessedEnd;
+};
+
+bool EffectClickRemoval::ProcessOne(int count, WaveTrack * track,
+                                    sampleCount start, sampleCount len,
+                                    int sep, bool *didSomething)
+{
    sampleCount idealBlockLen = track->GetMaxBlockSize() * 4;
    if (idealBlockLen % windowSize != 0)
       idealBlockLen += (windowSize - (idealBlockLen % windowSize));
 
+   if (CanProcessSegments(len, idealBlockLen)) {
+      Segments segments(this, count, track, start, len,
+                        idealBlockLen, sep, didSomething);
+      return ProcessSegments(segments, start, len, idealBlockLen, 0);
+   }
+
    bool bResult = true;
    sampleCount s = 0;
    float *buffer = new float[idealBlockLen];
@@ -187,25 +321,9 @@ bool EffectClickRemoval::ProcessOne(int count, WaveTrack * track, sampleCount st
 
       track->Get((samplePtr) buffer, floatSample, start + s, block);
 
-      for (int i=0; i < (block-windowSize/2); i += windowSize/2)
-      {
-         int wcopy = windowSize;
-         if (i + wcopy > block)
-            wcopy = block - i;
-
-         int j;
-         for(j=0; j<wcopy; j++)
-            datawindow[j] = buffer[i+j];
-         for(j=wcopy; j<windowSize; j++)
-            datawindow[j] = 0;
-
-         mbDidSomething |= RemoveClicks(windowSize, datawindow);
+      *didSomething |= ProcessBlock(buffer, block, datawindow, sep);
 
-         for(j=0; j<wcopy; j++)
-           buffer[i+j] = datawindow[j];
-      }
-
-      if (mbDidSomething) // RemoveClicks() actually did something.
+      if (*didSomething) // RemoveClicks() actually did something.
          track->Set((samplePtr) buffer, floatSample, start + s, block);
 
       s += block;
@@ -222,7 +340,34 @@ bool EffectClickRemoval::ProcessOne(int count, WaveTrack * track, sampleCount st
    return bResult;
 }
 
-bool EffectClickRemoval::RemoveClicks(sampleCount len, float *buffer)
+bool EffectClickRemoval::ProcessBlock(float *buffer, sampleCount block,
+                                      float *datawindow, int &sep)
+{
+   bool bResult = false;
+
+   for (int i=0; i < (block-windowSize/2); i += windowSize/2)
+   {
+      int wcopy = windowSize;
+      if (i + wcopy > block)
+         wcopy = block - i;
+
+      int j;
+      for(j=0; j<wcopy; j++)
+         datawindow[j] = buffer[i+j];
+      for(j=wcopy; j<windowSize; j++)
+         datawindow[j] = 0;
+
+      bResult |= RemoveClicks(windowSize, datawindow, sep);
+
+      for(j=0; j<wcopy; j++)
+        buffer[i+j] = datawindow[j];
+   }
+
+   return bResult;
+}
+
+bool EffectClickRemoval::RemoveClicks(sampleCount len, float *buffer,
+                                      int &sep)
 {
    bool bResult = false; // This effect usually does nothing.
    int i;
@@ -16,6 +16,8 @@
 #ifndef __AUDACITY_EFFECT_CLICK_REMOVAL__
 #define __AUDACITY_EFFECT_CLICK_REMOVAL__
 
+#include <vector>
+
 #include <wx/bitmap.h>
 #include <wx/button.h>
 #include <wx/panel.h>
@@ -65,13 +67,41 @@ public:
 
    virtual bool Process();
 
+protected:
+   // Each track is an item
+   virtual bool IsThreadSafe() { return true; }
+   virtual bool ProcessItem(int index);
+
 private:
+   // A track to remove clicks from
+   struct Job {
+      WaveTrack *track;
+      int count;
+      sampleCount start;
+      sampleCount len;
+      // The sep its first window starts from
+      int sep;
+      bool didSomething;
+   };
+
+   // Blocks of a long track, several at a time
+   class Segments;
+   friend class Segments;
+
    bool ProcessOne(int count, WaveTrack * track,
-                   sampleCount start, sampleCount len);
+                   sampleCount start, sampleCount len, int sep,
+                   bool *didSomething);
+   // Remove the clicks from block samples of buffer, a window at a time;
+   // returns whether there were any.  sep is updated as RemoveClicks()
+   // updates it.
+   bool ProcessBlock(float *buffer, sampleCount block, float *datawindow,
+                     int &sep);
 
-   bool RemoveClicks(sampleCount len, float *buffer);
+   // sep is rounded up to a power of two on the way
+   bool RemoveClicks(sampleCount len, float *buffer, int &sep);
 
    Envelope *mEnvelope;
+   std::vector<Job> mJobs;
 
    bool mbDidSomething; // This effect usually does nothing on real-world data.
    int       windowSize;
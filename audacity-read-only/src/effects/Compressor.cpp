@@ -11,8 +11,10 @@
 *******************************************************************//**
 
 \class EffectCompressor
-\brief An Effect derived from EffectTwoPassSimpleMono
+\brief An Effect that compresses each track through a CompressorEngine,
+and then optionally normalizes.
 
+ - The envelope follower became the streaming CompressorEngine.
  - Martyn Shaw made it inherit from EffectTwoPassSimpleMono 10/2005.
  - Steve Jolly made it inherit from EffectSimpleMono.
  - GUI added and implementation improved by Dominic Mazzoni, 5/11/2003.
@@ -52,18 +54,14 @@ EffectCompressor::EffectCompressor()
 {
    mNormalize = true;
    mUsePeak = false;
-   mThreshold = 0.25;
+   mLookAhead = true;
    mAttackTime = 0.2;      // seconds
    mDecayTime = 1.0;       // seconds
    mRatio = 2.0;           // positive number > 1.0
-   mCompression = 0.5;
    mThresholdDB = -12.0;
    mNoiseFloorDB = -40.0;
-   mNoiseFloor = 0.01;
-   mCircle = NULL;
-   mFollow1 = NULL;
-   mFollow2 = NULL;
-   mFollowLen = 0;
+   mCurTrackNum = 0;
+   mMax = 0.0;
 }
 
 bool EffectCompressor::Init()
@@ -76,24 +74,13 @@ bool EffectCompressor::Init()
    gPrefs->Read(wxT("/Effects/Compressor/DecayTime"), &mDecayTime, 1.0f );
    gPrefs->Read(wxT("/Effects/Compressor/Normalize"), &mNormalize, true );
    gPrefs->Read(wxT("/Effects/Compressor/UsePeak"), &mUsePeak, false );
+   gPrefs->Read(wxT("/Effects/Compressor/LookAhead"), &mLookAhead, true );
 
    return true;
 }
 
 EffectCompressor::~EffectCompressor()
 {
-   if (mCircle) {
-      delete[] mCircle;
-      mCircle = NULL;
-   }
-   if(mFollow1!=NULL) {
-      delete[] mFollow1;
-      mFollow1 = NULL;
-   }
-   if(mFollow2!=NULL) {
-      delete[] mFollow2;
-      mFollow2 = NULL;
-   }
 }
 
 bool EffectCompressor::TransferParameters( Shuttle & shuttle )
@@ -105,6 +92,7 @@ bool EffectCompressor::TransferParameters( Shuttle & shuttle )
    shuttle.TransferDouble( wxT("ReleaseTime"), mDecayTime, 1.0f );
    shuttle.TransferBool( wxT("Normalize"), mNormalize, true );
    shuttle.TransferBool( wxT("UsePeak"), mUsePeak, false );
+   shuttle.TransferBool( wxT("LookAhead"), mLookAhead, true );
    return true;
 }
 
@@ -118,6 +106,7 @@ bool EffectCompressor::PromptUser()
    dlog.decay = mDecayTime;
    dlog.useGain = mNormalize;
    dlog.usePeak = mUsePeak;
+   dlog.lookAhead = mLookAhead;
    dlog.TransferDataToWindow();
 
    dlog.CentreOnParent();
@@ -133,6 +122,7 @@ bool EffectCompressor::PromptUser()
    mDecayTime = dlog.decay;
    mNormalize = dlog.useGain;
    mUsePeak = dlog.usePeak;
+   mLookAhead = dlog.lookAhead;
 
    // Retain the settings
    gPrefs->Write(wxT("/Effects/Compressor/ThresholdDB"), mThresholdDB);
@@ -142,294 +132,149 @@ bool EffectCompressor::PromptUser()
    gPrefs->Write(wxT("/Effects/Compressor/DecayTime"), mDecayTime);
    gPrefs->Write(wxT("/Effects/Compressor/Normalize"), mNormalize);
    gPrefs->Write(wxT("/Effects/Compressor/UsePeak"), mUsePeak);
+   gPrefs->Write(wxT("/Effects/Compressor/LookAhead"), mLookAhead);
 
    return gPrefs->Flush();
 }
 
-bool EffectCompressor::NewTrackPass1()
+bool EffectCompressor::Process()
 {
-   mThreshold = pow(10.0, mThresholdDB/20); // factor of 20 because it's power
-   mNoiseFloor = pow(10.0, mNoiseFloorDB/20);
-   mNoiseCounter = 100;
-
-   mAttackInverseFactor = exp(log(mThreshold) / (mCurRate * mAttackTime + 0.5));
-   mAttackFactor = 1.0 / mAttackInverseFactor;
-   mDecayFactor = exp(log(mThreshold) / (mCurRate * mDecayTime + 0.5));
-
-   if(mRatio > 1)
-      mCompression = 1.0-1.0/mRatio;
-   else
-      mCompression = 0.0;
-
-   mLastLevel = mThreshold;
-
-   if (mCircle)
-      delete[] mCircle;
-   mCircleSize = 100;
-   mCircle = new double[mCircleSize];
-   for(int j=0; j<mCircleSize; j++) {
-      mCircle[j] = 0.0;
-   }
-   mCirclePos = 0;
-   mRMSSum = 0.0;
+   this->CopyInputTracks(); // Set up mOutputTracks.
 
-   return true;
+   // The make-up gain brings the loudest sample of all the tracks to 0 dB
+   mMax = 0.0;
+   bool bGoodResult = ProcessPass(0);
+   if (bGoodResult && mNormalize)
+      bGoodResult = ProcessPass(1);
+
+   this->ReplaceProcessedTracks(bGoodResult);
+   return bGoodResult;
 }
-bool EffectCompressor::InitPass1()
-{
-   mMax=0.0;
-   if (!mNormalize)
-      DisableSecondPass();
 
-   // Find the maximum block length required for any track
-   sampleCount maxlen=0;
-   SelectedTrackListOfKindIterator iter(Track::Wave, mTracks);
+bool EffectCompressor::ProcessPass(int pass)
+{
+   //Iterate over each track
+   SelectedTrackListOfKindIterator iter(Track::Wave, mOutputTracks);
    WaveTrack *track = (WaveTrack *) iter.First();
+   mCurTrackNum = 0;
    while (track) {
-      sampleCount len=track->GetMaxBlockSize();
-      if(len > maxlen)
-         maxlen = len;
+      //Get start and end times from track
+      double trackStart = track->GetStartTime();
+      double trackEnd = track->GetEndTime();
+
+      //Set the current bounds to whichever left marker is
+      //greater and whichever right marker is less:
+      double t0 = mT0 < trackStart? trackStart: mT0;
+      double t1 = mT1 > trackEnd? trackEnd: mT1;
+
+      // Process only if the right marker is to the right of the left marker
+      if (t1 > t0) {
+         sampleCount start = track->TimeToLongSamples(t0);
+         sampleCount end = track->TimeToLongSamples(t1);
+
+         bool ret;
+         if (pass == 0)
+            ret = CompressOne(track, start, end);
+         else
+            ret = NormalizeOne(track, start, end);
+         if (!ret)
+            return false;
+      }
+
       //Iterate to the next track
       track = (WaveTrack *) iter.Next();
+      mCurTrackNum++;
    }
-   if(mFollow1!=NULL) {
-      delete[] mFollow1;
-      mFollow1 = NULL;
-   }
-   if(mFollow2!=NULL) {
-      delete[] mFollow2;
-      mFollow2 = NULL;
-   }
-   // Allocate buffers for the envelope
-   if(maxlen > 0) {
-      mFollow1 = new float[maxlen];
-      mFollow2 = new float[maxlen];
-   }
-   mFollowLen = maxlen;
 
    return true;
 }
-bool EffectCompressor::InitPass2()
-{
-    // Actually, this should not even be called, because we call
-    // DisableSecondPass() before, if mNormalize is false.
-    return mNormalize;
-}
 
-// Process the input with 2 buffers available at a time
-// buffer1 will be written upon return
-// buffer2 will be passed as buffer1 on the next call
-bool EffectCompressor::TwoBufferProcessPass1(float *buffer1, sampleCount len1, float *buffer2, sampleCount len2)
+class EffectCompressor::Compression : public EffectLatentWork
 {
-   int i;
+public:
+   Compression(EffectCompressor *effect) : mEffect(effect) {}
 
-   // If buffers are bigger than allocated, then abort
-   // (this should never happen, but if it does, we don't want to crash)
-   if((len1 > mFollowLen) || (len2 > mFollowLen))
-      return false;
-
-   // This makes sure that the initial value is well-chosen
-   // buffer1 == NULL on the first and only the first call
-   if (buffer1 == NULL) {
-      // Initialize the mLastLevel to the peak level in the first buffer
-      // This avoids problems with large spike events near the beginning of the track
-      mLastLevel = mThreshold;
-      for(i=0; i<len2; i++) {
-         if(mLastLevel < fabs(buffer2[i]))
-            mLastLevel = fabs(buffer2[i]);
+   virtual void ProcessBlock(float *buffer, sampleCount len, bool first)
+   {
+      if (first) {
+         // Start the envelope at the peak level in the first buffer
+         // This avoids problems with large spike events near the beginning of the track
+         float peak = 0.0f;
+         for (sampleCount i = 0; i < len; i++)
+            if (peak < fabs(buffer[i]))
+               peak = fabs(buffer[i]);
+         mEffect->mEngine.Reset(peak);
       }
+      mEffect->mEngine.Process(buffer, buffer, len);
    }
 
-   // buffer2 is NULL on the last and only the last call
-   if(buffer2 != NULL) {
-      Follow(buffer2, mFollow2, len2, mFollow1, len1);
+   virtual bool Progress(double frac)
+   {
+      return mEffect->UpdateProgress(0, frac);
    }
 
-   if(buffer1 != NULL) {
-      for (i = 0; i < len1; i++) {
-         buffer1[i] = DoCompression(buffer1[i], mFollow1[i]);
-      }
-   }
+private:
+   EffectCompressor *mEffect;
+};
 
+bool EffectCompressor::CompressOne(WaveTrack *track,
+                                   sampleCount start, sampleCount end)
+{
+   mEngine.Init(track->GetRate(), mThresholdDB, mNoiseFloorDB, mRatio,
+                mAttackTime, mDecayTime, mUsePeak, mLookAhead);
 
-#if 0
-   // Copy the envelope over the track data (for debug purposes)
-   memcpy(buffer1, mFollow1, len1*sizeof(float));
-#endif
+   Compression compression(this);
+   bool bGoodResult = ProcessLatent(compression, track, start, end,
+                                    mEngine.GetLatency());
 
-   // Rotate the buffer pointers
-   float *tmpfloat = mFollow1;
-   mFollow1 = mFollow2;
-   mFollow2 = tmpfloat;
+   // What went out before start was silence, so this is the loudest
+   // sample written
+   if (mMax < mEngine.GetPeak())
+      mMax = mEngine.GetPeak();
 
-   return true;
+   return bGoodResult;
 }
 
-bool EffectCompressor::ProcessPass2(float *buffer, sampleCount len)
+bool EffectCompressor::NormalizeOne(WaveTrack *track,
+                                    sampleCount start, sampleCount end)
 {
-   if (mMax != 0)
-   {
-      for (int i = 0; i < len; i++)
-         buffer[i] /= mMax;
-   }
-
-   return true;
-}
+   if (mMax == 0)
+      return true;
 
-void EffectCompressor::FreshenCircle()
-{
-   // Recompute the RMS sum periodically to prevent accumulation of rounding errors
-   // during long waveforms
-   mRMSSum = 0;
-   for(int i=0; i<mCircleSize; i++)
-      mRMSSum += mCircle[i];
-}
+   sampleCount maxblock = track->GetMaxBlockSize();
+   float *buffer = new float[maxblock];
 
-float EffectCompressor::AvgCircle(float value)
-{
-   float level;
+   double len = (double)(end - start);
+   bool bGoodResult = true;
 
-   // Calculate current level from root-mean-squared of
-   // circular buffer ("RMS")
-   mRMSSum -= mCircle[mCirclePos];
-   mCircle[mCirclePos] = value*value;
-   mRMSSum += mCircle[mCirclePos];
-   level = sqrt(mRMSSum/mCircleSize);
-   mCirclePos = (mCirclePos+1)%mCircleSize;
+   for (sampleCount s = start; s < end; ) {
+      sampleCount block = track->GetBestBlockSize(s);
+      if (block > maxblock)
+         block = maxblock;
+      if (s + block > end)
+         block = end - s;
 
-   return level;
-}
+      track->Get((samplePtr) buffer, floatSample, s, block);
+      for (sampleCount i = 0; i < block; i++)
+         buffer[i] /= mMax;
+      track->Set((samplePtr) buffer, floatSample, s, block);
+      s += block;
 
-void EffectCompressor::Follow(float *buffer, float *env, int len, float *previous, int previous_len)
-{
-   /*
-
-   "Follow"ing algorithm by Roger B. Dannenberg, taken from
-   Nyquist.  His description follows.  -DMM
-
-   Description: this is a sophisticated envelope follower.
-    The input is an envelope, e.g. something produced with
-    the AVG function. The purpose of this function is to
-    generate a smooth envelope that is generally not less
-    than the input signal. In other words, we want to "ride"
-    the peaks of the signal with a smooth function. The
-    algorithm is as follows: keep a current output value
-    (called the "value"). The value is allowed to increase
-    by at most rise_factor and decrease by at most fall_factor.
-    Therefore, the next value should be between
-    value * rise_factor and value * fall_factor. If the input
-    is in this range, then the next value is simply the input.
-    If the input is less than value * fall_factor, then the
-    next value is just value * fall_factor, which will be greater
-    than the input signal. If the input is greater than value *
-    rise_factor, then we compute a rising envelope that meets
-    the input value by working bacwards in time, changing the
-    previous values to input / rise_factor, input / rise_factor^2,
-    input / rise_factor^3, etc. until this new envelope intersects
-    the previously computed values. There is only a limited buffer
-    in which we can work backwards, so if the new envelope does not
-    intersect the old one, then make yet another pass, this time
-    from the oldest buffered value forward, increasing on each
-    sample by rise_factor to produce a maximal envelope. This will
-    still be less than the input.
-
-    The value has a lower limit of floor to make sure value has a
-    reasonable positive value from which to begin an attack.
-   */
-   int i;
-   double level,last;
-
-   if(!mUsePeak) {
-      // Update RMS sum directly from the circle buffer
-      // to avoid accumulation of rounding errors
-      FreshenCircle();
-   }
-   // First apply a peak detect with the requested decay rate
-   last = mLastLevel;
-   for(i=0; i<len; i++) {
-      if(mUsePeak)
-         level = fabs(buffer[i]);
-      else // use RMS
-         level = AvgCircle(buffer[i]);
-      // Don't increase gain when signal is continuously below the noise floor
-      if(level < mNoiseFloor) {
-         mNoiseCounter++;
-      } else {
-         mNoiseCounter = 0;
-      }
-      if(mNoiseCounter < 100) {
-         last *= mDecayFactor;
-         if(last < mThreshold)
-            last = mThreshold;
-         if(level > last)
-            last = level;
+      if (UpdateProgress(1, (s - start) / len)) {
+         bGoodResult = false;
+         break;
       }
-      env[i] = last;
-   }
-   mLastLevel = last;
-
-   // Next do the same process in reverse direction to get the requested attack rate
-   last = mLastLevel;
-   for(i=len-1; i>=0; i--) {
-      last *= mAttackInverseFactor;
-      if(last < mThreshold)
-         last = mThreshold;
-      if(env[i] < last)
-         env[i] = last;
-      else
-         last = env[i];
    }
 
-   if((previous != NULL) && (previous_len > 0)) {
-      // If the previous envelope was passed, propagate the rise back until we intersect
-      for(i=previous_len-1; i>0; i--) {
-         last *= mAttackInverseFactor;
-         if(last < mThreshold)
-            last = mThreshold;
-         if(previous[i] < last)
-            previous[i] = last;
-         else // Intersected the previous envelope buffer, so we are finished
-            return;
-      }
-      // If we can't back up far enough, project the starting level forward
-      // until we intersect the desired envelope
-      last = previous[0];
-      for(i=1; i<previous_len; i++) {
-         last *= mAttackFactor;
-         if(previous[i] > last)
-            previous[i] = last;
-         else // Intersected the desired envelope, so we are finished
-            return;
-      }
-      // If we still didn't intersect, then continue ramp up into current buffer
-      for(i=0; i<len; i++) {
-         last *= mAttackFactor;
-         if(buffer[i] > last)
-            buffer[i] = last;
-         else // Finally got an intersect
-            return;
-      }
-      // If we still didn't intersect, then reset mLastLevel
-      mLastLevel = last;
-   }
+   delete[] buffer;
+   return bGoodResult;
 }
 
-float EffectCompressor::DoCompression(float value, double env)
+bool EffectCompressor::UpdateProgress(int pass, double frac)
 {
-   float out;
-   if(mUsePeak) {
-      // Peak values map 1.0 to 1.0 - 'upward' compression
-      out = value * pow(1.0/env, mCompression);
-   } else {
-      // With RMS-based compression don't change values below mThreshold - 'downward' compression
-      out = value * pow(mThreshold/env, mCompression);
-   }
-
-   // Retain the maximum value for use in the normalization pass
-   if(mMax < fabs(out))
-      mMax = fabs(out);
-
-   return out;
+   int passes = mNormalize ? 2 : 1;
+   return TotalProgress((mCurTrackNum + frac + GetNumWaveTracks() * pass) /
+                        (GetNumWaveTracks() * passes));
 }
 
 //----------------------------------------------------------------------------
@@ -677,6 +522,8 @@ void CompressorDialog::PopulateOrExchange(ShuttleGui & S)
                                     wxT("true"));
       mPeakCheckBox = S.AddCheckBox(_("Compress based on Peaks"),
                                     wxT("false"));
+      mLookAheadCheckBox = S.AddCheckBox(_("Look ahead by the attack time"),
+                                         wxT("true"));
    }
    S.EndHorizontalLay();
 }
@@ -694,6 +541,7 @@ bool CompressorDialog::TransferDataToWindow()
    mDecaySlider->SetValue((int)rint(decay));
    mGainCheckBox->SetValue(useGain);
    mPeakCheckBox->SetValue(usePeak);
+   mLookAheadCheckBox->SetValue(lookAhead);
 
    TransferDataFromWindow();
 
@@ -709,6 +557,7 @@ bool CompressorDialog::TransferDataFromWindow()
    decay = (double)(mDecaySlider->GetValue());
    useGain = mGainCheckBox->GetValue();
    usePeak = mPeakCheckBox->GetValue();
+   lookAhead = mLookAheadCheckBox->GetValue();
 
    mPanel->threshold = threshold;
    mPanel->noisefloor = noisefloor;
@@ -768,6 +617,7 @@ void CompressorDialog::OnPreview(wxCommandEvent & WXUNUSED(event))
    double    oldRatio = mEffect->mRatio;
    bool      oldUseGain = mEffect->mNormalize;
    bool      oldUsePeak = mEffect->mUsePeak;
+   bool      oldLookAhead = mEffect->mLookAhead;
 
    mEffect->mAttackTime = attack;
    mEffect->mDecayTime = decay;
@@ -776,6 +626,7 @@ void CompressorDialog::OnPreview(wxCommandEvent & WXUNUSED(event))
    mEffect->mRatio = ratio;
    mEffect->mNormalize = useGain;
    mEffect->mUsePeak = usePeak;
+   mEffect->mLookAhead = lookAhead;
 
    mEffect->Preview();
 
@@ -786,6 +637,7 @@ void CompressorDialog::OnPreview(wxCommandEvent & WXUNUSED(event))
    mEffect->mRatio = oldRatio;
    mEffect->mNormalize = oldUseGain;
    mEffect->mUsePeak = oldUsePeak;
+   mEffect->mLookAhead = oldLookAhead;
 }
 
 void CompressorDialog::OnSlider(wxCommandEvent & WXUNUSED(event))
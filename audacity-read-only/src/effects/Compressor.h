@@ -24,11 +24,12 @@ class wxString;
 #include <wx/sizer.h>
 #include <wx/stattext.h>
 #include <wx/intl.h>
-#include "TwoPassSimpleMono.h"
+#include "Effect.h"
+#include "CompressorEngine.h"
 
 class WaveTrack;
 
-class EffectCompressor: public EffectTwoPassSimpleMono {
+class EffectCompressor: public Effect {
 
 public:
 
@@ -58,24 +59,22 @@ public:
    virtual bool TransferParameters( Shuttle & shuttle );
 
  protected:
-   virtual bool TwoBufferProcessPass1(float *buffer1, sampleCount len1, float *buffer2, sampleCount len2);
-   virtual bool ProcessPass2(float *buffer, sampleCount len);
+   virtual bool Process();
 
  private:
+   // CompressOne()'s stream through the engine
+   class Compression;
+   friend class Compression;
 
-   virtual bool NewTrackPass1();
-   virtual bool InitPass1();
-   virtual bool InitPass2();
+   bool ProcessPass(int pass);
+   // Compress a track in one pass through the engine
+   bool CompressOne(WaveTrack *track, sampleCount start, sampleCount end);
+   // Apply the make-up gain
+   bool NormalizeOne(WaveTrack *track, sampleCount start, sampleCount end);
+   bool UpdateProgress(int pass, double frac);
 
-   void FreshenCircle();
-   float AvgCircle(float x);
-   double    mRMSSum;
-   int       mCircleSize;
-   int       mCirclePos;
-   double   *mCircle;
-
-   void Follow(float *buffer, float *env, int len, float *previous, int previous_len);
-   float DoCompression(float x, double env);
+   CompressorEngine mEngine;
+   int       mCurTrackNum;
 
    double    mAttackTime;
    double    mThresholdDB;
@@ -83,21 +82,9 @@ public:
    double    mRatio;
    bool      mNormalize;	//MJS
    bool      mUsePeak;
+   bool      mLookAhead;
 
    double    mDecayTime;   // The "Release" time.
-   double    mAttackFactor;
-   double    mAttackInverseFactor;
-   double    mDecayFactor;
-   double    mThreshold;
-   double    mCompression;
-   double    mNoiseFloor;
-   int       mNoiseCounter;
-   double    mGain;
-   double    mLastLevel;
-   float	*mFollow1;
-   float	*mFollow2;
-   sampleCount mFollowLen;
-
    double    mMax;			//MJS
 
    friend class CompressorDialog;
@@ -149,6 +136,7 @@ public:
    double decay;  // "release"
    bool useGain;
    bool usePeak;
+   bool lookAhead;
 
 private:
    void OnSize( wxSizeEvent &event );
@@ -180,6 +168,7 @@ private:
 
    wxCheckBox *mGainCheckBox;
    wxCheckBox *mPeakCheckBox;
+   wxCheckBox *mLookAheadCheckBox;
 
 private:
    DECLARE_EVENT_TABLE()
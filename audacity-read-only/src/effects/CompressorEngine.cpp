@@ -0,0 +1,461 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  CompressorEngine.cpp
+
+*******************************************************************//**
+
+\class CompressorEngine
+\brief Dynamic range compression of one channel, a block at a time.
+
+This is the envelope follower that EffectCompressor used to run as a
+forward pass for the decay and a backward one for the attack, over
+buffers of the whole track.  Here both are done as the samples stream
+through.  The level decays as it did, never below the threshold, and is
+held while the signal stays below the noise floor.  The envelope may rise
+by at most the attack rate.  With lookahead, the output is delayed by the
+attack time, and the envelope of each sample is the greatest of the
+levels ahead of it, less the attack rate for each sample between, so that
+it has risen when a loud passage comes through, as the backward pass
+made it.  Without, the envelope simply rises at the attack rate, and there
+is no latency.
+
+Levels and envelopes are kept as logs, so the decay and attack are sums,
+and the gain is (reference / envelope) ^ compression = e ^ (compression *
+(log reference - log envelope)).  The logs of the levels and the powers of
+e are polynomial approximations, good to about a part in 10^7, worked out
+four samples at a time with SSE2 where there is that.  The serial parts,
+which only add and compare, are done a sample at a time between them.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#include "CompressorEngine.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(__SSE2__) || defined(_M_X64) || \
+   (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+// Samples in a row below the noise floor after which the level is held
+#define NOISE_HOLD 100
+
+//
+// Polynomial log and exp, after those of the Cephes library.  The vector
+// versions do the same operations in the same order, so the results are
+// the same whichever computes a sample.
+//
+
+#define LOG_MIN_NORM 1.17549435e-38f
+#define LOG_SQRTHF 0.707106781186547524f
+#define LOG_P0 7.0376836292e-2f
+#define LOG_P1 -1.1514610310e-1f
+#define LOG_P2 1.1676998740e-1f
+#define LOG_P3 -1.2420140846e-1f
+#define LOG_P4 1.4249322787e-1f
+#define LOG_P5 -1.6668057665e-1f
+#define LOG_P6 2.0000714765e-1f
+#define LOG_P7 -2.4999993993e-1f
+#define LOG_P8 3.3333331174e-1f
+#define LOG_Q1 -2.12194440e-4f
+#define LOG_Q2 0.693359375f
+
+#define EXP_HI 88.3762626647949f
+#define EXP_LO -88.3762626647949f
+#define EXP_LOG2E 1.44269504088896341f
+#define EXP_C1 0.693359375f
+#define EXP_C2 -2.12194440e-4f
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+// Natural log of |x|; 0 is taken as the smallest normal float
+static inline float LogMagnitude(float x)
+{
+   union { float f; int i; } u;
+   u.f = fabsf(x);
+   if (!(u.f > LOG_MIN_NORM))
+      u.f = LOG_MIN_NORM;
+
+   // x = m * 2^e, with m in [0.5, 1)
+   float e = (float)((u.i >> 23) - 0x7f) + 1.0f;
+   u.i = (u.i & 0x007fffff) | 0x3f000000;
+   float m = u.f;
+
+   // Then in [sqrt(0.5) - 1, sqrt(2) - 1)
+   float t = (m < LOG_SQRTHF) ? m : 0.0f;
+   m = m - 1.0f;
+   if (t != 0.0f)
+      e = e - 1.0f;
+   m = m + t;
+
+   float z = m * m;
+   float y = LOG_P0;
+   y = y * m + LOG_P1;
+   y = y * m + LOG_P2;
+   y = y * m + LOG_P3;
+   y = y * m + LOG_P4;
+   y = y * m + LOG_P5;
+   y = y * m + LOG_P6;
+   y = y * m + LOG_P7;
+   y = y * m + LOG_P8;
+   y = y * m;
+   y = y * z;
+   y = y + e * LOG_Q1;
+   y = y - z * 0.5f;
+   m = m + y;
+   return m + e * LOG_Q2;
+}
+
+// e^x, 0 from about -88 down
+static inline float Exp(float x)
+{
+   if (x > EXP_HI)
+      x = EXP_HI;
+   if (x < EXP_LO)
+      x = EXP_LO;
+
+   // x = n log(2) + r
+   float n = floorf(x * EXP_LOG2E + 0.5f);
+   x = x - n * EXP_C1;
+   x = x - n * EXP_C2;
+
+   float z = x * x;
+   float y = EXP_P0;
+   y = y * x + EXP_P1;
+   y = y * x + EXP_P2;
+   y = y * x + EXP_P3;
+   y = y * x + EXP_P4;
+   y = y * x + EXP_P5;
+   y = y * z;
+   y = y + x;
+   y = y + 1.0f;
+
+   union { float f; int i; } u;
+   u.i = ((int)n + 0x7f) << 23;
+   return y * u.f;
+}
+
+#if defined(COMPRESSOR_SSE2)
+
+static inline __m128 LogMagnitude4(__m128 x)
+{
+   const __m128 one = _mm_set1_ps(1.0f);
+
+   x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+   // max() gives its second operand for NaNs, as the scalar test does
+   x = _mm_max_ps(x, _mm_set1_ps(LOG_MIN_NORM));
+
+   __m128i bits = _mm_castps_si128(x);
+   __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23),
+                                            _mm_set1_epi32(0x7f)));
+   e = _mm_add_ps(e, one);
+   bits = _mm_and_si128(bits, _mm_set1_epi32(0x007fffff));
+   __m128 m = _mm_castsi128_ps(_mm_or_si128(bits, _mm_set1_epi32(0x3f000000)));
+
+   __m128 mask = _mm_cmplt_ps(m, _mm_set1_ps(LOG_SQRTHF));
+   __m128 t = _mm_and_ps(m, mask);
+   m = _mm_sub_ps(m, one);
+   e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+   m = _mm_add_ps(m, t);
+
+   __m128 z = _mm_mul_ps(m, m);
+   __m128 y = _mm_set1_ps(LOG_P0);
+   y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P1));
+   y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P2));
+   y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P3));
+   y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P4));
+   y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P5));
+   y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P6));
+   y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P7));
+   y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P8));
+   y = _mm_mul_ps(y, m);
+   y = _mm_mul_ps(y, z);
+   y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(LOG_Q1)));
+   y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+   m = _mm_add_ps(m, y);
+   return _mm_add_ps(m, _mm_mul_ps(e, _mm_set1_ps(LOG_Q2)));
+}
+
+static inline __m128 Exp4(__m128 x)
+{
+   const __m128 one = _mm_set1_ps(1.0f);
+
+   x = _mm_min_ps(x, _mm_set1_ps(EXP_HI));
+   x = _mm_max_ps(x, _mm_set1_ps(EXP_LO));
+
+   // floor(), by truncating and correcting the negative ones
+   __m128 f = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(EXP_LOG2E)),
+                         _mm_set1_ps(0.5f));
+   __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(f));
+   n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, f), one));
+
+   x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(EXP_C1)));
+   x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(EXP_C2)));
+
+   __m128 z = _mm_mul_ps(x, x);
+   __m128 y = _mm_set1_ps(EXP_P0);
+   y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+   y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+   y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+   y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+   y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+   y = _mm_mul_ps(y, z);
+   y = _mm_add_ps(y, x);
+   y = _mm_add_ps(y, one);
+
+   __m128i pow2n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n),
+                                                _mm_set1_epi32(0x7f)), 23);
+   return _mm_mul_ps(y, _mm_castsi128_ps(pow2n));
+}
+
+#endif
+
+// out[i] = scale * log |in[i]|
+static void LogMagnitudes(const float *in, float *out, int len, float scale)
+{
+   int i = 0;
+
+#if defined(COMPRESSOR_SSE2)
+   const __m128 s = _mm_set1_ps(scale);
+   for (; i + 4 <= len; i += 4)
+      _mm_storeu_ps(out + i, _mm_mul_ps(LogMagnitude4(_mm_loadu_ps(in + i)), s));
+#endif
+
+   for (; i < len; i++)
+      out[i] = LogMagnitude(in[i]) * scale;
+}
+
+// out[i] = in[i] * e ^ (compression * (reference - env[i])); returns the
+// greatest |out[i]|
+static float ApplyGain(const float *in, const float *env, float *out, int len,
+                       float compression, float reference)
+{
+   int i = 0;
+   float peak = 0.0f;
+
+#if defined(COMPRESSOR_SSE2)
+   const __m128 c = _mm_set1_ps(compression);
+   const __m128 r = _mm_set1_ps(reference);
+   const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+   __m128 peaks = _mm_setzero_ps();
+   for (; i + 4 <= len; i += 4) {
+      __m128 g = Exp4(_mm_mul_ps(c, _mm_sub_ps(r, _mm_loadu_ps(env + i))));
+      __m128 o = _mm_mul_ps(_mm_loadu_ps(in + i), g);
+      _mm_storeu_ps(out + i, o);
+      peaks = _mm_max_ps(peaks, _mm_and_ps(o, absMask));
+   }
+   float lanes[4];
+   _mm_storeu_ps(lanes, peaks);
+   for (int j = 0; j < 4; j++)
+      if (lanes[j] > peak)
+         peak = lanes[j];
+#endif
+
+   for (; i < len; i++) {
+      out[i] = in[i] * Exp(compression * (reference - env[i]));
+      if (fabsf(out[i]) > peak)
+         peak = fabsf(out[i]);
+   }
+
+   return peak;
+}
+
+CompressorEngine::CompressorEngine()
+{
+   mDelay = NULL;
+   mWindowKey = NULL;
+   mWindowIndex = NULL;
+   mLatency = 0;
+   mWindowCapacity = 0;
+
+   Init(44100.0, -12.0, -40.0, 2.0, 0.2, 1.0, false, false);
+}
+
+CompressorEngine::~CompressorEngine()
+{
+   delete[] mDelay;
+   delete[] mWindowKey;
+   delete[] mWindowIndex;
+}
+
+void CompressorEngine::Init(double rate, double thresholdDB,
+                            double noiseFloorDB, double ratio,
+                            double attackTime, double decayTime,
+                            bool usePeak, bool lookAhead)
+{
+   // The same factors as EffectCompressor always used, as logs: the
+   // envelope takes the attack time to rise from the threshold to 0 dB,
+   // and the level the decay time to fall back
+   double logThreshold = log(pow(10.0, thresholdDB / 20));
+   mLogThreshold = (float)logThreshold;
+   mLogNoiseFloor = (float)log(pow(10.0, noiseFloorDB / 20));
+   mAttack = -logThreshold / (rate * attackTime + 0.5);
+   mDecay = logThreshold / (rate * decayTime + 0.5);
+   mUsePeak = usePeak;
+   // Peak values map 1.0 to 1.0 - 'upward' compression.  With RMS-based
+   // compression don't change values below the threshold - 'downward'
+   // compression.
+   mLogReference = usePeak ? 0.0f : mLogThreshold;
+   mCompression = ratio > 1 ? (float)(1.0 - 1.0 / ratio) : 0.0f;
+
+   delete[] mDelay;
+   delete[] mWindowKey;
+   delete[] mWindowIndex;
+   mDelay = NULL;
+
+   // The rise from the threshold to 0 dB is all seen in time
+   mLatency = lookAhead ? (sampleCount)(rate * attackTime + 0.5) : 0;
+   if (mLatency > 0)
+      mDelay = new float[mLatency];
+   mWindowCapacity = mLatency + 1;
+   mWindowKey = new double[mWindowCapacity];
+   mWindowIndex = new sampleCount[mWindowCapacity];
+
+   Reset();
+}
+
+void CompressorEngine::Reset(float level)
+{
+   mLevel = mLogThreshold;
+   if (level > 0 && log(level) > mLevel)
+      mLevel = log(level);
+   mEnv = mLevel;
+   mNoiseCounter = NOISE_HOLD;
+
+   memset(mSquares, 0, sizeof(mSquares));
+   mSquarePos = 0;
+
+   mCount = 0;
+   if (mDelay)
+      memset(mDelay, 0, mLatency * sizeof(float));
+   mDelayPos = 0;
+   mWindowFront = 0;
+   mWindowSize = 0;
+
+   mPeak = 0.0f;
+}
+
+void CompressorEngine::Process(const float *in, float *out, sampleCount len)
+{
+   while (len > 0) {
+      int block = len > COMPRESSOR_ENGINE_CHUNK ?
+         COMPRESSOR_ENGINE_CHUNK : (int)len;
+      ProcessChunk(in, out, block);
+      in += block;
+      out += block;
+      len -= block;
+   }
+}
+
+void CompressorEngine::ProcessChunk(const float *in, float *out, int len)
+{
+   int i;
+
+   // Levels of the input
+   if (mUsePeak)
+      LogMagnitudes(in, mLevels, len, 1.0f);
+   else {
+      // Recompute the RMS sum each time to prevent accumulation of
+      // rounding errors during long waveforms
+      double sum = 0;
+      for (i = 0; i < COMPRESSOR_ENGINE_RMS_WINDOW; i++)
+         sum += mSquares[i];
+      for (i = 0; i < len; i++) {
+         float square = in[i] * in[i];
+         sum += square - mSquares[mSquarePos];
+         mSquares[mSquarePos] = square;
+         if (++mSquarePos == COMPRESSOR_ENGINE_RMS_WINDOW)
+            mSquarePos = 0;
+         mLevels[i] = (float)(sum / COMPRESSOR_ENGINE_RMS_WINDOW);
+      }
+      // Half the log of the mean square is the log of its root
+      LogMagnitudes(mLevels, mLevels, len, 0.5f);
+   }
+
+   // Envelope of the samples output
+   double level = mLevel;
+   double env = mEnv;
+   for (i = 0; i < len; i++) {
+      // Don't increase gain when signal is continuously below the noise floor
+      if (mLevels[i] < mLogNoiseFloor) {
+         if (mNoiseCounter < NOISE_HOLD)
+            mNoiseCounter++;
+      }
+      else
+         mNoiseCounter = 0;
+      if (mNoiseCounter < NOISE_HOLD) {
+         level += mDecay;
+         if (level < mLogThreshold)
+            level = mLogThreshold;
+         if (mLevels[i] > level)
+            level = mLevels[i];
+      }
+
+      // The sample now output, once the delay line has filled; levels
+      // from before it drop out of the window
+      sampleCount t = mCount - mLatency;
+      while (mWindowSize > 0 && mWindowIndex[mWindowFront] < t) {
+         if (++mWindowFront == mWindowCapacity)
+            mWindowFront = 0;
+         mWindowSize--;
+      }
+
+      // So does any level as low as this one, less the attack between
+      double key = level - mCount * mAttack;
+      while (mWindowSize > 0) {
+         sampleCount back = mWindowFront + mWindowSize - 1;
+         if (back >= mWindowCapacity)
+            back -= mWindowCapacity;
+         if (mWindowKey[back] > key)
+            break;
+         mWindowSize--;
+      }
+      sampleCount slot = mWindowFront + mWindowSize;
+      if (slot >= mWindowCapacity)
+         slot -= mWindowCapacity;
+      mWindowKey[slot] = key;
+      mWindowIndex[slot] = mCount;
+      mWindowSize++;
+      mCount++;
+
+      if (t >= 0) {
+         double ahead = mWindowKey[mWindowFront] + t * mAttack;
+         env += mAttack;
+         if (ahead < env)
+            env = ahead;
+      }
+      mEnvs[i] = (float)env;
+   }
+   mLevel = level;
+   mEnv = env;
+
+   // The samples output
+   const float *delayed = in;
+   if (mLatency > 0) {
+      for (i = 0; i < len; i++) {
+         float x = in[i];
+         mDelayed[i] = mDelay[mDelayPos];
+         mDelay[mDelayPos] = x;
+         if (++mDelayPos == mLatency)
+            mDelayPos = 0;
+      }
+      delayed = mDelayed;
+   }
+
+   float peak = ApplyGain(delayed, mEnvs, out, len, mCompression,
+                          mLogReference);
+   if (peak > mPeak)
+      mPeak = peak;
+}
@@ -0,0 +1,99 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  CompressorEngine.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_COMPRESSOR_ENGINE__
+#define __AUDACITY_COMPRESSOR_ENGINE__
+
+#include "audacity/Types.h"
+
+/// Samples the engine works on at a time
+#define COMPRESSOR_ENGINE_CHUNK 256
+/// Samples the RMS level is taken over
+#define COMPRESSOR_ENGINE_RMS_WINDOW 100
+
+/// The compression of EffectCompressor as a single streaming pass over
+/// one channel, so that it can run a block at a time as audio plays.
+/// Once Init() has been called, Reset() and Process() neither allocate
+/// nor lock.
+class CompressorEngine
+{
+ public:
+   CompressorEngine();
+   ~CompressorEngine();
+
+   /// Set up for a channel at rate, as EffectCompressor's parameters
+   /// say.  With lookAhead the output is delayed by the attack time, so
+   /// that the gain is already down when a rise in level comes through.
+   /// Allocates the delay lines, and starts a stream with Reset().
+   void Init(double rate, double thresholdDB, double noiseFloorDB,
+             double ratio, double attackTime, double decayTime,
+             bool usePeak, bool lookAhead);
+
+   /// Start a new stream, the envelope following on from level, or from
+   /// the threshold if that is higher
+   void Reset(float level = 0.0f);
+
+   /// Samples by which the output lags the input
+   sampleCount GetLatency() const { return mLatency; }
+
+   /// Compress len samples of the stream; out may be in
+   void Process(const float *in, float *out, sampleCount len);
+
+   /// Greatest magnitude output since Reset()
+   float GetPeak() const { return mPeak; }
+
+ private:
+   void ProcessChunk(const float *in, float *out, int len);
+
+   // Levels and envelopes are natural logs, so that attack and decay
+   // are sums and the gain is a power of e
+   bool mUsePeak;
+   float mLogThreshold;
+   float mLogNoiseFloor;
+   /// What the envelope is taken relative to: the threshold for RMS,
+   /// 0 dB for peaks
+   float mLogReference;
+   float mCompression;
+   /// Greatest rise of the envelope per sample; > 0
+   double mAttack;
+   /// Fall of the level per sample; <= 0
+   double mDecay;
+
+   float mSquares[COMPRESSOR_ENGINE_RMS_WINDOW];
+   int mSquarePos;
+
+   /// Samples in a row below the noise floor, up to the number that
+   /// holds the level
+   int mNoiseCounter;
+   /// Detected level, with the decay applied
+   double mLevel;
+   /// Envelope of the last sample output
+   double mEnv;
+
+   /// Input samples so far
+   sampleCount mCount;
+   sampleCount mLatency;
+   float *mDelay;
+   sampleCount mDelayPos;
+
+   // The levels that could yet raise the envelope of the sample being
+   // output, a queue of decreasing level - mAttack * index
+   double *mWindowKey;
+   sampleCount *mWindowIndex;
+   sampleCount mWindowCapacity;
+   sampleCount mWindowFront;
+   sampleCount mWindowSize;
+
+   float mLevels[COMPRESSOR_ENGINE_CHUNK];
+   float mEnvs[COMPRESSOR_ENGINE_CHUNK];
+   float mDelayed[COMPRESSOR_ENGINE_CHUNK];
+
+   float mPeak;
+};
+
+#endif
@@ -0,0 +1,445 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ConvolutionEngine.cpp
+
+*******************************************************************//**
+
+\class ConvolutionEngine
+\brief Fast convolution of one channel with an impulse response.
+
+The response is cut into partitions, and the spectrum of each, zero
+padded to twice its length, is kept.  Each block of input is transformed
+with the block before it, and the spectra of the last few blocks are
+multiplied with those of the partitions, summed, and transformed back;
+the second half of the result is the output for the block (overlap-save).
+This costs a few operations a sample for each partition, where
+convolving in time costs one per sample of the response.
+
+Short partitions mean a short latency but many partitions for a long
+response.  With non-uniform partitioning, only the first
+2 * CONVOLUTION_TAIL_RATIO partitions are a block long; the rest of the
+response is cut into partitions CONVOLUTION_TAIL_RATIO blocks long, and
+convolved with blocks of input that long.  Since the first of those
+starts two tail blocks into the response, the output for a tail block
+isn't due until the tail block after the one its input ends in.  So
+each tail block is handed to a thread of the engine's own, which
+convolves it while the next CONVOLUTION_TAIL_RATIO blocks go through,
+and Process() takes about as long for every block.  Process() waits on
+the thread only if it falls that far behind.
+
+*//****************************************************************//**
+
+\class ConvolutionTailThread
+\brief The thread of a ConvolutionEngine that convolves its tail.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#include "ConvolutionEngine.h"
+
+#include <string.h>
+
+// acc += x * h, over bins [first, last) of spectra packed as
+// Transform() leaves them, where bin 0 is DC and Nyquist
+static void MultiplyAdd(float *acc, const float *x, const float *h,
+                        int first, int last)
+{
+   if (first == 0) {
+      acc[0] += x[0] * h[0];
+      acc[1] += x[1] * h[1];
+      first = 1;
+   }
+   for (int i = first; i < last; i++) {
+      float xr = x[2 * i], xi = x[2 * i + 1];
+      float hr = h[2 * i], hi = h[2 * i + 1];
+      acc[2 * i] += xr * hr - xi * hi;
+      acc[2 * i + 1] += xr * hi + xi * hr;
+   }
+}
+
+class ConvolutionTailThread : public wxThread {
+ public:
+   ConvolutionTailThread(ConvolutionEngine *engine):
+      wxThread(wxTHREAD_JOINABLE), mEngine(engine) {}
+   virtual ExitCode Entry()
+   {
+      mEngine->TailRun();
+      return 0;
+   }
+ private:
+   ConvolutionEngine *mEngine;
+};
+
+ConvolutionEngine::ConvolutionEngine():
+   mTailAvailable(mTailMutex),
+   mTailFinished(mTailMutex)
+{
+   hHeadFFT = NULL;
+   hTailFFT = NULL;
+   mHeadIR = NULL;
+   mHeadFDL = NULL;
+   mInput = NULL;
+   mOutput = NULL;
+   mScratch = NULL;
+   mAcc = NULL;
+   mTailIR = NULL;
+   mTailFDL = NULL;
+   mTailInput = NULL;
+   mTailJob = NULL;
+   mTailScratch = NULL;
+   mTailAcc = NULL;
+   mTailOut[0] = mTailOut[1] = NULL;
+
+   mTailThread = NULL;
+   mTailJobBlock = 0;
+   mTailPending = false;
+   mTailStopping = false;
+
+   mWet = 1.0f;
+   mDry = 0.0f;
+
+   // A unit impulse, until told otherwise
+   float impulse = 1.0f;
+   Init(&impulse, 1, 256, false);
+}
+
+ConvolutionEngine::~ConvolutionEngine()
+{
+   Free();
+}
+
+void ConvolutionEngine::Free()
+{
+   StopTailThread();
+
+   if (hHeadFFT)
+      ReleaseFFT(hHeadFFT);
+   if (hTailFFT)
+      ReleaseFFT(hTailFFT);
+   hHeadFFT = NULL;
+   hTailFFT = NULL;
+
+   delete[] mHeadIR;
+   delete[] mHeadFDL;
+   delete[] mInput;
+   delete[] mOutput;
+   delete[] mScratch;
+   delete[] mAcc;
+   delete[] mTailIR;
+   delete[] mTailFDL;
+   delete[] mTailInput;
+   delete[] mTailJob;
+   delete[] mTailScratch;
+   delete[] mTailAcc;
+   delete[] mTailOut[0];
+   delete[] mTailOut[1];
+   mHeadIR = NULL;
+   mHeadFDL = NULL;
+   mInput = NULL;
+   mOutput = NULL;
+   mScratch = NULL;
+   mAcc = NULL;
+   mTailIR = NULL;
+   mTailFDL = NULL;
+   mTailInput = NULL;
+   mTailJob = NULL;
+   mTailScratch = NULL;
+   mTailAcc = NULL;
+   mTailOut[0] = mTailOut[1] = NULL;
+}
+
+void ConvolutionEngine::Init(const float *ir, sampleCount irLen,
+                             int blockSize, bool nonUniform)
+{
+   Free();
+
+   mBlockSize = blockSize;
+   mTailLen = blockSize * CONVOLUTION_TAIL_RATIO;
+   sampleCount headLen = irLen;
+   if (!nonUniform || irLen <= 2 * mTailLen) {
+      mTailLen = 0;
+      mTailParts = 0;
+   }
+   else {
+      headLen = 2 * mTailLen;
+      mTailParts = (int)((irLen - headLen + mTailLen - 1) / mTailLen);
+   }
+   mHeadParts = (int)((headLen + blockSize - 1) / blockSize);
+   if (mHeadParts < 1)
+      mHeadParts = 1;
+
+   int size = 2 * blockSize;
+   hHeadFFT = GetFFT(size);
+   mHeadIR = new float[mHeadParts * size];
+   mHeadFDL = new float[mHeadParts * size];
+   mInput = new float[size];
+   mOutput = new float[blockSize];
+   mScratch = new float[size];
+   mAcc = new float[size];
+   Partition(ir, headLen, 0, blockSize, mHeadParts, hHeadFFT,
+             mHeadIR, mScratch);
+
+   if (mTailParts > 0) {
+      size = 2 * mTailLen;
+      hTailFFT = GetFFT(size);
+      mTailIR = new float[mTailParts * size];
+      mTailFDL = new float[mTailParts * size];
+      mTailInput = new float[size];
+      mTailJob = new float[size];
+      mTailScratch = new float[size];
+      mTailAcc = new float[size];
+      mTailOut[0] = new float[mTailLen];
+      mTailOut[1] = new float[mTailLen];
+      Partition(ir, irLen, headLen, mTailLen, mTailParts, hTailFFT,
+                mTailIR, mTailScratch);
+
+      StartTailThread();
+   }
+
+   Reset();
+}
+
+void ConvolutionEngine::StartTailThread()
+{
+   mTailPending = false;
+   mTailStopping = false;
+
+   ConvolutionTailThread *thread = new ConvolutionTailThread(this);
+   if (thread->Create() != wxTHREAD_NO_ERROR) {
+      delete thread;
+      return;
+   }
+   thread->Run();
+   mTailThread = thread;
+}
+
+void ConvolutionEngine::StopTailThread()
+{
+   if (!mTailThread)
+      return;
+
+   mTailMutex.Lock();
+   mTailStopping = true;
+   mTailAvailable.Signal();
+   mTailMutex.Unlock();
+
+   mTailThread->Wait();
+   delete mTailThread;
+   mTailThread = NULL;
+   mTailPending = false;
+}
+
+void ConvolutionEngine::Partition(const float *ir, sampleCount irLen,
+                                  sampleCount offset, int partLen, int parts,
+                                  HFFT hFFT, float *spectra, float *scratch)
+{
+   int size = 2 * partLen;
+   for (int p = 0; p < parts; p++) {
+      // The partition, zero padded to twice its length
+      float *input = spectra + p * size;
+      memset(input, 0, size * sizeof(float));
+      sampleCount start = offset + (sampleCount)p * partLen;
+      sampleCount len = irLen - start;
+      if (len > partLen)
+         len = partLen;
+      if (len > 0)
+         memcpy(input, ir + start, (size_t)len * sizeof(float));
+      Transform(input, hFFT, input, scratch);
+   }
+}
+
+void ConvolutionEngine::Transform(const float *input, HFFT hFFT,
+                                  float *spectrum, float *scratch)
+{
+   int size = 2 * hFFT->Points;
+   memcpy(scratch, input, size * sizeof(float));
+   RealFFTf(scratch, hFFT);
+
+   // Into the order InverseRealFFTf() takes
+   spectrum[0] = scratch[0];
+   spectrum[1] = scratch[1];
+   for (int i = 1; i < hFFT->Points; i++) {
+      spectrum[2 * i] = scratch[hFFT->BitReversed[i]];
+      spectrum[2 * i + 1] = scratch[hFFT->BitReversed[i] + 1];
+   }
+}
+
+void ConvolutionEngine::Reset()
+{
+   WaitTail();
+
+   int size = 2 * mBlockSize;
+   memset(mHeadFDL, 0, mHeadParts * size * sizeof(float));
+   memset(mInput, 0, size * sizeof(float));
+   memset(mOutput, 0, mBlockSize * sizeof(float));
+   mHeadPos = 0;
+   mFill = 0;
+   mBlocks = 0;
+
+   if (mTailParts > 0) {
+      size = 2 * mTailLen;
+      memset(mTailFDL, 0, mTailParts * size * sizeof(float));
+      memset(mTailInput, 0, size * sizeof(float));
+      memset(mTailOut[0], 0, mTailLen * sizeof(float));
+      memset(mTailOut[1], 0, mTailLen * sizeof(float));
+   }
+   mTailBlocks = 0;
+}
+
+void ConvolutionEngine::SetMix(float wet, float dry)
+{
+   mWet = wet;
+   mDry = dry;
+}
+
+void ConvolutionEngine::Process(const float *in, float *out, sampleCount len)
+{
+   while (len > 0) {
+      int block = mBlockSize - mFill;
+      if (len < block)
+         block = (int)len;
+
+      // Read the input before writing the output, which may be the same
+      float *input = mInput + mBlockSize + mFill;
+      memcpy(input, in, block * sizeof(float));
+      memcpy(out, mOutput + mFill, block * sizeof(float));
+
+      mFill += block;
+      if (mFill == mBlockSize) {
+         ProcessBlock();
+         mFill = 0;
+      }
+
+      in += block;
+      out += block;
+      len -= block;
+   }
+}
+
+void ConvolutionEngine::ProcessBlock()
+{
+   int size = 2 * mBlockSize;
+   int i;
+
+   // Spectrum of the last two blocks
+   if (++mHeadPos == mHeadParts)
+      mHeadPos = 0;
+   Transform(mInput, hHeadFFT, mHeadFDL + mHeadPos * size, mScratch);
+
+   // Each partition with the block as far back as the partition is into
+   // the response
+   memset(mAcc, 0, size * sizeof(float));
+   for (int p = 0; p < mHeadParts; p++) {
+      int slot = mHeadPos - p;
+      if (slot < 0)
+         slot += mHeadParts;
+      MultiplyAdd(mAcc, mHeadFDL + slot * size, mHeadIR + p * size,
+                  0, mBlockSize);
+   }
+   InverseRealFFTf(mAcc, hHeadFFT);
+   ReorderToTime(hHeadFFT, mAcc, mScratch);
+
+   // The second half is the convolution for the block
+   float *result = mScratch + mBlockSize;
+   if (mTailParts > 0) {
+      sampleCount start = mBlocks * mBlockSize;
+      sampleCount period = start / mTailLen;
+      const float *tail = mTailOut[period % 2] + (start - period * mTailLen);
+      for (i = 0; i < mBlockSize; i++)
+         result[i] += tail[i];
+   }
+   const float *dry = mInput + mBlockSize;
+   for (i = 0; i < mBlockSize; i++)
+      mOutput[i] = mWet * result[i] + mDry * dry[i];
+
+   if (mTailParts > 0) {
+      // Gather a tail block, and hand it on once it is whole
+      int pos = (int)(mBlocks % CONVOLUTION_TAIL_RATIO);
+      memcpy(mTailInput + mTailLen + pos * mBlockSize, dry,
+             mBlockSize * sizeof(float));
+      if (pos == CONVOLUTION_TAIL_RATIO - 1) {
+         StartTail();
+         memcpy(mTailInput, mTailInput + mTailLen, mTailLen * sizeof(float));
+      }
+   }
+
+   memcpy(mInput, mInput + mBlockSize, mBlockSize * sizeof(float));
+   mBlocks++;
+}
+
+void ConvolutionEngine::StartTail()
+{
+   // The thread is done with the tail block before unless it is behind:
+   // that one's output is due from the next block on
+   WaitTail();
+
+   memcpy(mTailJob, mTailInput, 2 * mTailLen * sizeof(float));
+   sampleCount block = mTailBlocks++;
+
+   if (!mTailThread) {
+      ConvolveTail(block);
+      return;
+   }
+
+   wxMutexLocker locker(mTailMutex);
+   mTailJobBlock = block;
+   mTailPending = true;
+   mTailAvailable.Signal();
+}
+
+void ConvolutionEngine::WaitTail()
+{
+   if (!mTailThread)
+      return;
+
+   wxMutexLocker locker(mTailMutex);
+   while (mTailPending)
+      mTailFinished.Wait();
+}
+
+void ConvolutionEngine::TailRun()
+{
+   wxMutexLocker locker(mTailMutex);
+
+   for (;;) {
+      while (!mTailPending && !mTailStopping)
+         mTailAvailable.Wait();
+      if (mTailStopping)
+         return;
+
+      sampleCount block = mTailJobBlock;
+      mTailMutex.Unlock();
+      ConvolveTail(block);
+      mTailMutex.Lock();
+
+      mTailPending = false;
+      mTailFinished.Signal();
+   }
+}
+
+void ConvolutionEngine::ConvolveTail(sampleCount block)
+{
+   int size = 2 * mTailLen;
+   Transform(mTailJob, hTailFFT, mTailFDL + (block % mTailParts) * size,
+             mTailScratch);
+
+   // Each partition with the tail block as far back as the partition is
+   // into the tail
+   memset(mTailAcc, 0, size * sizeof(float));
+   for (int j = 0; j < mTailParts && j <= block; j++) {
+      int slot = (int)((block - j) % mTailParts);
+      MultiplyAdd(mTailAcc, mTailFDL + slot * size, mTailIR + j * size,
+                  0, mTailLen);
+   }
+   InverseRealFFTf(mTailAcc, hTailFFT);
+   ReorderToTime(hTailFFT, mTailAcc, mTailScratch);
+
+   // The output for the tail block after next, which the caller isn't
+   // reading yet
+   sampleCount period = block + 2;
+   memcpy(mTailOut[period % 2], mTailScratch + mTailLen,
+          mTailLen * sizeof(float));
+}
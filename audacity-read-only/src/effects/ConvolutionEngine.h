@@ -0,0 +1,139 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ConvolutionEngine.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_CONVOLUTION_ENGINE__
+#define __AUDACITY_CONVOLUTION_ENGINE__
+
+#include <wx/thread.h>
+
+#include "../RealFFTf.h"
+#include "audacity/Types.h"
+
+class ConvolutionTailThread;
+
+/// Head blocks in each partition of the tail, with non-uniform
+/// partitioning
+#define CONVOLUTION_TAIL_RATIO 8
+
+/// Convolves one channel with an impulse response, a block at a time,
+/// by partitioned overlap-save in the frequency domain.  The output lags
+/// the input by the block size.  Once Init() has been called, Reset()
+/// and Process() don't allocate.  The tail of a non-uniformly
+/// partitioned response is convolved on a thread of the engine's own.
+class ConvolutionEngine
+{
+ public:
+   ConvolutionEngine();
+   ~ConvolutionEngine();
+
+   /// Set up to convolve with ir[0, irLen), in partitions of blockSize, a
+   /// power of two.  With nonUniform, all but the start of a long
+   /// response is done in partitions CONVOLUTION_TAIL_RATIO times longer,
+   /// each tail block on the engine's thread while the next
+   /// CONVOLUTION_TAIL_RATIO blocks go through.  Allocates, starts that
+   /// thread, and starts a stream with Reset().
+   void Init(const float *ir, sampleCount irLen, int blockSize,
+             bool nonUniform);
+
+   /// Start a new stream, from silence
+   void Reset();
+
+   /// out = wet * convolution + dry * input, delayed alike; 1 and 0
+   /// unless set
+   void SetMix(float wet, float dry);
+
+   /// Samples by which the output lags the input
+   sampleCount GetLatency() const { return mBlockSize; }
+
+   /// Convolve len samples of the stream; out may be in
+   void Process(const float *in, float *out, sampleCount len);
+
+ private:
+   void Free();
+   // The spectra of the partitions of ir from offset on
+   static void Partition(const float *ir, sampleCount irLen,
+                         sampleCount offset, int partLen, int parts,
+                         HFFT hFFT, float *spectra, float *scratch);
+   // Transform 2 * partLen samples of input into spectrum
+   static void Transform(const float *input, HFFT hFFT, float *spectrum,
+                         float *scratch);
+   // Once a block of input is in
+   void ProcessBlock();
+
+   void StartTailThread();
+   void StopTailThread();
+   friend class ConvolutionTailThread;
+   // Body of the thread
+   void TailRun();
+   // Hand the tail block just gathered to the thread, or convolve it
+   // here if there is none
+   void StartTail();
+   // Until the thread has finished the tail block it was handed
+   void WaitTail();
+   // Convolve tail block, whose input with the block before is in
+   // mTailJob, into the output of the tail block after next
+   void ConvolveTail(sampleCount block);
+
+   int mBlockSize;
+   float mWet;
+   float mDry;
+
+   // Head: partitions of mBlockSize, each block convolved as it comes
+   HFFT hHeadFFT;
+   int mHeadParts;
+   /// Spectra of the partitions, 2 * mBlockSize each, DC and Nyquist
+   /// first and then the bins in order
+   float *mHeadIR;
+   /// Spectra of the last mHeadParts blocks of input, newest at mHeadPos
+   float *mHeadFDL;
+   int mHeadPos;
+   /// The last two blocks of input
+   float *mInput;
+   int mFill;
+   /// Output of the last block
+   float *mOutput;
+   float *mScratch;
+   float *mAcc;
+   sampleCount mBlocks;
+
+   // Tail: partitions of mTailLen, from 2 * mTailLen into the response,
+   // so that each tail block can be convolved on the thread while the
+   // next CONVOLUTION_TAIL_RATIO blocks go through, and be done before
+   // its output is due
+   HFFT hTailFFT;
+   int mTailLen;
+   int mTailParts;
+   float *mTailIR;
+   /// Only the thread uses it while it has a tail block
+   float *mTailFDL;
+   /// The last tail block of input, and the one being gathered
+   float *mTailInput;
+   /// The last two tail blocks of input, as handed to the thread
+   float *mTailJob;
+   float *mTailScratch;
+   float *mTailAcc;
+   /// Output for two periods of mTailLen, the one going out and the one
+   /// being worked on
+   float *mTailOut[2];
+   /// Tail blocks of input so far
+   sampleCount mTailBlocks;
+
+   /// NULL if there are no tail partitions, or it couldn't be started
+   ConvolutionTailThread *mTailThread;
+   wxMutex mTailMutex;
+   wxCondition mTailAvailable;
+   wxCondition mTailFinished;
+   // Changed only with mTailMutex locked
+   /// The tail block the thread was handed last
+   sampleCount mTailJobBlock;
+   /// Whether the thread has a tail block it hasn't finished
+   bool mTailPending;
+   bool mTailStopping;
+};
+
+#endif
@@ -0,0 +1,456 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ConvolutionReverb.cpp
+
+*******************************************************************//**
+
+\class EffectConvolutionReverb
+\brief Reverberation by convolving with the recorded impulse response
+of a room, read from an audio file.
+
+  Each channel of each track is convolved by its own ConvolutionEngine,
+  on the ThreadPool.  The right channel of a stereo track takes the
+  second channel of a stereo response; every other channel the first.
+  The response is resampled to the rate of the track if need be.  As
+  with EffectReverb, the selection keeps its length, and the reverb
+  that would ring on past its end is cut off.
+
+  The response read is kept until another file is chosen, so a chain
+  that applies it to a batch of files doesn't read it again for each.
+
+*//****************************************************************//**
+
+\class ConvolutionReverbDialog
+\brief Dialog used with EffectConvolutionReverb
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <wx/button.h>
+#include <wx/file.h>
+#include <wx/filefn.h>
+#include <wx/msgdlg.h>
+#include <wx/textctrl.h>
+#include <wx/intl.h>
+
+#include "sndfile.h"
+
+#include "ConvolutionReverb.h"
+#include "ConvolutionEngine.h"
+#include "FileDialog.h"
+#include "../Prefs.h"
+#include "../Resample.h"
+#include "../ShuttleGui.h"
+#include "../WaveTrack.h"
+
+// Block sizes offered, MIN_BLOCK_SIZE and the powers of two up from it
+#define MIN_BLOCK_SIZE   64
+#define NUM_BLOCK_SIZES  7
+
+// Longest response read, so that a wrong choice of file doesn't take
+// all of memory
+#define MAX_RESPONSE_SECONDS 60
+
+// The index among the block sizes offered of blockSize, or of the one
+// nearest below it
+static int BlockSizeIndex(int blockSize)
+{
+   int index = 0;
+   while (index < NUM_BLOCK_SIZES - 1 &&
+          (MIN_BLOCK_SIZE << (index + 1)) <= blockSize)
+      index++;
+   return index;
+}
+
+EffectConvolutionReverb::EffectConvolutionReverb()
+{
+   mLoadedTime = 0;
+   mChannels = 0;
+
+   Init();
+}
+
+EffectConvolutionReverb::~EffectConvolutionReverb()
+{
+   FreeResponses();
+}
+
+bool EffectConvolutionReverb::Init()
+{
+   mFileName = gPrefs->Read(wxT("/Effects/ConvolutionReverb/File"), wxEmptyString);
+   mBlockSize = gPrefs->Read(wxT("/Effects/ConvolutionReverb/BlockSize"), 1024L);
+   mBlockSize = MIN_BLOCK_SIZE << BlockSizeIndex(mBlockSize);  // corrupted Prefs?
+   gPrefs->Read(wxT("/Effects/ConvolutionReverb/NonUniform"), &mNonUniform, true);
+   gPrefs->Read(wxT("/Effects/ConvolutionReverb/WetGain"), &mWetGain, -6.0);
+   gPrefs->Read(wxT("/Effects/ConvolutionReverb/DryGain"), &mDryGain, 0.0);
+   gPrefs->Read(wxT("/Effects/ConvolutionReverb/WetOnly"), &mWetOnly, false);
+   return true;
+}
+
+wxString EffectConvolutionReverb::GetEffectDescription()
+{
+   // Note: This is useful only after values have been set.
+   wxString strResult =
+      wxString::Format(_("Applied effect: %s"), GetEffectName().c_str());
+   strResult += wxString::Format(_(", impulse response = %s"),
+                                 wxFileNameFromPath(mFileName).c_str());
+   strResult += wxString::Format(_(", wet gain = %.1f dB"), mWetGain);
+   if (mWetOnly)
+      strResult += _(", wet only");
+   else
+      strResult += wxString::Format(_(", dry gain = %.1f dB"), mDryGain);
+   return strResult;
+}
+
+bool EffectConvolutionReverb::PromptUser()
+{
+   ConvolutionReverbDialog dlog(this, mParent);
+
+   dlog.CentreOnParent();
+   dlog.ShowModal();
+
+   if (dlog.GetReturnCode() == wxID_CANCEL)
+      return false;
+
+   gPrefs->Write(wxT("/Effects/ConvolutionReverb/File"), mFileName);
+   gPrefs->Write(wxT("/Effects/ConvolutionReverb/BlockSize"), mBlockSize);
+   gPrefs->Write(wxT("/Effects/ConvolutionReverb/NonUniform"), mNonUniform);
+   gPrefs->Write(wxT("/Effects/ConvolutionReverb/WetGain"), mWetGain);
+   gPrefs->Write(wxT("/Effects/ConvolutionReverb/DryGain"), mDryGain);
+   gPrefs->Write(wxT("/Effects/ConvolutionReverb/WetOnly"), mWetOnly);
+   return gPrefs->Flush();
+}
+
+bool EffectConvolutionReverb::TransferParameters( Shuttle & shuttle )
+{
+   shuttle.TransferString(wxT("File"), mFileName, wxEmptyString);
+   shuttle.TransferInt(wxT("BlockSize"), mBlockSize, 1024);
+   shuttle.TransferBool(wxT("NonUniform"), mNonUniform, true);
+   shuttle.TransferDouble(wxT("WetGain"), mWetGain, -6.0);
+   shuttle.TransferDouble(wxT("DryGain"), mDryGain, 0.0);
+   shuttle.TransferBool(wxT("WetOnly"), mWetOnly, false);
+   return true;
+}
+
+void EffectConvolutionReverb::FreeResponses()
+{
+   for (size_t i = 0; i < mResponses.size(); i++)
+      delete[] mResponses[i].samples;
+   mResponses.clear();
+   mLoadedFileName = wxEmptyString;
+}
+
+bool EffectConvolutionReverb::LoadFile()
+{
+   // Read again if the file has changed, as it may have between runs
+   time_t modified = 0;
+   if (wxFileExists(mFileName))
+      modified = wxFileModificationTime(mFileName);
+   if (!mResponses.empty() &&
+       mFileName == mLoadedFileName && modified == mLoadedTime)
+      return true;
+   FreeResponses();
+
+   SF_INFO info;
+   SNDFILE *file = NULL;
+
+   memset(&info, 0, sizeof(info));
+
+   wxFile f;   // will be closed when it goes out of scope
+
+   if (f.Open(mFileName)) {
+      // As ImportPCM does: wxWidgets can open a file with a Unicode name
+      // and libsndfile can't (under Windows).
+      file = sf_open_fd(f.fd(), SFM_READ, &info, TRUE);
+   }
+
+   // The file descriptor is now owned by "file", or closed by
+   // sf_open_fd() if it failed.
+   f.Detach();
+
+   if (!file) {
+      wxMessageBox(
+         wxString::Format(_("Could not read the impulse response \"%s\"."),
+                          mFileName.c_str()),
+         this->GetEffectName(),
+         wxOK | wxICON_ERROR);
+      return false;
+   }
+
+   if (info.frames <= 0 || info.channels <= 0 ||
+       info.frames > (sf_count_t)info.samplerate * MAX_RESPONSE_SECONDS) {
+      sf_close(file);
+      wxMessageBox(
+         wxString::Format(_("The impulse response must be no longer than %d seconds."),
+                          MAX_RESPONSE_SECONDS),
+         this->GetEffectName(),
+         wxOK | wxICON_ERROR);
+      return false;
+   }
+
+   float *interleaved = new float[info.frames * info.channels];
+   sampleCount len = sf_readf_float(file, interleaved, info.frames);
+   sf_close(file);
+
+   // One channel after another
+   Response response;
+   response.rate = info.samplerate;
+   response.len = len;
+   response.samples = new float[len * info.channels];
+   for (int c = 0; c < info.channels; c++)
+      for (sampleCount i = 0; i < len; i++)
+         response.samples[c * len + i] = interleaved[i * info.channels + c];
+   delete[] interleaved;
+
+   mResponses.push_back(response);
+   mChannels = info.channels;
+   mLoadedFileName = mFileName;
+   mLoadedTime = modified;
+
+   return true;
+}
+
+const EffectConvolutionReverb::Response *
+EffectConvolutionReverb::GetResponse(double rate)
+{
+   for (size_t i = 0; i < mResponses.size(); i++)
+      if (mResponses[i].rate == rate)
+         return &mResponses[i];
+
+   // Resampled from what was read, which is first
+   const Response &read = mResponses[0];
+   double factor = rate / read.rate;
+   int maxLen = (int)(read.len * factor) + 1024;
+
+   Response response;
+   response.rate = rate;
+   response.len = 0;
+   response.samples = new float[maxLen * mChannels];
+   for (int c = 0; c < mChannels; c++) {
+      Resample resample(true, factor, factor);
+      float *in = read.samples + c * read.len;
+      float *out = response.samples + c * maxLen;
+      int inLen = (int)read.len;
+      int inPos = 0;
+      int outPos = 0;
+      while (outPos < maxLen) {
+         int used = 0;
+         int made = resample.Process(factor, in + inPos, inLen - inPos, true,
+                                     &used, out + outPos, maxLen - outPos);
+         inPos += used;
+         outPos += made;
+         if (made <= 0 && (used <= 0 || inPos >= inLen))
+            break;
+      }
+      if (response.len < outPos)
+         response.len = outPos;
+      memset(out + outPos, 0, (maxLen - outPos) * sizeof(float));
+   }
+
+   // Close up the channels
+   for (int c = 1; c < mChannels; c++)
+      memmove(response.samples + c * response.len,
+              response.samples + c * maxLen,
+              response.len * sizeof(float));
+
+   mResponses.push_back(response);
+   return &mResponses.back();
+}
+
+bool EffectConvolutionReverb::Process()
+{
+   if (!LoadFile())
+      return false;
+
+   this->CopyInputTracks(); // Set up mOutputTracks.
+   bool bGoodResult = true;
+
+   mJobs.clear();
+   SelectedTrackListOfKindIterator iter(Track::Wave, mOutputTracks);
+   WaveTrack *track = (WaveTrack *) iter.First();
+   int count = 0;
+   while (track) {
+      double trackStart = track->GetStartTime();
+      double trackEnd = track->GetEndTime();
+      double t0 = mT0 < trackStart? trackStart: mT0;
+      double t1 = mT1 > trackEnd? trackEnd: mT1;
+
+      if (t1 > t0) {
+         const Response *response = GetResponse(track->GetRate());
+         int channel = 0;
+         if (track->GetChannel() == Track::RightChannel && mChannels > 1)
+            channel = 1;
+
+         Job job;
+         job.track = track;
+         job.count = count;
+         job.start = track->TimeToLongSamples(t0);
+         job.end = track->TimeToLongSamples(t1);
+         // Kept valid by mResponses however it grows
+         job.response = response->samples + channel * response->len;
+         job.responseLen = response->len;
+         mJobs.push_back(job);
+      }
+
+      track = (WaveTrack *) iter.Next();
+      count++;
+   }
+
+   bGoodResult = ProcessItems((int)mJobs.size());
+   mJobs.clear();
+
+   this->ReplaceProcessedTracks(bGoodResult);
+   return bGoodResult;
+}
+
+bool EffectConvolutionReverb::ProcessItem(int index)
+{
+   Job &job = mJobs[index];
+   return ProcessOne(job.count, job.track, job.start, job.end,
+                     job.response, job.responseLen);
+}
+
+class EffectConvolutionReverb::Convolution : public EffectLatentWork
+{
+public:
+   Convolution(EffectConvolutionReverb *effect, ConvolutionEngine &engine,
+               int count)
+      : mEffect(effect), mEngine(engine), mCount(count)
+   {
+   }
+
+   virtual void ProcessBlock(float *buffer, sampleCount len,
+                             bool WXUNUSED(first))
+   {
+      mEngine.Process(buffer, buffer, len);
+   }
+
+   virtual bool Progress(double frac)
+   {
+      return mEffect->TrackProgress(mCount, frac);
+   }
+
+private:
+   EffectConvolutionReverb *mEffect;
+   ConvolutionEngine &mEngine;
+   int mCount;
+};
+
+bool EffectConvolutionReverb::ProcessOne(int count, WaveTrack *track,
+                                         sampleCount start, sampleCount end,
+                                         const float *response,
+                                         sampleCount responseLen)
+{
+   ConvolutionEngine engine;
+   engine.Init(response, responseLen,
+               MIN_BLOCK_SIZE << BlockSizeIndex(mBlockSize), mNonUniform);
+   engine.SetMix((float)pow(10.0, mWetGain / 20.0),
+                 mWetOnly ? 0.0f : (float)pow(10.0, mDryGain / 20.0));
+
+   Convolution convolution(this, engine, count);
+   return ProcessLatent(convolution, track, start, end, engine.GetLatency());
+}
+
+//----------------------------------------------------------------------------
+// ConvolutionReverbDialog
+//----------------------------------------------------------------------------
+
+enum {
+   ID_BROWSE = 10001
+};
+
+BEGIN_EVENT_TABLE(ConvolutionReverbDialog, EffectDialog)
+    EVT_BUTTON(ID_BROWSE, ConvolutionReverbDialog::OnBrowse)
+    EVT_BUTTON(ID_EFFECT_PREVIEW, ConvolutionReverbDialog::OnPreview)
+END_EVENT_TABLE()
+
+ConvolutionReverbDialog::ConvolutionReverbDialog(EffectConvolutionReverb * effect,
+                                                 wxWindow * parent)
+:  EffectDialog(parent, _("Convolution Reverb"), PROCESS_EFFECT),
+   mEffect(effect)
+{
+   mFileText = NULL;
+   mBlockSizeIndex = BlockSizeIndex(mEffect->mBlockSize);
+
+   Init();
+}
+
+void ConvolutionReverbDialog::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(3, wxEXPAND);
+   {
+      S.SetStretchyCol(1);
+      mFileText = S.TieTextBox(_("Impulse response:"), mEffect->mFileName, 40);
+      S.Id(ID_BROWSE).AddButton(_("Browse..."));
+   }
+   S.EndMultiColumn();
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      wxArrayString blockSizes;
+      for (int i = 0; i < NUM_BLOCK_SIZES; i++)
+         blockSizes.Add(wxString::Format(wxT("%d"), MIN_BLOCK_SIZE << i));
+      S.TieChoice(_("Latency (samples):"), mBlockSizeIndex, &blockSizes);
+      S.SetSizeHints(-1, -1);
+
+      S.TieNumericTextBox(_("Wet gain (dB):"), mEffect->mWetGain, 10);
+      S.TieNumericTextBox(_("Dry gain (dB):"), mEffect->mDryGain, 10);
+   }
+   S.EndMultiColumn();
+
+   S.StartVerticalLay(false);
+   {
+      S.TieCheckBox(_("Wet only"), mEffect->mWetOnly);
+      S.TieCheckBox(_("Longer partitions for the tail of long responses"),
+                    mEffect->mNonUniform);
+   }
+   S.EndVerticalLay();
+}
+
+bool ConvolutionReverbDialog::TransferDataFromWindow()
+{
+   EffectDialog::TransferDataFromWindow();
+   mEffect->mBlockSize = MIN_BLOCK_SIZE << mBlockSizeIndex;
+   return true;
+}
+
+bool ConvolutionReverbDialog::Validate()
+{
+   if (!wxFileExists(mFileText->GetValue())) {
+      wxMessageBox(_("Please choose an impulse response file."),
+                   mEffect->GetEffectName(),
+                   wxOK | wxICON_ERROR,
+                   this);
+      return false;
+   }
+   return true;
+}
+
+void ConvolutionReverbDialog::OnBrowse(wxCommandEvent & WXUNUSED(event))
+{
+   wxString path = FileSelector(_("Choose an impulse response"),
+                                wxPathOnly(mFileText->GetValue()),
+                                wxFileNameFromPath(mFileText->GetValue()),
+                                wxT(""),
+                                _("WAV files (*.wav)|*.wav;*.WAV|All files|*"),
+                                wxFD_OPEN | wxRESIZE_BORDER,
+                                this);
+   if (!path.IsEmpty())
+      mFileText->SetValue(path);
+}
+
+void ConvolutionReverbDialog::OnPreview(wxCommandEvent & WXUNUSED(event))
+{
+   if (!Validate())
+      return;
+   TransferDataFromWindow();
+   mEffect->Preview();
+}
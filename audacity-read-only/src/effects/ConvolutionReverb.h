@@ -0,0 +1,139 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ConvolutionReverb.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_EFFECT_CONVOLUTION_REVERB__
+#define __AUDACITY_EFFECT_CONVOLUTION_REVERB__
+
+#include <time.h>
+#include <vector>
+
+#include <wx/intl.h>
+#include <wx/string.h>
+
+#include "Effect.h"
+
+class wxTextCtrl;
+class WaveTrack;
+
+class EffectConvolutionReverb : public Effect
+{
+ public:
+   EffectConvolutionReverb();
+   virtual ~EffectConvolutionReverb();
+
+   virtual wxString GetEffectName() {
+      return wxString(_("Convolution Reverb..."));
+   }
+
+   virtual std::set<wxString> GetEffectCategories() {
+      std::set<wxString> result;
+      result.insert(wxT("http://lv2plug.in/ns/lv2core#ReverbPlugin"));
+      return result;
+   }
+
+   virtual wxString GetEffectIdentifier() {
+      return wxString(wxT("ConvolutionReverb"));
+   }
+
+   virtual wxString GetEffectAction() {
+      return wxString(_("Applying Convolution Reverb"));
+   }
+
+   // Useful only after PromptUser values have been set.
+   virtual wxString GetEffectDescription();
+
+   virtual bool Init();
+   virtual bool PromptUser();
+   virtual bool TransferParameters( Shuttle & shuttle );
+
+   virtual bool Process();
+
+ protected:
+   // Each channel of each track is an item
+   virtual bool IsThreadSafe() { return true; }
+   virtual bool ProcessItem(int index);
+
+ private:
+   // The impulse response, one channel after another
+   struct Response {
+      double rate;
+      sampleCount len;
+      float *samples;
+   };
+
+   // A channel to convolve
+   struct Job {
+      WaveTrack *track;
+      int count;
+      sampleCount start;
+      sampleCount end;
+      const float *response;
+      sampleCount responseLen;
+   };
+
+   // ProcessOne()'s stream through a ConvolutionEngine
+   class Convolution;
+   friend class Convolution;
+
+   // Read mFileName, unless it is what was read last; false, with a
+   // message shown, if it can't be
+   bool LoadFile();
+   // The response at rate, resampled if the file's rate is another
+   const Response *GetResponse(double rate);
+   void FreeResponses();
+
+   bool ProcessOne(int count, WaveTrack *track,
+                   sampleCount start, sampleCount end,
+                   const float *response, sampleCount responseLen);
+
+   std::vector<Job> mJobs;
+
+   // Kept from one Process() to the next, so that a chain applying the
+   // same response to many files reads it once
+   wxString mLoadedFileName;
+   time_t mLoadedTime;
+   int mChannels;
+   std::vector<Response> mResponses;
+
+   // Settings
+   wxString mFileName;
+   int mBlockSize;
+   bool mNonUniform;
+   double mWetGain;
+   double mDryGain;
+   bool mWetOnly;
+
+   friend class ConvolutionReverbDialog;
+};
+
+//----------------------------------------------------------------------------
+// ConvolutionReverbDialog
+//----------------------------------------------------------------------------
+
+class ConvolutionReverbDialog : public EffectDialog
+{
+ public:
+   ConvolutionReverbDialog(EffectConvolutionReverb * effect,
+                           wxWindow * parent);
+
+   void PopulateOrExchange(ShuttleGui & S);
+   bool TransferDataFromWindow();
+   bool Validate();
+
+ private:
+   void OnBrowse(wxCommandEvent & event);
+   void OnPreview(wxCommandEvent & event);
+
+   EffectConvolutionReverb *mEffect;
+   wxTextCtrl *mFileText;
+   int mBlockSizeIndex;
+
+   DECLARE_EVENT_TABLE()
+};
+
+#endif
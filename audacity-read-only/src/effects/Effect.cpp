@@ -23,6 +23,9 @@ greater use in future.
 
 #include "../Audacity.h"
 
+#include <string.h>
+#include <vector>
+
 #include <wx/defs.h>
 #include <wx/string.h>
 #include <wx/msgdlg.h>
@@ -37,6 +40,7 @@ greater use in future.
 #include "../Mix.h"
 #include "../Prefs.h"
 #include "../Project.h"
+#include "../ThreadPool.h"
 #include "../WaveTrack.h"
 #include "../widgets/ProgressDialog.h"
 #include "../ondemand/ODManager.h"
@@ -81,6 +85,7 @@ Effect::Effect()
    mNumTracks = 0;
    mNumGroups = 0;
    mProgress = NULL;
+   mParallel = NULL;
 
    // Can change effect flags later (this is the new way)
    // OR using the old way, over-ride GetEffectFlags().
@@ -1243,8 +1248,404 @@ void Effect::End()
 {
 }
 
+//
+// ProcessItems() in parallel
+//
+
+// What the items running in parallel have reported through the Progress
+// methods, for the GUI thread to show, and whether they should stop
+class EffectParallelState {
+ public:
+   EffectParallelState(int numTracks, int numGroups):
+      mFinished(mMutex),
+      mDone(false), mFailed(false), mCancelled(false),
+      mKind(kindNone),
+      mTrackFrac(numTracks, 0.0), mGroupFrac(numGroups, 0.0),
+      mTotalFrac(0.0)
+   {
+   }
+
+   // Record frac of entry which of fracs; returns true to stop
+   bool Report(int kind, std::vector<double> *fracs, int which,
+               double frac, const wxString &msg)
+   {
+      wxMutexLocker locker(mMutex);
+      mKind = kind;
+      if (fracs && which >= 0 && which < (int)fracs->size())
+         (*fracs)[which] = wxMin(wxMax(frac, 0.0), 1.0);
+      else
+         mTotalFrac = frac;
+      // A copy of its own: wxString buffers are shared between copies,
+      // and their counts aren't atomic
+      if (!msg.IsEmpty())
+         mMessage = msg.c_str();
+      return mFailed || mCancelled;
+   }
+
+   enum {
+      kindNone,
+      kindTrack,
+      kindGroup,
+      kindTotal
+   };
+
+   wxMutex mMutex;
+   wxCondition mFinished;
+   bool mDone;
+   bool mFailed;
+   bool mCancelled;
+
+   // Which Progress method the items called last
+   int mKind;
+   std::vector<double> mTrackFrac;
+   std::vector<double> mGroupFrac;
+   double mTotalFrac;
+   wxString mMessage;
+};
+
+class EffectParallelJob : public ParallelJob {
+ public:
+   EffectParallelJob(Effect *effect, EffectParallelState *state):
+      mEffect(effect), mState(state) {}
+
+   virtual void RunItem(int index, int WXUNUSED(slot))
+   {
+      {
+         wxMutexLocker locker(mState->mMutex);
+         if (mState->mFailed || mState->mCancelled)
+            return;
+      }
+
+      if (!mEffect->ProcessItem(index)) {
+         wxMutexLocker locker(mState->mMutex);
+         mState->mFailed = true;
+      }
+   }
+
+ private:
+   Effect *mEffect;
+   EffectParallelState *mState;
+};
+
+// Runs the job on the ThreadPool, so that the GUI thread is free to
+// update the progress dialog
+class EffectParallelThread : public wxThread {
+ public:
+   EffectParallelThread(EffectParallelJob *job, EffectParallelState *state,
+                        int count):
+      wxThread(wxTHREAD_JOINABLE), mJob(job), mState(state), mCount(count) {}
+
+   virtual ExitCode Entry()
+   {
+      ThreadPool::Get().Run(*mJob, mCount);
+
+      wxMutexLocker locker(mState->mMutex);
+      mState->mDone = true;
+      mState->mFinished.Signal();
+      return 0;
+   }
+
+ private:
+   EffectParallelJob *mJob;
+   EffectParallelState *mState;
+   int mCount;
+};
+
+bool Effect::ProcessItems(int count)
+{
+   EffectParallelState state(mNumTracks, mNumGroups);
+   EffectParallelJob job(this, &state);
+   EffectParallelThread thread(&job, &state, count);
+
+   if (count < 2 || !IsThreadSafe() ||
+       ThreadPool::Get().GetMaxThreads() < 2 ||
+       thread.Create() != wxTHREAD_NO_ERROR) {
+      for (int i = 0; i < count; i++)
+         if (!ProcessItem(i))
+            return false;
+      return true;
+   }
+
+   mParallel = &state;
+   thread.Run();
+
+   state.mMutex.Lock();
+   while (!state.mDone) {
+      state.mFinished.WaitTimeout(100);
+      if (state.mDone || !mProgress)
+         continue;
+
+      int kind = state.mKind;
+      double current = 0.0;
+      double total = 1.0;
+      wxString msg = state.mMessage.c_str();
+      if (kind == EffectParallelState::kindTrack) {
+         for (size_t i = 0; i < state.mTrackFrac.size(); i++)
+            current += state.mTrackFrac[i];
+         total = (double)mNumTracks;
+      }
+      else if (kind == EffectParallelState::kindGroup) {
+         for (size_t i = 0; i < state.mGroupFrac.size(); i++)
+            current += state.mGroupFrac[i];
+         total = (double)mNumGroups;
+      }
+      else
+         current = state.mTotalFrac;
+
+      // Not while holding the lock: the dialog yields to the event loop
+      state.mMutex.Unlock();
+      int updateResult = eProgressSuccess;
+      if (kind == EffectParallelState::kindTotal)
+         updateResult = mProgress->Update(current);
+      else if (kind != EffectParallelState::kindNone)
+         updateResult = mProgress->Update(current, total, msg);
+      state.mMutex.Lock();
+
+      if (updateResult != eProgressSuccess)
+         state.mCancelled = true;
+   }
+   bool bGoodResult = !state.mFailed && !state.mCancelled;
+   state.mMutex.Unlock();
+
+   thread.Wait();
+   mParallel = NULL;
+
+   return bGoodResult;
+}
+
+//
+// ProcessSegments()
+//
+
+// Computes one round of segments, one per item, and counts the samples
+// done so far for the progress dialog
+class EffectSegmentJob : public ParallelJob {
+ public:
+   EffectSegmentJob(EffectSegmentWork *work, sampleCount start,
+                    sampleCount len, sampleCount segmentLen,
+                    sampleCount warmUp, float **buffers, bool *results):
+      mFinished(mMutex),
+      mRoundDone(false), mCancelled(false), mDoneLen(0),
+      mWork(work), mStart(start), mLen(len), mSegmentLen(segmentLen),
+      mWarmUp(warmUp), mBuffers(buffers), mResults(results), mFirst(start)
+   {
+   }
+
+   // Start of the round's first segment
+   void StartRound(sampleCount first)
+   {
+      wxMutexLocker locker(mMutex);
+      mFirst = first;
+      mRoundDone = false;
+      mDoneLen = 0;
+   }
+
+   virtual void RunItem(int index, int WXUNUSED(slot))
+   {
+      sampleCount segStart = mFirst + index * mSegmentLen;
+      sampleCount segLen = wxMin(mSegmentLen, mStart + mLen - segStart);
+      sampleCount readStart = wxMax(mStart, segStart - mWarmUp);
+
+      {
+         wxMutexLocker locker(mMutex);
+         if (mCancelled) {
+            mResults[index] = false;
+            return;
+         }
+      }
+
+      mResults[index] = mWork->ProcessSegment(readStart, segStart, segLen,
+                                              mBuffers[index]);
+
+      wxMutexLocker locker(mMutex);
+      mDoneLen += segLen;
+   }
+
+   wxMutex mMutex;
+   wxCondition mFinished;
+   bool mRoundDone;
+   bool mCancelled;
+   // Samples of the round's segments computed
+   sampleCount mDoneLen;
+
+ private:
+   EffectSegmentWork *mWork;
+   sampleCount mStart;
+   sampleCount mLen;
+   sampleCount mSegmentLen;
+   sampleCount mWarmUp;
+   float **mBuffers;
+   bool *mResults;
+   sampleCount mFirst;
+};
+
+// Runs a round of segments on the ThreadPool, so that the GUI thread is
+// free to update the progress dialog
+class EffectSegmentThread : public wxThread {
+ public:
+   EffectSegmentThread(EffectSegmentJob *job, int count, int threads):
+      wxThread(wxTHREAD_JOINABLE), mJob(job), mCount(count),
+      mThreads(threads) {}
+
+   virtual ExitCode Entry()
+   {
+      ThreadPool::Get().Run(*mJob, mCount, mThreads);
+
+      wxMutexLocker locker(mJob->mMutex);
+      mJob->mRoundDone = true;
+      mJob->mFinished.Signal();
+      return 0;
+   }
+
+ private:
+   EffectSegmentJob *mJob;
+   int mCount;
+   int mThreads;
+};
+
+bool Effect::CanProcessSegments(sampleCount len, sampleCount segmentLen)
+{
+   ThreadPool &pool = ThreadPool::Get();
+
+   return !mParallel && len > segmentLen &&
+      pool.GetMaxThreads() > 1 && !pool.IsPoolThread();
+}
+
+bool Effect::ProcessSegments(EffectSegmentWork &work,
+                             sampleCount start, sampleCount len,
+                             sampleCount segmentLen, sampleCount warmUp)
+{
+   ThreadPool &pool = ThreadPool::Get();
+   int threads =
+      CanProcessSegments(len, segmentLen) ? pool.GetMaxThreads() : 1;
+
+   // Memory for one round of segments
+   float **buffers = new float *[threads];
+   for (int i = 0; i < threads; i++)
+      buffers[i] = new float[segmentLen];
+   bool *results = new bool[threads];
+
+   EffectSegmentJob job(&work, start, len, segmentLen, warmUp,
+                        buffers, results);
+
+   bool bGoodResult = true;
+   sampleCount first = start;
+   while (bGoodResult && first < start + len) {
+      int count = 0;
+      sampleCount next = first;
+      while (count < threads && next < start + len) {
+         count++;
+         next += segmentLen;
+      }
+
+      job.StartRound(first);
+      EffectSegmentThread thread(&job, count, threads);
+      if (threads < 2 || thread.Create() != wxTHREAD_NO_ERROR)
+         pool.Run(job, count, threads);
+      else {
+         thread.Run();
+
+         job.mMutex.Lock();
+         while (!job.mRoundDone) {
+            job.mFinished.WaitTimeout(100);
+            if (job.mRoundDone)
+               break;
+
+            double frac = (first - start + job.mDoneLen) / (double)len;
+
+            // Not while holding the lock: the dialog yields to the event
+            // loop
+            job.mMutex.Unlock();
+            bool cancelled = work.Progress(frac);
+            job.mMutex.Lock();
+
+            // Segments already started run to their end
+            if (cancelled)
+               job.mCancelled = true;
+         }
+         if (job.mCancelled)
+            bGoodResult = false;
+         job.mMutex.Unlock();
+
+         thread.Wait();
+      }
+
+      for (int i = 0; bGoodResult && i < count; i++) {
+         sampleCount segStart = first + i * segmentLen;
+         sampleCount segLen = wxMin(segmentLen, start + len - segStart);
+         bGoodResult = results[i] &&
+            work.WriteSegment(segStart, segLen, buffers[i]);
+      }
+
+      first = next;
+   }
+
+   for (int i = 0; i < threads; i++)
+      delete[] buffers[i];
+   delete[] buffers;
+   delete[] results;
+
+   return bGoodResult;
+}
+
+bool Effect::ProcessLatent(EffectLatentWork &work, WaveTrack *track,
+                           sampleCount start, sampleCount end,
+                           sampleCount latency)
+{
+   sampleCount maxblock = track->GetMaxBlockSize();
+   float *buffer = new float[maxblock];
+
+   double len = (double)(end - start);
+   sampleCount s = start;        // next sample to read
+   sampleCount w = start;        // next sample to write
+   sampleCount skip = latency;   // output still to drop
+   bool bGoodResult = true;
+
+   while (w < end) {
+      sampleCount block;
+      if (s < end) {
+         block = track->GetBestBlockSize(s);
+         if (block > maxblock)
+            block = maxblock;
+         if (s + block > end)
+            block = end - s;
+         track->Get((samplePtr) buffer, floatSample, s, block);
+      }
+      else {
+         block = end - w;
+         if (block > maxblock)
+            block = maxblock;
+         memset(buffer, 0, block * sizeof(float));
+      }
+
+      work.ProcessBlock(buffer, block, s == start);
+      s += block;
+
+      // Writing behind what has been read
+      sampleCount drop = skip < block ? skip : block;
+      skip -= drop;
+      if (block > drop) {
+         track->Set((samplePtr) (buffer + drop), floatSample, w, block - drop);
+         w += block - drop;
+      }
+
+      if (work.Progress((w - start) / len)) {
+         bGoodResult = false;
+         break;
+      }
+   }
+
+   delete[] buffer;
+
+   return bGoodResult;
+}
+
 bool Effect::TotalProgress(double frac)
 {
+   if (mParallel)
+      return mParallel->Report(EffectParallelState::kindTotal,
+                               NULL, 0, frac, wxEmptyString);
+
    int updateResult = (mProgress ?
       mProgress->Update(frac) :
       eProgressSuccess);
@@ -1253,6 +1654,10 @@ bool Effect::TotalProgress(double frac)
 
 bool Effect::TrackProgress(int whichTrack, double frac, wxString msg)
 {
+   if (mParallel)
+      return mParallel->Report(EffectParallelState::kindTrack,
+                               &mParallel->mTrackFrac, whichTrack, frac, msg);
+
    int updateResult = (mProgress ?
       mProgress->Update(whichTrack + frac, (double) mNumTracks, msg) :
       eProgressSuccess);
@@ -1261,6 +1666,11 @@ bool Effect::TrackProgress(int whichTrack, double frac, wxString msg)
 
 bool Effect::TrackGroupProgress(int whichGroup, double frac)
 {
+   if (mParallel)
+      return mParallel->Report(EffectParallelState::kindGroup,
+                               &mParallel->mGroupFrac, whichGroup, frac,
+                               wxEmptyString);
+
    int updateResult = (mProgress ?
       mProgress->Update(whichGroup + frac, (double) mNumGroups) :
       eProgressSuccess);
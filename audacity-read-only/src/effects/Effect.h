@@ -33,6 +33,7 @@ class wxWindow;
 
 class SelectedRegion;
 class TimeWarper;
+class EffectParallelState;
 
 #define PLUGIN_EFFECT   0x0001
 #define BUILTIN_EFFECT  0x0002
@@ -62,6 +63,46 @@ class TimeWarper;
 //and so can just drop the steps we don't want?
 #define SKIP_EFFECT_MILLISECOND 99999
 
+// Work on a run of samples that Effect::ProcessSegments() splits into
+// segments
+class AUDACITY_DLL_API EffectSegmentWork
+{
+ public:
+   virtual ~EffectSegmentWork() {}
+
+   // Compute the len output samples from start into out, reading the
+   // input from readStart on.  Runs for several segments at once, in any
+   // order, so it may only read the track.
+   virtual bool ProcessSegment(sampleCount readStart, sampleCount start,
+                               sampleCount len, float *out) = 0;
+
+   // Write the output of a segment; called for each in turn, on the
+   // thread that called ProcessSegments()
+   virtual bool WriteSegment(sampleCount start, sampleCount len,
+                             float *out) = 0;
+
+   // Report the fraction of the run computed while segments are being
+   // computed, on the thread that called ProcessSegments(); returns true
+   // if the user has cancelled, as the Progress methods of Effect do
+   virtual bool Progress(double frac) = 0;
+};
+
+// A stream whose output lags its input, that Effect::ProcessLatent()
+// runs over a track
+class AUDACITY_DLL_API EffectLatentWork
+{
+ public:
+   virtual ~EffectLatentWork() {}
+
+   // Process len samples of the stream in buffer, in place.  first is
+   // true for the first block read from the track.
+   virtual void ProcessBlock(float *buffer, sampleCount len, bool first) = 0;
+
+   // Report the fraction of the output written; returns true if the
+   // user has cancelled, as the Progress methods of Effect do
+   virtual bool Progress(double frac) = 0;
+};
+
 class AUDACITY_DLL_API Effect : public EffectHostInterface
 {
  //
@@ -309,6 +350,15 @@ class AUDACITY_DLL_API Effect : public EffectHostInterface
    // clean up any temporary memory
    virtual void End();
 
+   // Return true if ProcessItem() may run for several items at once,
+   // off the GUI thread.  Such items must not touch the UI or gPrefs
+   // themselves; they may call the Progress methods below.
+   virtual bool IsThreadSafe() { return false; }
+
+   // Do one item of ProcessItems(); return false if it failed or the
+   // user cancelled
+   virtual bool ProcessItem(int WXUNUSED(index)) { return false; }
+
  //
  // protected data
  //
@@ -360,6 +410,40 @@ class AUDACITY_DLL_API Effect : public EffectHostInterface
 
    int GetNumWaveGroups() { return mNumGroups; }
 
+   // Call ProcessItem() for items [0, count), usually one per track or
+   // stereo pair.  If IsThreadSafe(), the items run on the ThreadPool
+   // while this thread keeps the progress dialog up to date; otherwise
+   // one after another.  Returns false once any item fails or the user
+   // cancels, without starting the items not yet started.
+   bool ProcessItems(int count);
+
+   // Whether ProcessSegments() would compute several segments of len
+   // samples at once: not if ProcessItems() already runs items in
+   // parallel, nor if len is a single segment
+   bool CanProcessSegments(sampleCount len, sampleCount segmentLen);
+
+   // Run work over samples [start, start + len) in segments of
+   // segmentLen, the last maybe shorter, as many at a time as the
+   // ThreadPool has threads.  Each segment reads warmUp samples before
+   // its start (but none before start), enough for the effect's state
+   // or window to be what it would be in a serial run, and outputs from
+   // its start only; the outputs are written in order.  While a round
+   // of segments is computed this thread keeps the progress dialog up
+   // to date through work.Progress().  Returns false as soon as a
+   // segment fails or isn't written, or the user cancels.
+   bool ProcessSegments(EffectSegmentWork &work,
+                        sampleCount start, sampleCount len,
+                        sampleCount segmentLen, sampleCount warmUp);
+
+   // Run work over samples [start, end) of track, a block at a time,
+   // and write its output back over them.  The output lags the input by
+   // latency samples: the first latency samples out are from before
+   // start, and are dropped, and the last ones are got by feeding work
+   // silence after end.  Returns false if the user cancels.
+   bool ProcessLatent(EffectLatentWork &work, WaveTrack *track,
+                      sampleCount start, sampleCount end,
+                      sampleCount latency);
+
    // Calculates the start time and selection length in samples
    void GetSamples(WaveTrack *track, sampleCount *start, sampleCount *len);
 
@@ -439,8 +523,13 @@ class AUDACITY_DLL_API Effect : public EffectHostInterface
    int mCurrentGroup;
    int mHighGroup;
 
+   // Set while ProcessItems() runs items in parallel
+   EffectParallelState *mParallel;
+
+   friend class EffectParallelJob;
    friend class EffectManager;// so it can call PromptUser in support of batch commands.
    friend class EffectRack;
+   friend class EffectSegmentsTest;
 };
 
 // Base dialog for generate effect
@@ -240,7 +240,7 @@ void EffectEqualization::ReadPrefs()
 
 EffectEqualization::EffectEqualization()
 {
-   hFFT = InitializeFFT(windowSize);
+   hFFT = GetFFT(windowSize);
    mFFTBuffer = new float[windowSize];
    mFilterFuncR = new float[windowSize];
    mFilterFuncI = new float[windowSize];
@@ -263,7 +263,7 @@ EffectEqualization::EffectEqualization()
 EffectEqualization::~EffectEqualization()
 {
    if(hFFT)
-      EndFFT(hFFT);
+      ReleaseFFT(hFFT);
    hFFT = NULL;
    if(mFFTBuffer)
       delete[] mFFTBuffer;
@@ -447,12 +447,82 @@ bool EffectEqualization::Process()
 }
 
 
+// Segments of whole lumps: the output of a lump depends only on it and
+// the lump before, so each segment filters one lump before its start too,
+// and comes out as it would in one pass.
+class EffectEqualization::Segments : public EffectSegmentWork
+{
+public:
+   Segments(EffectEqualization *effect, int count, WaveTrack *track,
+            WaveTrack *output, sampleCount start, sampleCount len,
+            float *tail)
+      : mEffect(effect), mCount(count), mTrack(track), mOutput(output)
+      , mStart(start), mLen(len), mTail(tail)
+   {
+   }
+
+   virtual bool ProcessSegment(sampleCount readStart,
+                               sampleCount start, sampleCount len, float *out)
+   {
+      const int windowSize = mEffect->windowSize;
+      float *window1 = new float[windowSize];
+      float *window2 = new float[windowSize];
+      float *scratch = new float[windowSize];
+      float *thisWindow = window1;
+      float *lastWindow = window2;
+      int wcopy = 0;
+
+      for (int i = 0; i < windowSize; i++)
+         lastWindow[i] = 0;
+
+      // Just for lastWindow
+      if (readStart < start) {
+         mTrack->Get((samplePtr)out, floatSample, readStart, start - readStart);
+         mEffect->FilterLumps(out, start - readStart,
+                              thisWindow, lastWindow, wcopy, scratch);
+      }
+
+      mTrack->Get((samplePtr)out, floatSample, start, len);
+      mEffect->FilterLumps(out, len, thisWindow, lastWindow, wcopy, scratch);
+
+      if (start + len == mStart + mLen)
+         mEffect->GetTail(mTail, thisWindow, lastWindow, wcopy);
+
+      delete[] window1;
+      delete[] window2;
+      delete[] scratch;
+
+      return true;
+   }
+
+   virtual bool WriteSegment(sampleCount start, sampleCount len, float *out)
+   {
+      mOutput->Append((samplePtr)out, floatSample, len);
+
+      return !mEffect->TrackProgress(mCount,
+                                     (start + len - mStart) / (double)mLen);
+   }
+
+   virtual bool Progress(double frac)
+   {
+      return mEffect->TrackProgress(mCount, frac);
+   }
+
+private:
+   EffectEqualization *mEffect;
+   int mCount;
+   WaveTrack *mTrack;
+   WaveTrack *mOutput;
+   sampleCount mStart;
+   sampleCount mLen;
+   float *mTail;
+};
+
 bool EffectEqualization::ProcessOne(int count, WaveTrack * t,
                                     sampleCount start, sampleCount len)
 {
    // create a new WaveTrack to hold all of the output, including 'tails' each end
-   AudacityProject *p = GetActiveProject();
-   WaveTrack *output = p->GetTrackFactory()->NewWaveTrack(floatSample, t->GetRate());
+   WaveTrack *output = mFactory->NewWaveTrack(floatSample, t->GetRate());
 
    int L = windowSize - (mM - 1);   //Process L samples at a go
    sampleCount s = start;
@@ -462,80 +532,62 @@ bool EffectEqualization::ProcessOne(int count, WaveTrack * t,
 
    float *buffer = new float[idealBlockLen];
 
-   float *window1 = new float[windowSize];
-   float *window2 = new float[windowSize];
-   float *thisWindow = window1;
-   float *lastWindow = window2;
-
    sampleCount originalLen = len;
 
-   int i,j;
-   for(i=0; i<windowSize; i++)
-      lastWindow[i] = 0;
-
    TrackProgress(count, 0.);
    bool bLoopSuccess = true;
-   int wcopy = 0;
    int offset = (mM - 1)/2;
 
-   while(len)
+   const sampleCount segmentLen = ((1 << 20) / L) * L;
+   if (CanProcessSegments(len, segmentLen))
+   {
+      // The last segment leaves the tail in buffer
+      Segments segments(this, count, t, output, start, len, buffer);
+      bLoopSuccess = ProcessSegments(segments, start, len, segmentLen, L);
+   }
+   else
    {
-      sampleCount block = idealBlockLen;
-      if (block > len)
-         block = len;
+      float *window1 = new float[windowSize];
+      float *window2 = new float[windowSize];
+      float *thisWindow = window1;
+      float *lastWindow = window2;
 
-      t->Get((samplePtr)buffer, floatSample, s, block);
+      int i;
+      for(i=0; i<windowSize; i++)
+         lastWindow[i] = 0;
 
-      for(i=0; i<block; i+=L)   //go through block in lumps of length L
-      {
-         wcopy = L;
-         if (i + wcopy > block)   //if last lump would exceed block
-            wcopy = block - i;   //shorten it
-         for(j=0; j<wcopy; j++)
-            thisWindow[j] = buffer[i+j];   //copy the L (or remaining) samples
-         for(j=wcopy; j<windowSize; j++)
-            thisWindow[j] = 0;   //this includes the padding
-
-         Filter(windowSize, thisWindow);
-
-         // Overlap - Add
-         for(j=0; (j<mM-1) && (j<wcopy); j++)
-            buffer[i+j] = thisWindow[j] + lastWindow[L + j];
-         for(j=mM-1; j<wcopy; j++)
-            buffer[i+j] = thisWindow[j];
-
-         float *tempP = thisWindow;
-         thisWindow = lastWindow;
-         lastWindow = tempP;
-      }  //next i, lump of this block
-
-      output->Append((samplePtr)buffer, floatSample, block);
-      len -= block;
-      s += block;
-
-      if (TrackProgress(count, (s-start)/(double)originalLen))
+      int wcopy = 0;
+
+      while(len)
       {
-         bLoopSuccess = false;
-         break;
+         sampleCount block = idealBlockLen;
+         if (block > len)
+            block = len;
+
+         t->Get((samplePtr)buffer, floatSample, s, block);
+
+         FilterLumps(buffer, block, thisWindow, lastWindow, wcopy, mFFTBuffer);
+
+         output->Append((samplePtr)buffer, floatSample, block);
+         len -= block;
+         s += block;
+
+         if (TrackProgress(count, (s-start)/(double)originalLen))
+         {
+            bLoopSuccess = false;
+            break;
+         }
       }
+
+      if(bLoopSuccess)
+         GetTail(buffer, thisWindow, lastWindow, wcopy);
+
+      delete[] window1;
+      delete[] window2;
    }
 
    if(bLoopSuccess)
    {
-      // mM-1 samples of 'tail' left in lastWindow, get them now
-      if(wcopy < (mM-1)) {
-         // Still have some overlap left to process
-         // (note that lastWindow and thisWindow have been exchanged at this point
-         //  so that 'thisWindow' is really the window prior to 'lastWindow')
-         for(j=0; j<mM-1-wcopy; j++)
-            buffer[j] = lastWindow[wcopy + j] + thisWindow[L + wcopy + j];
-         // And fill in the remainder after the overlap
-         for( ; j<mM-1; j++)
-            buffer[j] = lastWindow[wcopy + j];
-      } else {
-         for(j=0; j<mM-1; j++)
-            buffer[j] = lastWindow[wcopy + j];
-      }
       output->Append((samplePtr)buffer, floatSample, mM-1);
       output->Flush();
 
@@ -606,15 +658,72 @@ bool EffectEqualization::ProcessOne(int count, WaveTrack * t,
    }
 
    delete[] buffer;
-   delete[] window1;
-   delete[] window2;
    delete output;
 
    return bLoopSuccess;
 }
 
+void EffectEqualization::FilterLumps(float *buffer, sampleCount block,
+                                     float *&thisWindow, float *&lastWindow,
+                                     int &wcopy, float *scratch)
+{
+   int L = windowSize - (mM - 1);
+   int i,j;
+
+   for(i=0; i<block; i+=L)   //go through block in lumps of length L
+   {
+      wcopy = L;
+      if (i + wcopy > block)   //if last lump would exceed block
+         wcopy = block - i;   //shorten it
+      for(j=0; j<wcopy; j++)
+         thisWindow[j] = buffer[i+j];   //copy the L (or remaining) samples
+      for(j=wcopy; j<windowSize; j++)
+         thisWindow[j] = 0;   //this includes the padding
+
+      Filter(windowSize, thisWindow, scratch);
+
+      // Overlap - Add
+      for(j=0; (j<mM-1) && (j<wcopy); j++)
+         buffer[i+j] = thisWindow[j] + lastWindow[L + j];
+      for(j=mM-1; j<wcopy; j++)
+         buffer[i+j] = thisWindow[j];
+
+      float *tempP = thisWindow;
+      thisWindow = lastWindow;
+      lastWindow = tempP;
+   }  //next i, lump of this block
+}
+
+void EffectEqualization::GetTail(float *buffer, const float *thisWindow,
+                                 const float *lastWindow, int wcopy)
+{
+   int L = windowSize - (mM - 1);
+   int j;
+
+   // mM-1 samples of 'tail' left in lastWindow, get them now
+   if(wcopy < (mM-1)) {
+      // Still have some overlap left to process
+      // (note that lastWindow and thisWindow have been exchanged at this point
+      //  so that 'thisWindow' is really the window prior to 'lastWindow')
+      for(j=0; j<mM-1-wcopy; j++)
+         buffer[j] = lastWindow[wcopy + j] + thisWindow[L + wcopy + j];
+      // And fill in the remainder after the overlap
+      for( ; j<mM-1; j++)
+         buffer[j] = lastWindow[wcopy + j];
+   } else {
+      for(j=0; j<mM-1; j++)
+         buffer[j] = lastWindow[wcopy + j];
+   }
+}
+
 void EffectEqualization::Filter(sampleCount len,
                                 float *buffer)
+{
+   Filter(len, buffer, mFFTBuffer);
+}
+
+void EffectEqualization::Filter(sampleCount len,
+                                float *buffer, float *scratch)
 {
    int i;
    float re,im;
@@ -624,20 +733,20 @@ void EffectEqualization::Filter(sampleCount len,
 
    // Apply filter
    // DC component is purely real
-   mFFTBuffer[0] = buffer[0] * mFilterFuncR[0];
+   scratch[0] = buffer[0] * mFilterFuncR[0];
    for(i=1; i<(len/2); i++)
    {
       re=buffer[hFFT->BitReversed[i]  ];
       im=buffer[hFFT->BitReversed[i]+1];
-      mFFTBuffer[2*i  ] = re*mFilterFuncR[i] - im*mFilterFuncI[i];
-      mFFTBuffer[2*i+1] = re*mFilterFuncI[i] + im*mFilterFuncR[i];
+      scratch[2*i  ] = re*mFilterFuncR[i] - im*mFilterFuncI[i];
+      scratch[2*i+1] = re*mFilterFuncI[i] + im*mFilterFuncR[i];
    }
    // Fs/2 component is purely real
-   mFFTBuffer[1] = buffer[1] * mFilterFuncR[len/2];
+   scratch[1] = buffer[1] * mFilterFuncR[len/2];
 
    // Inverse FFT and normalization
-   InverseRealFFTf(mFFTBuffer, hFFT);
-   ReorderToTime(hFFT, mFFTBuffer, buffer);
+   InverseRealFFTf(scratch, hFFT);
+   ReorderToTime(hFFT, scratch, buffer);
 }
 
 
@@ -120,11 +120,27 @@ public:
 
 
 private:
+   // Whole lumps of a long track, several segments at a time
+   class Segments;
+   friend class Segments;
+
    bool ProcessOne(int count, WaveTrack * t,
                    sampleCount start, sampleCount len);
+   // Filter block samples of buffer in place, a lump at a time, each
+   // overlap-added to the one before; wcopy is the length of the last
+   void FilterLumps(float *buffer, sampleCount block,
+                    float *&thisWindow, float *&lastWindow, int &wcopy,
+                    float *scratch);
+   // The mM - 1 samples of tail after the last lump
+   void GetTail(float *buffer, const float *thisWindow,
+                const float *lastWindow, int wcopy);
 
    void Filter(sampleCount len,
                float *buffer);
+   // As above, using scratch rather than mFFTBuffer, so that several
+   // can run at once
+   void Filter(sampleCount len,
+               float *buffer, float *scratch);
 
    void ReadPrefs();
 
@@ -152,6 +168,7 @@ public:
 
 friend class EqualizationDialog;
 friend class EqualizationPanel;
+friend class EffectSegmentsTest;
 };
 
 
@@ -134,13 +134,12 @@ bool EffectFindClipping::ProcessOne(LabelTrack * l,
 {
    bool bGoodResult = true;
    sampleCount s = 0;
-   sampleCount blockSize = (sampleCount) (mStart * 1000);
 
    if (len < mStart) {
       return true;
    }
 
-   float *buffer = new float[blockSize];
+   float *buffer = new float[t->GetMaxBlockSize()];
 
    float *ptr = buffer;
 
@@ -157,7 +156,21 @@ bool EffectFindClipping::ProcessOne(LabelTrack * l,
             break;
          }
 
-         block = s + blockSize > len ? len - s : blockSize;
+         block = t->GetBestBlockSize(start + s);
+         if (s + block > len)
+            block = len - s;
+
+         // Short of a run to label, a block without clipping would only
+         // end the run, so its SampleStats say all that it would
+         if (startrun < mStart) {
+            SampleStats stats;
+            if (t->GetStats(&stats, start + s, block) && stats.clipped == 0) {
+               startrun = 0;
+               s += block;
+               block = 0;
+               continue;
+            }
+         }
 
          t->Get((samplePtr)buffer, floatSample, start + s, block);
          ptr = buffer;
@@ -22,6 +22,7 @@
 #include "ChangeSpeed.h"
 #include "ClickRemoval.h"
 #include "Compressor.h"
+#include "ConvolutionReverb.h"
 #include "DtmfGen.h"
 #include "Echo.h"
 #include "Paulstretch.h"
@@ -241,6 +242,7 @@ void LoadEffects()
    #endif
    em.RegisterEffect(new EffectClickRemoval());
    em.RegisterEffect(new EffectCompressor());
+   em.RegisterEffect(new EffectConvolutionReverb());
    em.RegisterEffect(new EffectEcho());
    em.RegisterEffect(new EffectPaulstretch());
    em.RegisterEffect(new EffectEqualization());
@@ -242,13 +242,21 @@ public:
                 Statistics &statistics, TrackFactory &factory,
                 SelectedTrackListOfKindIterator &iter, double mT0, double mT1);
 
-private:
    bool ProcessOne(EffectNoiseReduction &effect,
-                   Statistics &statistics,
-                   TrackFactory &factory,
-                   int count, WaveTrack *track,
-                   sampleCount start, sampleCount len);
+                   Statistics &statistics, const Job &job);
+
+   // Reduce noise in len samples of track from start into out, as if
+   // the track began at readStart and ended at end
+   bool ReduceSegment(Statistics &statistics, WaveTrack *track,
+                      sampleCount end, sampleCount readStart,
+                      sampleCount start, sampleCount len, float *out);
+
+   // Samples before a segment for ReduceSegment() to read, so that its
+   // output is as if it had started at the beginning of the track: for
+   // the history to fill, the release to decay, and the windows to overlap
+   sampleCount SegmentWarmUp() const;
 
+private:
    void StartNewTrack();
    void ProcessSamples(Statistics &statistics,
       WaveTrack *outputTrack, sampleCount len, float *buffer);
@@ -257,6 +265,8 @@ private:
    void GatherStatistics(Statistics &statistics);
    inline bool Classify(const Statistics &statistics, int band);
    void ReduceNoise(const Statistics &statistics, WaveTrack *outputTrack);
+   // Append to outputTrack, or to the segment ReduceSegment() fills
+   void Output(WaveTrack *outputTrack, float *buffer, int len);
    void RotateHistoryWindows();
    void FinishTrackStatistics(Statistics &statistics);
    void FinishTrack(Statistics &statistics, WaveTrack *outputTrack);
@@ -303,6 +313,13 @@ private:
    int       mNWindowsToExamine;
    int       mCenter;
    int       mHistoryLen;
+   int       mReleaseBlocks;
+
+   // The segment ReduceSegment() fills, or NULL
+   float       *mOut;
+   sampleCount mOutSkip;
+   sampleCount mOutLen;
+   sampleCount mOutCount;
 
    struct Record
    {
@@ -631,9 +648,26 @@ bool EffectNoiseReduction::Process()
    return bGoodResult;
 }
 
+bool EffectNoiseReduction::IsThreadSafe()
+{
+   return !mSettings->mDoProfile;
+}
+
+bool EffectNoiseReduction::ProcessItem(int index)
+{
+   // A Worker of its own for each track; ProcessOne() starts each track
+   // from the same state anyway
+   Worker worker(*mSettings, mStatistics->mRate
+#ifdef EXPERIMENTAL_SPECTRAL_EDITING
+                 , mF0, mF1
+#endif
+      );
+   return worker.ProcessOne(*this, *mStatistics, mJobs[index]);
+}
+
 EffectNoiseReduction::Worker::~Worker()
 {
-   EndFFT(hFFT);
+   ReleaseFFT(hFFT);
    for(int ii = 0, nn = mQueue.size(); ii < nn; ++ii)
       delete mQueue[ii];
 }
@@ -642,6 +676,9 @@ bool EffectNoiseReduction::Worker::Process
 (EffectNoiseReduction &effect, Statistics &statistics, TrackFactory &factory,
  SelectedTrackListOfKindIterator &iter, double mT0, double mT1)
 {
+   std::vector<Job> &jobs = effect.mJobs;
+   jobs.clear();
+
    int count = 0;
    WaveTrack *track = (WaveTrack *) iter.First();
    while (track) {
@@ -661,16 +698,56 @@ bool EffectNoiseReduction::Worker::Process
       if (t1 > t0) {
          sampleCount start = track->TimeToLongSamples(t0);
          sampleCount end = track->TimeToLongSamples(t1);
-         sampleCount len = (sampleCount)(end - start);
 
-         if (!ProcessOne(effect, statistics, factory,
-                         count, track, start, len))
-            return false;
+         Job job;
+         job.track = track;
+         job.outputTrack = NULL;
+         job.count = count;
+         job.start = start;
+         job.len = (sampleCount)(end - start);
+         jobs.push_back(job);
       }
       track = (WaveTrack *) iter.Next();
       ++count;
    }
 
+   bool bGoodResult = true;
+   if (mDoProfile) {
+      for (size_t ii = 0; bGoodResult && ii < jobs.size(); ++ii)
+         bGoodResult = ProcessOne(effect, statistics, jobs[ii]);
+   }
+   else {
+      // Made here rather than by the items, as making a WaveTrack reads
+      // preferences
+      for (size_t ii = 0; ii < jobs.size(); ++ii)
+         jobs[ii].outputTrack = factory.NewWaveTrack
+            (jobs[ii].track->GetSampleFormat(), jobs[ii].track->GetRate());
+
+      bGoodResult = effect.ProcessItems((int)jobs.size());
+
+      for (size_t ii = 0; ii < jobs.size(); ++ii) {
+         const Job &job = jobs[ii];
+         WaveTrack *outputTrack = job.outputTrack;
+
+         if (bGoodResult) {
+            // Take the output track and insert it in place of the original
+            // sample data (as operated on -- this may not match mT0/mT1)
+            double t0 = outputTrack->LongSamplesToTime(job.start);
+            double tLen = outputTrack->LongSamplesToTime(job.len);
+            // Filtering effects always end up with more data than they started with.  Delete this 'tail'.
+            outputTrack->HandleClear(tLen, outputTrack->GetEndTime(), false, false);
+            bool bResult = job.track->ClearAndPaste(t0, t0 + tLen, outputTrack, true, false);
+            wxASSERT(bResult); // TO DO: Actually handle this.
+         }
+
+         delete outputTrack;
+      }
+   }
+   jobs.clear();
+
+   if (!bGoodResult)
+      return false;
+
    if (mDoProfile) {
       if (statistics.mTotalWindows == 0) {
          ::wxMessageBox(_("Selected noise profile is too short."));
@@ -722,7 +799,7 @@ EffectNoiseReduction::Worker::Worker
 , mSampleRate(sampleRate)
 
 , mWindowSize(settings.WindowSize())
-, hFFT(InitializeFFT(mWindowSize))
+, hFFT(GetFFT(mWindowSize))
 , mFFTBuffer(mWindowSize)
 , mInWaveBuffer(mWindowSize)
 , mOutOverlapBuffer(mWindowSize)
@@ -746,6 +823,11 @@ EffectNoiseReduction::Worker::Worker
 , mInSampleCount(0)
 , mOutStepCount(0)
 , mInWavePos(0)
+
+, mOut(NULL)
+, mOutSkip(0)
+, mOutLen(0)
+, mOutCount(0)
 {
 #ifdef EXPERIMENTAL_SPECTRAL_EDITING
    {
@@ -760,6 +842,7 @@ EffectNoiseReduction::Worker::Worker
    const double noiseGain = -settings.mNoiseGain;
    const int nAttackBlocks = 1 + (int)(settings.mAttackTime * sampleRate / mStepSize);
    const int nReleaseBlocks = 1 + (int)(settings.mReleaseTime * sampleRate / mStepSize);
+   mReleaseBlocks = nReleaseBlocks;
    // Applies to amplitudes, divide by 20:
    mNoiseAttenFactor = pow(10.0, noiseGain / 20.0);
    // Apply to gain factors which apply to amplitudes, divide by 20:
@@ -1247,7 +1330,7 @@ void EffectNoiseReduction::Worker::ReduceNoise
       float *buffer = &mOutOverlapBuffer[0];
       if (mOutStepCount >= 0) {
          // Output the first portion of the overlap buffer, they're done
-         outputTrack->Append((samplePtr)buffer, floatSample, mStepSize);
+         Output(outputTrack, buffer, mStepSize);
       }
 
       // Shift the remainder over.
@@ -1256,18 +1339,140 @@ void EffectNoiseReduction::Worker::ReduceNoise
    }
 }
 
+void EffectNoiseReduction::Worker::Output
+(WaveTrack *outputTrack, float *buffer, int len)
+{
+   if (!mOut) {
+      outputTrack->Append((samplePtr)buffer, floatSample, len);
+      return;
+   }
+
+   // Drop the output of the warm-up, and any past the segment
+   if (mOutSkip > 0) {
+      int skip = (int)std::min(sampleCount(len), mOutSkip);
+      buffer += skip;
+      len -= skip;
+      mOutSkip -= skip;
+   }
+
+   int copy = (int)std::min(sampleCount(len), mOutLen - mOutCount);
+   if (copy > 0) {
+      memcpy(mOut + mOutCount, buffer, copy * sizeof(float));
+      mOutCount += copy;
+   }
+}
+
+// Reduces noise in segments of a track, each with a Worker of its own
+class EffectNoiseReduction::Segments : public EffectSegmentWork
+{
+public:
+   Segments(EffectNoiseReduction &effect, Statistics &statistics,
+            const Job &job)
+      : mEffect(effect), mStatistics(statistics), mJob(job)
+   {
+   }
+
+   virtual bool ProcessSegment(sampleCount readStart,
+                               sampleCount start, sampleCount len, float *out)
+   {
+      Worker worker(*mEffect.mSettings, mStatistics.mRate
+#ifdef EXPERIMENTAL_SPECTRAL_EDITING
+                    , mEffect.mF0, mEffect.mF1
+#endif
+         );
+      return worker.ReduceSegment(mStatistics, mJob.track,
+                                  mJob.start + mJob.len,
+                                  readStart, start, len, out);
+   }
+
+   virtual bool WriteSegment(sampleCount start, sampleCount len, float *out)
+   {
+      mJob.outputTrack->Append((samplePtr)out, floatSample, len);
+
+      return !mEffect.TrackProgress
+         (mJob.count, (start + len - mJob.start) / (double)mJob.len);
+   }
+
+   virtual bool Progress(double frac)
+   {
+      return mEffect.TrackProgress(mJob.count, frac);
+   }
+
+private:
+   EffectNoiseReduction &mEffect;
+   // Only read, as segments are made only when reducing noise
+   Statistics &mStatistics;
+   const Job &mJob;
+};
+
+sampleCount EffectNoiseReduction::Worker::SegmentWarmUp() const
+{
+   // A couple of steps more, for the release to reach the floor after
+   // rounding
+   return sampleCount(mHistoryLen + mReleaseBlocks + mStepsPerWindow + 2)
+      * mStepSize;
+}
+
+bool EffectNoiseReduction::Worker::ReduceSegment
+(Statistics &statistics, WaveTrack *track, sampleCount end,
+ sampleCount readStart, sampleCount start, sampleCount len, float *out)
+{
+   StartNewTrack();
+
+   mOut = out;
+   mOutSkip = start - readStart;
+   mOutLen = len;
+   mOutCount = 0;
+
+   sampleCount bufferSize = track->GetMaxBlockSize();
+   FloatVector buffer(bufferSize);
+
+   sampleCount blockSize;
+   sampleCount samplePos = readStart;
+   while (mOutCount < mOutLen && samplePos < end) {
+      blockSize = std::min(end - samplePos, track->GetBestBlockSize(samplePos));
+
+      track->Get((samplePtr)&buffer[0], floatSample, samplePos, blockSize);
+      samplePos += blockSize;
+
+      mInSampleCount += blockSize;
+      ProcessSamples(statistics, NULL, blockSize, &buffer[0]);
+   }
+
+   if (mOutCount < mOutLen)
+      FinishTrack(statistics, NULL);
+
+   mOut = NULL;
+
+   return mOutCount == mOutLen;
+}
+
 bool EffectNoiseReduction::Worker::ProcessOne
-(EffectNoiseReduction &effect,  Statistics &statistics, TrackFactory &factory,
- int count, WaveTrack * track, sampleCount start, sampleCount len)
+(EffectNoiseReduction &effect,  Statistics &statistics, const Job &job)
 {
+   WaveTrack *track = job.track;
+   WaveTrack *outputTrack = job.outputTrack;
+   sampleCount start = job.start;
+   sampleCount len = job.len;
+
    if (track == NULL)
       return false;
 
-   StartNewTrack();
+   if (!mDoProfile) {
+      // Steps in a segment are where they would be in the whole track
+      const sampleCount segmentLen = ((1 << 20) / mStepSize) * mStepSize;
+      if (effect.CanProcessSegments(len, segmentLen)) {
+         Segments segments(effect, statistics, job);
+         if (!effect.ProcessSegments(segments, start, len,
+                                     segmentLen, SegmentWarmUp()))
+            return false;
 
-   std::auto_ptr<WaveTrack> outputTrack(
-      mDoProfile ? NULL
-      : factory.NewWaveTrack(track->GetSampleFormat(), track->GetRate()));
+         outputTrack->Flush();
+         return true;
+      }
+   }
+
+   StartNewTrack();
 
    sampleCount bufferSize = track->GetMaxBlockSize();
    FloatVector buffer(bufferSize);
@@ -1284,32 +1489,24 @@ bool EffectNoiseReduction::Worker::ProcessOne
       samplePos += blockSize;
 
       mInSampleCount += blockSize;
-      ProcessSamples(statistics, outputTrack.get(), blockSize, &buffer[0]);
+      ProcessSamples(statistics, outputTrack, blockSize, &buffer[0]);
 
       // Update the Progress meter, let user cancel
       bLoopSuccess = 
-         !effect.TrackProgress(count, (samplePos - start) / (double)len);
+         !effect.TrackProgress(job.count, (samplePos - start) / (double)len);
    }
 
    if (bLoopSuccess) {
       if (mDoProfile)
          FinishTrackStatistics(statistics);
       else
-         FinishTrack(statistics, &*outputTrack);
+         FinishTrack(statistics, outputTrack);
    }
 
    if (bLoopSuccess && !mDoProfile) {
-      // Flush the output WaveTrack (since it's buffered)
+      // Flush the output WaveTrack (since it's buffered); Process()
+      // pastes it in place of the original
       outputTrack->Flush();
-
-      // Take the output track and insert it in place of the original
-      // sample data (as operated on -- this may not match mT0/mT1)
-      double t0 = outputTrack->LongSamplesToTime(start);
-      double tLen = outputTrack->LongSamplesToTime(len);
-      // Filtering effects always end up with more data than they started with.  Delete this 'tail'.
-      outputTrack->HandleClear(tLen, outputTrack->GetEndTime(), false, false);
-      bool bResult = track->ClearAndPaste(t0, t0 + tLen, &*outputTrack, true, false);
-      wxASSERT(bResult); // TO DO: Actually handle this.
    }
 
    return bLoopSuccess;
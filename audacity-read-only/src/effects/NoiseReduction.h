@@ -16,6 +16,7 @@
 #include "Effect.h"
 
 #include <memory>
+#include <vector>
 
 class EffectNoiseReduction: public Effect {
 public:
@@ -41,12 +42,32 @@ public:
    class Statistics;
    class Dialog;
 
+protected:
+   // Reducing noise, the tracks are items; profiling adds them all to one
+   // set of statistics, so not then
+   virtual bool IsThreadSafe();
+   virtual bool ProcessItem(int index);
+
 private:
    class Worker;
+   // Segments of a long track, several at a time
+   class Segments;
    friend class Dialog;
+   friend class Worker;
+   friend class Segments;
+
+   // A track to reduce noise in, into outputTrack
+   struct Job {
+      WaveTrack *track;
+      WaveTrack *outputTrack;
+      int count;
+      sampleCount start;
+      sampleCount len;
+   };
 
    std::auto_ptr<Settings> mSettings;
    std::auto_ptr<Statistics> mStatistics;
+   std::vector<Job> mJobs;
 };
 
 #endif
@@ -147,13 +147,12 @@ bool EffectNormalize::Process()
    if (mGain == false && mDC == false)
       return true;
 
-   float ratio;
    if( mGain )
-      ratio = pow(10.0,TrapDouble(mLevel, // same value used for all tracks
+      mRatio = pow(10.0,TrapDouble(mLevel, // same value used for all tracks
                                NORMALIZE_DB_MIN,
                                NORMALIZE_DB_MAX)/20.0);
    else
-      ratio = 1.0;
+      mRatio = 1.0;
 
    //Iterate over each track
    this->CopyInputTracks(); // Set up mOutputTracks.
@@ -162,7 +161,7 @@ bool EffectNormalize::Process()
    WaveTrack *track = (WaveTrack *) iter.First();
    WaveTrack *prevTrack;
    prevTrack = track;
-   mCurTrackNum = 0;
+   int curTrackNum = 0;
    wxString topMsg;
    if(mDC && mGain)
       topMsg = _("Removing DC offset and Normalizing...\n");
@@ -173,181 +172,204 @@ bool EffectNormalize::Process()
    else if(!mDC && !mGain)
       topMsg = wxT("Not doing anything)...\n");   // shouldn't get here
 
+   // Gather the items, each track or linked stereo pair
+   mItems.clear();
    while (track) {
       //Get start and end times from track
       double trackStart = track->GetStartTime();
       double trackEnd = track->GetEndTime();
 
+      Item item;
+      item.track[0] = track;
+      item.channels = 1;
+      item.trackNum = curTrackNum;
+
       //Set the current bounds to whichever left marker is
       //greater and whichever right marker is less:
-      mCurT0 = mT0 < trackStart? trackStart: mT0;
-      mCurT1 = mT1 > trackEnd? trackEnd: mT1;
+      item.t0 = mT0 < trackStart? trackStart: mT0;
+      item.t1 = mT1 > trackEnd? trackEnd: mT1;
 
       // Process only if the right marker is to the right of the left marker
-      if (mCurT1 > mCurT0) {
-         wxString msg;
+      if (item.t1 > item.t0) {
          wxString trackName = track->GetName();
 
-         if(!track->GetLinked() || mStereoInd)
-            msg = topMsg + _("Analyzing: ") + trackName;
-         else
-            msg = topMsg + _("Analyzing first track of stereo pair: ") + trackName;
-         AnalyseTrack(track, msg);  // sets mOffset and offset-adjusted mMin and mMax
          if(!track->GetLinked() || mStereoInd) {   // mono or 'stereo tracks independently'
-            float extent = wxMax(fabs(mMax), fabs(mMin));
-            if( (extent > 0) && mGain )
-               mMult = ratio / extent;
-            else
-               mMult = 1.0;
-            msg = topMsg + _("Processing: ") + trackName;
+            item.analyseMsg[0] = topMsg + _("Analyzing: ") + trackName;
+            item.processMsg[0] = topMsg + _("Processing: ") + trackName;
             if(track->GetLinked() || prevTrack->GetLinked())  // only get here if there is a linked track but we are processing independently
-               msg = topMsg + _("Processing stereo channels independently: ") + trackName;
-
-            if (!ProcessOne(track, msg))
-            {
-               bGoodResult = false;
-               break;
-            }
+               item.processMsg[0] = topMsg + _("Processing stereo channels independently: ") + trackName;
          }
          else
          {
-            // we have a linked stereo track
-            // so we need to find it's min, max and offset
-            // as they are needed to calc the multiplier for both tracks
-            float offset1 = mOffset;   // remember ones from first track
-            float min1 = mMin;
-            float max1 = mMax;
+            // we have a linked stereo track, and its min, max and
+            // offset are needed to calc the multiplier for both tracks
             track = (WaveTrack *) iter.Next();  // get the next one
-            mCurTrackNum++;   // keeps progress bar correct
-            msg = topMsg + _("Analyzing second track of stereo pair: ") + trackName;
-            AnalyseTrack(track, msg);  // sets mOffset and offset-adjusted mMin and mMax
-            float offset2 = mOffset;   // ones for second track
-            float min2 = mMin;
-            float max2 = mMax;
-            float extent = wxMax(fabs(min1), fabs(max1));
-            extent = wxMax(extent, fabs(min2));
-            extent = wxMax(extent, fabs(max2));
-            if( (extent > 0) && mGain )
-               mMult = ratio / extent; // we need to use this for both linked tracks
-            else
-               mMult = 1.0;
-            mOffset = offset1;
-            track = (WaveTrack *) iter.Prev();  // go back to the first linked one
-            mCurTrackNum--;   // keeps progress bar correct
-            msg = topMsg + _("Processing first track of stereo pair: ") + trackName;
-            if (!ProcessOne(track, msg))
-            {
-               bGoodResult = false;
-               break;
-            }
-            mOffset = offset2;
-            track = (WaveTrack *) iter.Next();  // go to the second linked one
-            mCurTrackNum++;   // keeps progress bar correct
-            msg = topMsg + _("Processing second track of stereo pair: ") + trackName;
-            if (!ProcessOne(track, msg))
-            {
-               bGoodResult = false;
-               break;
-            }
+            curTrackNum++;   // keeps progress bar correct
+            item.track[1] = track;
+            item.channels = 2;
+            item.analyseMsg[0] = topMsg + _("Analyzing first track of stereo pair: ") + trackName;
+            item.analyseMsg[1] = topMsg + _("Analyzing second track of stereo pair: ") + trackName;
+            item.processMsg[0] = topMsg + _("Processing first track of stereo pair: ") + trackName;
+            item.processMsg[1] = topMsg + _("Processing second track of stereo pair: ") + trackName;
          }
+
+         mItems.push_back(item);
       }
 
       //Iterate to the next track
       prevTrack = track;
       track = (WaveTrack *) iter.Next();
-      mCurTrackNum++;
+      curTrackNum++;
    }
 
+   if(mGain) {
+      // Since we need complete summary data, we need to block until the OD tasks are done for these tracks
+      // TODO: should we restrict the flags to just the relevant block files (for selections)
+      for (size_t i = 0; i < mItems.size(); i++)
+         for (int c = 0; c < mItems[i].channels; c++)
+            while (mItems[i].track[c]->GetODFlags()) {
+               // update the gui
+               mProgress->Update(0, wxT("Waiting for waveform to finish computing..."));
+               wxMilliSleep(100);
+            }
+   }
+
+   // The items run in parallel; only they touch their Item
+   bGoodResult = ProcessItems((int)mItems.size());
+
+   if (bGoodResult) {
+      for (size_t i = 0; i < mItems.size(); i++) {
+         const Item &item = mItems[i];
+         gFrameSum += item.frameSum;
+         mMult = item.mult;
+         mOffset = item.offset[item.channels - 1];
+      }
+   }
+   mItems.clear();
+
    this->ReplaceProcessedTracks(bGoodResult);
    return bGoodResult;
 }
 
-void EffectNormalize::AnalyseTrack(WaveTrack * track, wxString msg)
+bool EffectNormalize::ProcessItem(int index)
 {
-   if(mGain) {
-      // Since we need complete summary data, we need to block until the OD tasks are done for this track
-      // TODO: should we restrict the flags to just the relevant block files (for selections)
-      while (track->GetODFlags()) {
-         // update the gui
-         mProgress->Update(0, wxT("Waiting for waveform to finish computing..."));
-         wxMilliSleep(100);
-      }
+   Item &item = mItems[index];
+
+   float extent = 0.0;
+   for (int c = 0; c < item.channels; c++) {
+      float min, max;
+      if (!AnalyseTrack(item.track[c], item.trackNum + c, item.t0, item.t1,
+                        item.analyseMsg[c], &min, &max, &item.offset[c]))
+         return false;
+      extent = wxMax(extent, fabs(min));
+      extent = wxMax(extent, fabs(max));
+   }
+
+   if( (extent > 0) && mGain )
+      item.mult = mRatio / extent; // we need to use this for both linked tracks
+   else
+      item.mult = 1.0;
+
+   item.frameSum = 0.0;
+   for (int c = 0; c < item.channels; c++) {
+      if (!ProcessOne(item.track[c], item.trackNum + c, item.t0, item.t1,
+                      item.mult, item.offset[c], item.processMsg[c],
+                      &item.frameSum))
+         return false;
+   }
 
-      track->GetMinMax(&mMin, &mMax, mCurT0, mCurT1); // set mMin, mMax.  No progress bar here as it's fast.
+   return true;
+}
+
+bool EffectNormalize::AnalyseTrack(WaveTrack * track, int trackNum,
+                                   double t0, double t1, wxString msg,
+                                   float *min, float *max, float *offset)
+{
+   if(mGain) {
+      // Process() waited for the OD tasks
+      track->GetMinMax(min, max, t0, t1); // No progress bar here as it's fast.
    } else {
-      mMin = -1.0, mMax = 1.0;   // sensible defaults?
+      *min = -1.0, *max = 1.0;   // sensible defaults?
    }
 
    if(mDC) {
-      AnalyseDC(track, msg); // sets mOffset
-      mMin += mOffset;
-      mMax += mOffset;
+      if (!AnalyseDC(track, trackNum, t0, t1, msg, offset))
+         return false;
+      *min += *offset;
+      *max += *offset;
    } else {
-      mOffset = 0.0;
+      *offset = 0.0;
    }
+
+   return true;
 }
 
-//AnalyseDC() takes a track, transforms it to bunch of buffer-blocks,
-//and executes AnalyzeData on it...
-// sets mOffset
-bool EffectNormalize::AnalyseDC(WaveTrack * track, wxString msg)
+//AnalyseDC() takes a track, and sums it a block at a time, from the
+//blocks' SampleStats, so that only blocks the selection cuts are read...
+// sets offset
+bool EffectNormalize::AnalyseDC(WaveTrack * track, int trackNum,
+                                double t0, double t1, wxString msg,
+                                float *offset)
 {
    bool rc = true;
    sampleCount s;
 
-   mOffset = 0.0; // we might just return
+   *offset = 0.0; // we might just return
 
    if(!mDC)  // don't do analysis if not doing dc removal
       return(rc);
 
    //Transform the marker timepoints to samples
-   sampleCount start = track->TimeToLongSamples(mCurT0);
-   sampleCount end = track->TimeToLongSamples(mCurT1);
+   sampleCount start = track->TimeToLongSamples(t0);
+   sampleCount end = track->TimeToLongSamples(t1);
 
    //Get the length of the buffer (as double). len is
    //used simply to calculate a progress meter, so it is easier
    //to make it a double now than it is to do it later
    double len = (double)(end - start);
 
-   //Initiate a processing buffer.  This buffer will (most likely)
-   //be shorter than the length of the track being processed.
-   float *buffer = new float[track->GetMaxBlockSize()];
-
-   mSum = 0.0; // dc offset inits
-   mCount = 0;
+   double sum = 0.0; // dc offset inits
+   sampleCount count = 0;
+   float *buffer = NULL;
 
-   //Go through the track one buffer at a time. s counts which
-   //sample the current buffer starts at.
+   //Go through the track one block at a time. s counts which
+   //sample the current block starts at.
    s = start;
    while (s < end) {
-      //Get a block of samples (smaller than the size of the buffer)
+      //Get the rest of the block s is in
       sampleCount block = track->GetBestBlockSize(s);
 
       //Adjust the block size if it is the final block in the track
       if (s + block > end)
          block = end - s;
 
-      //Get the samples from the track and put them in the buffer
-      track->Get((samplePtr) buffer, floatSample, s, block);
-
-      //Process the buffer.
-      AnalyzeData(buffer, block);
+      //Sum the samples, reading them if there are no stats to sum
+      SampleStats stats;
+      if (!track->GetStats(&stats, s, block)) {
+         if (!buffer)
+            buffer = new float[track->GetMaxBlockSize()];
+         track->Get((samplePtr) buffer, floatSample, s, block);
+         stats = SampleStats();
+         stats.Add(buffer, block, 0);
+      }
+      sum += stats.sum;
+      count += stats.len;
 
       //Increment s one blockfull of samples
       s += block;
 
       //Update the Progress meter
-      if (TrackProgress(mCurTrackNum,
+      if (TrackProgress(trackNum,
                         ((double)(s - start) / len)/2.0, msg)) {
-         rc = false; //lda .. break, not return, so that buffer is deleted
+         rc = false;
          break;
       }
    }
 
-   //Clean up the buffer
    delete[] buffer;
 
-   mOffset = (float)(-mSum / mCount);  // calculate actual offset (amount that needs to be added on)
+   if (count > 0)
+      *offset = (float)(-sum / count);  // calculate actual offset (amount that needs to be added on)
 
    //Return true because the effect processing succeeded ... unless cancelled
    return rc;
@@ -355,15 +377,18 @@ bool EffectNormalize::AnalyseDC(WaveTrack * track, wxString msg)
 
 //ProcessOne() takes a track, transforms it to bunch of buffer-blocks,
 //and executes ProcessData, on it...
-// uses mMult and mOffset to normalize a track.  Needs to have them set before being called
-bool EffectNormalize::ProcessOne(WaveTrack * track, wxString msg)
+// uses mult and offset to normalize a track, and adds to frameSum
+bool EffectNormalize::ProcessOne(WaveTrack * track, int trackNum,
+                                 double t0, double t1,
+                                 float mult, float offset, wxString msg,
+                                 double *frameSum)
 {
    bool rc = true;
    sampleCount s;
 
    //Transform the marker timepoints to samples
-   sampleCount start = track->TimeToLongSamples(mCurT0);
-   sampleCount end = track->TimeToLongSamples(mCurT1);
+   sampleCount start = track->TimeToLongSamples(t0);
+   sampleCount end = track->TimeToLongSamples(t1);
 
    //Get the length of the buffer (as double). len is
    //used simply to calculate a progress meter, so it is easier
@@ -389,7 +414,7 @@ bool EffectNormalize::ProcessOne(WaveTrack * track, wxString msg)
       track->Get((samplePtr) buffer, floatSample, s, block);
 
       //Process the buffer.
-      ProcessData(buffer, block);
+      ProcessData(buffer, block, mult, offset, frameSum);
 
       //Copy the newly-changed samples back onto the track.
       track->Set((samplePtr) buffer, floatSample, s, block);
@@ -398,7 +423,7 @@ bool EffectNormalize::ProcessOne(WaveTrack * track, wxString msg)
       s += block;
 
       //Update the Progress meter
-      if (TrackProgress(mCurTrackNum,
+      if (TrackProgress(trackNum,
                         0.5+((double)(s - start) / len)/2.0, msg)) {
          rc = false; //lda .. break, not return, so that buffer is deleted
          break;
@@ -411,23 +436,15 @@ bool EffectNormalize::ProcessOne(WaveTrack * track, wxString msg)
    return rc;
 }
 
-void EffectNormalize::AnalyzeData(float *buffer, sampleCount len)
-{
-   sampleCount i;
-
-   for(i=0; i<len; i++)
-      mSum += (double)buffer[i];
-   mCount += len;
-}
-
-void EffectNormalize::ProcessData(float *buffer, sampleCount len)
+void EffectNormalize::ProcessData(float *buffer, sampleCount len,
+                                  float mult, float offset, double *frameSum)
 {
    sampleCount i;
 
    for(i=0; i<len; i++) {
-      float adjFrame = (buffer[i] + mOffset) * mMult;
+      float adjFrame = (buffer[i] + offset) * mult;
       buffer[i] = adjFrame;
-      gFrameSum += fabs(adjFrame);  //lda: validation.
+      *frameSum += fabs(adjFrame);  //lda: validation.
    }
 }
 
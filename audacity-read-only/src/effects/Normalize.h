@@ -12,6 +12,8 @@
 #ifndef __AUDACITY_EFFECT_NORMALIZE__
 #define __AUDACITY_EFFECT_NORMALIZE__
 
+#include <vector>
+
 #include "Effect.h"
 
 #include <wx/checkbox.h>
@@ -59,27 +61,50 @@ class EffectNormalize: public Effect
    virtual bool CheckWhetherSkipEffect();
    virtual bool Process();
 
+ protected:
+   // Each track, or each stereo pair normalized together, is an item
+   virtual bool IsThreadSafe() { return true; }
+   virtual bool ProcessItem(int index);
+
  private:
-   bool ProcessOne(WaveTrack * t, wxString msg);
-   virtual void AnalyseTrack(WaveTrack * track, wxString msg);
-   virtual void AnalyzeData(float *buffer, sampleCount len);
-   bool AnalyseDC(WaveTrack * track, wxString msg);
-   virtual void ProcessData(float *buffer, sampleCount len);
+   // A track, or both channels of a stereo pair
+   struct Item {
+      WaveTrack *track[2];
+      int channels;
+      int trackNum; // of track[0]
+      double t0;
+      double t1;
+      wxString analyseMsg[2];
+      wxString processMsg[2];
+
+      // Set by ProcessItem()
+      float mult;
+      float offset[2];
+      double frameSum;
+   };
+
+   bool ProcessOne(WaveTrack * t, int trackNum, double t0, double t1,
+                   float mult, float offset, wxString msg, double *frameSum);
+   // sets offset and offset-adjusted min and max
+   virtual bool AnalyseTrack(WaveTrack * track, int trackNum,
+                             double t0, double t1, wxString msg,
+                             float *min, float *max, float *offset);
+   bool AnalyseDC(WaveTrack * track, int trackNum, double t0, double t1,
+                  wxString msg, float *offset);
+   virtual void ProcessData(float *buffer, sampleCount len,
+                            float mult, float offset, double *frameSum);
 
    bool   mGain;
    bool   mDC;
    double mLevel;
    bool   mStereoInd;
 
-   int    mCurTrackNum;
-   double mCurT0;
-   double mCurT1;
+   float  mRatio;
+   std::vector<Item> mItems;
+
+   // Of the last track, for validation
    float  mMult;
    float  mOffset;
-   float  mMin;
-   float  mMax;
-   double mSum;
-   sampleCount    mCount;
 };
 
 //----------------------------------------------------------------------------
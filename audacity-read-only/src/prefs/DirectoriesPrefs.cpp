@@ -34,6 +34,8 @@
 
 #include "../Prefs.h"
 #include "../AudacityApp.h"
+#include "../BlockCache.h"
+#include "../BlockPrefetcher.h"
 #include "../Internat.h"
 #include "../ShuttleGui.h"
 #include "DirectoriesPrefs.h"
@@ -100,6 +102,34 @@ void DirectoriesPrefs::PopulateOrExchange(ShuttleGui & S)
    }
    S.EndStatic();
 
+   S.StartStatic(_("Block cache"));
+   {
+      S.StartTwoColumn();
+      {
+         S.TieNumericTextBox(_("&Memory for recently read audio (MB):"),
+                             wxT("/Directories/BlockCacheSize"),
+                             64,
+                             9);
+         S.TieNumericTextBox(_("&Blocks to read ahead during playback:"),
+                             wxT("/AudioIO/PrefetchBlocks"),
+                             4,
+                             9);
+      }
+      S.EndTwoColumn();
+   }
+   S.EndStatic();
+
+#ifdef EXPERIMENTAL_PACKED_BLOCKFILES
+   S.StartStatic(_("Project data"));
+   {
+      // Read by DirManager when a project is created or opened
+      S.TieCheckBox(_("Store new audio of a project in a single &pack file"),
+                    wxT("/Directories/PackBlockFiles"),
+                    false);
+   }
+   S.EndStatic();
+#endif
+
 #ifdef DEPRECATED_AUDIO_CACHE
    // See http://bugzilla.audacityteam.org/show_bug.cgi?id=545.
    S.StartStatic(_("Audio cache"));
@@ -240,5 +270,9 @@ bool DirectoriesPrefs::Apply()
    ShuttleGui S(this, eIsSavingToPrefs);
    PopulateOrExchange(S);
 
+   long mb = gPrefs->Read(wxT("/Directories/BlockCacheSize"), 64L);
+   BlockCache::Get().SetBudget(mb > 0 ? (size_t)mb << 20 : 0);
+   BlockPrefetcher::Get().SetDepth(gPrefs->Read(wxT("/AudioIO/PrefetchBlocks"), 4L));
+
    return true;
 }
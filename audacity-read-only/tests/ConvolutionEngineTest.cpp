@@ -0,0 +1,153 @@
+#include <iostream>
+#include <ostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <wx/init.h>
+
+#include "effects/ConvolutionEngine.h"
+
+
+// Checks ConvolutionEngine against convolution in time, worked out in
+// doubles, for responses that take the head partitions only and ones
+// that take the tail too, fed in blocks of all sizes.
+class ConvolutionEngineTest {
+   int len;
+   int maxIR;
+
+   float *input;
+   float *ir;
+   float *output;
+
+public:
+   ConvolutionEngineTest()
+   {
+       std::cout << "==> Testing ConvolutionEngine\n";
+   }
+
+   void setUp() {
+      len = 60000;
+      maxIR = 200000;
+
+      input = new float[len];
+      ir = new float[maxIR];
+      output = new float[len];
+
+      srand(1);
+      for (int i = 0; i < len; i++)
+         input[i] = 2.0f * (rand() / (float)RAND_MAX - 0.5f);
+      // Decaying noise, as a room's response is
+      for (int i = 0; i < maxIR; i++)
+         ir[i] = 2.0f * (rand() / (float)RAND_MAX - 0.5f) *
+            (float)exp(-3.0 * i / maxIR);
+   }
+
+   void tearDown() {
+      delete [] input;
+      delete [] ir;
+      delete [] output;
+   }
+
+   double Direct(int irLen, int i) {
+      double sum = 0;
+      for (int k = 0; k < irLen && k <= i; k++)
+         sum += (double)ir[k] * input[i - k];
+      return sum;
+   }
+
+   void Compare(int irLen, int blockSize, bool nonUniform) {
+      ConvolutionEngine engine;
+      engine.Init(ir, irLen, blockSize, nonUniform);
+      sampleCount latency = engine.GetLatency();
+      assert(latency == blockSize);
+
+      memcpy(output, input, len * sizeof(float));
+      for (int s = 0; s < len; ) {
+         int block = 1 + rand() % (3 * blockSize);
+         if (s + block > len)
+            block = len - s;
+         // In place
+         engine.Process(output + s, output + s, block);
+         s += block;
+      }
+
+      for (int i = 0; i < latency; i++)
+         assert(output[i] == 0.0f);
+
+      // Every sample is too slow for the long responses
+      int step = irLen > 10000 ? 37 : 1;
+      double tolerance = 1e-5 * sqrt((double)irLen) + 1e-6;
+      for (int i = 0; i + latency < len; i += step) {
+         double expected = Direct(irLen, i);
+         if (fabs(output[i + latency] - expected) > tolerance)
+         {
+            std::cout << output[i + latency] << " != " << expected
+                      << " (irLen=" << irLen << ", blockSize=" << blockSize
+                      << ", i=" << i << ")" << std::endl;
+            assert(false);
+         }
+      }
+   }
+
+   void testUniform() {
+      std::cout << "\tuniform partitions should convolve...";
+      std::cout << std::flush;
+
+      const int irLens[] = {1, 100, 1024, 3000};
+      for (int i = 0; i < 4; i++) {
+         Compare(irLens[i], 64, false);
+         Compare(irLens[i], 256, false);
+      }
+
+      std::cout << "OK\n";
+   }
+
+   void testNonUniform() {
+      std::cout << "\tnon-uniform partitions should convolve...";
+      std::cout << std::flush;
+
+      // Head only; then tail partitions of 512 and 2048
+      Compare(1000, 64, true);
+      Compare(1025, 64, true);
+      Compare(20000, 64, true);
+      Compare(maxIR, 256, true);
+
+      std::cout << "OK\n";
+   }
+
+   void testMix() {
+      std::cout << "\tthe dry signal should only be delayed...";
+      std::cout << std::flush;
+
+      ConvolutionEngine engine;
+      engine.Init(ir, 5000, 128, true);
+      engine.SetMix(0.0f, 1.0f);
+      engine.Process(input, output, len);
+
+      sampleCount latency = engine.GetLatency();
+      for (int i = 0; i < len; i++)
+         assert(output[i] == (i < latency ? 0.0f : input[i - latency]));
+
+      std::cout << "OK\n";
+   }
+};
+
+int main()
+{
+    // The engine convolves the tail on a wxThread
+    wxInitializer initializer;
+
+    ConvolutionEngineTest tester;
+
+    tester.setUp();
+    tester.testUniform();
+    tester.testNonUniform();
+    tester.testMix();
+    tester.tearDown();
+
+    CleanupFFT();
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <iostream>
+#include <ostream>
+#include <cassert>
+#include <cstdlib>
+#include <cmath>
+
+#include <wx/init.h>
+#include <wx/fileconf.h>
+#include <wx/thread.h>
+
+#include "Prefs.h"
+#include "DirManager.h"
+#include "Track.h"
+#include "WaveTrack.h"
+#include "ThreadPool.h"
+#include "effects/ClickRemoval.h"
+#include "effects/Equalization.h"
+#include "effects/NoiseReduction.h"
+
+// Runs an effect on a pool thread, where Effect::CanProcessSegments() is
+// false, so that it processes its track one block after another
+class SerialRun : public ParallelJob {
+public:
+   SerialRun(Effect &effect):
+      mEffect(effect), mStarted(mMutex), mCount(0), mResult(false) {}
+
+   virtual void RunItem(int WXUNUSED(index), int WXUNUSED(slot))
+   {
+      // Neither item goes on until both have started, so one of them is
+      // on a pool thread rather than the caller's
+      {
+         wxMutexLocker locker(mMutex);
+         if (++mCount == 2)
+            mStarted.Broadcast();
+         while (mCount < 2)
+            mStarted.Wait();
+      }
+
+      if (ThreadPool::Get().IsPoolThread())
+         mResult = mEffect.Process();
+   }
+
+   bool Run()
+   {
+      ThreadPool::Get().Run(*this, 2, 2);
+      return mResult;
+   }
+
+private:
+   Effect &mEffect;
+   wxMutex mMutex;
+   wxCondition mStarted;
+   int mCount;
+   bool mResult;
+};
+
+// Checks that the effects which split a long track into segments, several
+// computed at once, give what they give processing it serially.  Noise
+// Reduction starts each segment SegmentWarmUp() samples early, so this
+// checks that that is enough.
+class EffectSegmentsTest {
+   DirManager *mDirManager;
+   TrackFactory *mFactory;
+
+   double rate;
+   // Over three segments of each effect
+   sampleCount len;
+   float *input;
+   float *serial;
+   float *segmented;
+
+public:
+   EffectSegmentsTest()
+   {
+      std::cout << "==> Testing segmented effects against serial\n";
+   }
+
+   void setUp()
+   {
+      DirManager::SetTempDir(wxT("/tmp/effect-segments-test-dir"));
+      mDirManager = new DirManager;
+      mFactory = new TrackFactory(mDirManager);
+
+      rate = 44100.0;
+      len = 3 * (1 << 20) + 12345;
+      input = new float[len];
+      serial = new float[len];
+      segmented = new float[len];
+
+      // Noise, with bursts of tone across the segment boundaries and
+      // clicks every so often
+      srand(1);
+      for (sampleCount i = 0; i < len; i++) {
+         input[i] = 0.05f * (rand() / (float)RAND_MAX - 0.5f);
+         if (i > 2 * rate && (i / (sampleCount)(rate / 2)) % 2)
+            input[i] += 0.5f * (float)sin(2 * M_PI * 440.0 * i / rate);
+      }
+      for (sampleCount i = 3 * rate; i + 1 < len; i += 12347) {
+         input[i] += 0.9f;
+         input[i + 1] -= 0.9f;
+      }
+   }
+
+   void tearDown()
+   {
+      delete [] input;
+      delete [] serial;
+      delete [] segmented;
+      delete mFactory;
+      delete mDirManager;
+   }
+
+   // A selected track of the input in list, for effect to work on
+   void Select(Effect &effect, TrackList &list)
+   {
+      WaveTrack *track = mFactory->NewWaveTrack(floatSample, rate);
+      track->Append((samplePtr)input, floatSample, len);
+      track->Flush();
+      track->SetSelected(true);
+      list.Add(track);
+
+      effect.mFactory = mFactory;
+      effect.mProjectRate = rate;
+      effect.mTracks = &list;
+      effect.mT0 = 0.0;
+      effect.mT1 = track->GetEndTime();
+      effect.CountWaveTracks();
+   }
+
+   void GetOutput(TrackList &list, float *output)
+   {
+      WaveTrack *track = (WaveTrack *)TrackListIterator(&list).First();
+      assert(track->TimeToLongSamples(track->GetEndTime()) == len);
+      track->Get((samplePtr)output, floatSample, 0, len);
+      list.Clear(true);
+   }
+
+   void Run(Effect &effect, float *output, bool segments)
+   {
+      TrackList list;
+      Select(effect, list);
+      bool result;
+      if (segments)
+         result = effect.Process();
+      else
+         result = SerialRun(effect).Run();
+      assert(result);
+      GetOutput(list, output);
+   }
+
+   float MaxDifference()
+   {
+      float diff = 0;
+      for (sampleCount i = 0; i < len; i++)
+         diff = std::max(diff, (float)fabs(serial[i] - segmented[i]));
+      return diff;
+   }
+
+   void testEqualization()
+   {
+      std::cout << "\tEqualization..." << std::flush;
+
+      EffectEqualization effect;
+      // Low pass, as a curve would give it
+      const int windowSize = EffectEqualization::windowSize;
+      for (int i = 0; i <= windowSize / 2; i++) {
+         effect.mFilterFuncR[i] = i < windowSize / 16 ? 1.0f : 0.1f;
+         effect.mFilterFuncI[i] = 0.0f;
+      }
+
+      Run(effect, serial, false);
+      Run(effect, segmented, true);
+
+      // Whole lumps, each with the one before: no difference at all
+      assert(MaxDifference() == 0.0f);
+
+      std::cout << "ok\n";
+   }
+
+   void testClickRemoval()
+   {
+      std::cout << "\tClick Removal..." << std::flush;
+
+      EffectClickRemoval serialEffect;
+      Run(serialEffect, serial, false);
+
+      // sep carries from one run to the next, so another effect
+      EffectClickRemoval segmentedEffect;
+      Run(segmentedEffect, segmented, true);
+
+      assert(MaxDifference() == 0.0f);
+
+      std::cout << "ok\n";
+   }
+
+   void testNoiseReduction()
+   {
+      std::cout << "\tNoise Reduction..." << std::flush;
+
+      EffectNoiseReduction effect;
+
+      // Profile the noise before the first burst
+      {
+         TrackList list;
+         Select(effect, list);
+         effect.mT1 = 1.0;
+         bool result = effect.Process();
+         assert(result);
+         list.Clear(true);
+      }
+
+      Run(effect, serial, false);
+      Run(effect, segmented, true);
+
+      // After SegmentWarmUp() samples, a segment's gains have come to
+      // what they are in the serial run, all but rounding
+      float diff = MaxDifference();
+      std::cout << "(max difference " << diff << ") " << std::flush;
+      assert(diff < 1e-6f);
+
+      std::cout << "ok\n";
+   }
+};
+
+int main()
+{
+   wxInitializer initializer;
+
+   gPrefs = new wxFileConfig(wxT("Audacity"), wxEmptyString,
+                             wxT("/tmp/effect-segments-test.cfg"));
+   // A pool of several threads, however many CPUs there are
+   gPrefs->Write(wxT("/Performance/Threads"), 4L);
+   int threads = ThreadPool::Get().GetMaxThreads();
+   assert(threads > 1);
+
+   EffectSegmentsTest tester;
+
+   tester.setUp();
+   tester.testEqualization();
+   tester.testClickRemoval();
+   tester.testNoiseReduction();
+   tester.tearDown();
+
+   ThreadPool::Deinit();
+   delete gPrefs;
+   gPrefs = NULL;
+
+   return 0;
+}
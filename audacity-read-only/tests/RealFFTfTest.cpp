@@ -0,0 +1,143 @@
+#include <iostream>
+#include <ostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include "RealFFTf.h"
+
+
+// Checks RealFFTfBatch() and InverseRealFFTfBatch() against RealFFTf()
+// and InverseRealFFTf() on each buffer: the batches do the same
+// arithmetic in the same order, so they must match exactly, whatever
+// number of lanes they run on.
+class RealFFTfTest {
+   int maxLen;
+   int maxCount;
+
+   float *input;
+   float *scalarOut;
+   float *batchOut;
+
+public:
+   RealFFTfTest()
+   {
+       std::cout << "==> Testing batched RealFFTf\n";
+   }
+
+   void setUp() {
+      maxLen = 4096;
+      // Enough for two batches of the widest vectors and some left over
+      maxCount = 19;
+
+      input = new float[maxLen * maxCount];
+      scalarOut = new float[maxLen * maxCount];
+      batchOut = new float[maxLen * maxCount];
+
+      srand(1);
+      for (int i = 0; i < maxLen * maxCount; i++)
+         input[i] = 2.0f * (rand() / (float)RAND_MAX - 0.5f);
+   }
+
+   void tearDown() {
+      delete [] input;
+      delete [] scalarOut;
+      delete [] batchOut;
+   }
+
+   void Compare(int len, int count, bool inverse) {
+      HFFT h = GetFFT(len);
+
+      memcpy(scalarOut, input, len * count * sizeof(float));
+      memcpy(batchOut, input, len * count * sizeof(float));
+
+      for (int b = 0; b < count; b++) {
+         if (inverse)
+            InverseRealFFTf(scalarOut + b * len, h);
+         else
+            RealFFTf(scalarOut + b * len, h);
+      }
+
+      if (inverse)
+         InverseRealFFTfBatch(batchOut, count, h);
+      else
+         RealFFTfBatch(batchOut, count, h);
+
+      if (memcmp(scalarOut, batchOut, len * count * sizeof(float)) != 0)
+      {
+         for (int i = 0; i < len * count; i++)
+            if (scalarOut[i] != batchOut[i])
+            {
+               std::cout << scalarOut[i] << " != " << batchOut[i]
+                         << " (len=" << len << ", count=" << count
+                         << ", i=" << i << ")" << std::endl;
+               break;
+            }
+         assert(false);
+      }
+
+      ReleaseFFT(h);
+   }
+
+   void testLanes(int lanes) {
+      std::cout << "\t" << lanes << " lanes should match one at a time...";
+      std::cout << std::flush;
+
+      SetRealFFTfBatchLanes(lanes);
+
+      const int counts[] = {1, 3, 4, 8, 9, maxCount};
+
+      for (int len = 8; len <= maxLen; len *= 2)
+      for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+      {
+         Compare(len, counts[c], false);
+         Compare(len, counts[c], true);
+      }
+
+      SetRealFFTfBatchLanes(0);
+
+      std::cout << "OK\n";
+   }
+
+   void testPlanner() {
+      std::cout << "\tthe lanes chosen for each size should work...";
+      std::cout << std::flush;
+
+      for (int len = 8; len <= maxLen; len *= 2)
+      {
+         HFFT h = GetFFT(len);
+         int lanes = GetRealFFTfBatchLanes(h);
+         assert(lanes == 1 || lanes == 4 || lanes == 8);
+         // Chosen once, then kept
+         assert(GetRealFFTfBatchLanes(h) == lanes);
+         ReleaseFFT(h);
+
+         Compare(len, maxCount, false);
+         Compare(len, maxCount, true);
+      }
+
+      std::cout << "OK\n";
+   }
+};
+
+int main()
+{
+    RealFFTfTest tester;
+
+    const int lanes[] = {1, 4, 8};
+
+    for (int i = 0; i < 3; i++)
+    {
+       tester.setUp();
+       tester.testLanes(lanes[i]);
+       tester.tearDown();
+    }
+
+    tester.setUp();
+    tester.testPlanner();
+    tester.tearDown();
+
+    CleanupFFT();
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <ostream>
+#include <iomanip>
+#include <cstdlib>
+#include <ctime>
+
+#include "Dither.h"
+#include "SampleConvert.h"
+
+
+// Times Dither::Apply() on each path this CPU has, for the conversions
+// CopySamples() does: reading blocks to float, writing them back to
+// int, and interleaving for playback and export.
+//
+// Not one of the tests; build it with "make SampleFormatBench".
+class SampleFormatBench {
+   int bufferLen;
+   int repeats;
+
+   samplePtr source;
+   samplePtr dest;
+
+public:
+   SampleFormatBench()
+   {
+      std::cout << "==> Benchmarking sample format conversion "
+                << "(million samples per second)\n";
+
+      // About what one Mixer or Sequence::Get() call converts
+      bufferLen = 65536;
+      repeats = 200;
+
+      // Wide enough for any format and a stride of 2
+      source = new char[bufferLen * 2 * 4];
+      dest = new char[bufferLen * 2 * 4];
+
+      srand(1);
+      for (int i = 0; i < bufferLen * 2; i++)
+      {
+         float x = 2.0f * (rand() / (float)RAND_MAX - 0.5f);
+         ((float *)source)[i] = x;
+      }
+   }
+
+   ~SampleFormatBench()
+   {
+      delete [] source;
+      delete [] dest;
+   }
+
+   double Time(SampleConvertPath path, Dither::DitherType type,
+               sampleFormat srcFormat, sampleFormat dstFormat,
+               unsigned int srcStride, unsigned int dstStride)
+   {
+      Dither dither;
+
+      SetSampleConvertPath(path);
+
+      // Once to warm the caches up
+      dither.Apply(type, source, srcFormat, dest, dstFormat,
+                   bufferLen, srcStride, dstStride);
+
+      clock_t start = clock();
+      for (int i = 0; i < repeats; i++)
+         dither.Apply(type, source, srcFormat, dest, dstFormat,
+                      bufferLen, srcStride, dstStride);
+      double seconds = (clock() - start) / (double)CLOCKS_PER_SEC;
+
+      if (seconds <= 0)
+         return 0;
+      return bufferLen * (double)repeats / seconds / 1e6;
+   }
+
+   void Run()
+   {
+      struct Case {
+         const char *name;
+         sampleFormat srcFormat, dstFormat;
+         Dither::DitherType type;
+         unsigned int srcStride, dstStride;
+      };
+      const Case cases[] = {
+         {"int16 -> float",              int16Sample, floatSample, Dither::none,      1, 1},
+         {"int24 -> float",              int24Sample, floatSample, Dither::none,      1, 1},
+         {"int16 -> int24",              int16Sample, int24Sample, Dither::none,      1, 1},
+         {"float -> int16",              floatSample, int16Sample, Dither::none,      1, 1},
+         {"float -> int16, rectangle",   floatSample, int16Sample, Dither::rectangle, 1, 1},
+         {"float -> int16, triangle",    floatSample, int16Sample, Dither::triangle,  1, 1},
+         {"float -> int16, shaped",      floatSample, int16Sample, Dither::shaped,    1, 1},
+         {"float -> int24, triangle",    floatSample, int24Sample, Dither::triangle,  1, 1},
+         {"int24 -> int16, triangle",    int24Sample, int16Sample, Dither::triangle,  1, 1},
+         {"float -> int16 interleaved",  floatSample, int16Sample, Dither::triangle,  1, 2},
+         {"int16 interleaved -> float",  int16Sample, floatSample, Dither::none,      2, 1},
+      };
+
+      const SampleConvertPath paths[] = {convertScalar, convertSSE2, convertAVX2};
+      const char *names[] = {"scalar", "SSE2", "AVX2"};
+      int numPaths = 3;
+      while (numPaths > 1 && paths[numPaths - 1] > GetBestSampleConvertPath())
+         numPaths--;
+
+      std::cout << std::setw(30) << std::left << "";
+      for (int p = 0; p < numPaths; p++)
+         std::cout << std::setw(10) << std::right << names[p];
+      std::cout << "\n";
+
+      for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+      {
+         std::cout << std::setw(30) << std::left << cases[c].name;
+         for (int p = 0; p < numPaths; p++)
+         {
+            double rate = Time(paths[p], cases[c].type,
+                               cases[c].srcFormat, cases[c].dstFormat,
+                               cases[c].srcStride, cases[c].dstStride);
+            std::cout << std::setw(10) << std::right << std::fixed
+                      << std::setprecision(0) << rate << std::flush;
+         }
+         std::cout << "\n";
+      }
+
+      SetSampleConvertPath(GetBestSampleConvertPath());
+   }
+};
+
+int main()
+{
+   SampleFormatBench bench;
+
+   bench.Run();
+
+   return 0;
+}
@@ -0,0 +1,244 @@
+#include <iostream>
+#include <ostream>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "Dither.h"
+#include "SampleConvert.h"
+
+
+// Checks the vector paths of Dither::Apply() against the scalar one:
+// exactly, where nothing is dithered, and within the spread of the
+// dither noise where something is.
+class SampleFormatTest {
+   int dataLen;
+
+   short *int16Data;
+   int *int24Data;
+   float *floatData;
+
+   // Room for the widest stride
+   samplePtr scalarOut;
+   samplePtr vectorOut;
+
+public:
+   SampleFormatTest()
+   {
+       std::cout << "==> Testing sample format conversion\n";
+   }
+
+   void setUp() {
+      dataLen = 20000;
+
+      int16Data = new short[dataLen * 3];
+      int24Data = new int[dataLen * 3];
+      floatData = new float[dataLen * 3];
+      scalarOut = new char[dataLen * 3 * 4];
+      vectorOut = new char[dataLen * 3 * 4];
+
+      srand(1);
+      for (int i = 0; i < dataLen * 3; i++)
+      {
+         // Beyond full scale now and then, to exercise the clipping
+         float x = 2.4f * (rand() / (float)RAND_MAX - 0.5f);
+         floatData[i] = x;
+         int16Data[i] = (short)(rand() % 65536 - 32768);
+         int24Data[i] = rand() % (1 << 24) - (1 << 23);
+      }
+      // No NaNs: lrintf() makes different ints of them on different
+      // platforms
+      floatData[6] = std::numeric_limits<float>::infinity();
+      floatData[7] = -std::numeric_limits<float>::infinity();
+      floatData[8] = 1.0f;
+      floatData[9] = -1.0f;
+      // Halfway between two 16-bit values, to check the rounding
+      floatData[10] = 2.5f / 32768;
+      floatData[11] = -3.5f / 32768;
+   }
+
+   void tearDown() {
+      delete [] int16Data;
+      delete [] int24Data;
+      delete [] floatData;
+      delete [] scalarOut;
+      delete [] vectorOut;
+   }
+
+   samplePtr SourceOf(sampleFormat format) {
+      if (format == int16Sample)
+         return (samplePtr)int16Data;
+      if (format == int24Sample)
+         return (samplePtr)int24Data;
+      return (samplePtr)floatData;
+   }
+
+   // Sample i of a buffer of the given format, as a double, in units
+   // of the LSB of int16 or int24, or as it is for float
+   double SampleAt(samplePtr buffer, sampleFormat format, int i) {
+      if (format == int16Sample)
+         return ((short *)buffer)[i];
+      if (format == int24Sample)
+         return ((int *)buffer)[i];
+      return ((float *)buffer)[i];
+   }
+
+   void Convert(SampleConvertPath path, Dither::DitherType type,
+                sampleFormat srcFormat, sampleFormat dstFormat,
+                samplePtr out, int len, int srcStride, int dstStride) {
+      Dither dither;
+
+      SetSampleConvertPath(path);
+      memset(out, 0, dataLen * 3 * 4);
+      dither.Apply(type, SourceOf(srcFormat), srcFormat,
+                   out, dstFormat, len, srcStride, dstStride);
+   }
+
+   void testExact(SampleConvertPath path) {
+      std::cout << "\tconversions without dither should match exactly...";
+      std::cout << std::flush;
+
+      const sampleFormat formats[] = {int16Sample, int24Sample, floatSample};
+      const int strides[][2] = {{1, 1}, {2, 1}, {1, 3}, {2, 2}};
+      // Short ones are all tail; the long one has several blocks
+      const int lens[] = {1, 3, 7, 8, 15, 17, 33, dataLen - 5};
+
+      for (int f = 0; f < 3; f++)
+      for (int g = 0; g < 3; g++)
+      for (size_t s = 0; s < sizeof(strides) / sizeof(strides[0]); s++)
+      for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++)
+      {
+         sampleFormat srcFormat = formats[f], dstFormat = formats[g];
+         if (srcFormat == dstFormat)
+            continue;
+
+         int len = lens[l], srcStride = strides[s][0], dstStride = strides[s][1];
+
+         Convert(convertScalar, Dither::none, srcFormat, dstFormat,
+                 scalarOut, len, srcStride, dstStride);
+         Convert(path, Dither::none, srcFormat, dstFormat,
+                 vectorOut, len, srcStride, dstStride);
+
+         // Samples between the strided ones must be untouched, too
+         int bytes = len * dstStride * SAMPLE_SIZE(dstFormat);
+         if (memcmp(scalarOut, vectorOut, bytes) != 0)
+         {
+            for (int i = 0; i < len * dstStride; i++)
+               if (SampleAt(scalarOut, dstFormat, i) !=
+                   SampleAt(vectorOut, dstFormat, i))
+               {
+                  std::cout << SampleAt(scalarOut, dstFormat, i) << " != "
+                            << SampleAt(vectorOut, dstFormat, i)
+                            << " (i=" << i << ")" << std::endl;
+                  break;
+               }
+            assert(false);
+         }
+      }
+
+      std::cout << "OK\n";
+   }
+
+   void testDithered(SampleConvertPath path) {
+      std::cout << "\tdithered conversions should stay within the noise...";
+      std::cout << std::flush;
+
+      const Dither::DitherType types[] =
+         {Dither::rectangle, Dither::triangle, Dither::shaped};
+      // Largest difference from the undithered result, in LSBs: the
+      // noise is at most 1/2 LSB, 1 LSB and 2 LSBs peak, plus rounding,
+      // and noise shaping feeds the error of earlier samples back
+      const double bounds[] = {1, 2, 24};
+
+      const sampleFormat srcFormats[] = {int24Sample, floatSample, floatSample};
+      const sampleFormat dstFormats[] = {int16Sample, int16Sample, int24Sample};
+
+      samplePtr plain = new char[dataLen * 3 * 4];
+
+      for (int t = 0; t < 3; t++)
+      for (int c = 0; c < 3; c++)
+      for (int stride = 1; stride <= 2; stride++)
+      {
+         sampleFormat srcFormat = srcFormats[c], dstFormat = dstFormats[c];
+
+         Convert(convertScalar, Dither::none, srcFormat, dstFormat,
+                 plain, dataLen, stride, stride);
+         Convert(convertScalar, types[t], srcFormat, dstFormat,
+                 scalarOut, dataLen, stride, stride);
+         Convert(path, types[t], srcFormat, dstFormat,
+                 vectorOut, dataLen, stride, stride);
+
+         double scalarPower = 0, vectorPower = 0;
+         int changed = 0;
+
+         for (int i = 0; i < dataLen * stride; i++)
+         {
+            double p = SampleAt(plain, dstFormat, i);
+            double a = SampleAt(scalarOut, dstFormat, i) - p;
+            double b = SampleAt(vectorOut, dstFormat, i) - p;
+
+            if (i % stride != 0)
+            {
+               assert(b == 0);
+               continue;
+            }
+
+            if (fabs(b) > bounds[t] || fabs(a) > bounds[t])
+            {
+               std::cout << "scalar " << a << ", vector " << b
+                         << " (i=" << i << ")" << std::endl;
+               assert(false);
+            }
+
+            scalarPower += a * a;
+            vectorPower += b * b;
+            if (b != 0)
+               changed++;
+         }
+
+         // There must be noise, and about as much as the scalar path's
+         assert(changed > dataLen / 8);
+         double ratio = vectorPower / scalarPower;
+         if (ratio < 0.8 || ratio > 1.25)
+         {
+            std::cout << "noise power ratio " << ratio << std::endl;
+            assert(false);
+         }
+      }
+
+      delete [] plain;
+
+      std::cout << "OK\n";
+   }
+};
+
+int main()
+{
+    SampleFormatTest tester;
+
+    const SampleConvertPath paths[] = {convertSSE2, convertAVX2};
+    const char *names[] = {"SSE2", "AVX2"};
+
+    for (int i = 0; i < 2; i++)
+    {
+       if (paths[i] > GetBestSampleConvertPath())
+       {
+          std::cout << "\t" << names[i] << " not supported here, skipped\n";
+          continue;
+       }
+
+       std::cout << "\t" << names[i] << ":\n";
+
+       tester.setUp();
+       tester.testExact(paths[i]);
+       tester.tearDown();
+
+       tester.setUp();
+       tester.testDithered(paths[i]);
+       tester.tearDown();
+    }
+
+    return 0;
+}
@@ -1,9 +1,12 @@
 
 #include "Sequence.h"
 #include "DirManager.h"
+#include "AudacityApp.h"
 #include <wx/hash.h>
 #include <vector>
 #include <iostream>
+#include <float.h>
+#include <math.h>
 
 class SequenceTest
 {
@@ -131,6 +134,132 @@ public:
       std::cout << "ok\n";
    }
 
+   // Largest max, over the whole sequence, that GetWaveDisplay() gives
+   // at samplesPerPixel
+   float DisplayMax(double samplesPerPixel)
+   {
+      sampleCount numSamples = mSequence->GetNumSamples();
+      int len = (int)(numSamples / samplesPerPixel) + 1;
+
+      std::vector<sampleCount> where(len + 1);
+      std::vector<float> min(len), max(len), rms(len);
+      std::vector<int> bl(len);
+      for (int i = 0; i <= len; i++)
+         where[i] = (sampleCount)(i * samplesPerPixel);
+
+      assert(mSequence->GetWaveDisplay(&min[0], &max[0], &rms[0], &bl[0],
+                                       len, &where[0], samplesPerPixel));
+
+      float result = -FLT_MAX;
+      for (int i = 0; i < len; i++) {
+         assert(min[i] <= max[i]);
+         assert(bl[i] >= 0);
+         if (max[i] > result)
+            result = max[i];
+      }
+      return result;
+   }
+
+   void TestWaveDisplay()
+   {
+      std::cout << "\tSequence::GetWaveDisplay() should find a peak at every zoom, and lose it when it's deleted..." << std::flush;
+
+      int appendBufLen = (int)(mSequence->GetMaxBlockSize() * 1.4);
+      samplePtr appendBuf = NewSamples(appendBufLen, floatSample);
+      for (int i = 0; i < appendBufLen; i++)
+         ((float *)appendBuf)[i] = 0.5f * (rand() / (float)RAND_MAX - 0.5f);
+
+      for (int i = 0; i < 20; i++)
+         mSequence->Append(appendBuf, floatSample, appendBufLen);
+
+      const double zooms[] = {100, 300, 5000, 70000, 300000, 3000000};
+      const int numZooms = sizeof(zooms) / sizeof(zooms[0]);
+
+      // Draw once, so that later draws use what this one made
+      for (int z = 0; z < numZooms; z++)
+         assert(DisplayMax(zooms[z]) < 0.5f);
+
+      sampleCount peakPos = mSequence->GetNumSamples() / 3 + 12345;
+      float peak = 0.9f;
+      assert(mSequence->Set((samplePtr)&peak, floatSample, peakPos, 1));
+      for (int z = 0; z < numZooms; z++)
+         assert(DisplayMax(zooms[z]) == peak);
+
+      assert(mSequence->Delete(peakPos - 10, 20));
+      for (int z = 0; z < numZooms; z++)
+         assert(DisplayMax(zooms[z]) < 0.5f);
+
+      // Appending only adds to what was made
+      peak = 0.7f;
+      mSequence->Append((samplePtr)&peak, floatSample, 1);
+      for (int z = 0; z < numZooms; z++)
+         assert(DisplayMax(zooms[z]) == peak);
+
+      DeleteSamples(appendBuf);
+
+      std::cout << "ok\n";
+   }
+
+   void TestStats()
+   {
+      std::cout << "\tSequence::GetStats() should count what the samples do, whether blocks are whole or cut..." << std::flush;
+
+      int appendBufLen = (int)(mSequence->GetMaxBlockSize() * 1.4);
+      std::vector<float> data;
+      for (int i = 0; i < 6; i++) {
+         std::vector<float> appendBuf(appendBufLen);
+         for (int j = 0; j < appendBufLen; j++)
+            appendBuf[j] = 0.5f * (rand() / (float)RAND_MAX - 0.5f);
+         // Some clipping, and a peak, in some blocks
+         if (i % 2) {
+            appendBuf[rand() % appendBufLen] = 1.0f;
+            appendBuf[rand() % appendBufLen] = -1.0f;
+         }
+         if (i == 3)
+            appendBuf[rand() % appendBufLen] = -1.5f;
+         mSequence->Append((samplePtr)&appendBuf[0], floatSample, appendBufLen);
+         data.insert(data.end(), appendBuf.begin(), appendBuf.end());
+      }
+
+      for (int i = 0; i < 50; i++) {
+         sampleCount start = rand() % data.size();
+         sampleCount len = rand() % (data.size() - start);
+         if (i == 0)
+            start = 0, len = data.size();
+
+         SampleStats stats;
+         assert(mSequence->GetStats(start, len, &stats));
+
+         double sum = 0, sumsq = 0;
+         float min = FLT_MAX, max = -FLT_MAX, peakValue = 0;
+         sampleCount clipped = 0, peak = -1;
+         for (sampleCount j = 0; j < len; j++) {
+            float v = data[start + j];
+            sum += v;
+            sumsq += v * v;
+            if (v < min)
+               min = v;
+            if (v > max)
+               max = v;
+            if (fabs(v) >= MAX_AUDIO)
+               clipped++;
+            if (fabs(v) > peakValue)
+               peakValue = fabs(v), peak = j;
+         }
+
+         // Sums are made a block at a time, so may round differently
+         assert(stats.len == len);
+         assert(fabs(stats.sum - sum) < 1e-6 * (1 + len));
+         assert(fabs(stats.sumsq - sumsq) < 1e-6 * (1 + len));
+         assert(stats.min == min);
+         assert(stats.max == max);
+         assert(stats.clipped == clipped);
+         assert(stats.peak == peak);
+      }
+
+      std::cout << "ok\n";
+   }
+
 };
 
 int main()
@@ -149,6 +278,14 @@ int main()
    tester.TestGetGarbageInput();
    tester.TearDown();
 
+   tester.SetUp();
+   tester.TestWaveDisplay();
+   tester.TearDown();
+
+   tester.SetUp();
+   tester.TestStats();
+   tester.TearDown();
+
    return 0;
 }
 
@@ -1,5 +1,6 @@
 #ifndef __DESA2_H__
 #include <stdio.h>
+#include <pthread.h>
 #ifdef WIN32
 #include <float.h>
 #define ISNAN(x) (!!(_isnan(x)))
@@ -8,6 +9,10 @@
 #endif
 #include "buffer.h"
 #include "desa2_fs.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DESA2_FS_X86 1
+#include <immintrin.h>
+#endif
 /*#include "options.h"
 
 #ifdef FASTMATH
@@ -55,4 +60,178 @@ desa2_fs(circ_buffer_t *b, size_t i)
 
 }
 
+/*
+ * acos(r) = sqrt(1 - |r|) * P(|r|) for r in [0, 1] and
+ * PI - acos(-r) for negative r, P of degree 3
+ * (Abramowitz & Stegun 4.4.45, |error| <= 6.7e-5).
+ */
+#define DESA2_ACOS_C0 (1.5707288f)
+#define DESA2_ACOS_C1 (-0.2121144f)
+#define DESA2_ACOS_C2 (0.0742610f)
+#define DESA2_ACOS_C3 (-0.0187293f)
+#define DESA2_PI_F (3.14159265f)
+
+static inline float
+desa2_acosf_approx(float r)
+{
+    float a, p;
+
+    a = fabsf(r);
+    p = ((DESA2_ACOS_C3 * a + DESA2_ACOS_C2) * a + DESA2_ACOS_C1) * a + DESA2_ACOS_C0;
+    p *= sqrtf(1.0f - a);
+    return (r < 0.0f) ? (DESA2_PI_F - p) : p;
+}
+
+extern void
+desa2_fs_block_scalar(const float *x, size_t n, float *out)
+{
+    size_t k;
+    float d, num, r, x2sq;
+
+    for (k = 0; k < n; k++)
+    {
+        x2sq = x[k + 2] * x[k + 2];
+        d = 2.0f * (x2sq - (x[k + 1] * x[k + 3]));
+        num = (x2sq - (x[k] * x[k + 4]))
+            - ((x[k + 1] * x[k + 1]) - (x[k] * x[k + 2]))
+            - ((x[k + 3] * x[k + 3]) - (x[k + 2] * x[k + 4]));
+        r = num / d;
+        /* d == 0 and |r| > 1 (NaN in acos) give 0, as desa2_fs does */
+        if (d == 0.0f || !(fabsf(r) <= 1.0f))
+            out[k] = 0.0f;
+        else
+            out[k] = 0.5f * desa2_acosf_approx(r);
+    }
+}
+
+#ifdef DESA2_FS_X86
+static void
+desa2_fs_block_sse2(const float *x, size_t n, float *out)
+{
+    size_t k;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 pi = _mm_set1_ps(DESA2_PI_F);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 x0, x1, x2, x3, x4, x2sq, d, num, r, a, p, neg, valid;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        x0 = _mm_loadu_ps(x + k);
+        x1 = _mm_loadu_ps(x + k + 1);
+        x2 = _mm_loadu_ps(x + k + 2);
+        x3 = _mm_loadu_ps(x + k + 3);
+        x4 = _mm_loadu_ps(x + k + 4);
+
+        x2sq = _mm_mul_ps(x2, x2);
+        d = _mm_mul_ps(two, _mm_sub_ps(x2sq, _mm_mul_ps(x1, x3)));
+        num = _mm_sub_ps(x2sq, _mm_mul_ps(x0, x4));
+        num = _mm_sub_ps(num, _mm_sub_ps(_mm_mul_ps(x1, x1), _mm_mul_ps(x0, x2)));
+        num = _mm_sub_ps(num, _mm_sub_ps(_mm_mul_ps(x3, x3), _mm_mul_ps(x2, x4)));
+        r = _mm_div_ps(num, d);
+
+        a = _mm_andnot_ps(sign, r);
+        valid = _mm_and_ps(_mm_cmple_ps(a, one), _mm_cmpneq_ps(d, zero));
+        p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(DESA2_ACOS_C3), a), _mm_set1_ps(DESA2_ACOS_C2));
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(DESA2_ACOS_C1));
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(DESA2_ACOS_C0));
+        p = _mm_mul_ps(p, _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, a), zero)));
+        neg = _mm_cmplt_ps(r, zero);
+        p = _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(pi, p)), _mm_andnot_ps(neg, p));
+        _mm_storeu_ps(out + k, _mm_and_ps(valid, _mm_mul_ps(half, p)));
+    }
+    desa2_fs_block_scalar(x + k, n - k, out + k);
+}
+
+__attribute__((target("avx2")))
+static void
+desa2_fs_block_avx2(const float *x, size_t n, float *out)
+{
+    size_t k;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 pi = _mm256_set1_ps(DESA2_PI_F);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 x0, x1, x2, x3, x4, x2sq, d, num, r, a, p, neg, valid;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        x0 = _mm256_loadu_ps(x + k);
+        x1 = _mm256_loadu_ps(x + k + 1);
+        x2 = _mm256_loadu_ps(x + k + 2);
+        x3 = _mm256_loadu_ps(x + k + 3);
+        x4 = _mm256_loadu_ps(x + k + 4);
+
+        x2sq = _mm256_mul_ps(x2, x2);
+        d = _mm256_mul_ps(two, _mm256_sub_ps(x2sq, _mm256_mul_ps(x1, x3)));
+        num = _mm256_sub_ps(x2sq, _mm256_mul_ps(x0, x4));
+        num = _mm256_sub_ps(num, _mm256_sub_ps(_mm256_mul_ps(x1, x1), _mm256_mul_ps(x0, x2)));
+        num = _mm256_sub_ps(num, _mm256_sub_ps(_mm256_mul_ps(x3, x3), _mm256_mul_ps(x2, x4)));
+        r = _mm256_div_ps(num, d);
+
+        a = _mm256_andnot_ps(sign, r);
+        valid = _mm256_and_ps(_mm256_cmp_ps(a, one, _CMP_LE_OQ),
+                _mm256_cmp_ps(d, zero, _CMP_NEQ_UQ));
+        p = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(DESA2_ACOS_C3), a), _mm256_set1_ps(DESA2_ACOS_C2));
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(DESA2_ACOS_C1));
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(DESA2_ACOS_C0));
+        p = _mm256_mul_ps(p, _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(one, a), zero)));
+        neg = _mm256_cmp_ps(r, zero, _CMP_LT_OQ);
+        p = _mm256_blendv_ps(p, _mm256_sub_ps(pi, p), neg);
+        _mm256_storeu_ps(out + k, _mm256_and_ps(valid, _mm256_mul_ps(half, p)));
+    }
+    desa2_fs_block_sse2(x + k, n - k, out + k);
+}
+#endif /* DESA2_FS_X86 */
+
+typedef void (*desa2_fs_block_fn)(const float *, size_t, float *);
+
+static desa2_fs_block_fn    desa2_fs_block_impl = NULL;
+static const char           *desa2_fs_block_name = NULL;
+static pthread_once_t       desa2_fs_block_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Pick the kernel. Run through pthread_once, so callers on any thread
+ * see both statics set once it returns.
+ */
+static void
+desa2_fs_block_resolve(void)
+{
+#ifdef DESA2_FS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        desa2_fs_block_name = "avx2";
+        desa2_fs_block_impl = desa2_fs_block_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        desa2_fs_block_name = "sse2";
+        desa2_fs_block_impl = desa2_fs_block_sse2;
+        return;
+    }
+#endif
+    desa2_fs_block_name = "scalar";
+    desa2_fs_block_impl = desa2_fs_block_scalar;
+}
+
+extern void
+desa2_fs_block(const float *x, size_t n, float *out)
+{
+    pthread_once(&desa2_fs_block_once, desa2_fs_block_resolve);
+    desa2_fs_block_impl(x, n, out);
+}
+
+extern const char *
+desa2_fs_block_kernel(void)
+{
+    pthread_once(&desa2_fs_block_once, desa2_fs_block_resolve);
+    return desa2_fs_block_name;
+}
+
 #endif
@@ -5,5 +5,23 @@
 
 extern double
 desa2_fs(circ_buffer_t *b, size_t i);
+
+/*
+ * Block variant of desa2_fs, in float. Computes n estimates
+ * out[k] = 0.5 * acos(num/den) of samples x[k], ..., x[k + 4],
+ * so x must hold n + 4 samples. The acos is approximated
+ * (absolute error below 1e-4 rad). Uses AVX2 or SSE2 kernel
+ * if CPU supports it, scalar code otherwise.
+ */
+extern void
+desa2_fs_block(const float *x, size_t n, float *out);
+
+/* Portable kernel, always available (used as the reference). */
+extern void
+desa2_fs_block_scalar(const float *x, size_t n, float *out);
+
+/* Name of the kernel desa2_fs_block dispatches to. */
+extern const char *
+desa2_fs_block_kernel(void);
 #endif
 
@@ -15,7 +15,9 @@
 
 #include "buffer.h"
 #include "sma_buf.h"
+#include "rolling_stats.h"
 #include "desa2_fs.h"
+#include "desa_detector.h"
  
 #define BLOCK       160         /* samples processed in each invocation */
 #define SAMPLE_RATE 8000.0      /* sample rate of input signal */
@@ -23,151 +25,34 @@
  
 /*
  * Purpose: detect a tone using DESA-1 algorithm
+ *          and dump per sample estimates
  *
  * Parameters:
+ *      d           detector state of the stream
+ *      stats       rolling statistics of the stream, restarted
+ *                  every frame (history allocated once, in main)
  *      input       pointer to input samples
  *      variance    the variance of the frequency estimates
  *
  * Return value: frequency estimate in Hz
  */
 double
-desa1(double *input, double *variance)
+desa1(desa_detector_t *d, rolling_stats_t *stats, double *input, double *variance)
 {
-    // detector variables
-    static double diff0 = 0.0;  // delayed differences
-    static double diff1 = 0.0;
-    static double diff2 = 0.0;
-    static double diff3 = 0.0;
-    static double x1 = 0.0;     // delayed inputs
-    static double x2 = 0.0;
-    static double x3 = 0.0;
-	sma_buffer_t    sma_b;
-	sma_buffer_t    sqa_b;
- 
-    double num; // numerator
-    double den; // denominator
-    double freq[BLOCK]; // frequency estimates
-    int i;
- 
-	INIT_SMA_BUFFER(&sma_b, 10);
-	INIT_SMA_BUFFER(&sqa_b, 10);
-    // calculate the frequency estimate for each sample
-    for ( i = 0; i < BLOCK; i++ )
-    {
-        diff0 = input[i] - x1;
-        num = diff2 * diff2 - diff1 * diff3
-            + diff1 * diff1 - diff0 * diff2;
-        den = x2 * x2 - x1 * x3;
-        freq[i] = SAMPLE_RATE * asin(sqrt(num/(8.0 * den))) / M_PI;
-        APPEND_SMA_VAL(&sma_b, freq[i]);
-        APPEND_SMA_VAL(&sqa_b, freq[i] * freq[i]);
-        // handle errors - division by zero, square root of
-        // negative number or asin of number > 1 or < -1
-        if (isnan(freq[i]))
-        {
-            freq[i] = 0;
-        } else  if (isinf(freq[i]))
-        {
-            freq[i] = 2000.0;
-        }
- 
-        diff3 = diff2;
-        diff2 = diff1;
-        diff1 = diff0;
-        x3 = x2;
-        x2 = x1;
-        x1 = input[i];
-	printf("<<< AVMD f[%f]Hz\tsample[%d]\t[%f] >>>\n", freq[i], i, input[i]);
-	printf("<<< AVMD v[%f] f[%f]Hz sma[%f]Hz sqa[%f]\tsample[%d]\t[%d] >>>\n",
-            sqa_b.sma - (sma_b.sma * sma_b.sma), freq[i], sma_b.sma, sqa_b.sma, i, input[i]);
-    }
- 
-    // calculate mean frequency
-    double mean = 0.0;
-    for ( i = 0; i < BLOCK; i++ )
-    {
-        mean += freq[i];
-    }
-    mean /= (double)BLOCK;
- 
-    // calculate the variance in the frequency estimates
-    *variance = 0.0;
-    for ( i = 0; i < BLOCK; i++ )
-    {
-        *variance += freq[i] * freq[i];
-    }
-    *variance /= (double)BLOCK;
-    *variance -= (mean * mean);
- 
-    return mean;
-}
- 
-/*
- * Purpose: detect a tone using DESA-2 algorithm
- *
- * Parameters:
- *      input       pointer to input samples
- *      variance    the variance of the frequency estimates
- *
- * Return value: frequency estimate in Hz
- */
-double
-desa2(double *input, double *variance)
-{
-    // detector variables
-    static double diff0 = 0.0;  // delayed differences
-    static double diff1 = 0.0;
-    static double diff2 = 0.0;
-    static double x1 = 0.0;     // delayed inputs
-    static double x2 = 0.0;
-    static double x3 = 0.0;
- 
-    double num; // numerator
-    double den; // denominator
     double freq[BLOCK]; // frequency estimates
+    double mean;
     int i;
- 
-    // calculate the frequency estimate for each sample
-    for (i = 0; i < BLOCK; i++)
-    {
-        diff0 = input[i] - x2;
-        num = diff1 * diff1 - diff0 * diff2;
-        den = x2 * x2 - x1 * x3;
-        freq[i] = SAMPLE_RATE * asin(sqrt(num/(4.0 * den)))
-            / (2.0 * M_PI);
-        // handle errors - division by zero, square root of
-        // negative number or asin of number > 1 or < -1
-        if (isnan(freq[i]))
-        {
-            freq[i] = 0;
-        } else  if (isinf(freq[i]))
-        {
-            freq[i] = 2000.0;
-        }
- 
-        diff2 = diff1;
-        diff1 = diff0;
-        x3 = x2;
-        x2 = x1;
-        x1 = input[i];
-    }
- 
-    // calculate mean frequency
-    double mean = 0.0;
+
+    mean = desa1_process(d, input, BLOCK, freq, variance);
+
+    rolling_stats_reset(stats);
     for (i = 0; i < BLOCK; i++)
     {
-        mean += freq[i];
-    }
-    mean /= (double)BLOCK;
- 
-    // calculate the variance in the frequency estimates
-    *variance = 0.0;
-    for ( i = 0; i < BLOCK; i++ )
-    {
-        *variance += freq[i] * freq[i];
+        rolling_stats_append(stats, freq[i]);
+	printf("<<< AVMD f[%f]Hz\tsample[%d]\t[%f] >>>\n", freq[i], i, input[i]);
+	printf("<<< AVMD v[%f] f[%f]Hz sma[%f]Hz\tsample[%d]\t[%f] >>>\n",
+            rolling_stats_variance(stats, 0), freq[i], rolling_stats_mean(stats, 0), i, input[i]);
     }
-    *variance /= (double)BLOCK;
-    *variance -= (mean * mean);
  
     return mean;
 }
@@ -288,6 +173,40 @@ desa2_freeswitch_double(double *input, double *mean1, double *mean2, double *var
     return;
 }
 
+/*
+ * Purpose: detect a tone using vectorized DESA-2 block kernel,
+ *          estimates in float, one call per frame.
+ *
+ * Parameters:
+ *      input       pointer to input samples
+ *      mean        mean of the estimates (radians per sample)
+ *      variance    the variance of the estimates
+ */
+void
+desa2_freeswitch_block(int16_t *input, double *mean, double *variance)
+{
+    int i;
+    float x[BLOCK];
+    float est[BLOCK - P];
+    double sum, sqsum;
+
+    for (i = 0; i < BLOCK; i++)
+    {
+        x[i] = (float)input[i];
+    }
+    desa2_fs_block(x, BLOCK - P, est);
+
+    sum = 0.0;
+    sqsum = 0.0;
+    for (i = 0; i < (BLOCK - P); i++)
+    {
+        sum += est[i];
+        sqsum += (double)est[i] * est[i];
+    }
+    *mean = sum / (double)(BLOCK - P);
+    *variance = sqsum / (double)(BLOCK - P) - (*mean * *mean);
+}
+
 // convert 16 bit ints to doubles
 void
 intToFloat(int16_t *input, double *output, int length)
@@ -311,6 +230,9 @@ main(int argc, char *argv[])
     double inputData[BLOCK];
     double frequency, freq2;
     double variance, var2;
+    desa_detector_t desa1_d, desa2_d;
+    rolling_stats_t desa1_stats;
+    size_t desa1_window = 10;
     int numWords;
     int sampleCount, i;
     char *inFileName;
@@ -339,6 +261,14 @@ main(int argc, char *argv[])
  
     // start counting frames
     sampleCount = 0;
+    desa_detector_init(&desa1_d, SAMPLE_RATE);
+    desa_detector_init(&desa2_d, SAMPLE_RATE);
+    if (rolling_stats_init(&desa1_stats, &desa1_window, 1) != 0)
+    {
+        printf("Exiting. Out of memory\n");
+        fclose( inFile );
+        return(1);
+    }
  
     numWords = fread(intData, sizeof(int16_t), BLOCK, inFile );
  
@@ -356,11 +286,11 @@ main(int argc, char *argv[])
 inputData[30 + i] = 20000.0 + i;
         }*/
         // get the frequency estimates
-        frequency = desa1( inputData, &variance );
+        frequency = desa1(&desa1_d, &desa1_stats, inputData, &variance);
         printf("\nDesa1: Mean freq = %f, var = %f, std dev = %f",
             frequency, variance, sqrt(variance));
  
-        frequency = desa2( inputData, &variance );
+        frequency = desa2_process(&desa2_d, inputData, BLOCK, NULL, &variance);
         printf("\nDesa2: Mean freq = %f, var = %f, std dev = %f\n",
             frequency, variance, sqrt(variance));
 
@@ -371,6 +301,10 @@ inputData[30 + i] = 20000.0 + i;
         desa2_freeswitch_double(inputData, &frequency, &freq2, &variance, &var2);
         printf("\nDesa2_fs_double: Mean freq = %f, var = %f, std dev = %f\n, freq2 = %f, var2 = %f\n",
             frequency, variance, sqrt(variance), freq2, var2);
+
+        desa2_freeswitch_block(intData, &frequency, &variance);
+        printf("\nDesa2_fs_block[%s]: Mean freq = %f, var = %f, std dev = %f, REAL_FREQ = %f\n",
+            desa2_fs_block_kernel(), frequency, variance, sqrt(variance), TO_HZ(SAMPLE_RATE, frequency));
  
         sampleCount += BLOCK;
         numWords = fread(intData, sizeof(int16_t), BLOCK, inFile );
@@ -378,6 +312,7 @@ inputData[30 + i] = 20000.0 + i;
  
     printf("\nFinished. sampleCount = %d\n",sampleCount);
  
+    rolling_stats_destroy(&desa1_stats);
     fclose( inFile );
     return 0;
 }
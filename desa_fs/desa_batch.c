@@ -0,0 +1,491 @@
+/*
+ * @file    desa_batch.c
+ * @brief   Offline DESA-2 analysis of many raw captures.
+ *          Inputs (files, directories, list files) are memory
+ *          mapped and sharded over a pool of threads, each
+ *          running its own detector. For every input a summary
+ *          is written: detection time, mean frequency and
+ *          per frame mean/variance trace, as CSV or binary.
+ *
+ * @author  Piotr Gregor < piotrek.gregor gmail.com >
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <ftw.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "desa_detector.h"
+
+#define BLOCK       160         /* samples per frame */
+#define SAMPLE_RATE 8000.0      /* sample rate of input signal */
+
+/* tone is detected after HITS consecutive frames with variance
+ * below VARIANCE (Hz^2) and mean in (0, DESA_FREQ_INF) */
+#define DESA_BATCH_VARIANCE     (100.0)
+#define DESA_BATCH_HITS         (3)
+
+#define DESA_BATCH_MAGIC        "DESASUM"
+#define DESA_BATCH_VERSION      (1)
+#define DESA_BATCH_EXT_CSV      ".desa.csv"
+#define DESA_BATCH_EXT_BIN      ".desa"
+
+/* Binary summary: header followed by frames records. */
+typedef struct {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    block;          /* samples per frame */
+    double      sample_rate;
+    uint64_t    frames;
+    int64_t     detection;      /* first frame of detection, -1 if none */
+    double      mean;           /* mean frequency in Hz over detection */
+} desa_batch_header_t;
+
+typedef struct {
+    float       mean;           /* Hz */
+    float       variance;
+} desa_batch_frame_t;
+
+typedef struct {
+    char        *path;
+    off_t       size;
+    int         status;         /* 0 ok, errno otherwise */
+    uint64_t    frames;
+    int64_t     detection;
+    double      mean;
+} desa_batch_file_t;
+
+typedef struct {
+    desa_batch_file_t   *files;
+    size_t              n;
+    size_t              cap;
+    size_t              next;       /* next file to take, atomic */
+    const char          *outdir;
+    const char          *ext;       /* extension filter for directories */
+    int                 binary;
+    double              threshold;
+    int                 hits;
+} desa_batch_t;
+
+static desa_batch_t batch;
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-j threads] [-o outdir] [-b] [-e ext] [-v variance] [-n hits]\n"
+            "\t\t[-l list] [file|directory]...\n\n"
+            "Runs DESA-2 over 16 bit %d Hz raw files, %d sample frames.\n"
+            "Directories are walked recursively for files ending with ext (default .raw),\n"
+            "list holds one path per line (- for stdin).\n"
+            "Summary of each input goes to <input>%s (or %s with -b), next to the input\n"
+            "or in outdir with path separators replaced by '_'. Detection is %d frames\n"
+            "in a row with variance below %.1f Hz^2 (-n, -v).\n"
+            "One line per input is printed: path,frames,detection_s,mean_hz\n",
+            name, (int)SAMPLE_RATE, BLOCK, DESA_BATCH_EXT_CSV, DESA_BATCH_EXT_BIN,
+            DESA_BATCH_HITS, DESA_BATCH_VARIANCE);
+}
+
+static int
+batch_add(const char *path, off_t size)
+{
+    desa_batch_file_t *files;
+
+    if (batch.n == batch.cap)
+    {
+        batch.cap = batch.cap ? 2 * batch.cap : 256;
+        files = realloc(batch.files, batch.cap * sizeof(*files));
+        if (files == NULL) return -1;
+        batch.files = files;
+    }
+    memset(&batch.files[batch.n], 0, sizeof(*files));
+    batch.files[batch.n].path = strdup(path);
+    if (batch.files[batch.n].path == NULL) return -1;
+    batch.files[batch.n].size = size;
+    batch.n++;
+    return 0;
+}
+
+static int
+has_ext(const char *path, const char *ext)
+{
+    size_t lp = strlen(path), le = strlen(ext);
+    return lp >= le && strcmp(path + lp - le, ext) == 0;
+}
+
+static int
+walk_cb(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    (void)ftw;
+    if (type == FTW_F && S_ISREG(st->st_mode) && has_ext(path, batch.ext))
+    {
+        if (batch_add(path, st->st_size) != 0) return -1;
+    }
+    return 0;
+}
+
+static int
+add_input(const char *path)
+{
+    struct stat st;
+
+    if (stat(path, &st) != 0)
+    {
+        fprintf(stderr, "Can't stat %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        return nftw(path, walk_cb, 32, FTW_PHYS);
+    }
+    return batch_add(path, st.st_size);
+}
+
+static int
+add_list(const char *list)
+{
+    FILE *f;
+    char line[4096];
+    size_t len;
+    int ret = 0;
+
+    f = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Can't open list %s: %s\n", list, strerror(errno));
+        return -1;
+    }
+    while (ret == 0 && fgets(line, sizeof(line), f) != NULL)
+    {
+        len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        {
+            line[--len] = '\0';
+        }
+        if (len == 0) continue;
+        ret = add_input(line);
+    }
+    if (f != stdin) fclose(f);
+    return ret;
+}
+
+/* largest first, so the long ones don't end up last on one thread */
+static int
+size_cmp(const void *a, const void *b)
+{
+    const desa_batch_file_t *fa = a, *fb = b;
+    if (fa->size != fb->size) return fa->size < fb->size ? 1 : -1;
+    return strcmp(fa->path, fb->path);
+}
+
+static int
+path_cmp(const void *a, const void *b)
+{
+    return strcmp(((const desa_batch_file_t *)a)->path,
+            ((const desa_batch_file_t *)b)->path);
+}
+
+static int
+summary_path(const char *path, char *out, size_t len)
+{
+    const char *ext = batch.binary ? DESA_BATCH_EXT_BIN : DESA_BATCH_EXT_CSV;
+    size_t i, n;
+    int ret;
+
+    if (batch.outdir == NULL)
+    {
+        ret = snprintf(out, len, "%s%s", path, ext);
+        return (ret < 0 || (size_t)ret >= len) ? -1 : 0;
+    }
+
+    ret = snprintf(out, len, "%s/", batch.outdir);
+    if (ret < 0 || (size_t)ret >= len) return -1;
+    n = (size_t)ret;
+    while (path[0] == '/' || (path[0] == '.' && path[1] == '/'))
+    {
+        path += path[0] == '/' ? 1 : 2;
+    }
+    for (i = 0; path[i] != '\0' && n + 1 < len; i++)
+    {
+        out[n++] = path[i] == '/' ? '_' : path[i];
+    }
+    out[n] = '\0';
+    ret = snprintf(out + n, len - n, "%s", ext);
+    return (ret < 0 || (size_t)ret >= len - n) ? -1 : 0;
+}
+
+static int
+write_summary(const desa_batch_file_t *file, const desa_batch_frame_t *trace)
+{
+    char path[4096];
+    FILE *f;
+    desa_batch_header_t hdr;
+    uint64_t i;
+    int ret = 0;
+
+    if (summary_path(file->path, path, sizeof(path)) != 0) return ENAMETOOLONG;
+
+    f = fopen(path, batch.binary ? "wb" : "w");
+    if (f == NULL) return errno;
+
+    if (batch.binary)
+    {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, DESA_BATCH_MAGIC, sizeof(hdr.magic));
+        hdr.version = DESA_BATCH_VERSION;
+        hdr.block = BLOCK;
+        hdr.sample_rate = SAMPLE_RATE;
+        hdr.frames = file->frames;
+        hdr.detection = file->detection;
+        hdr.mean = file->mean;
+        if (fwrite(&hdr, sizeof(hdr), 1, f) != 1
+                || (file->frames > 0 && fwrite(trace, sizeof(*trace), file->frames, f) != file->frames))
+        {
+            ret = EIO;
+        }
+    } else
+    {
+        fprintf(f, "# file,%s\n# frames,%llu\n# detection_s,%f\n# mean_hz,%f\n",
+                file->path, (unsigned long long)file->frames,
+                file->detection < 0 ? -1.0 : file->detection * BLOCK / SAMPLE_RATE,
+                file->mean);
+        fprintf(f, "frame,time_s,mean_hz,variance\n");
+        for (i = 0; i < file->frames; i++)
+        {
+            fprintf(f, "%llu,%f,%f,%f\n", (unsigned long long)i, i * BLOCK / SAMPLE_RATE,
+                    trace[i].mean, trace[i].variance);
+        }
+        if (ferror(f)) ret = EIO;
+    }
+
+    if (fclose(f) != 0 && ret == 0) ret = errno;
+    return ret;
+}
+
+/*
+ * Purpose: analyze one input, fill in file results and write
+ *          its summary
+ *
+ * Parameters:
+ *      file        the input
+ *      d           detector, reset here
+ *      trace       per thread trace buffer, grown as needed
+ *      trace_len   its length in frames
+ *
+ * Return value: 0 on success, errno otherwise
+ */
+static int
+analyze(desa_batch_file_t *file, desa_detector_t *d,
+        desa_batch_frame_t **trace, size_t *trace_len)
+{
+    int fd;
+    struct stat st;
+    const int16_t *samples = NULL;
+    desa_batch_frame_t *t;
+    double x[BLOCK];
+    double mean, variance, sum;
+    uint64_t frames, i, run;
+    size_t k;
+    int ret = 0;
+
+    file->detection = -1;
+    file->mean = 0.0;
+    file->frames = 0;
+
+    fd = open(file->path, O_RDONLY);
+    if (fd < 0) return errno;
+    if (fstat(fd, &st) != 0)
+    {
+        ret = errno;
+        close(fd);
+        return ret;
+    }
+
+    frames = (uint64_t)st.st_size / (BLOCK * sizeof(int16_t));
+    if (frames > 0)
+    {
+        samples = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (samples == MAP_FAILED)
+        {
+            ret = errno;
+            close(fd);
+            return ret;
+        }
+        madvise((void *)samples, (size_t)st.st_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    if (frames > *trace_len)
+    {
+        t = realloc(*trace, frames * sizeof(*t));
+        if (t == NULL)
+        {
+            munmap((void *)samples, (size_t)st.st_size);
+            return ENOMEM;
+        }
+        *trace = t;
+        *trace_len = frames;
+    }
+    t = *trace;
+
+    desa_detector_reset(d);
+    run = 0;
+    sum = 0.0;
+    for (i = 0; i < frames; i++)
+    {
+        for (k = 0; k < BLOCK; k++)
+        {
+            x[k] = (double)samples[i * BLOCK + k];
+        }
+        mean = desa2_process(d, x, BLOCK, NULL, &variance);
+        t[i].mean = (float)mean;
+        t[i].variance = (float)variance;
+
+        if (file->detection >= 0) continue;
+        if (variance < batch.threshold && mean > 0.0 && mean < DESA_FREQ_INF)
+        {
+            run++;
+            sum += mean;
+            if (run == (uint64_t)batch.hits)
+            {
+                file->detection = (int64_t)(i + 1 - run);
+                file->mean = sum / (double)run;
+            }
+        } else
+        {
+            run = 0;
+            sum = 0.0;
+        }
+    }
+    file->frames = frames;
+
+    if (frames > 0) munmap((void *)samples, (size_t)st.st_size);
+
+    return write_summary(file, t);
+}
+
+static void *
+worker(void *arg)
+{
+    desa_detector_t d;
+    desa_batch_frame_t *trace = NULL;
+    size_t trace_len = 0, i;
+
+    (void)arg;
+    desa_detector_init(&d, SAMPLE_RATE);
+    for (;;)
+    {
+        i = __sync_fetch_and_add(&batch.next, 1);
+        if (i >= batch.n) break;
+        batch.files[i].status = analyze(&batch.files[i], &d, &trace, &trace_len);
+    }
+    free(trace);
+    return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+    pthread_t *threads;
+    long threads_n;
+    size_t i;
+    int opt, failed = 0;
+    desa_batch_file_t *file;
+
+    threads_n = sysconf(_SC_NPROCESSORS_ONLN);
+    batch.ext = ".raw";
+    batch.threshold = DESA_BATCH_VARIANCE;
+    batch.hits = DESA_BATCH_HITS;
+
+    while ((opt = getopt(argc, argv, "j:o:be:v:n:l:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j':
+                threads_n = atol(optarg);
+                break;
+            case 'o':
+                batch.outdir = optarg;
+                break;
+            case 'b':
+                batch.binary = 1;
+                break;
+            case 'e':
+                batch.ext = optarg;
+                break;
+            case 'v':
+                batch.threshold = atof(optarg);
+                break;
+            case 'n':
+                batch.hits = atoi(optarg);
+                break;
+            case 'l':
+                if (add_list(optarg) != 0) return 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    for (i = (size_t)optind; i < (size_t)argc; i++)
+    {
+        if (add_input(argv[i]) != 0) return 1;
+    }
+    if (batch.n == 0 || threads_n < 1 || batch.hits < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if ((size_t)threads_n > batch.n) threads_n = (long)batch.n;
+
+    qsort(batch.files, batch.n, sizeof(*batch.files), size_cmp);
+
+    threads = malloc(threads_n * sizeof(*threads));
+    if (threads == NULL) return 1;
+    for (i = 0; i < (size_t)threads_n; i++)
+    {
+        if (pthread_create(&threads[i], NULL, worker, NULL) != 0)
+        {
+            fprintf(stderr, "Can't create thread\n");
+            threads_n = (long)i;
+            break;
+        }
+    }
+    /* if no thread could be started, work here */
+    if (threads_n == 0) worker(NULL);
+    for (i = 0; i < (size_t)threads_n; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    /* report in stable order */
+    qsort(batch.files, batch.n, sizeof(*batch.files), path_cmp);
+    for (i = 0; i < batch.n; i++)
+    {
+        file = &batch.files[i];
+        if (file->status != 0)
+        {
+            fprintf(stderr, "%s: %s\n", file->path, strerror(file->status));
+            failed++;
+        } else
+        {
+            printf("%s,%llu,%f,%f\n", file->path, (unsigned long long)file->frames,
+                    file->detection < 0 ? -1.0 : file->detection * BLOCK / SAMPLE_RATE,
+                    file->mean);
+        }
+        free(file->path);
+    }
+    free(batch.files);
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * @file    desa_detector.c
+ * @brief   Reentrant DESA-1/DESA-2 tone detectors.
+ *
+ * @author  Piotr Gregor < piotrek.gregor gmail.com >
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "desa_detector.h"
+
+/* handle errors - division by zero, square root of
+ * negative number or asin of number > 1 or < -1 */
+#define DESA_FIX_ESTIMATE(f) \
+    (isnan(f) ? 0.0 : (isinf(f) ? DESA_FREQ_INF : (f)))
+
+extern void
+desa_detector_init(desa_detector_t *d, double sample_rate)
+{
+    d->sample_rate = sample_rate;
+    desa_detector_reset(d);
+}
+
+extern void
+desa_detector_reset(desa_detector_t *d)
+{
+    d->diff1 = 0.0;
+    d->diff2 = 0.0;
+    d->diff3 = 0.0;
+    d->x1 = 0.0;
+    d->x2 = 0.0;
+    d->x3 = 0.0;
+}
+
+extern double
+desa1_process(desa_detector_t *d, const double *input, size_t len,
+        double *freq, double *variance)
+{
+    double diff0, diff1, diff2, diff3;
+    double x1, x2, x3;
+    double num;     /* numerator */
+    double den;     /* denominator */
+    double f, sum, sqsum, mean;
+    size_t i;
+
+    diff1 = d->diff1;
+    diff2 = d->diff2;
+    diff3 = d->diff3;
+    x1 = d->x1;
+    x2 = d->x2;
+    x3 = d->x3;
+    sum = 0.0;
+    sqsum = 0.0;
+
+    for (i = 0; i < len; i++)
+    {
+        diff0 = input[i] - x1;
+        num = diff2 * diff2 - diff1 * diff3
+            + diff1 * diff1 - diff0 * diff2;
+        den = x2 * x2 - x1 * x3;
+        f = d->sample_rate * asin(sqrt(num/(8.0 * den))) / M_PI;
+        f = DESA_FIX_ESTIMATE(f);
+        if (freq != NULL) freq[i] = f;
+        sum += f;
+        sqsum += f * f;
+
+        diff3 = diff2;
+        diff2 = diff1;
+        diff1 = diff0;
+        x3 = x2;
+        x2 = x1;
+        x1 = input[i];
+    }
+
+    d->diff1 = diff1;
+    d->diff2 = diff2;
+    d->diff3 = diff3;
+    d->x1 = x1;
+    d->x2 = x2;
+    d->x3 = x3;
+
+    if (len == 0)
+    {
+        *variance = 0.0;
+        return 0.0;
+    }
+    mean = sum / (double)len;
+    *variance = sqsum / (double)len - (mean * mean);
+    return mean;
+}
+
+extern double
+desa2_process(desa_detector_t *d, const double *input, size_t len,
+        double *freq, double *variance)
+{
+    double diff0, diff1, diff2;
+    double x1, x2, x3;
+    double num;     /* numerator */
+    double den;     /* denominator */
+    double f, sum, sqsum, mean;
+    size_t i;
+
+    diff1 = d->diff1;
+    diff2 = d->diff2;
+    x1 = d->x1;
+    x2 = d->x2;
+    x3 = d->x3;
+    sum = 0.0;
+    sqsum = 0.0;
+
+    for (i = 0; i < len; i++)
+    {
+        diff0 = input[i] - x2;  /* three sample derivative */
+        num = diff1 * diff1 - diff0 * diff2;
+        den = x2 * x2 - x1 * x3;
+        f = d->sample_rate * asin(sqrt(num/(4.0 * den))) / (2.0 * M_PI);
+        f = DESA_FIX_ESTIMATE(f);
+        if (freq != NULL) freq[i] = f;
+        sum += f;
+        sqsum += f * f;
+
+        diff2 = diff1;
+        diff1 = diff0;
+        x3 = x2;
+        x2 = x1;
+        x1 = input[i];
+    }
+
+    d->diff1 = diff1;
+    d->diff2 = diff2;
+    d->x1 = x1;
+    d->x2 = x2;
+    d->x3 = x3;
+
+    if (len == 0)
+    {
+        *variance = 0.0;
+        return 0.0;
+    }
+    mean = sum / (double)len;
+    *variance = sqsum / (double)len - (mean * mean);
+    return mean;
+}
+
+extern int
+desa2_batch_init(desa2_batch_t *b, size_t channels, double sample_rate)
+{
+    double *mem;
+
+    memset(b, 0, sizeof(*b));
+    if (channels == 0) return -1;
+
+    /* one allocation holding all 7 arrays */
+    mem = (double *) malloc(7 * channels * sizeof(double));
+    if (mem == NULL) return -1;
+
+    b->channels = channels;
+    b->sample_rate = sample_rate;
+    b->diff1 = mem;
+    b->diff2 = mem + channels;
+    b->x1 = mem + 2 * channels;
+    b->x2 = mem + 3 * channels;
+    b->x3 = mem + 4 * channels;
+    b->sum = mem + 5 * channels;
+    b->sqsum = mem + 6 * channels;
+    desa2_batch_reset(b);
+    return 0;
+}
+
+extern void
+desa2_batch_reset(desa2_batch_t *b)
+{
+    memset(b->diff1, 0, 7 * b->channels * sizeof(double));
+}
+
+extern void
+desa2_batch_destroy(desa2_batch_t *b)
+{
+    free(b->diff1);
+    memset(b, 0, sizeof(*b));
+}
+
+extern void
+desa2_batch_process(desa2_batch_t *b, const double *input, size_t len,
+        double *mean, double *variance)
+{
+    size_t i, c;
+    size_t channels = b->channels;
+    double * restrict diff1 = b->diff1;
+    double * restrict diff2 = b->diff2;
+    double * restrict x1 = b->x1;
+    double * restrict x2 = b->x2;
+    double * restrict x3 = b->x3;
+    double * restrict sum = b->sum;
+    double * restrict sqsum = b->sqsum;
+    const double scale = b->sample_rate / (2.0 * M_PI);
+    const double *in;
+    double diff0, num, den, f;
+
+    for (c = 0; c < channels; c++)
+    {
+        sum[c] = 0.0;
+        sqsum[c] = 0.0;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        in = input + i * channels;
+        /* same recurrence as desa2_process, one lane per channel */
+        for (c = 0; c < channels; c++)
+        {
+            diff0 = in[c] - x2[c];
+            num = diff1[c] * diff1[c] - diff0 * diff2[c];
+            den = x2[c] * x2[c] - x1[c] * x3[c];
+            f = scale * asin(sqrt(num/(4.0 * den)));
+            f = DESA_FIX_ESTIMATE(f);
+            sum[c] += f;
+            sqsum[c] += f * f;
+
+            diff2[c] = diff1[c];
+            diff1[c] = diff0;
+            x3[c] = x2[c];
+            x2[c] = x1[c];
+            x1[c] = in[c];
+        }
+    }
+
+    for (c = 0; c < channels; c++)
+    {
+        if (len == 0)
+        {
+            mean[c] = 0.0;
+            variance[c] = 0.0;
+            continue;
+        }
+        mean[c] = sum[c] / (double)len;
+        variance[c] = sqsum[c] / (double)len - (mean[c] * mean[c]);
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * @file    desa_detector.h
+ * @brief   Reentrant DESA-1/DESA-2 tone detectors.
+ *          Each stream owns its delay line, so any number of
+ *          detectors can run side by side, on any thread.
+ *
+ * @author  Piotr Gregor < piotrek.gregor gmail.com >
+ *
+ */
+
+#ifndef __DESA_DETECTOR_H__
+#define __DESA_DETECTOR_H__
+#include <stddef.h>
+#include <stdint.h>
+
+/* Value stored in place of an estimate which went to infinity
+ * (division by zero in DESA formulas). */
+#define DESA_FREQ_INF (2000.0)
+
+/* Per stream detector state (delay line of a single channel). */
+typedef struct {
+    double diff1;       /* delayed differences */
+    double diff2;
+    double diff3;
+    double x1;          /* delayed inputs */
+    double x2;
+    double x3;
+    double sample_rate;
+} desa_detector_t;
+
+extern void
+desa_detector_init(desa_detector_t *d, double sample_rate);
+
+extern void
+desa_detector_reset(desa_detector_t *d);
+
+/*
+ * Purpose: run DESA-1 over len samples, carrying the delay
+ *          line over from the previous call
+ *
+ * Parameters:
+ *      d           detector state
+ *      input       pointer to input samples
+ *      len         number of samples
+ *      freq        if not NULL, per sample frequency estimates
+ *                  (len values) are stored in here
+ *      variance    the variance of the frequency estimates
+ *
+ * Return value: mean frequency estimate in Hz
+ */
+extern double
+desa1_process(desa_detector_t *d, const double *input, size_t len,
+        double *freq, double *variance);
+
+/*
+ * Purpose: as desa1_process but using DESA-2 algorithm
+ */
+extern double
+desa2_process(desa_detector_t *d, const double *input, size_t len,
+        double *freq, double *variance);
+
+/*
+ * Bank of DESA-2 detectors for many independent channels.
+ * States are kept structure-of-arrays so the per sample update
+ * walks all the channels with unit stride.
+ */
+typedef struct {
+    size_t channels;
+    double *diff1;      /* channels entries each */
+    double *diff2;
+    double *x1;
+    double *x2;
+    double *x3;
+    double *sum;        /* scratch accumulators */
+    double *sqsum;
+    double sample_rate;
+} desa2_batch_t;
+
+/* Returns 0 on success, -1 if memory can't be allocated. */
+extern int
+desa2_batch_init(desa2_batch_t *b, size_t channels, double sample_rate);
+
+extern void
+desa2_batch_reset(desa2_batch_t *b);
+
+extern void
+desa2_batch_destroy(desa2_batch_t *b);
+
+/*
+ * Purpose: run DESA-2 over len frames of all channels
+ *
+ * Parameters:
+ *      b           bank of detectors
+ *      input       len frames, each holding b->channels interleaved
+ *                  samples (sample of channel c at time i is
+ *                  input[i * b->channels + c])
+ *      len         number of frames
+ *      mean        mean frequency estimate in Hz per channel
+ *      variance    variance of the estimates per channel
+ */
+extern void
+desa2_batch_process(desa2_batch_t *b, const double *input, size_t len,
+        double *mean, double *variance);
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * @file    rolling_stats.h
+ * @brief   Rolling mean and variance over several windows
+ *          sharing one history.
+ *
+ *          Replacement for sma_buffer_t pairs (SMA of x and SMA
+ *          of x^2, variance as their difference): each window keeps
+ *          its mean and the sum of squared deviations (M2), updated
+ *          Welford style when a sample enters and the oldest one
+ *          leaves, so variance doesn't cancel catastrophically for
+ *          large means (frequencies in Hz). Division by window
+ *          length is a multiplication by its reciprocal, the
+ *          history is indexed with a power of 2 mask. Drift of the
+ *          incremental update is removed by exact recomputation
+ *          every ROLLING_STATS_RESYNC samples of the window.
+ *
+ * @author  Piotr Gregor < piotrek.gregor gmail.com >
+ *
+ */
+
+#ifndef __ROLLING_STATS_H__
+#define __ROLLING_STATS_H__
+#include <stdlib.h>
+#include <string.h>
+
+#define ROLLING_STATS_MAX_WINDOWS   (8)
+
+/* resync period in window lengths (power of 2) */
+#define ROLLING_STATS_RESYNC        (1024)
+
+typedef struct {
+    size_t len;             /* window length in samples */
+    double inv_len;
+    double mean;
+    double m2;              /* sum of squared deviations from mean */
+    size_t resync;          /* samples until exact recomputation */
+} rolling_window_t;
+
+typedef struct {
+    double *hist;           /* last mask + 1 samples */
+    size_t mask;
+    size_t count;           /* samples appended so far */
+    size_t windows_n;
+    rolling_window_t windows[ROLLING_STATS_MAX_WINDOWS];
+} rolling_stats_t;
+
+/*
+ * Purpose: create statistics over windows_n windows
+ *
+ * Parameters:
+ *      rs          statistics
+ *      lens        window lengths (any, not 0)
+ *      windows_n   number of windows, up to ROLLING_STATS_MAX_WINDOWS
+ *
+ * Return value: 0 on success, -1 on invalid parameters or if
+ *               memory can't be allocated
+ */
+static inline int
+rolling_stats_init(rolling_stats_t *rs, const size_t *lens, size_t windows_n)
+{
+    size_t i, size = 1;
+
+    memset(rs, 0, sizeof(*rs));
+    if (windows_n == 0 || windows_n > ROLLING_STATS_MAX_WINDOWS) return -1;
+
+    for (i = 0; i < windows_n; i++)
+    {
+        if (lens[i] == 0) return -1;
+        while (size < lens[i]) size <<= 1;
+        rs->windows[i].len = lens[i];
+        rs->windows[i].inv_len = 1.0 / (double)lens[i];
+        rs->windows[i].resync = ROLLING_STATS_RESYNC * lens[i];
+    }
+
+    rs->hist = (double *)calloc(size, sizeof(double));
+    if (rs->hist == NULL) return -1;
+    rs->mask = size - 1;
+    rs->windows_n = windows_n;
+    return 0;
+}
+
+static inline void
+rolling_stats_reset(rolling_stats_t *rs)
+{
+    size_t i;
+
+    memset(rs->hist, 0, (rs->mask + 1) * sizeof(double));
+    rs->count = 0;
+    for (i = 0; i < rs->windows_n; i++)
+    {
+        rs->windows[i].mean = 0.0;
+        rs->windows[i].m2 = 0.0;
+        rs->windows[i].resync = ROLLING_STATS_RESYNC * rs->windows[i].len;
+    }
+}
+
+static inline void
+rolling_stats_destroy(rolling_stats_t *rs)
+{
+    free(rs->hist);
+    memset(rs, 0, sizeof(*rs));
+}
+
+/* Two pass mean and M2 of the last w->len samples (window full). */
+static inline void
+rolling_window_resync(const rolling_stats_t *rs, rolling_window_t *w)
+{
+    size_t i, p;
+    double mean = 0.0, m2 = 0.0, d;
+
+    p = rs->count - w->len;
+    for (i = 0; i < w->len; i++)
+    {
+        mean += rs->hist[(p + i) & rs->mask];
+    }
+    mean *= w->inv_len;
+    for (i = 0; i < w->len; i++)
+    {
+        d = rs->hist[(p + i) & rs->mask] - mean;
+        m2 += d * d;
+    }
+    w->mean = mean;
+    w->m2 = m2;
+    w->resync = ROLLING_STATS_RESYNC * w->len;
+}
+
+/*
+ * Purpose: append sample x to the history and update all windows
+ */
+static inline void
+rolling_stats_append(rolling_stats_t *rs, double x)
+{
+    size_t i, n;
+    double old, mean, delta;
+    rolling_window_t *w;
+
+    n = rs->count;
+    for (i = 0; i < rs->windows_n; i++)
+    {
+        w = &rs->windows[i];
+        if (n >= w->len)
+        {
+            /* x enters, sample len behind leaves */
+            old = rs->hist[(n - w->len) & rs->mask];
+            delta = x - old;
+            mean = w->mean + delta * w->inv_len;
+            w->m2 += delta * ((x - mean) + (old - w->mean));
+            w->mean = mean;
+        } else
+        {
+            /* warm up, plain Welford over n + 1 samples */
+            delta = x - w->mean;
+            w->mean += delta / (double)(n + 1);
+            w->m2 += delta * (x - w->mean);
+        }
+    }
+
+    rs->hist[n & rs->mask] = x;
+    rs->count = n + 1;
+
+    for (i = 0; i < rs->windows_n; i++)
+    {
+        w = &rs->windows[i];
+        if (rs->count > w->len && --w->resync == 0)
+        {
+            rolling_window_resync(rs, w);
+        }
+    }
+}
+
+/* Mean of window w (of the samples seen so far while warming up). */
+static inline double
+rolling_stats_mean(const rolling_stats_t *rs, size_t w)
+{
+    return rs->windows[w].mean;
+}
+
+/* Population variance of window w, never negative. */
+static inline double
+rolling_stats_variance(const rolling_stats_t *rs, size_t w)
+{
+    const rolling_window_t *win = &rs->windows[w];
+    double v;
+
+    if (rs->count == 0) return 0.0;
+    if (rs->count < win->len)
+    {
+        v = win->m2 / (double)rs->count;
+    } else
+    {
+        v = win->m2 * win->inv_len;
+    }
+    return v > 0.0 ? v : 0.0;
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * @file    rolling_stats_bench.c
+ * @brief   Precision and speed of rolling_stats_t against pairs
+ *          of sma_buffer_t (variance as SMA(x^2) - SMA(x)^2).
+ *          Input looks like frequency estimates of a steady tone:
+ *          large mean, small spread, long run.
+ *
+ * @author  Piotr Gregor < piotrek.gregor gmail.com >
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "buffer.h"
+#include "sma_buf.h"
+#include "rolling_stats.h"
+
+#define BENCH_N         (16 * 1024 * 1024)
+#define BENCH_WINDOWS   (3)
+#define BENCH_CHECK     (4099)      /* check every this many samples */
+
+static const size_t lens[BENCH_WINDOWS] = { 10, 64, 160 };
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* exact variance of the len samples ending at x[end - 1] */
+static double
+exact_variance(const double *x, size_t end, size_t len)
+{
+    size_t i;
+    double mean = 0.0, v = 0.0;
+
+    for (i = end - len; i < end; i++) mean += x[i];
+    mean /= (double)len;
+    for (i = end - len; i < end; i++) v += (x[i] - mean) * (x[i] - mean);
+    return v / (double)len;
+}
+
+static double
+rel_error(double v, double ref)
+{
+    return fabs(v - ref) / ref;
+}
+
+int
+main(void)
+{
+    double *x;
+    double t, e_sma[BENCH_WINDOWS] = { 0 }, e_rs[BENCH_WINDOWS] = { 0 }, ref, sink = 0.0;
+    sma_buffer_t sma[BENCH_WINDOWS], sqa[BENCH_WINDOWS];
+    rolling_stats_t rs;
+    size_t i, w;
+
+    x = (double *)malloc(BENCH_N * sizeof(double));
+    if (x == NULL) return 1;
+    srand(1);
+    for (i = 0; i < BENCH_N; i++)
+    {
+        x[i] = 1000.0 + 0.01 * (2.0 * rand() / (double)RAND_MAX - 1.0);
+    }
+
+    for (w = 0; w < BENCH_WINDOWS; w++)
+    {
+        INIT_SMA_BUFFER(&sma[w], lens[w]);
+        INIT_SMA_BUFFER(&sqa[w], lens[w]);
+    }
+    if (rolling_stats_init(&rs, lens, BENCH_WINDOWS) != 0) return 1;
+
+    /* precision */
+    for (i = 0; i < BENCH_N; i++)
+    {
+        for (w = 0; w < BENCH_WINDOWS; w++)
+        {
+            APPEND_SMA_VAL(&sma[w], x[i]);
+            APPEND_SMA_VAL(&sqa[w], x[i] * x[i]);
+        }
+        rolling_stats_append(&rs, x[i]);
+        if (i % BENCH_CHECK == BENCH_CHECK - 1)
+        {
+            for (w = 0; w < BENCH_WINDOWS; w++)
+            {
+                ref = exact_variance(x, i + 1, lens[w]);
+                t = rel_error(sqa[w].sma - sma[w].sma * sma[w].sma, ref);
+                if (t > e_sma[w]) e_sma[w] = t;
+                t = rel_error(rolling_stats_variance(&rs, w), ref);
+                if (t > e_rs[w]) e_rs[w] = t;
+            }
+        }
+    }
+    for (w = 0; w < BENCH_WINDOWS; w++)
+    {
+        printf("window %4zu: max relative variance error sma pair %.3e, rolling %.3e\n",
+                lens[w], e_sma[w], e_rs[w]);
+    }
+
+    /* speed, all windows per sample */
+    for (w = 0; w < BENCH_WINDOWS; w++)
+    {
+        RESET_SMA_BUFFER(&sma[w]);
+        RESET_SMA_BUFFER(&sqa[w]);
+    }
+    t = now();
+    for (i = 0; i < BENCH_N; i++)
+    {
+        for (w = 0; w < BENCH_WINDOWS; w++)
+        {
+            APPEND_SMA_VAL(&sma[w], x[i]);
+            APPEND_SMA_VAL(&sqa[w], x[i] * x[i]);
+            sink += sqa[w].sma - sma[w].sma * sma[w].sma;
+        }
+    }
+    t = now() - t;
+    printf("sma pairs  %8.1f Msamples/s\n", BENCH_N / t / 1e6);
+
+    rolling_stats_reset(&rs);
+    t = now();
+    for (i = 0; i < BENCH_N; i++)
+    {
+        rolling_stats_append(&rs, x[i]);
+        for (w = 0; w < BENCH_WINDOWS; w++)
+        {
+            sink += rolling_stats_variance(&rs, w);
+        }
+    }
+    t = now() - t;
+    printf("rolling    %8.1f Msamples/s\n", BENCH_N / t / 1e6);
+    printf("(%f)\n", sink);
+
+    for (w = 0; w < BENCH_WINDOWS; w++)
+    {
+        free(sma[w].data);
+        free(sqa[w].data);
+    }
+    rolling_stats_destroy(&rs);
+    free(x);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * @file    desa2_freeswitch.c
+ * @brief   DESA-2 detection as in FreeSWITCH, with persistent context.
+ *
+ * @author  Piotr Gregor < piotrek.gregor gmail.com >
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "desa2_fs.h"
+#include "desa2_freeswitch.h"
+
+extern int
+desa2_ctx_init(desa2_ctx_t *ctx, size_t block, size_t sma_len)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->block = block;
+
+    ctx->freq = (double *) malloc(block * sizeof(double));
+    if (ctx->freq == NULL) goto fail;
+    INIT_CIRC_BUFFER(&ctx->b, block);
+    INIT_SMA_BUFFER(&ctx->sma_b, sma_len);
+    INIT_SMA_BUFFER(&ctx->sqa_b, sma_len);
+    /* touch all the pages now, not during first frames */
+    memset(ctx->b.buf, 0, ctx->b.buf_len * sizeof(BUFF_TYPE));
+    memset(ctx->freq, 0, block * sizeof(double));
+    return 0;
+
+fail:
+    desa2_ctx_destroy(ctx);
+    return -1;
+}
+
+extern void
+desa2_ctx_destroy(desa2_ctx_t *ctx)
+{
+    free(ctx->b.buf);
+    free(ctx->sma_b.data);
+    free(ctx->sqa_b.data);
+    free(ctx->freq);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+/*
+ * Purpose: compute estimates of the frame starting at buffer
+ *          position start and the statistics of them
+ */
+static void
+desa2_freeswitch_frame(desa2_ctx_t *ctx, size_t start, double *mean1, double *mean2,
+        double *var1, double *var2, uint32_t sample_rate, int print, const char *name)
+{
+    size_t i, n;
+    double *freq = ctx->freq;
+    sma_buffer_t *sma_b = &ctx->sma_b;
+    sma_buffer_t *sqa_b = &ctx->sqa_b;
+
+    n = ctx->block - P;
+    /* statistics are per frame */
+	RESET_SMA_BUFFER(sma_b);
+	RESET_SMA_BUFFER(sqa_b);
+
+    // calculate the frequency estimate for each sample as in FS
+    for (i = 0; i < n; i++)
+    {
+        freq[i] = desa2_fs_tweaked(&ctx->b, start + i);
+        APPEND_SMA_VAL(sma_b, freq[i]);
+        APPEND_SMA_VAL(sqa_b, freq[i] * freq[i]);
+	*var1 = sqa_b->sma - (sma_b->sma * sma_b->sma);
+        if (print != 0)
+            printf("----%s: Mean kind-of-freq = %f, var = %f, REAL_FREQ = %f\t\tsample[%f]\n",
+            name, freq[i], *var1, TO_HZ(sample_rate, 0.5 * acos(freq[i])), GET_SAMPLE(&ctx->b, start + i));
+    }
+    /* set mean */
+    *mean1 = sma_b->sma;
+    /* calculate the variance */
+	*var1 = sqa_b->sma - (sma_b->sma * sma_b->sma);
+
+    /* for comparison calculate mean2 frequency & var2 */
+    double mean = 0.0;
+    for (i = 0; i < n; i++)
+    {
+        mean += freq[i];
+    }
+    mean /= (double) n;
+    *mean2 = mean;
+    *var2 = 0.0;
+    for (i = 0; i < n; i++ )
+    {
+        *var2 += freq[i] * freq[i];
+    }
+    *var2 /= (double) n;
+    *var2 -= (mean * mean);
+}
+
+extern void
+desa2_freeswitch_int(desa2_ctx_t *ctx, int16_t *input, double *mean1, double *mean2,
+        double *var1, double *var2, uint32_t sample_rate, int print)
+{
+    size_t start = ctx->b.pos;
+
+	INSERT_INT16_FRAME(&ctx->b, input, ctx->block);
+    desa2_freeswitch_frame(ctx, start, mean1, mean2, var1, var2, sample_rate, print, "Desa2_fs_int");
+}
+
+extern void
+desa2_freeswitch_double(desa2_ctx_t *ctx, double *input, double *mean1, double *mean2,
+        double *var1, double *var2, uint32_t sample_rate, int print)
+{
+    size_t start = ctx->b.pos;
+
+	INSERT_DOUBLE_FRAME(&ctx->b, input, ctx->block);
+    desa2_freeswitch_frame(ctx, start, mean1, mean2, var1, var2, sample_rate, print, "Desa2_fs_double");
+}
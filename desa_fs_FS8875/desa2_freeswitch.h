@@ -0,0 +1,68 @@
+/*
+ * @file    desa2_freeswitch.h
+ * @brief   DESA-2 detection as in FreeSWITCH, with persistent context.
+ *          All the buffers are allocated once in desa2_ctx_init,
+ *          processing of a frame doesn't touch the heap.
+ *
+ * @author  Piotr Gregor < piotrek.gregor gmail.com >
+ *
+ */
+
+#ifndef __DESA2_FREESWITCH_H__
+#define __DESA2_FREESWITCH_H__
+#include <stdint.h>
+#include "buffer.h"
+#include "sma_buf.h"
+
+/*! Number of points in desa2 sample */
+#define P (5)
+/*! Conversion to Hertz */
+#define TO_HZ(r, f) (((r) * (f)) / (2.0 * M_PI))
+
+typedef struct {
+    size_t          block;      /* samples in each frame */
+    circ_buffer_t   b;          /* power of 2 length, frames are appended */
+    sma_buffer_t    sma_b;
+    sma_buffer_t    sqa_b;
+    double          *freq;      /* estimates of current frame */
+} desa2_ctx_t;
+
+/*
+ * Purpose: allocate context for frames of block samples
+ *
+ * Parameters:
+ *      ctx         context
+ *      block       number of samples in each frame
+ *      sma_len     length of SMA windows
+ *
+ * Return value: 0 on success, -1 if memory can't be allocated
+ */
+extern int
+desa2_ctx_init(desa2_ctx_t *ctx, size_t block, size_t sma_len);
+
+extern void
+desa2_ctx_destroy(desa2_ctx_t *ctx);
+
+/*
+ * Purpose: detect a tone using DESA-2 algorithm
+ *          as in FreeSWITCH's current implementation.
+ *
+ * Parameters:
+ *      ctx         context created by desa2_ctx_init
+ *      input       pointer to ctx->block input samples
+ *      mean1       SMA of the estimates
+ *      mean2       mean of the estimates
+ *      var1        variance computed from SMAs
+ *      var2        variance of the estimates
+ *      sample_rate sample rate of input
+ *      print       dump each estimate if not 0
+ */
+extern void
+desa2_freeswitch_int(desa2_ctx_t *ctx, int16_t *input, double *mean1, double *mean2,
+        double *var1, double *var2, uint32_t sample_rate, int print);
+
+extern void
+desa2_freeswitch_double(desa2_ctx_t *ctx, double *input, double *mean1, double *mean2,
+        double *var1, double *var2, uint32_t sample_rate, int print);
+
+#endif
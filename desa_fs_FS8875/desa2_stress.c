@@ -0,0 +1,151 @@
+/*
+ * @file    desa2_stress.c
+ * @brief   Stress test of persistent DESA-2 context.
+ *          Drives millions of frames through desa2_freeswitch_int
+ *          and desa2_freeswitch_double and checks that after
+ *          initialization there are no heap allocations and
+ *          resident set size stays flat.
+ *          Linked with -Wl,--wrap=malloc,... so every allocation
+ *          made by detector code is counted here.
+ *
+ * @author  Piotr Gregor < piotrek.gregor gmail.com >
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "desa2_freeswitch.h"
+
+#define BLOCK           160
+#define SAMPLE_RATE     8000
+#define TONES           17
+#define FRAMES_DEFAULT  (2 * 1000 * 1000)
+#define REPORT_EVERY    (250 * 1000)
+/* pages RSS may grow by after the first report (stdio etc.) */
+#define RSS_SLACK_PAGES (16)
+
+static size_t malloc_calls = 0;
+
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t nmemb, size_t size);
+extern void *__real_realloc(void *ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size)
+{
+    ++malloc_calls;
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+    ++malloc_calls;
+    return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+    ++malloc_calls;
+    return __real_realloc(ptr, size);
+}
+
+/* resident set size in pages, 0 on error */
+static long
+rss_pages(void)
+{
+    long size, resident;
+    FILE *fp;
+
+    fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL) return 0;
+    if (fscanf(fp, "%ld %ld", &size, &resident) != 2) resident = 0;
+    fclose(fp);
+    return resident;
+}
+
+int
+main(int argc, char *argv[])
+{
+    desa2_ctx_t ctx_int, ctx_double;
+    int16_t intData[TONES][BLOCK];
+    double doubleData[TONES][BLOCK];
+    double mean1, mean2, var1, var2;
+    double checksum;
+    long frames, f, rss, rss_base;
+    size_t mallocs_after_init;
+    int i, t, ret;
+
+    frames = FRAMES_DEFAULT;
+    if (argc == 2)
+    {
+        frames = atol(argv[1]);
+    } else if (argc > 2)
+    {
+        printf("Incorrect arguments, usage:\n\tdesa2_stress [frames]\n");
+        return 1;
+    }
+
+    if (desa2_ctx_init(&ctx_int, BLOCK, 160) != 0 ||
+            desa2_ctx_init(&ctx_double, BLOCK, 40) != 0)
+    {
+        printf("Cannot allocate detector context\n");
+        return 1;
+    }
+    mallocs_after_init = malloc_calls;
+
+    /* tones of 400 - 2000Hz, changing every frame */
+    for (t = 0; t < TONES; t++)
+    {
+        for (i = 0; i < BLOCK; i++)
+        {
+            doubleData[t][i] = sin(2.0 * M_PI * (400.0 + t * 100.0) * i / SAMPLE_RATE);
+            intData[t][i] = (int16_t)(doubleData[t][i] * 16000.0);
+        }
+    }
+
+    /* let stdio allocate its buffers before RSS is sampled */
+    printf("running [%ld] frames, rss [%ld] pages\n", frames, rss_pages());
+
+    checksum = 0.0;
+    rss_base = 0;
+    ret = 0;
+    for (f = 0; f < frames; f++)
+    {
+        t = f % TONES;
+        desa2_freeswitch_int(&ctx_int, intData[t], &mean1, &mean2, &var1, &var2, SAMPLE_RATE, 0);
+        checksum += mean1 + var2;
+        desa2_freeswitch_double(&ctx_double, doubleData[t], &mean1, &mean2, &var1, &var2, SAMPLE_RATE, 0);
+        checksum += mean2 + var1;
+
+        if ((f + 1) % REPORT_EVERY == 0 || f + 1 == frames)
+        {
+            rss = rss_pages();
+            if (rss_base == 0) rss_base = rss;
+            printf("frames [%ld] rss [%ld] pages, mallocs after init [%zu]\n",
+                    f + 1, rss, malloc_calls - mallocs_after_init);
+            if (rss > rss_base + RSS_SLACK_PAGES)
+            {
+                printf("FAIL: RSS grew from [%ld] to [%ld] pages\n", rss_base, rss);
+                ret = 1;
+            }
+        }
+    }
+
+    if (malloc_calls != mallocs_after_init)
+    {
+        printf("FAIL: [%zu] allocations after init\n", malloc_calls - mallocs_after_init);
+        ret = 1;
+    }
+
+    desa2_ctx_destroy(&ctx_int);
+    desa2_ctx_destroy(&ctx_double);
+
+    printf("%s: [%ld] frames, checksum [%f]\n", ret == 0 ? "PASS" : "FAIL", frames, checksum);
+    return ret;
+}
@@ -16,9 +16,9 @@
 #include "buffer.h"
 #include "sma_buf.h"
 #include "desa2_fs.h"
+#include "desa2_freeswitch.h"
  
 #define BLOCK       160         /* samples processed in each invocation */
-#define TO_HZ(r, f) (((r) * (f)) / (2.0 * M_PI))
 
 #define DESA_MAX(a, b) (a) > (b) ? (a) : (b)
 #define MEDIAN_FILTER(a, b, c) (a) > (b) ? ((a) > (c) ? \
@@ -172,127 +172,6 @@ desa2(double *input, double *variance, uint32_t sample_rate)
     return mean;
 }
 
-/*
- * Purpose: detect a tone using DESA-2 algorithm
- *          as in FreeSWITCH's current implementation.
- *
- * Parameters:
- *      input       pointer to input samples
- *      variance    the variance of the frequency estimates
- *
- * Return value: frequency estimate in Hz
- */
-/*! Number of points in desa2 sample */
-#define P (5)
-/*! Conversion to Hertz */
-#define TO_HZ(r, f) (((r) * (f)) / (2.0 * M_PI))
-void
-desa2_freeswitch_int(int16_t *input, double *mean1, double *mean2, double *var1, double *var2, uint32_t sample_rate, int print)
-{
-    int i;
-    circ_buffer_t   b;
-	sma_buffer_t    sma_b;
-	sma_buffer_t    sqa_b;
-    double freq[BLOCK]; // frequency estimates
-
-    INIT_CIRC_BUFFER(&b, BLOCK);
-	INIT_SMA_BUFFER(&sma_b, 160);
-	INIT_SMA_BUFFER(&sqa_b, 160);
-
-	INSERT_INT16_FRAME(&b, input, BLOCK);
-
-    // calculate the frequency estimate for each sample as in FS
-    for (i = 0; i < (BLOCK - P); i++)
-    {
-        freq[i] = desa2_fs_tweaked(&b, i);
-        APPEND_SMA_VAL(&sma_b, freq[i]);
-        APPEND_SMA_VAL(&sqa_b, freq[i] * freq[i]);
-	*var1 = sqa_b.sma - (sma_b.sma * sma_b.sma);
-/*	printf("<<< AVMD v[%f] f[%f][%f]Hz sma[%f][%f]Hz sqa[%f]\tsample[%d]\t[%d] >>>\n",
-            *var1, freq[i], TO_HZ(sample_rate, freq[i]), sma_b.sma, TO_HZ(sample_rate, sma_b.sma), sqa_b.sma, i, input[i]); */
-        if (print != 0)
-            printf("----Desa2_fs_int: Mean kind-of-freq = %f, var = %f, REAL_FREQ = %f\t\tsample[%f]\n",
-            freq[i], *var1, TO_HZ(sample_rate, 0.5 * acos(freq[i])), input[i]);
-    }
-    /* set mean */
-    *mean1 = sma_b.sma;
-    /* calculate the variance */
-	*var1 = sqa_b.sma - (sma_b.sma * sma_b.sma);
-
-    /* for comparison calculate mean2 frequency & var2 */
-    double mean = 0.0;
-    for (i = 0; i < (BLOCK - P); i++)
-    {
-        mean += freq[i];
-    }
-    mean /= (double) (BLOCK - P);
-    *mean2 = mean;
-    *var2 = 0.0;
-    for (i = 0; i < (BLOCK - P); i++ )
-    {
-        *var2 += freq[i] * freq[i];
-    }
-    *var2 /= (double)(BLOCK - P);
-    *var2 -= (mean * mean);
- 
-    free(b.buf);
-    return;
-}
-
-void
-desa2_freeswitch_double(double *input, double *mean1, double *mean2, double *var1, double *var2, uint32_t sample_rate)
-{
-    int i;
-    circ_buffer_t   b;
-	sma_buffer_t    sma_b;
-	sma_buffer_t    sqa_b;
-    double freq[BLOCK]; // frequency estimates
-
-    INIT_CIRC_BUFFER(&b, BLOCK);
-	INIT_SMA_BUFFER(&sma_b, 40);
-	INIT_SMA_BUFFER(&sqa_b, 40);
-
-	INSERT_DOUBLE_FRAME(&b, input, BLOCK);
-
-    // calculate the frequency estimate for each sample as in FS
-    for (i = 0; i < (BLOCK - P); i++)
-    {
-        freq[i] = desa2_fs_tweaked(&b, i);
-        APPEND_SMA_VAL(&sma_b, freq[i]);
-        APPEND_SMA_VAL(&sqa_b, freq[i] * freq[i]);
-	*var1 = sqa_b.sma - (sma_b.sma * sma_b.sma);
-/*	printf("<<< AVMD v[%f] f[%f][%f]Hz sma[%f][%f]Hz sqa[%f]\tsample[%d]\t[%f][%f]>>>\n",
-            *var1, freq[i], TO_HZ(sample_rate, freq[i]), sma_b.sma, TO_HZ(sample_rate, sma_b.sma), sqa_b.sma, i, input[i], GET_SAMPLE((&b), i)); */
-        printf("----Desa2_fs_double: Mean kind-of-freq = %f, var = %f, REAL_FREQ = %f\t\tsample[%f]\n",
-            freq[i], *var1, TO_HZ(sample_rate, 0.5 * acos(freq[i])), input[i]);
-    }
-    /* set mean */
-    *mean1 = sma_b.sma;
-    /* calculate the variance */
-	*var1 = sqa_b.sma - (sma_b.sma * sma_b.sma);
-
-    /* for comparison calculate mean2 frequency & var2 */
-    double mean = 0.0;
-    for (i = 0; i < (BLOCK - P); i++)
-    {
-        mean += freq[i];
-    }
-    mean /= (double) (BLOCK - P);
-    *mean2 = mean;
-    *var2 = 0.0;
-    for (i = 0; i < (BLOCK - P); i++ )
-    {
-        *var2 += freq[i] * freq[i];
-    }
-    *var2 /= (double)(BLOCK - P);
-    *var2 -= (mean * mean);
- 
-    free(b.buf);
-    free(sma_b.data);
-    free(sqa_b.data);
-    return;
-}
-
 // convert 16 bit ints to doubles
 void
 intToFloat(int16_t *input, double *output, int length)
@@ -322,6 +201,7 @@ main(int argc, char *argv[])
     FILE *inFile;
     uint32_t sample_rate;
     int frame_n;
+    desa2_ctx_t ctx_int, ctx_double;
  
     inFileName = NULL;
  
@@ -344,6 +224,14 @@ main(int argc, char *argv[])
         return(1);
     }
  
+    if (desa2_ctx_init(&ctx_int, BLOCK, 160) != 0 ||
+            desa2_ctx_init(&ctx_double, BLOCK, 40) != 0)
+    {
+        printf("Exiting. Cannot allocate detector context\n");
+        fclose(inFile);
+        return(1);
+    }
+
     // start counting frames
     sampleCount = 0;
  
@@ -382,11 +270,11 @@ main(int argc, char *argv[])
         printf("Desa2: Mean kind-of-freq = %f, var = %f, std dev = %f, REAL_FREQ = %f\n",
             frequency, variance, sqrt(variance), sample_rate * asin(sqrt(frequency/4.0)) / (2.0 * M_PI));
 
-        desa2_freeswitch_int(intData, &frequency, &freq2, &variance, &var2, sample_rate, frame_n);
+        desa2_freeswitch_int(&ctx_int, intData, &frequency, &freq2, &variance, &var2, sample_rate, frame_n);
         printf("Desa2_fs_int: Mean kind-of-freq = %f, var = %f, std dev = %f, freq2 = %f, var2 = %f, REAL_FREQ = %f\n",
             frequency, variance, sqrt(variance), freq2, var2, TO_HZ(sample_rate, 0.5 * acos(frequency)));
 
-        /*desa2_freeswitch_double(inputData, &frequency, &freq2, &variance, &var2, sample_rate);
+        /*desa2_freeswitch_double(&ctx_double, inputData, &frequency, &freq2, &variance, &var2, sample_rate, 1);
         printf("Desa2_fs_double: Mean kind-of-freq = %f, var = %f, std dev = %f, freq2 = %f, var2 = %f, REAL_FREQ = %f\n",
             frequency, variance, sqrt(variance), freq2, var2, TO_HZ(sample_rate, 0.5 * (double)acos(frequency)));
  */
@@ -396,6 +284,8 @@ main(int argc, char *argv[])
  
     printf("\nFinished. sampleCount = %d\n",sampleCount);
  
+    desa2_ctx_destroy(&ctx_int);
+    desa2_ctx_destroy(&ctx_double);
     fclose( inFile );
     return 0;
 }
@@ -0,0 +1,78 @@
+/*
+ * @file    acosf_poly.c
+ * @brief   Table free arc cosine over arrays, kernel picked at runtime.
+ */
+
+#include <stddef.h>
+
+#include "acosf_poly.h"
+
+static void
+acosf_poly_array_1(const float *x, float *y, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        y[i] = acosf_poly(x[i]);
+    }
+}
+
+#ifdef ACOSF_POLY_X86
+__attribute__((target("sse2")))
+static void
+acosf_poly_array_4(const float *x, float *y, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, acosf_poly4(_mm_loadu_ps(x + i)));
+    }
+    acosf_poly_array_1(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx")))
+static void
+acosf_poly_array_8(const float *x, float *y, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, acosf_poly8(_mm256_loadu_ps(x + i)));
+    }
+    acosf_poly_array_1(x + i, y + i, n - i);
+}
+#endif
+
+extern int
+acosf_poly_array_lanes(const float *x, float *y, size_t n, int lanes)
+{
+    switch (lanes)
+    {
+        case 1:
+            acosf_poly_array_1(x, y, n);
+            return 0;
+#ifdef ACOSF_POLY_X86
+        case 4:
+            if (!__builtin_cpu_supports("sse2")) return -1;
+            acosf_poly_array_4(x, y, n);
+            return 0;
+        case 8:
+            if (!__builtin_cpu_supports("avx")) return -1;
+            acosf_poly_array_8(x, y, n);
+            return 0;
+#endif
+        default:
+            return -1;
+    }
+}
+
+extern void
+acosf_poly_array(const float *x, float *y, size_t n)
+{
+    if (acosf_poly_array_lanes(x, y, n, 8) == 0) return;
+    if (acosf_poly_array_lanes(x, y, n, 4) == 0) return;
+    acosf_poly_array_1(x, y, n);
+}
@@ -0,0 +1,150 @@
+/*
+ * @file    acosf_poly.h
+ * @brief   Table free arc cosine.
+ *
+ *          acos(x) = sqrt(1 - x) * P(x) for x in [0, 1] and
+ *          acos(x) = PI - acos(-x) for x in [-1, 0),
+ *          P fitted to minimise max absolute error of acos.
+ *          As acosf, returns NaN for |x| > 1.
+ *
+ *          Degree of P is chosen at compile time. By default
+ *          it follows ACOS_TABLE_DISCARDED_BITS so that error
+ *          is comparable to the table of that resolution
+ *          (error of the table away from +-1), define
+ *          ACOSF_POLY_DEGREE to 1, 2, 3, 4, 5 or 7 to override.
+ *          Errors are the largest over every float in [-1, 1],
+ *          float rounding included:
+ *
+ *          degree  max abs error   table resolution
+ *          7       3.5e-7          3, 4
+ *          5       9.7e-7          5 - 8
+ *          4       5.1e-6          9 - 11
+ *          3       3.8e-5          12 - 14
+ *          2       3.3e-4          15 - 17
+ *          1       3.2e-3          18 - 26
+ */
+
+#ifndef __ACOSF_POLY_H__
+#define __ACOSF_POLY_H__
+#include <stddef.h>
+#include <math.h>
+
+#include "fast_acosf.h"
+
+#ifndef ACOSF_POLY_DEGREE
+#if ACOS_TABLE_DISCARDED_BITS <= 4
+#define ACOSF_POLY_DEGREE (7)
+#elif ACOS_TABLE_DISCARDED_BITS <= 8
+#define ACOSF_POLY_DEGREE (5)
+#elif ACOS_TABLE_DISCARDED_BITS <= 11
+#define ACOSF_POLY_DEGREE (4)
+#elif ACOS_TABLE_DISCARDED_BITS <= 14
+#define ACOSF_POLY_DEGREE (3)
+#elif ACOS_TABLE_DISCARDED_BITS <= 17
+#define ACOSF_POLY_DEGREE (2)
+#else
+#define ACOSF_POLY_DEGREE (1)
+#endif
+#endif
+
+#if ACOSF_POLY_DEGREE == 7
+#define ACOSF_POLY_COEFS \
+    1.570796314e+00f, -2.145998924e-01f, 8.899926422e-02f, -5.031277867e-02f, \
+    3.133544775e-02f, -1.780894181e-02f, 7.245410292e-03f, -1.441467096e-03f
+#elif ACOSF_POLY_DEGREE == 5
+#define ACOSF_POLY_COEFS \
+    1.570795690e+00f, -2.145428161e-01f, 8.817104736e-02f, -4.592720836e-02f, \
+    2.062003496e-02f, -4.911162401e-03f
+#elif ACOSF_POLY_DEGREE == 4
+#define ACOSF_POLY_COEFS \
+    1.570791534e+00f, -2.142806099e-01f, 8.563837088e-02f, -3.761820387e-02f, \
+    9.732961493e-03f
+#elif ACOSF_POLY_DEGREE == 3
+#define ACOSF_POLY_COEFS \
+    1.570758340e+00f, -2.128751787e-01f, 7.689736853e-02f, -2.089202167e-02f
+#elif ACOSF_POLY_DEGREE == 2
+#define ACOSF_POLY_COEFS \
+    1.570470260e+00f, -2.054975199e-01f, 5.138950468e-02f
+#elif ACOSF_POLY_DEGREE == 1
+#define ACOSF_POLY_COEFS \
+    1.567589348e+00f, -1.682579998e-01f
+#else
+#error "ACOSF_POLY_DEGREE must be 1, 2, 3, 4, 5 or 7"
+#endif
+
+#define ACOSF_POLY_PI (3.14159265358979f)
+
+static const float acosf_poly_coefs[ACOSF_POLY_DEGREE + 1] = { ACOSF_POLY_COEFS };
+
+static inline float
+acosf_poly(float x)
+{
+    int i;
+    float a, p;
+
+    a = fabsf(x);
+    p = acosf_poly_coefs[ACOSF_POLY_DEGREE];
+    for (i = ACOSF_POLY_DEGREE - 1; i >= 0; i--)
+    {
+        p = p * a + acosf_poly_coefs[i];
+    }
+    p *= sqrtf(1.0f - a);
+    return (x < 0.0f) ? (ACOSF_POLY_PI - p) : p;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ACOSF_POLY_X86 1
+#include <immintrin.h>
+
+/* 4 lanes */
+__attribute__((target("sse2")))
+static inline __m128
+acosf_poly4(__m128 x)
+{
+    int i;
+    __m128 a, p, neg;
+
+    a = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    p = _mm_set1_ps(acosf_poly_coefs[ACOSF_POLY_DEGREE]);
+    for (i = ACOSF_POLY_DEGREE - 1; i >= 0; i--)
+    {
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(acosf_poly_coefs[i]));
+    }
+    p = _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)));
+    neg = _mm_cmplt_ps(x, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(_mm_set1_ps(ACOSF_POLY_PI), p)),
+            _mm_andnot_ps(neg, p));
+}
+
+/* 8 lanes, callers must be built for AVX (or use acosf_poly_array) */
+__attribute__((target("avx")))
+static inline __m256
+acosf_poly8(__m256 x)
+{
+    int i;
+    __m256 a, p, neg;
+
+    a = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+    p = _mm256_set1_ps(acosf_poly_coefs[ACOSF_POLY_DEGREE]);
+    for (i = ACOSF_POLY_DEGREE - 1; i >= 0; i--)
+    {
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(acosf_poly_coefs[i]));
+    }
+    p = _mm256_mul_ps(p, _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), a)));
+    neg = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ);
+    return _mm256_or_ps(_mm256_and_ps(neg, _mm256_sub_ps(_mm256_set1_ps(ACOSF_POLY_PI), p)),
+            _mm256_andnot_ps(neg, p));
+}
+#endif /* x86 */
+
+/*
+ * y[i] = acos(x[i]) for n values, using the widest kernel
+ * the CPU supports (AVX, SSE2 or scalar).
+ */
+extern void acosf_poly_array(const float *x, float *y, size_t n);
+
+/* The same with kernel forced: 1 (scalar), 4 or 8 lanes. Returns -1
+ * if the CPU or build doesn't support it. */
+extern int acosf_poly_array_lanes(const float *x, float *y, size_t n, int lanes);
+
+#endif
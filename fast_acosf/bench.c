@@ -0,0 +1,144 @@
+/*
+ * @file    bench.c
+ * @brief   Throughput and max error of arc cosine variants:
+ *          libm acosf, mapped table (fast_acosf) and polynomial
+ *          (scalar, 4 and 8 lanes).
+ *          Input is random in [-1, 1] and larger than caches so
+ *          table lookups are random accesses, as in detector.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "fast_acosf.h"
+#include "acosf_poly.h"
+
+#define BENCH_N         (4 * 1024 * 1024)
+#define BENCH_ROUNDS    (10)
+
+static float *x_in;
+static float *y_out;
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+run_acosf(void)
+{
+    size_t i;
+    for (i = 0; i < BENCH_N; i++) y_out[i] = acosf(x_in[i]);
+}
+
+static void
+run_table(void)
+{
+    size_t i;
+    for (i = 0; i < BENCH_N; i++) y_out[i] = fast_acosf(x_in[i]);
+}
+
+static void
+run_poly_1(void)
+{
+    acosf_poly_array_lanes(x_in, y_out, BENCH_N, 1);
+}
+
+static void
+run_poly_4(void)
+{
+    acosf_poly_array_lanes(x_in, y_out, BENCH_N, 4);
+}
+
+static void
+run_poly_8(void)
+{
+    acosf_poly_array_lanes(x_in, y_out, BENCH_N, 8);
+}
+
+/* max abs error against double acos, over the whole input */
+static double
+max_error(double *at)
+{
+    size_t i;
+    double e, max = 0.0;
+
+    for (i = 0; i < BENCH_N; i++)
+    {
+        e = fabs((double)y_out[i] - acos((double)x_in[i]));
+        if (e > max)
+        {
+            max = e;
+            *at = x_in[i];
+        }
+    }
+    return max;
+}
+
+static void
+bench(const char *name, void (*fn)(void))
+{
+    int r;
+    double t, best, err, at = 0.0;
+
+    best = 1e9;
+    for (r = 0; r < BENCH_ROUNDS; r++)
+    {
+        t = now();
+        fn();
+        t = now() - t;
+        if (t < best) best = t;
+    }
+    err = max_error(&at);
+    printf("%-14s %10.1f Msamples/s   max error %.3e (at x = %f)\n",
+            name, BENCH_N / best / 1e6, err, at);
+}
+
+int
+main(void)
+{
+    size_t i;
+    int ret;
+
+    x_in = (float *) malloc(BENCH_N * sizeof(float));
+    y_out = (float *) malloc(BENCH_N * sizeof(float));
+    if (x_in == NULL || y_out == NULL) return -1;
+
+    srand(1);
+    for (i = 0; i < BENCH_N; i++)
+    {
+        x_in[i] = 2.0f * ((float)rand() / (float)RAND_MAX) - 1.0f;
+    }
+
+    printf("table resolution [%d] discarded bits, [%zu] bytes; polynomial degree [%d]\n",
+            ACOS_TABLE_DISCARDED_BITS, (size_t)ACOS_TABLE_LENGTH * sizeof(float),
+            ACOSF_POLY_DEGREE);
+
+    bench("acosf", run_acosf);
+
+    ret = init_fast_acosf();
+    if (ret == 0)
+    {
+        bench("table", run_table);
+        destroy_fast_acosf();
+    } else
+    {
+        printf("%-14s can't init table [%d]\n", "table", ret);
+    }
+
+    bench("poly", run_poly_1);
+    if (acosf_poly_array_lanes(x_in, y_out, 4, 4) == 0)
+        bench("poly x4", run_poly_4);
+    if (acosf_poly_array_lanes(x_in, y_out, 8, 8) == 0)
+        bench("poly x8", run_poly_8);
+
+    free(x_in);
+    free(y_out);
+    return 0;
+}
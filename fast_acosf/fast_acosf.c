@@ -0,0 +1,250 @@
+/*
+ * @file    fast_acosf.c
+ * @brief   Arc cosine from precomputed table mapped into memory.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+
+#include "fast_acosf.h"
+
+static float    *acos_table = NULL;
+static void     *acos_map = NULL;       /* header followed by table */
+static size_t   acos_map_size = 0;
+
+extern float fast_acosf(float x)
+{
+    return acos_table[index_from_float(x)];
+}
+
+extern uint32_t index_from_float(float f)
+{
+    float_conv_t d;
+    d.f = f;
+    return ((d.i & SIGN_MASK) >> (32 - ACOS_TABLE_DATA_BITS)) | 
+        ((d.i & DATA_MASK) >> ACOS_TABLE_DISCARDED_BITS);
+}
+
+extern float float_from_index(uint32_t d)
+{
+    float_conv_t f;
+    f.i = ((d & SIGN_UNPACK_MASK) << (32 - ACOS_TABLE_DATA_BITS)) | 
+        ((d & DATA_UNPACK_MASK) << ACOS_TABLE_DISCARDED_BITS) | CONST_DATA_MASK;
+    return f.f;
+}
+
+
+/* FNV-1a over table data */
+static uint64_t table_checksum(const float *table, size_t len)
+{
+    const unsigned char *p = (const unsigned char *) table;
+    size_t  i, n = len * sizeof(float);
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void table_header_init(acos_table_header_t *h)
+{
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, ACOS_TABLE_MAGIC, sizeof(h->magic));
+    h->version = ACOS_TABLE_VERSION;
+    h->data_offset = ACOS_TABLE_DATA_OFFSET;
+    h->const_exponent = ACOS_TABLE_CONST_EXPONENT;
+    h->const_exponent_bits = ACOS_TABLE_CONST_EXPONENT_BITS;
+    h->discarded_bits = ACOS_TABLE_DISCARDED_BITS;
+    h->length = ACOS_TABLE_LENGTH;
+}
+
+/* 0 if header describes table of this build's resolution */
+static int table_header_check(const acos_table_header_t *h, off_t file_size)
+{
+    acos_table_header_t expected;
+
+    table_header_init(&expected);
+    if (memcmp(h->magic, expected.magic, sizeof(h->magic)) != 0) return -1;
+    if (h->version != expected.version) return -2;
+    if (h->data_offset != expected.data_offset ||
+            h->const_exponent != expected.const_exponent ||
+            h->const_exponent_bits != expected.const_exponent_bits ||
+            h->discarded_bits != expected.discarded_bits ||
+            h->length != expected.length) return -3;
+    if (file_size != (off_t) ACOS_TABLE_FILE_SIZE) return -4;
+    return 0;
+}
+
+/*
+ * Write table to a temporary file next to path and rename it
+ * over path, so other processes see either no file or complete one.
+ */
+extern int compute_table(const char *path)
+{
+    uint32_t    i;
+    float       *table;
+    FILE        *acos_table_file;
+    char        tmp_path[PATH_MAX];
+    acos_table_header_t *h;
+    unsigned char *file_data;
+    int         ret;
+
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", path, (long) getpid())
+            >= (int) sizeof(tmp_path)) {
+        return -1;
+    }
+
+    file_data = (unsigned char *) calloc(1, ACOS_TABLE_FILE_SIZE);
+    if (file_data == NULL) return -1;
+    h = (acos_table_header_t *) file_data;
+    table = (float *) (file_data + ACOS_TABLE_DATA_OFFSET);
+
+    for (i = 0; i < ACOS_TABLE_LENGTH; i++) {
+        table[i] = acosf(float_from_index(i));
+    }
+    table_header_init(h);
+    h->checksum = table_checksum(table, ACOS_TABLE_LENGTH);
+
+    ret = 0;
+    acos_table_file = fopen(tmp_path, "w");
+    if (acos_table_file == NULL) {
+        ret = -1;
+        goto out;
+    }
+    if (fwrite(file_data, ACOS_TABLE_FILE_SIZE, 1, acos_table_file) != 1) {
+        fclose(acos_table_file);
+        ret = -1;
+        goto fail;
+    }
+    if (fflush(acos_table_file) != 0 || fsync(fileno(acos_table_file)) != 0) {
+        fclose(acos_table_file);
+        ret = -2;
+        goto fail;
+    }
+    if (fclose(acos_table_file) != 0) {
+        ret = -2;
+        goto fail;
+    }
+    if (rename(tmp_path, path) != 0) {
+        ret = -3;
+        goto fail;
+    }
+    goto out;
+
+fail:
+    unlink(tmp_path);
+out:
+    free(file_data);
+    return ret;
+}
+
+/*
+ * Map table file, 0 on success, -1 if the file is not there,
+ * -2 if it is there but not valid for this build, < -2 on errors.
+ */
+static int map_table(const char *path, int flags)
+{
+    int     fd;
+    struct stat st;
+    void    *map;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) return (errno == ENOENT) ? -1 : -3;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -3;
+    }
+    if (st.st_size < (off_t) sizeof(acos_table_header_t)) {
+        close(fd);
+        return -2;
+    }
+
+    map = mmap(
+            NULL,                               /* kernel chooses the address at which to create the mapping */
+            st.st_size,
+            PROT_READ,
+            MAP_SHARED | MAP_POPULATE,          /* read-ahead on the file.  Later accesses  to  the  mapping
+                                                 * will not be blocked by page faults */
+            fd,
+            0
+            );
+    /* mapping stays valid after close */
+    close(fd);
+    if (map == MAP_FAILED) return -4;
+
+    if (table_header_check((const acos_table_header_t *) map, st.st_size) != 0 ||
+            ((flags & FAST_ACOSF_VERIFY) &&
+             table_checksum((const float *) ((char *) map + ACOS_TABLE_DATA_OFFSET), ACOS_TABLE_LENGTH)
+                != ((const acos_table_header_t *) map)->checksum)) {
+        munmap(map, st.st_size);
+        return -2;
+    }
+
+#ifdef MADV_HUGEPAGE
+    /* takes effect if file lives on huge page tmpfs or kernel
+     * does read only THP for page cache, ignored otherwise */
+    if (flags & FAST_ACOSF_HUGEPAGES) {
+        (void) madvise(map, st.st_size, MADV_HUGEPAGE);
+    }
+#endif
+
+    acos_map = map;
+    acos_map_size = st.st_size;
+    acos_table = (float *) ((char *) map + ACOS_TABLE_DATA_OFFSET);
+    return 0;
+}
+
+extern int init_fast_acosf_file(const char *path, int flags)
+{
+    int     ret;
+
+    if (acos_table != NULL) return 0;
+
+    ret = map_table(path, flags);
+    if (ret == 0) {
+        fprintf(stderr, "Using previously created file [%s]\n", path);
+        return 0;
+    }
+    if (ret != -1 && ret != -2) return -1;
+
+    fprintf(stderr,
+            "File [%s] %s. Creating file...\n", path,
+            (ret == -1) ? "doesn't exist" : "is not a valid table for this build"
+           );
+    if (compute_table(path) != 0) return -2;
+
+    ret = map_table(path, flags);
+    if (ret == -4) return -4;
+    if (ret != 0) return -3;
+    return 0;
+}
+
+extern int init_fast_acosf(void)
+{
+    return init_fast_acosf_file(ACOS_TABLE_FILENAME, 0);
+}
+
+extern int destroy_fast_acosf(void)
+{
+    if (acos_map == NULL) return 0;
+    if (munmap(acos_map, acos_map_size) == -1) return -1;
+    /* disable use of fast arc cosine file */
+    acos_map = NULL;
+    acos_map_size = 0;
+    acos_table = NULL;
+
+    return 0;
+}
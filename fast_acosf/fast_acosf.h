@@ -0,0 +1,94 @@
+/*
+ * @file    fast_acosf.h
+ * @brief   Arc cosine from precomputed table mapped into memory.
+ */
+
+#ifndef __FAST_ACOSF_H__
+#define __FAST_ACOSF_H__
+#include <stddef.h>
+#include <stdint.h>
+
+/* 
+ * Manipulate these parameters to change
+ * mapping's resolution. The sine tone
+ * of 1600Hz is detected even with 20
+ * bits discarded in float integer representation
+ * with only slightly increased amount of false
+ * positives (keeping variance threshold on 0.0001).
+ * 12 bits seem to be good choice when there is
+ * a need to compute faster and/or decrease mapped file
+ * size on disk while keeping false positives low.
+ */
+#define ACOS_TABLE_CONST_EXPONENT (0x70)
+#define ACOS_TABLE_CONST_EXPONENT_BITS (3)
+#define ACOS_TABLE_DISCARDED_BITS (20)
+/* rosolution:
+    3: 15 728 640 indices spreading range [0.0, 1.0], table size on disk 134 217 728 bytes
+    4:  7 364 320 indices spreading range [0.0, 1.0], table size on disk  67 108 864 bytes
+    5:  3 932 160 indices spreading range [0.0, 1.0], table size on disk  33 554 432 bytes
+    12:    30 720 indices spreading range [0.0, 1.0], table size on disk     262 144 bytes
+    16:     1 920 indices spreading range [0.0, 1.0], table size on disk      16 384 bytes
+    20:       120 indices spreading range [0.0, 1.0], table size on disk       1 024 bytes
+    24:         7 indices spreading range [0.0, 1.0], table size on disk          64 bytes
+    26:         1 indices spreading range [0.0, 1.0], table size on disk          16 bytes
+*/
+#define ACOS_TABLE_FREE_EXPONENT_BITS (7 - ACOS_TABLE_CONST_EXPONENT_BITS)
+#define ACOS_TABLE_DATA_BITS (31 - ACOS_TABLE_CONST_EXPONENT_BITS - ACOS_TABLE_DISCARDED_BITS)
+#define ACOS_TABLE_LENGTH (1 << (31 - ACOS_TABLE_CONST_EXPONENT_BITS - ACOS_TABLE_DISCARDED_BITS))
+
+#define VARIA_DATA_MASK (0x87FFFFFF & ~((1 << ACOS_TABLE_DISCARDED_BITS) - 1))
+#define CONST_DATA_MASK (((1 << ACOS_TABLE_CONST_EXPONENT_BITS) - 1) \
+                                    << (ACOS_TABLE_DATA_BITS - 1 + ACOS_TABLE_DISCARDED_BITS))
+
+#define SIGN_UNPACK_MASK (1 << (ACOS_TABLE_DATA_BITS - 1))
+#define DATA_UNPACK_MASK ((1 << (ACOS_TABLE_DATA_BITS - 1)) - 1)
+
+#define SIGN_MASK  (0x80000000)
+#define DATA_MASK (DATA_UNPACK_MASK << ACOS_TABLE_DISCARDED_BITS)
+
+//#define ACOS_TABLE_LENGTH (1<<25)
+#define ACOS_TABLE_FILENAME "./acos_table.dat"
+
+/*
+ * Table file layout: header (padded to ACOS_TABLE_DATA_OFFSET so
+ * the table starts page aligned) followed by ACOS_TABLE_LENGTH floats.
+ * Mapping is refused if the header doesn't match resolution
+ * of the build, so processes built with different parameters
+ * never read a table of wrong layout.
+ */
+#define ACOS_TABLE_MAGIC "ACOSTBL"
+#define ACOS_TABLE_VERSION (1)
+#define ACOS_TABLE_DATA_OFFSET (4096)
+#define ACOS_TABLE_FILE_SIZE (ACOS_TABLE_DATA_OFFSET + (size_t) ACOS_TABLE_LENGTH * sizeof(float))
+
+typedef struct {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    data_offset;
+    uint32_t    const_exponent;
+    uint32_t    const_exponent_bits;
+    uint32_t    discarded_bits;
+    uint32_t    length;             /* in floats */
+    uint64_t    checksum;           /* FNV-1a of table data */
+} acos_table_header_t;
+
+/* flags of init_fast_acosf_file */
+#define FAST_ACOSF_VERIFY       (1 << 0)    /* check table checksum when mapping */
+#define FAST_ACOSF_HUGEPAGES    (1 << 1)    /* advise huge pages for the mapping */
+
+typedef union {
+    uint32_t i;
+    float f;
+} float_conv_t;
+
+extern float fast_acosf(float x);
+extern uint32_t index_from_float(float f);
+extern float float_from_index(uint32_t d);
+extern int compute_table(const char *path);
+/* map table at path, building it first if missing or not valid */
+extern int init_fast_acosf_file(const char *path, int flags);
+/* init_fast_acosf_file(ACOS_TABLE_FILENAME, 0) */
+extern int init_fast_acosf(void);
+extern int destroy_fast_acosf(void);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * @file    g711_bench.c
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Throughput of G711 conversions: Sun's g711.c routines,
+ *          SpanDSP's g711.h inline routines and g711_lut tables.
+ *          Also checks all of them agree for every input value.
+ * @date	18 March 2018
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "g711.h"
+#include "g711_lut.h"
+
+#define BENCH_N			(16 * 1024 * 1024)
+#define BENCH_ROUNDS	(5)
+
+/* g711.c */
+int linear2alaw(int pcm_val);
+int alaw2linear(int a_val);
+int linear2ulaw(int pcm_val);
+int ulaw2linear(int u_val);
+
+static uint8_t			*law;
+static int16_t			*lin;
+static g711_dec_table_t	dec_a;
+static g711_enc_table_t	enc_a;
+
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void dec_sun(void)		{ size_t i; for (i = 0; i < BENCH_N; ++i) lin[i] = alaw2linear(law[i]); }
+static void dec_spandsp(void)	{ size_t i; for (i = 0; i < BENCH_N; ++i) lin[i] = alaw_to_linear(law[i]); }
+static void dec_lut_scalar(void){ g711_decode_scalar(&dec_a, law, lin, BENCH_N); }
+static void dec_lut(void)		{ g711_decode(&dec_a, law, lin, BENCH_N); }
+static void enc_sun(void)		{ size_t i; for (i = 0; i < BENCH_N; ++i) law[i] = linear2alaw(lin[i]); }
+static void enc_spandsp(void)	{ size_t i; for (i = 0; i < BENCH_N; ++i) law[i] = linear_to_alaw(lin[i]); }
+static void enc_lut(void)		{ g711_encode(&enc_a, lin, law, BENCH_N); }
+
+static void
+bench(const char *name, void (*fn)(void))
+{
+	int		r = 0;
+	double	t = 0.0, best = 1e9;
+
+	for (r = 0; r < BENCH_ROUNDS; ++r) {
+		t = now();
+		fn();
+		t = now() - t;
+		if (t < best) {
+			best = t;
+		}
+	}
+	printf("%-24s %10.1f Msamples/s\n", name, BENCH_N / best / 1e6);
+}
+
+/* Every byte value twice, then a remainder shorter than a vector */
+#define CHECK_DEC_N		(2 * 256 + 7)
+
+/**
+ * Compare tables with reference routines over all inputs. Each table
+ * converts the whole range in one call, so the vector kernel runs on
+ * most of it and the scalar tail on the rest.
+ */
+static int
+check(void)
+{
+	int					i = 0, errors = 0;
+	uint8_t				b = 0;
+	uint16_t			r = 0;
+	uint8_t				bytes[CHECK_DEC_N];
+	int16_t				out_a[CHECK_DEC_N], out_a_swap[CHECK_DEC_N], out_u[CHECK_DEC_N];
+	int16_t				*pcm = malloc(65536 * sizeof(*pcm));
+	uint8_t				*enc_out_a = malloc(65536), *enc_out_u = malloc(65536);
+	g711_dec_table_t	dec_u, dec_a_swap;
+	g711_enc_table_t	*enc_u = malloc(sizeof(*enc_u));
+
+	if (enc_u == NULL || pcm == NULL || enc_out_a == NULL || enc_out_u == NULL) {
+		free(enc_u);
+		free(pcm);
+		free(enc_out_a);
+		free(enc_out_u);
+		return -1;
+	}
+	g711_dec_table_init(&dec_u, 'u', 0);
+	g711_dec_table_init(&dec_a_swap, 'a', 1);
+	g711_enc_table_init(enc_u, 'u', 0);
+
+	for (i = 0; i < CHECK_DEC_N; ++i) {
+		bytes[i] = (uint8_t) i;
+	}
+	g711_decode(&dec_a, bytes, out_a, CHECK_DEC_N);
+	g711_decode(&dec_a_swap, bytes, out_a_swap, CHECK_DEC_N);
+	g711_decode(&dec_u, bytes, out_u, CHECK_DEC_N);
+	for (i = 0; i < CHECK_DEC_N; ++i) {
+		b = bytes[i];
+		errors += (out_a[i] != alaw2linear(b)) + (out_a[i] != alaw_to_linear(b));
+		r = (uint16_t) alaw_to_linear(b);
+		errors += ((uint16_t) out_a_swap[i] != (uint16_t) ((r >> 8) | (r << 8)));
+		errors += (out_u[i] != ulaw2linear(b)) + (out_u[i] != ulaw_to_linear(b));
+	}
+
+	for (i = 0; i < 65536; ++i) {
+		pcm[i] = (int16_t) (i - 32768);
+	}
+	g711_encode(&enc_a, pcm, enc_out_a, 65536);
+	g711_encode(enc_u, pcm, enc_out_u, 65536);
+	for (i = 0; i < 65536; ++i) {
+		errors += (enc_out_a[i] != linear_to_alaw(pcm[i]));
+		errors += (enc_out_u[i] != linear_to_ulaw(pcm[i]));
+	}
+	free(enc_u);
+	free(pcm);
+	free(enc_out_a);
+	free(enc_out_u);
+
+	return errors;
+}
+
+int
+main(void)
+{
+	size_t	i = 0;
+	int		errors = 0;
+
+	law = malloc(BENCH_N);
+	lin = malloc(BENCH_N * sizeof(int16_t));
+	if (law == NULL || lin == NULL) {
+		return EXIT_FAILURE;
+	}
+	g711_dec_table_init(&dec_a, 'a', 0);
+	g711_enc_table_init(&enc_a, 'a', 0);
+
+	errors = check();
+	printf("check: %d mismatches\n", errors);
+
+	srand(1);
+	for (i = 0; i < BENCH_N; ++i) {
+		law[i] = (uint8_t) rand();
+	}
+	printf("A-Law -> linear:\n");
+	bench("g711.c alaw2linear", dec_sun);
+	bench("g711.h alaw_to_linear", dec_spandsp);
+	bench("lut scalar", dec_lut_scalar);
+	bench(g711_decode_kernel()[0] == 'a' ? "lut avx2" : "lut", dec_lut);
+
+	for (i = 0; i < BENCH_N; ++i) {
+		lin[i] = (int16_t) (rand() >> 8);
+	}
+	printf("linear -> A-Law:\n");
+	bench("g711.c linear2alaw", enc_sun);
+	bench("g711.h linear_to_alaw", enc_spandsp);
+	bench("lut", enc_lut);
+
+	free(law);
+	free(lin);
+
+	return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,183 @@
+/*
+ * @file    g711_io.c
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Chunked file/stream conversion driver for g711_lut.
+ * @date	18 March 2018
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "g711_io.h"
+
+
+static int
+write_all(int fd, const uint8_t *buf, size_t len)
+{
+	ssize_t	res = 0;
+
+	while (len > 0) {
+		res = write(fd, buf, len);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf += res;
+		len -= (size_t) res;
+	}
+
+	return 0;
+}
+
+/**
+ * Read until len bytes are in or end of input. Return bytes read
+ * or -1 on error.
+ */
+static ssize_t
+read_full(int fd, uint8_t *buf, size_t len)
+{
+	ssize_t	res = 0;
+	size_t	got = 0;
+
+	while (got < len) {
+		res = read(fd, buf + got, len - got);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (res == 0) {
+			break;
+		}
+		got += (size_t) res;
+	}
+
+	return (ssize_t) got;
+}
+
+int
+g711_stream(const char *in_path, const char *out_path, size_t in_size, size_t out_size,
+		g711_block_fn fn, const void *table, size_t *samples)
+{
+	int			in_fd = -1, out_fd = -1;
+	int			ret = 0;
+	struct stat	st;
+	uint8_t		*map = NULL, *in_buf = NULL, *out_buf = NULL;
+	size_t		map_len = 0, total = 0, n = 0, pos = 0;
+	ssize_t		got = 0;
+
+	if (strcmp(in_path, "-") == 0) {
+		in_fd = STDIN_FILENO;
+	} else {
+		in_fd = open(in_path, O_RDONLY);
+		if (in_fd == -1) {
+			return -1;
+		}
+	}
+
+	if (strcmp(out_path, "-") == 0) {
+		out_fd = STDOUT_FILENO;
+	} else {
+		out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (out_fd == -1) {
+			ret = -2;
+			goto out;
+		}
+	}
+
+	out_buf = malloc(G711_CHUNK_SAMPLES * out_size);
+	if (out_buf == NULL) {
+		ret = -5;
+		goto out;
+	}
+
+	if (fstat(in_fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+
+		/**
+		 * Regular file, map it and let the kernel read ahead.
+		 */
+
+		map_len = (size_t) st.st_size;
+		map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, in_fd, 0);
+		if (map == MAP_FAILED) {
+			map = NULL;
+			ret = -3;
+			goto out;
+		}
+		(void) madvise(map, map_len, MADV_SEQUENTIAL);
+
+		total = map_len / in_size;
+		for (pos = 0; pos < total; pos += n) {
+			n = total - pos;
+			if (n > G711_CHUNK_SAMPLES) {
+				n = G711_CHUNK_SAMPLES;
+			}
+			fn(table, map + pos * in_size, out_buf, n);
+			if (write_all(out_fd, out_buf, n * out_size) != 0) {
+				ret = -4;
+				goto out;
+			}
+		}
+
+	} else {
+
+		/**
+		 * Pipe or terminal, read in chunks.
+		 */
+
+		in_buf = malloc(G711_CHUNK_SAMPLES * in_size);
+		if (in_buf == NULL) {
+			ret = -5;
+			goto out;
+		}
+
+		while ((got = read_full(in_fd, in_buf, G711_CHUNK_SAMPLES * in_size)) > 0) {
+			n = (size_t) got / in_size;
+			fn(table, in_buf, out_buf, n);
+			if (write_all(out_fd, out_buf, n * out_size) != 0) {
+				ret = -4;
+				goto out;
+			}
+			total += n;
+			if ((size_t) got < G711_CHUNK_SAMPLES * in_size) {
+				break;
+			}
+		}
+		if (got < 0) {
+			ret = -3;
+			goto out;
+		}
+	}
+
+out:
+	if (map != NULL) {
+		munmap(map, map_len);
+	}
+	free(in_buf);
+	free(out_buf);
+	if (in_fd != -1 && in_fd != STDIN_FILENO) {
+		close(in_fd);
+	}
+	if (out_fd != -1 && out_fd != STDOUT_FILENO) {
+		if (close(out_fd) != 0 && ret == 0) {
+			ret = -4;
+		}
+	}
+	if (samples != NULL) {
+		*samples = total;
+	}
+
+	return ret;
+}
@@ -0,0 +1,34 @@
+/*
+ * @file    g711_io.h
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Chunked file/stream conversion driver for g711_lut.
+ * @date	18 March 2018
+ */
+
+#ifndef __G711_IO_H__
+#define __G711_IO_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* samples converted per chunk */
+#define G711_CHUNK_SAMPLES	(4 * 1024 * 1024)
+
+/**
+ * Convert n samples from in to out, table is the conversion table.
+ */
+typedef void (*g711_block_fn)(const void *table, const uint8_t *in, uint8_t *out, size_t n);
+
+/**
+ * Convert whole input into output, chunk by chunk.
+ * Path "-" stands for stdin/stdout. Regular input files are mapped
+ * into memory, other inputs (pipes) are read in chunks.
+ * in_size and out_size are sizes of a single sample in bytes.
+ * Trailing bytes not making a whole sample are ignored.
+ * Return 0 on success, -1 if input can't be opened, -2 if output can't
+ * be opened, -3 on read error, -4 on write error, -5 if out of memory.
+ */
+int g711_stream(const char *in_path, const char *out_path, size_t in_size, size_t out_size,
+		g711_block_fn fn, const void *table, size_t *samples);
+
+#endif
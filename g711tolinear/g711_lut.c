@@ -0,0 +1,192 @@
+/*
+ * @file    g711_lut.c
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Bulk G711 A-Law/U-Law <-> 16 bit linear conversion
+ *          with lookup tables.
+ * @date	18 March 2018
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "g711.h"
+#include "g711_lut.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define G711_LUT_X86 1
+#include <immintrin.h>
+#endif
+
+#define G711_SWAP16(x) ((uint16_t) ((((uint16_t) (x)) >> 8) | (((uint16_t) (x)) << 8)))
+
+
+int
+g711_dec_table_init(g711_dec_table_t *table, char enc, int swap)
+{
+	int		i = 0;
+	int16_t	s = 0;
+
+	if (enc != 'a' && enc != 'u') {
+		return -1;
+	}
+
+	for (i = 0; i < 256; ++i) {
+		if (enc == 'a') {
+			s = alaw_to_linear((uint8_t) i);
+		} else {
+			s = ulaw_to_linear((uint8_t) i);
+		}
+		if (swap) {
+			s = (int16_t) G711_SWAP16(s);
+		}
+		table->t[i] = s;
+	}
+
+	/* only read by 32 bit gathers of the last entry */
+	table->t[256] = 0;
+
+	return 0;
+}
+
+int
+g711_enc_table_init(g711_enc_table_t *table, char enc, int swap)
+{
+	int			i = 0;
+	uint16_t	idx = 0;
+
+	if (enc != 'a' && enc != 'u') {
+		return -1;
+	}
+
+	for (i = 0; i < G711_ENC_TABLE_LEN; ++i) {
+		idx = (uint16_t) i;
+		if (swap) {
+			idx = G711_SWAP16(idx);
+		}
+		if (enc == 'a') {
+			table->t[idx] = linear_to_alaw((int16_t) i);
+		} else {
+			table->t[idx] = linear_to_ulaw((int16_t) i);
+		}
+	}
+
+	return 0;
+}
+
+void
+g711_decode_scalar(const g711_dec_table_t *table, const uint8_t *in, int16_t *out, size_t n)
+{
+	size_t	i = 0;
+	const int16_t *t = table->t;
+
+	for (; i + 8 <= n; i += 8) {
+		out[i] = t[in[i]];
+		out[i + 1] = t[in[i + 1]];
+		out[i + 2] = t[in[i + 2]];
+		out[i + 3] = t[in[i + 3]];
+		out[i + 4] = t[in[i + 4]];
+		out[i + 5] = t[in[i + 5]];
+		out[i + 6] = t[in[i + 6]];
+		out[i + 7] = t[in[i + 7]];
+	}
+
+	for (; i < n; ++i) {
+		out[i] = t[in[i]];
+	}
+}
+
+#ifdef G711_LUT_X86
+/**
+ * 16 samples per iteration: bytes are widened to 32 bit indices,
+ * 32 bit words are gathered from table (entry and its neighbour,
+ * hence the padding entry), low halves are kept and packed back.
+ */
+__attribute__((target("avx2")))
+static void
+g711_decode_avx2(const g711_dec_table_t *table, const uint8_t *in, int16_t *out, size_t n)
+{
+	size_t	i = 0;
+	const int *base = (const int *) table->t;
+	__m128i	bytes;
+	__m256i	lo, hi;
+
+	for (; i + 16 <= n; i += 16) {
+		bytes = _mm_loadu_si128((const __m128i *) (in + i));
+		lo = _mm256_cvtepu8_epi32(bytes);
+		hi = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+		lo = _mm256_i32gather_epi32(base, lo, 2);
+		hi = _mm256_i32gather_epi32(base, hi, 2);
+		/* sign extend low 16 bits so packs doesn't saturate */
+		lo = _mm256_srai_epi32(_mm256_slli_epi32(lo, 16), 16);
+		hi = _mm256_srai_epi32(_mm256_slli_epi32(hi, 16), 16);
+		lo = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+		_mm256_storeu_si256((__m256i *) (out + i), lo);
+	}
+
+	g711_decode_scalar(table, in + i, out + i, n - i);
+}
+#endif
+
+typedef void (*g711_decode_fn)(const g711_dec_table_t *, const uint8_t *, int16_t *, size_t);
+
+static g711_decode_fn	g711_decode_impl = NULL;
+static const char		*g711_decode_name = NULL;
+static pthread_once_t	g711_decode_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Pick the kernel. Run through pthread_once, so callers on any thread
+ * see both statics set once it returns.
+ */
+static void
+g711_decode_resolve(void)
+{
+#ifdef G711_LUT_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		g711_decode_name = "avx2";
+		g711_decode_impl = g711_decode_avx2;
+		return;
+	}
+#endif
+	g711_decode_name = "scalar";
+	g711_decode_impl = g711_decode_scalar;
+}
+
+void
+g711_decode(const g711_dec_table_t *table, const uint8_t *in, int16_t *out, size_t n)
+{
+	pthread_once(&g711_decode_once, g711_decode_resolve);
+	g711_decode_impl(table, in, out, n);
+}
+
+const char *
+g711_decode_kernel(void)
+{
+	pthread_once(&g711_decode_once, g711_decode_resolve);
+	return g711_decode_name;
+}
+
+void
+g711_encode(const g711_enc_table_t *table, const int16_t *in, uint8_t *out, size_t n)
+{
+	size_t	i = 0;
+	const uint8_t *t = table->t;
+	const uint16_t *u = (const uint16_t *) in;
+
+	for (; i + 8 <= n; i += 8) {
+		out[i] = t[u[i]];
+		out[i + 1] = t[u[i + 1]];
+		out[i + 2] = t[u[i + 2]];
+		out[i + 3] = t[u[i + 3]];
+		out[i + 4] = t[u[i + 4]];
+		out[i + 5] = t[u[i + 5]];
+		out[i + 6] = t[u[i + 6]];
+		out[i + 7] = t[u[i + 7]];
+	}
+
+	for (; i < n; ++i) {
+		out[i] = t[u[i]];
+	}
+}
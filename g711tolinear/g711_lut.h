@@ -0,0 +1,53 @@
+/*
+ * @file    g711_lut.h
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Bulk G711 A-Law/U-Law <-> 16 bit linear conversion
+ *          with lookup tables.
+ *
+ *          Decoding uses a 256 entry int16_t table (plus one
+ *          padding entry for vector gathers), encoding a 64K entry
+ *          uint8_t table indexed by the 16 bit sample. Optional
+ *          byte swapping of linear samples is folded into tables,
+ *          so swapped conversion costs nothing extra.
+ * @date	18 March 2018
+ */
+
+#ifndef __G711_LUT_H__
+#define __G711_LUT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define G711_DEC_TABLE_LEN	(256 + 1)
+#define G711_ENC_TABLE_LEN	(65536)
+
+typedef struct {
+	int16_t	t[G711_DEC_TABLE_LEN];
+} g711_dec_table_t;
+
+typedef struct {
+	uint8_t	t[G711_ENC_TABLE_LEN];
+} g711_enc_table_t;
+
+/**
+ * Fill the tables for encoding enc ('a' for A-Law, 'u' for U-Law).
+ * If swap is not 0 linear samples are in opposite byte order.
+ * Return 0 on success, -1 for unknown encoding.
+ */
+int g711_dec_table_init(g711_dec_table_t *table, char enc, int swap);
+int g711_enc_table_init(g711_enc_table_t *table, char enc, int swap);
+
+/**
+ * Convert n samples. Decoding picks AVX2 gather kernel if CPU
+ * supports it, unrolled scalar lookups otherwise.
+ */
+void g711_decode(const g711_dec_table_t *table, const uint8_t *in, int16_t *out, size_t n);
+void g711_decode_scalar(const g711_dec_table_t *table, const uint8_t *in, int16_t *out, size_t n);
+void g711_encode(const g711_enc_table_t *table, const int16_t *in, uint8_t *out, size_t n);
+
+/**
+ * Name of the kernel g711_decode uses.
+ */
+const char * g711_decode_kernel(void);
+
+#endif
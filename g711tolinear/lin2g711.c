@@ -0,0 +1,108 @@
+/*
+ * @file    lin2g711.c
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Conversion from 16 bit linear to G711 A-Law/U-Law.
+ * @date	18 March 2018
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "g711_lut.h"
+#include "g711_io.h"
+
+
+void
+usage(const char *name)
+{
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "%s <output encoding> <input file> <output file> [s]\n\n", name);
+	fprintf(stderr, "For A-Law encoded output use 'a', for U-Law use 'u'.\n\nExample:\n");
+	fprintf(stderr, "\t%s a in.raw out.alaw\n\ns is optional, put it at the end of command if endiannes of input should be swapped.\n\n", name);
+	fprintf(stderr, "Example:\n\t%s a in.raw out.alaw s\n\n", name);
+	fprintf(stderr, "Use - as input or output file name for stdin or stdout.\n\n");
+}
+
+static void
+encode_block(const void *table, const uint8_t *in, uint8_t *out, size_t n)
+{
+	g711_encode((const g711_enc_table_t *) table, (const int16_t *) in, out, n);
+}
+
+int main(int argc, char *argv[])
+{
+	char enc = 'a';
+	char swap = '0';
+	size_t count = 0;
+	int ret = 0;
+	g711_enc_table_t *table = NULL;
+
+
+	if (argc < 4 || argc > 5) {
+		fprintf(stderr, "\nProgram takes 3 or 4 arguments (encoding, input, output file, optional swap).\n\n");
+		goto lin2g711help;
+	}
+
+	enc = *argv[1];
+	if (enc != 'a' && enc != 'u') {
+		fprintf(stderr, "\nError. Encoding should be 'a' for A-Law, 'u' for U-Law.\n\n");
+		goto lin2g711help;
+	}
+
+	if (argc == 5) { 
+		swap = *argv[4];
+		if (swap != 's') {
+			fprintf(stderr, "\nError. The last argument should be 's' if endiannes swapping required.\n\n");
+			goto lin2g711help;
+		}
+	}
+
+	table = malloc(sizeof(*table));
+	if (table == NULL) {
+		fprintf(stderr, "\nOut of memory.\n\n");
+		return EXIT_FAILURE;
+	}
+	g711_enc_table_init(table, enc, swap == 's');
+
+	ret = g711_stream(argv[2], argv[3], sizeof(int16_t), 1, encode_block, table, &count);
+	free(table);
+	if (ret == -1) {
+		fprintf(stderr, "\nError opening input file.\nPlease check the file name.\n\n");
+		goto lin2g711help;
+	}
+	if (ret == -2) {
+		fprintf(stderr, "\nError opening output file.\nPlease check the file name.\n\n");
+		goto lin2g711help;
+	}
+	if (ret != 0) {
+		goto lin2g711err;
+	}
+
+	fprintf(stderr, "\nDone. ");
+
+	if (enc == 'a') {
+		fprintf(stderr, "16 bit linear to A-Law.\n\n");
+	} else {
+		fprintf(stderr, "16 bit linear to U-Law.\n\n");
+	}
+
+	fprintf(stderr, "%zu samples written, %zu/%zu bytes read/written\n\n", count, count * 2, count);
+
+	if (swap == 's') {
+		fprintf(stderr, "Endiannes swapped.\n\n");
+	}
+
+
+	return EXIT_SUCCESS;
+
+lin2g711help:
+	usage(argv[0]);
+	return EXIT_FAILURE;
+
+lin2g711err:
+	fprintf(stderr, "\nI/O error (%d) while converting %s to %s.\n", ret, argv[2], argv[3]);
+	return EXIT_FAILURE;
+}
@@ -11,9 +11,8 @@
 #include <string.h>
 #include <stdint.h>
 
-#include "g711.h"
-
-#define BUF_SZ 400
+#include "g711_lut.h"
+#include "g711_io.h"
 
 
 void
@@ -21,22 +20,25 @@ usage(const char *name)
 {
 	fprintf(stderr, "Usage:\n");
 	fprintf(stderr, "%s <input encoding> <input file> <output file> [s]\n\n", name);
-	fprintf(stderr, "For A-Law encoded input use 'a', for U-Law use 'u'.\n\nExample:\n", name);
-	fprintf(stderr, "\t%s a in.alaw out.raw\n\ns is optional, put it at the end of command if endiannes should be swapped.\n\n", name);
+	fprintf(stderr, "For A-Law encoded input use 'a', for U-Law use 'u'.\n\nExample:\n");
+	fprintf(stderr, "\t%s a in.alaw out.raw\n\ns is optional, put it at the end of command if endiannes of output should be swapped.\n\n", name);
 	fprintf(stderr, "Example:\n\t%s a in.alaw out.raw s\n\n", name);
+	fprintf(stderr, "Use - as input or output file name for stdin or stdout.\n\n");
+}
+
+static void
+decode_block(const void *table, const uint8_t *in, uint8_t *out, size_t n)
+{
+	g711_decode((const g711_dec_table_t *) table, in, (int16_t *) out, n);
 }
 
 int main(int argc, char *argv[])
 {
-	FILE    *fpin = NULL, *fpout = NULL;
 	char enc = 'a';
 	char swap = '0';
-	int16_t buf[BUF_SZ]= {0};
-	int8_t val = 0;
-	int16_t s = 0;
-	size_t	read = 0, read_now = 0, count = 0;
-	size_t items_n = 0;
-	size_t i = 0;
+	size_t count = 0;
+	int ret = 0;
+	g711_dec_table_t table;
 
 
 	if (argc < 4 || argc > 5) {
@@ -50,18 +52,6 @@ int main(int argc, char *argv[])
 		goto g7112linhelp;
 	}
 
-	fpin = fopen(argv[2], "r");
-	if (fpin == NULL) {
-		fprintf(stderr, "\nError opening input file.\nPlease check the file name.\n\n");
-		goto g7112linhelp;
-	}
-
-	fpout = fopen(argv[3], "w");
-	if (fpout == NULL) {
-		fprintf(stderr, "\nError opening output file.\nPlease check the file name.\n\n");
-		goto g7112linhelp;
-	}
-
 	if (argc == 5) { 
 		swap = *argv[4];
 		if (swap != 's') {
@@ -70,48 +60,24 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	while ((read_now = fread((void *) buf, sizeof(buf[0]), BUF_SZ, fpin)) > 0) {
+	/**
+	 * Byte swapping is folded into the table.
+	 */
 
-		/**
-		 * Optionally swap endiannes.
-		 */
-
-		if (swap == 's') {
-
-			i = 0;
-
-			while (i < read_now) {
-				buf[i] = htons(buf[i]);
-				++i;
-			}
-		}
+	g711_dec_table_init(&table, enc, swap == 's');
 
-		read += read_now;						/* in items */
-
-		i = 0;									/* in items */
-
-		while (i < read_now * 2) {
-
-			val = * ((char *) buf + i);
-
-			if (enc == 'a') {		
-				s = alaw_to_linear(val);
-			} else {
-				s = ulaw_to_linear(val);
-			}
-
-
-			if (fwrite(&s, sizeof(s), 1, fpout) != 1) {
-				goto g7112linerr;
-			}
-
-			++count;
-			++i;
-		}
+	ret = g711_stream(argv[2], argv[3], 1, sizeof(int16_t), decode_block, &table, &count);
+	if (ret == -1) {
+		fprintf(stderr, "\nError opening input file.\nPlease check the file name.\n\n");
+		goto g7112linhelp;
+	}
+	if (ret == -2) {
+		fprintf(stderr, "\nError opening output file.\nPlease check the file name.\n\n");
+		goto g7112linhelp;
+	}
+	if (ret != 0) {
+		goto g7112linerr;
 	}
-
-	fclose(fpin);
-	fclose(fpout);
 
 	fprintf(stderr, "\nDone. ");
 
@@ -121,7 +87,7 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "U-Law to 16 bit linear.\n\n");
 	}
 
-	fprintf(stderr, "%zu samples written, %zu/%zu bytes read/written\n\n", count, read * 2, read * 4);
+	fprintf(stderr, "%zu samples written, %zu/%zu bytes read/written\n\n", count, count, count * 2);
 
 	if (swap == 's') {
 		fprintf(stderr, "Endiannes swapped.\n\n");
@@ -135,6 +101,6 @@ g7112linhelp:
 	return EXIT_FAILURE;
 
 g7112linerr:
-	fprintf(stderr, "\nI/O g7112linerror while writing to %s.\n", argv[3]);
+	fprintf(stderr, "\nI/O error (%d) while converting %s to %s.\n", ret, argv[2], argv[3]);
 	return EXIT_FAILURE;
 }
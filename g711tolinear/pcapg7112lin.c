@@ -0,0 +1,648 @@
+/*
+ * @file    pcapg7112lin.c
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Extraction of G711 RTP streams from pcap capture
+ *          into 16 bit linear files, in a single pass over
+ *          the memory mapped capture.
+ *
+ *          Packets are walked through link layer (Ethernet with
+ *          VLAN tags, Linux cooked v1/v2, BSD loopback, raw IP),
+ *          IPv4/IPv6 and UDP down to RTP. Only G711 payloads (PT 0
+ *          and 8) are kept, other payload types are skipped. RTP
+ *          header length honours CSRC count, header extension and
+ *          padding. Streams are demultiplexed by SSRC, ordered by
+ *          (extended) sequence number, placed by RTP timestamp
+ *          (gaps filled with silence) and decoded straight into
+ *          <capture>.<ssrc>.lin.
+ *
+ *          Named apart from the tshark based pcap2lin script, so
+ *          both can be installed.
+ * @date	18 March 2018
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "g711_lut.h"
+
+#define PCAP_MAGIC			0xa1b2c3d4
+#define PCAP_MAGIC_NSEC		0xa1b23c4d
+#define PCAP_HDR_LEN		24
+#define PCAP_REC_HDR_LEN	16
+
+#define LINKTYPE_NULL		0
+#define LINKTYPE_ETHERNET	1
+#define LINKTYPE_LOOP		108
+#define LINKTYPE_RAW		101
+#define LINKTYPE_RAW_OLD	12
+#define LINKTYPE_LINUX_SLL	113
+#define LINKTYPE_LINUX_SLL2	276
+
+#define ETHERTYPE_IPV4		0x0800
+#define ETHERTYPE_IPV6		0x86dd
+#define ETHERTYPE_VLAN		0x8100
+#define ETHERTYPE_QINQ		0x88a8
+
+#define IPPROTO_UDP_		17
+
+#define RTP_HDR_LEN			12
+#define RTP_PT_PCMU			0
+#define RTP_PT_PCMA			8
+
+/* timestamp jumps above this are not filled with silence */
+#define MAX_GAP_SAMPLES		(8000 * 10)
+#define OUT_CHUNK_SAMPLES	(1024 * 1024)
+
+
+typedef struct {
+	uint64_t	seq;		/* extended sequence number */
+	uint32_t	ts;
+	size_t		off;		/* payload offset in capture */
+	uint32_t	len;		/* payload length */
+} rtp_packet_t;
+
+typedef struct {
+	uint32_t		ssrc;
+	uint8_t			pt;
+	rtp_packet_t	*packets;
+	size_t			n;
+	size_t			cap;
+	uint64_t		max_seq;	/* highest extended sequence number so far */
+} rtp_stream_t;
+
+typedef struct {
+	rtp_stream_t	*s;
+	size_t			n;
+	size_t			cap;
+} rtp_streams_t;
+
+
+static inline uint16_t
+be16(const uint8_t *p)
+{
+	return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t
+be32(const uint8_t *p)
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline uint32_t
+pcap32(const uint8_t *p, int swapped)
+{
+	uint32_t v = 0;
+
+	memcpy(&v, p, sizeof(v));
+	if (swapped) {
+		v = __builtin_bswap32(v);
+	}
+
+	return v;
+}
+
+void
+usage(const char *name)
+{
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "%s <encoding> <input pcap file> [s]\n\n", name);
+	fprintf(stderr, "For A-Law encoded RTP use 'a', for U-Law use 'u', to choose by payload type (0 - U-Law, 8 - A-Law) use 'p'.\n");
+	fprintf(stderr, "Only RTP with payload type 0 or 8 is extracted, other payload types are skipped.\n\n");
+	fprintf(stderr, "Each RTP stream (SSRC) is written to <input pcap file>.<SSRC>.lin\n\n");
+	fprintf(stderr, "Example:\n\t%s a someAlaw.pcap\n\n", name);
+	fprintf(stderr, "s is optional, put it at the end of command if endiannes should be swapped.\n\n");
+	fprintf(stderr, "Example:\n\t%s a someAlaw.pcap s\n\n", name);
+}
+
+static rtp_stream_t *
+stream_get(rtp_streams_t *streams, uint32_t ssrc, uint8_t pt)
+{
+	size_t			i = 0;
+	rtp_stream_t	*s = NULL;
+
+	for (i = 0; i < streams->n; ++i) {
+		if (streams->s[i].ssrc == ssrc) {
+			return &streams->s[i];
+		}
+	}
+
+	if (streams->n == streams->cap) {
+		streams->cap = streams->cap ? streams->cap * 2 : 8;
+		s = realloc(streams->s, streams->cap * sizeof(*s));
+		if (s == NULL) {
+			return NULL;
+		}
+		streams->s = s;
+	}
+
+	s = &streams->s[streams->n++];
+	memset(s, 0, sizeof(*s));
+	s->ssrc = ssrc;
+	s->pt = pt;
+
+	return s;
+}
+
+static int
+stream_add(rtp_stream_t *s, uint16_t seq, uint32_t ts, size_t off, uint32_t len)
+{
+	rtp_packet_t	*p = NULL;
+	uint64_t		ext = 0;
+	int32_t			delta = 0;
+
+	if (s->n == s->cap) {
+		s->cap = s->cap ? s->cap * 2 : 1024;
+		p = realloc(s->packets, s->cap * sizeof(*p));
+		if (p == NULL) {
+			return -1;
+		}
+		s->packets = p;
+	}
+
+	/**
+	 * Extend 16 bit sequence number relative to the highest
+	 * seen so far, so wrap arounds and late packets order right.
+	 */
+
+	if (s->n == 0) {
+		ext = (1ULL << 32) + seq;		/* leave room for packets late before the first one */
+	} else {
+		delta = (int16_t) (seq - (uint16_t) s->max_seq);
+		ext = s->max_seq + delta;
+	}
+	if (s->n == 0 || ext > s->max_seq) {
+		s->max_seq = ext;
+	}
+
+	p = &s->packets[s->n++];
+	p->seq = ext;
+	p->ts = ts;
+	p->off = off;
+	p->len = len;
+
+	return 0;
+}
+
+static int
+packet_cmp(const void *a, const void *b)
+{
+	const rtp_packet_t *pa = a, *pb = b;
+
+	if (pa->seq != pb->seq) {
+		return pa->seq < pb->seq ? -1 : 1;
+	}
+	/* keep capture order of duplicates */
+	return pa->off < pb->off ? -1 : (pa->off > pb->off);
+}
+
+/**
+ * Find UDP payload in link layer frame. Return 0 and set
+ * *udp / *udp_len, or -1 if the frame is not UDP.
+ */
+static int
+frame_udp(const uint8_t *f, size_t len, uint32_t linktype, const uint8_t **udp, size_t *udp_len)
+{
+	uint16_t	ethertype = 0;
+	size_t		ihl = 0, l = 0;
+	uint8_t		next = 0;
+	const uint8_t *ip = NULL;
+
+	switch (linktype) {
+
+		case LINKTYPE_ETHERNET:
+			if (len < 14) {
+				return -1;
+			}
+			ethertype = be16(f + 12);
+			f += 14;
+			len -= 14;
+			while (ethertype == ETHERTYPE_VLAN || ethertype == ETHERTYPE_QINQ) {
+				if (len < 4) {
+					return -1;
+				}
+				ethertype = be16(f + 2);
+				f += 4;
+				len -= 4;
+			}
+			break;
+
+		case LINKTYPE_LINUX_SLL:
+			if (len < 16) {
+				return -1;
+			}
+			ethertype = be16(f + 14);
+			f += 16;
+			len -= 16;
+			break;
+
+		case LINKTYPE_LINUX_SLL2:
+			if (len < 20) {
+				return -1;
+			}
+			ethertype = be16(f);
+			f += 20;
+			len -= 20;
+			break;
+
+		case LINKTYPE_NULL:
+		case LINKTYPE_LOOP:
+			/**
+			 * 4 byte address family, its value and byte order
+			 * differ between systems, IP version tells the same.
+			 */
+			if (len < 5) {
+				return -1;
+			}
+			f += 4;
+			len -= 4;
+			ethertype = ((f[0] >> 4) == 6) ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4;
+			break;
+
+		case LINKTYPE_RAW:
+		case LINKTYPE_RAW_OLD:
+			if (len < 1) {
+				return -1;
+			}
+			ethertype = ((f[0] >> 4) == 6) ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4;
+			break;
+
+		default:
+			return -1;
+	}
+
+	ip = f;
+
+	if (ethertype == ETHERTYPE_IPV4) {
+		if (len < 20 || (ip[0] >> 4) != 4) {
+			return -1;
+		}
+		ihl = (ip[0] & 0x0f) * 4;
+		if (ihl < 20 || len < ihl) {
+			return -1;
+		}
+		/* fragments are skipped */
+		if ((be16(ip + 6) & 0x3fff) != 0) {
+			return -1;
+		}
+		if (ip[9] != IPPROTO_UDP_) {
+			return -1;
+		}
+		l = be16(ip + 2);
+		if (l < ihl || l > len) {
+			l = len;
+		}
+		f = ip + ihl;
+		len = l - ihl;
+	} else if (ethertype == ETHERTYPE_IPV6) {
+		if (len < 40 || (ip[0] >> 4) != 6) {
+			return -1;
+		}
+		next = ip[6];
+		l = 40 + be16(ip + 4);
+		if (l > len) {
+			l = len;
+		}
+		f = ip + 40;
+		len = l - 40;
+		/* hop-by-hop, routing and destination options */
+		while (next == 0 || next == 43 || next == 60) {
+			if (len < 8 || len < (size_t) (f[1] + 1) * 8) {
+				return -1;
+			}
+			next = f[0];
+			l = (size_t) (f[1] + 1) * 8;
+			f += l;
+			len -= l;
+		}
+		if (next != IPPROTO_UDP_) {
+			return -1;
+		}
+	} else {
+		return -1;
+	}
+
+	if (len < 8) {
+		return -1;
+	}
+	l = be16(f + 4);
+	if (l < 8 || l > len) {
+		l = len;
+	}
+	*udp = f + 8;
+	*udp_len = l - 8;
+
+	return 0;
+}
+
+/**
+ * Parse RTP header, on success return 0 and set payload offset
+ * within packet and payload length.
+ */
+static int
+rtp_payload(const uint8_t *p, size_t len, size_t *off, size_t *plen)
+{
+	size_t	hl = RTP_HDR_LEN;
+	size_t	pad = 0;
+	uint8_t	pt = 0;
+
+	if (len < RTP_HDR_LEN || (p[0] >> 6) != 2) {
+		return -1;
+	}
+	pt = p[1] & 0x7f;
+	/* RTCP (200 - 204) */
+	if (pt >= 72 && pt <= 76) {
+		return -1;
+	}
+
+	hl += (p[0] & 0x0f) * 4;					/* CSRC list */
+	if (p[0] & 0x10) {							/* header extension */
+		if (len < hl + 4) {
+			return -1;
+		}
+		hl += 4 + (size_t) be16(p + hl + 2) * 4;
+	}
+	if (len < hl) {
+		return -1;
+	}
+	if (p[0] & 0x20) {							/* padding */
+		pad = p[len - 1];
+		if (pad > len - hl) {
+			return -1;
+		}
+	}
+
+	*off = hl;
+	*plen = len - hl - pad;
+
+	return 0;
+}
+
+static int
+write_all(FILE *fp, const void *buf, size_t len)
+{
+	return (len == 0 || fwrite(buf, len, 1, fp) == 1) ? 0 : -1;
+}
+
+/**
+ * Sort packets of the stream and decode them into file.
+ * Return number of samples written or -1 on error.
+ */
+static long long
+stream_write(rtp_stream_t *s, const uint8_t *cap, const char *path, const g711_dec_table_t *table)
+{
+	FILE			*fp = NULL;
+	int16_t			*out = NULL;
+	size_t			i = 0, fill = 0, n = 0, pos = 0;
+	uint64_t		prev_seq = 0;
+	uint32_t		next_ts = 0, gap = 0;
+	long long		samples = 0;
+	const rtp_packet_t *p = NULL;
+
+	qsort(s->packets, s->n, sizeof(*s->packets), packet_cmp);
+
+	fp = fopen(path, "w");
+	out = malloc(OUT_CHUNK_SAMPLES * sizeof(int16_t));
+	if (fp == NULL || out == NULL) {
+		goto fail;
+	}
+
+	for (i = 0; i < s->n; ++i) {
+		p = &s->packets[i];
+		if (i > 0 && p->seq == prev_seq) {
+			continue;					/* duplicate */
+		}
+
+		/**
+		 * Lost packets or silence suppression, fill with silence
+		 * up to this packet's timestamp.
+		 */
+
+		if (i > 0) {
+			gap = p->ts - next_ts;
+			if (gap > 0 && gap <= MAX_GAP_SAMPLES) {
+				while (gap > 0) {
+					n = OUT_CHUNK_SAMPLES - fill;
+					if (n > gap) {
+						n = gap;
+					}
+					memset(out + fill, 0, n * sizeof(int16_t));
+					fill += n;
+					gap -= n;
+					samples += n;
+					if (fill == OUT_CHUNK_SAMPLES) {
+						if (write_all(fp, out, fill * sizeof(int16_t)) != 0) {
+							goto fail;
+						}
+						fill = 0;
+					}
+				}
+			}
+		}
+
+		for (pos = 0; pos < p->len; pos += n) {
+			n = p->len - pos;
+			if (n > OUT_CHUNK_SAMPLES - fill) {
+				n = OUT_CHUNK_SAMPLES - fill;
+			}
+			g711_decode(table, cap + p->off + pos, out + fill, n);
+			fill += n;
+			if (fill == OUT_CHUNK_SAMPLES) {
+				if (write_all(fp, out, fill * sizeof(int16_t)) != 0) {
+					goto fail;
+				}
+				fill = 0;
+			}
+		}
+		samples += p->len;
+
+		prev_seq = p->seq;
+		next_ts = p->ts + p->len;
+	}
+
+	if (write_all(fp, out, fill * sizeof(int16_t)) != 0) {
+		goto fail;
+	}
+	free(out);
+	if (fclose(fp) != 0) {
+		return -1;
+	}
+
+	return samples;
+
+fail:
+	free(out);
+	if (fp != NULL) {
+		fclose(fp);
+	}
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	char enc = 'a';
+	char swap = '0';
+	int fd = -1, swapped = 0, ret = EXIT_FAILURE;
+	struct stat st;
+	uint8_t *cap = NULL;
+	size_t cap_len = 0, off = 0, rec_len = 0, udp_len = 0, poff = 0, plen = 0, i = 0;
+	size_t packets = 0, rtp_packets = 0, skipped = 0;
+	uint32_t magic = 0, linktype = 0;
+	const uint8_t *udp = NULL;
+	rtp_streams_t streams = { 0 };
+	rtp_stream_t *s = NULL;
+	g711_dec_table_t alaw, ulaw;
+	const g711_dec_table_t *table = NULL;
+	char path[4096];
+	long long samples = 0;
+
+
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "\nProgram takes 2 or 3 arguments.\n\n");
+		goto pcap2linhelp;
+	}
+
+	enc = *argv[1];
+	if (enc != 'a' && enc != 'u' && enc != 'p') {
+		fprintf(stderr, "\nError. Encoding should be 'a' for A-Law, 'u' for U-Law, 'p' for choice by payload type.\n\n");
+		goto pcap2linhelp;
+	}
+
+	if (argc == 4) {
+		swap = *argv[3];
+		if (swap != 's') {
+			fprintf(stderr, "\nError. The last argument should be 's' if endiannes swapping required.\n\n");
+			goto pcap2linhelp;
+		}
+	}
+
+	g711_dec_table_init(&alaw, 'a', swap == 's');
+	g711_dec_table_init(&ulaw, 'u', swap == 's');
+
+	fd = open(argv[2], O_RDONLY);
+	if (fd == -1 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "\nError opening input file.\nPlease check the file name.\n\n");
+		goto pcap2linhelp;
+	}
+	cap_len = (size_t) st.st_size;
+	if (cap_len < PCAP_HDR_LEN) {
+		fprintf(stderr, "\nError. %s is not a pcap file.\n\n", argv[2]);
+		goto out;
+	}
+	cap = mmap(NULL, cap_len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (cap == MAP_FAILED) {
+		cap = NULL;
+		fprintf(stderr, "\nError mapping %s.\n\n", argv[2]);
+		goto out;
+	}
+	(void) madvise(cap, cap_len, MADV_SEQUENTIAL);
+
+	memcpy(&magic, cap, sizeof(magic));
+	if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NSEC) {
+		swapped = 0;
+	} else if (magic == __builtin_bswap32(PCAP_MAGIC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC)) {
+		swapped = 1;
+	} else {
+		fprintf(stderr, "\nError. %s is not a pcap file (pcapng is not supported, convert it with editcap -F pcap).\n\n", argv[2]);
+		goto out;
+	}
+	linktype = pcap32(cap + 20, swapped) & 0x0fffffff;
+	switch (linktype) {
+		case LINKTYPE_NULL:
+		case LINKTYPE_ETHERNET:
+		case LINKTYPE_LOOP:
+		case LINKTYPE_RAW:
+		case LINKTYPE_RAW_OLD:
+		case LINKTYPE_LINUX_SLL:
+		case LINKTYPE_LINUX_SLL2:
+			break;
+		default:
+			fprintf(stderr, "\nError. Link type %u of %s is not supported.\n\n", linktype, argv[2]);
+			goto out;
+	}
+
+	/**
+	 * Walk the records, remember where RTP payloads are.
+	 */
+
+	for (off = PCAP_HDR_LEN; off + PCAP_REC_HDR_LEN <= cap_len; off += PCAP_REC_HDR_LEN + rec_len) {
+		rec_len = pcap32(cap + off + 8, swapped);
+		if (rec_len > cap_len - off - PCAP_REC_HDR_LEN) {
+			fprintf(stderr, "Warning. Truncated record at offset %zu, stopping.\n", off);
+			break;
+		}
+		++packets;
+
+		if (frame_udp(cap + off + PCAP_REC_HDR_LEN, rec_len, linktype, &udp, &udp_len) != 0) {
+			continue;
+		}
+		if (rtp_payload(udp, udp_len, &poff, &plen) != 0 || plen == 0) {
+			continue;
+		}
+		if ((udp[1] & 0x7f) != RTP_PT_PCMU && (udp[1] & 0x7f) != RTP_PT_PCMA) {
+			++skipped;
+			continue;
+		}
+
+		s = stream_get(&streams, be32(udp + 8), udp[1] & 0x7f);
+		if (s == NULL || stream_add(s, be16(udp + 2), be32(udp + 4), (size_t) (udp - cap) + poff, (uint32_t) plen) != 0) {
+			fprintf(stderr, "\nOut of memory.\n\n");
+			goto out;
+		}
+		++rtp_packets;
+	}
+
+	fprintf(stderr, "\n%zu packets, %zu G711 RTP packets in %zu streams, %zu RTP packets of other payload types skipped.\n\n",
+			packets, rtp_packets, streams.n, skipped);
+
+	for (i = 0; i < streams.n; ++i) {
+		s = &streams.s[i];
+		if (enc == 'p') {
+			table = (s->pt == RTP_PT_PCMA) ? &alaw : &ulaw;
+		} else {
+			table = (enc == 'a') ? &alaw : &ulaw;
+		}
+		snprintf(path, sizeof(path), "%s.%08x.lin", argv[2], s->ssrc);
+		samples = stream_write(s, cap, path, table);
+		if (samples < 0) {
+			fprintf(stderr, "\nI/O error while writing to %s.\n", path);
+			goto out;
+		}
+		fprintf(stderr, "SSRC %08x (PT %u): %zu packets, %lld samples written to %s\n",
+				s->ssrc, s->pt, s->n, samples, path);
+	}
+
+	if (swap == 's') {
+		fprintf(stderr, "\nEndiannes swapped.\n");
+	}
+	fprintf(stderr, "\n");
+	ret = EXIT_SUCCESS;
+
+out:
+	for (i = 0; i < streams.n; ++i) {
+		free(streams.s[i].packets);
+	}
+	free(streams.s);
+	if (cap != NULL) {
+		munmap(cap, cap_len);
+	}
+	if (fd != -1) {
+		close(fd);
+	}
+	return ret;
+
+pcap2linhelp:
+	usage(argv[0]);
+	if (fd != -1) {
+		close(fd);
+	}
+	return EXIT_FAILURE;
+}
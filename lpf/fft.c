@@ -0,0 +1,160 @@
+/*
+ * @file    fft.c
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Radix-2 complex FFT, in place, on split real/imaginary
+ *          arrays.
+ * @date	29 July 2018
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fft.h"
+
+
+int fft_plan_init(fft_plan_t *plan, size_t n) {
+
+	size_t i = 0, j = 0, bits = 0;
+
+	memset(plan, 0, sizeof(*plan));
+
+	if (n < 2 || (n & (n - 1)) != 0) {
+		return -1;
+	}
+
+	while (((size_t) 1 << bits) < n) {
+		bits++;
+	}
+
+	plan->n = n;
+	plan->rev = malloc(n * sizeof(size_t));
+	plan->cos_t = malloc(n * sizeof(double));
+	plan->sin_t = malloc(n * sizeof(double));
+	if (plan->rev == NULL || plan->cos_t == NULL || plan->sin_t == NULL) {
+		fft_plan_destroy(plan);
+		return -2;
+	}
+
+	for (i = 0; i < n; i++) {
+		plan->rev[i] = 0;
+		for (j = 0; j < bits; j++) {
+			if (i & ((size_t) 1 << j)) {
+				plan->rev[i] |= (size_t) 1 << (bits - 1 - j);
+			}
+		}
+	}
+
+	/**
+	 * Twiddles of each stage stored contiguously, so butterfly
+	 * loops read them with unit stride.
+	 */
+
+	for (j = 1; j < n; j *= 2) {
+		for (i = 0; i < j; i++) {
+			plan->cos_t[j - 1 + i] = cos(M_PI * i / j);
+			plan->sin_t[j - 1 + i] = -sin(M_PI * i / j);
+		}
+	}
+
+	return 0;
+}
+
+void fft_plan_destroy(fft_plan_t *plan) {
+
+	free(plan->rev);
+	free(plan->cos_t);
+	free(plan->sin_t);
+	memset(plan, 0, sizeof(*plan));
+}
+
+/**
+ * Decimation in time, forward transform. First two stages
+ * (twiddles 1 and -i) are merged into one radix-4 pass.
+ */
+static void fft_run(const fft_plan_t *plan, double *re, double *im) {
+
+	size_t n = plan->n;
+	size_t i = 0, j = 0, k = 0, half = 0;
+	double t = 0, tr = 0, ti = 0;
+	double ar = 0, ai = 0, br = 0, bi = 0, cr = 0, ci = 0, dr = 0, di = 0;
+	const double *wr = NULL, *wi = NULL;
+	double *re0 = NULL, *im0 = NULL, *re1 = NULL, *im1 = NULL;
+
+	for (i = 0; i < n; i++) {
+		j = plan->rev[i];
+		if (j > i) {
+			t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+
+	if (n == 2) {
+		tr = re[1]; ti = im[1];
+		re[1] = re[0] - tr; im[1] = im[0] - ti;
+		re[0] += tr; im[0] += ti;
+		return;
+	}
+
+	for (i = 0; i < n; i += 4) {
+
+		ar = re[i] + re[i + 1];		ai = im[i] + im[i + 1];
+		br = re[i] - re[i + 1];		bi = im[i] - im[i + 1];
+		cr = re[i + 2] + re[i + 3];	ci = im[i + 2] + im[i + 3];
+		dr = re[i + 2] - re[i + 3];	di = im[i + 2] - im[i + 3];
+
+		/* d * -i */
+		re[i] = ar + cr;			im[i] = ai + ci;
+		re[i + 2] = ar - cr;		im[i + 2] = ai - ci;
+		re[i + 1] = br + di;		im[i + 1] = bi - dr;
+		re[i + 3] = br - di;		im[i + 3] = bi + dr;
+	}
+
+	for (half = 4; half < n; half *= 2) {
+
+		wr = plan->cos_t + half - 1;
+		wi = plan->sin_t + half - 1;
+
+		for (i = 0; i < n; i += 2 * half) {
+
+			re0 = re + i;
+			im0 = im + i;
+			re1 = re + i + half;
+			im1 = im + i + half;
+
+			for (k = 0; k < half; k++) {
+
+				tr = re1[k] * wr[k] - im1[k] * wi[k];
+				ti = re1[k] * wi[k] + im1[k] * wr[k];
+
+				re1[k] = re0[k] - tr;
+				im1[k] = im0[k] - ti;
+				re0[k] += tr;
+				im0[k] += ti;
+			}
+		}
+	}
+}
+
+void fft_forward(const fft_plan_t *plan, double *re, double *im) {
+
+	fft_run(plan, re, im);
+}
+
+/**
+ * Inverse via forward transform with real and imaginary
+ * parts swapped.
+ */
+void fft_inverse(const fft_plan_t *plan, double *re, double *im) {
+
+	size_t i = 0;
+	double scale = 1.0 / plan->n;
+
+	fft_run(plan, im, re);
+
+	for (i = 0; i < plan->n; i++) {
+		re[i] *= scale;
+		im[i] *= scale;
+	}
+}
@@ -0,0 +1,39 @@
+/*
+ * @file    fft.h
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Radix-2 complex FFT, in place, on split real/imaginary
+ *          arrays. Bit reversal permutation and twiddles are
+ *          precomputed once per size.
+ * @date	29 July 2018
+ */
+
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <stddef.h>
+
+typedef struct {
+	size_t		n;		/* power of 2 */
+	size_t		*rev;	/* bit reversal permutation */
+	double		*cos_t;	/* n - 1 twiddles, stage of half size h at h - 1 */
+	double		*sin_t;
+} fft_plan_t;
+
+/**
+ * Return 0 on success, -1 if n is not a power of 2 (>= 2),
+ * -2 if out of memory.
+ */
+int fft_plan_init(fft_plan_t *plan, size_t n);
+void fft_plan_destroy(fft_plan_t *plan);
+
+/**
+ * Forward transform X[k] = sum x[t] e^(-2 PI i k t / n).
+ */
+void fft_forward(const fft_plan_t *plan, double *re, double *im);
+
+/**
+ * Inverse transform, scaled by 1 / n.
+ */
+void fft_inverse(const fft_plan_t *plan, double *re, double *im);
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * @file    fir_bench.c
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Streaming FIR filter check and throughput.
+ *          Stream is fed in random block sizes through direct,
+ *          FFT and automatic paths and compared with plain
+ *          convolution of the whole stream; then throughput of
+ *          each path is measured against full convolution of
+ *          every segment (what lpf did before).
+ * @date	29 July 2018
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "fir_filter.h"
+
+#define BENCH_N			(1024 * 1024)
+#define BENCH_CHECK_N	(64 * 1024)
+#define BENCH_ROUNDS	3
+#define SEGMENT_LEN		16
+
+static double *x_in;
+static double *y_out;
+static double *y_ref;
+static double h[1025];
+
+static double now(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void reference(size_t taps, size_t n) {
+
+	size_t t = 0, k = 0;
+
+	for (t = 0; t < n; t++) {
+		y_ref[t] = 0;
+		for (k = 0; k < taps && k <= t; k++) {
+			y_ref[t] += h[k] * x_in[t - k];
+		}
+	}
+}
+
+static double check(fir_filter_t *f, void (*fn)(fir_filter_t *, const double *, double *, size_t), size_t n) {
+
+	size_t p = 0, m = 0, i = 0;
+	double e = 0, max = 0;
+
+	fir_filter_reset(f);
+	srand(2);
+
+	for (p = 0; p < n; p += m) {
+		m = 1 + rand() % 3000;
+		if (m > n - p) {
+			m = n - p;
+		}
+		fn(f, x_in + p, y_out + p, m);
+	}
+
+	for (i = 0; i < n; i++) {
+		e = fabs(y_out[i] - y_ref[i]);
+		if (e > max) {
+			max = e;
+		}
+	}
+
+	return max;
+}
+
+/* what lpf did: whole convolution (with tail) of each segment */
+static void segment_conv(size_t taps, size_t n) {
+
+	size_t s = 0, t = 0, k = 0;
+	double af[SEGMENT_LEN + 1024];
+
+	for (s = 0; s + SEGMENT_LEN <= n; s += SEGMENT_LEN) {
+		for (t = 0; t < SEGMENT_LEN + taps - 1; t++) {
+			af[t] = 0;
+			for (k = 0; k < SEGMENT_LEN; k++) {
+				if (t >= k && t - k < taps) {
+					af[t] += x_in[s + k] * h[t - k];
+				}
+			}
+		}
+		y_out[s] = af[0];
+	}
+}
+
+static double throughput(fir_filter_t *f, void (*fn)(fir_filter_t *, const double *, double *, size_t), size_t block) {
+
+	size_t r = 0, p = 0, m = 0;
+	double t = 0, best = 1e9;
+
+	for (r = 0; r < BENCH_ROUNDS; r++) {
+		fir_filter_reset(f);
+		t = now();
+		for (p = 0; p < BENCH_N; p += m) {
+			m = BENCH_N - p < block ? BENCH_N - p : block;
+			fn(f, x_in + p, y_out + p, m);
+		}
+		t = now() - t;
+		if (t < best) best = t;
+	}
+
+	return BENCH_N / best / 1e6;
+}
+
+static void print_crossover(size_t crossover) {
+
+	if (crossover == FIR_CROSSOVER_NEVER) {
+		printf("never");
+	} else {
+		printf("%zu samples", crossover);
+	}
+}
+
+int main(void) {
+
+	size_t sizes[] = { 33, 257, 1025 };
+	size_t blocks[] = { 16, 160, 65536 };
+	size_t s = 0, b = 0, i = 0;
+	double t = 0, e = 0;
+	int fail = 0;
+	fir_design_t d = { .fs = 8000, .centre = 1000, .half_band = 100, .window = FIR_WINDOW_HAMMING };
+	fir_filter_t f, g;
+
+	x_in = malloc(BENCH_N * sizeof(double));
+	y_out = malloc(BENCH_N * sizeof(double));
+	y_ref = malloc(BENCH_N * sizeof(double));
+	if (x_in == NULL || y_out == NULL || y_ref == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	srand(1);
+	for (i = 0; i < BENCH_N; i++) {
+		x_in[i] = 2.0 * ((double) rand() / RAND_MAX) - 1.0;
+	}
+
+	printf("direct kernel [%s]\n", fir_filter_kernel());
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+
+		d.taps = sizes[s];
+		if (fir_design(&d, h) != 0 || fir_filter_init(&f, h, d.taps, FIR_CROSSOVER_AUTO) != 0) {
+			printf("can't create filter of %zu taps\n", d.taps);
+			return EXIT_FAILURE;
+		}
+
+		printf("\n%zu taps, FFT %zu, crossover ", d.taps, f.plan.n);
+		print_crossover(f.crossover);
+		if (fir_filter_init(&g, h, d.taps, FIR_CROSSOVER_MEASURE) != 0) {
+			printf("can't create filter of %zu taps\n", d.taps);
+			return EXIT_FAILURE;
+		}
+		printf(", measured ");
+		print_crossover(g.crossover);
+		printf("\n");
+		fir_filter_destroy(&g);
+
+		reference(d.taps, BENCH_CHECK_N);
+		e = check(&f, fir_filter_process_direct, BENCH_CHECK_N);
+		printf("max error direct %.3e\n", e);
+		fail |= e > 1e-9;
+		e = check(&f, fir_filter_process_fft, BENCH_CHECK_N);
+		printf("max error fft    %.3e\n", e);
+		fail |= e > 1e-9;
+		e = check(&f, fir_filter_process, BENCH_CHECK_N);
+		printf("max error auto   %.3e\n", e);
+		fail |= e > 1e-9;
+
+		t = now();
+		segment_conv(d.taps, BENCH_N / 16);
+		t = now() - t;
+		printf("%-8s block %5d %10.2f Msamples/s\n", "segment", SEGMENT_LEN, BENCH_N / 16 / t / 1e6);
+
+		for (b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+			printf("%-8s block %5zu %10.2f Msamples/s\n", "direct", blocks[b], throughput(&f, fir_filter_process_direct, blocks[b]));
+			/* short blocks through FFT only waste time here */
+			if (blocks[b] >= 2 * f.step) {
+				printf("%-8s block %5zu %10.2f Msamples/s\n", "fft", blocks[b], throughput(&f, fir_filter_process_fft, blocks[b]));
+			}
+			printf("%-8s block %5zu %10.2f Msamples/s\n", "auto", blocks[b], throughput(&f, fir_filter_process, blocks[b]));
+		}
+
+		fir_filter_destroy(&f);
+	}
+
+	free(x_in);
+	free(y_out);
+	free(y_ref);
+
+	printf("\n%s\n", fail ? "FAIL" : "PASS");
+
+	return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
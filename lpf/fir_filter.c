@@ -0,0 +1,521 @@
+/*
+ * @file    fir_filter.c
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Windowed sinc FIR design and streaming FIR filter.
+ * @date	29 July 2018
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "fir_filter.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIR_FILTER_X86 1
+#include <immintrin.h>
+#endif
+
+/* max samples filtered directly at once */
+#define FIR_DIRECT_BLOCK	1024
+
+/* FFT at least this many times longer than filter */
+#define FIR_FFT_RATIO		4
+#define FIR_FFT_MIN			64
+
+#define FIR_CALIBRATE_ROUNDS	5
+
+
+static double sinc(double x) {
+
+	if (fabs(x) < 1e-12) {
+		return 1;
+	}
+
+	return sin(M_PI * x) / (M_PI * x);
+}
+
+static double window(fir_window_t type, size_t i, size_t len) {
+
+	double x = 0;
+
+	if (len < 2) {
+		return 1;
+	}
+
+	x = 2 * M_PI * ((double) i / (double) (len - 1));
+
+	switch (type) {
+
+		case FIR_WINDOW_HAMMING:
+			return 0.54 - 0.46 * cos(x);
+
+		case FIR_WINDOW_HANNING:
+			return 0.5 - 0.5 * cos(x);
+
+		case FIR_WINDOW_BLACKMAN:
+			return 0.42 - 0.5 * cos(x) + 0.08 * cos(2 * x);
+
+		case FIR_WINDOW_RECTANGULAR:
+		default:
+			return 1;
+	}
+}
+
+int fir_design(const fir_design_t *d, double *h) {
+
+	size_t n = 0;
+	double L2 = 0, t = 0;
+
+	if (d->fs <= 0 || d->half_band <= 0 || d->centre < 0 || d->taps % 2 == 0) {
+		return -1;
+	}
+
+	/* band must not reach below 0 Hz or above Nyquist */
+	if ((d->centre > 0 && d->centre < d->half_band) || d->centre + d->half_band > d->fs / 2) {
+		return -1;
+	}
+
+	L2 = (d->taps - 1) / 2;
+
+	for (n = 0; n < d->taps; n++) {
+
+		t = (double) n - L2;
+
+		/**
+		 * Low pass prototype of cutoff half_band, shifted to centre
+		 * by cosine modulation (2 cos, so pass band gain stays 1).
+		 */
+
+		h[n] = (2.0 * d->half_band / d->fs) * sinc(2.0 * d->half_band * t / d->fs);
+		h[n] *= window(d->window, n, d->taps);
+		if (d->centre > 0) {
+			h[n] *= 2.0 * cos(2.0 * M_PI * d->centre * t / d->fs);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Direct kernels: out[i] = sum_j hr[j] * x[i + j], i < m,
+ * x holds m + taps - 1 samples, hr is reversed filter.
+ * Vector kernels compute consecutive outputs in lanes, so
+ * each tap is one broadcast and one unaligned load per lane group.
+ */
+
+static void fir_direct_scalar(const double *hr, size_t taps, const double *x, double *out, size_t m) {
+
+	size_t i = 0, j = 0;
+	double acc = 0;
+
+	for (i = 0; i < m; i++) {
+		acc = 0;
+		for (j = 0; j < taps; j++) {
+			acc += hr[j] * x[i + j];
+		}
+		out[i] = acc;
+	}
+}
+
+#ifdef FIR_FILTER_X86
+__attribute__((target("sse2")))
+static void fir_direct_sse2(const double *hr, size_t taps, const double *x, double *out, size_t m) {
+
+	size_t i = 0, j = 0;
+	__m128d b, a0, a1, a2, a3;
+
+	for (; i + 8 <= m; i += 8) {
+		a0 = a1 = a2 = a3 = _mm_setzero_pd();
+		for (j = 0; j < taps; j++) {
+			b = _mm_set1_pd(hr[j]);
+			a0 = _mm_add_pd(a0, _mm_mul_pd(b, _mm_loadu_pd(x + i + j)));
+			a1 = _mm_add_pd(a1, _mm_mul_pd(b, _mm_loadu_pd(x + i + j + 2)));
+			a2 = _mm_add_pd(a2, _mm_mul_pd(b, _mm_loadu_pd(x + i + j + 4)));
+			a3 = _mm_add_pd(a3, _mm_mul_pd(b, _mm_loadu_pd(x + i + j + 6)));
+		}
+		_mm_storeu_pd(out + i, a0);
+		_mm_storeu_pd(out + i + 2, a1);
+		_mm_storeu_pd(out + i + 4, a2);
+		_mm_storeu_pd(out + i + 6, a3);
+	}
+
+	fir_direct_scalar(hr, taps, x + i, out + i, m - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void fir_direct_avx2(const double *hr, size_t taps, const double *x, double *out, size_t m) {
+
+	size_t i = 0, j = 0;
+	__m256d b, a0, a1, a2, a3;
+
+	for (; i + 16 <= m; i += 16) {
+		a0 = a1 = a2 = a3 = _mm256_setzero_pd();
+		for (j = 0; j < taps; j++) {
+			b = _mm256_broadcast_sd(hr + j);
+			a0 = _mm256_fmadd_pd(b, _mm256_loadu_pd(x + i + j), a0);
+			a1 = _mm256_fmadd_pd(b, _mm256_loadu_pd(x + i + j + 4), a1);
+			a2 = _mm256_fmadd_pd(b, _mm256_loadu_pd(x + i + j + 8), a2);
+			a3 = _mm256_fmadd_pd(b, _mm256_loadu_pd(x + i + j + 12), a3);
+		}
+		_mm256_storeu_pd(out + i, a0);
+		_mm256_storeu_pd(out + i + 4, a1);
+		_mm256_storeu_pd(out + i + 8, a2);
+		_mm256_storeu_pd(out + i + 12, a3);
+	}
+
+	for (; i + 4 <= m; i += 4) {
+		a0 = _mm256_setzero_pd();
+		for (j = 0; j < taps; j++) {
+			a0 = _mm256_fmadd_pd(_mm256_broadcast_sd(hr + j), _mm256_loadu_pd(x + i + j), a0);
+		}
+		_mm256_storeu_pd(out + i, a0);
+	}
+
+	fir_direct_scalar(hr, taps, x + i, out + i, m - i);
+}
+#endif
+
+typedef void (*fir_direct_fn)(const double *, size_t, const double *, double *, size_t);
+
+static fir_direct_fn	fir_direct_impl = NULL;
+static const char		*fir_direct_name = NULL;
+static size_t			fir_direct_lanes = 1;	/* doubles per vector */
+
+static void fir_direct_resolve(void) {
+
+#ifdef FIR_FILTER_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		fir_direct_name = "avx2";
+		fir_direct_impl = fir_direct_avx2;
+		fir_direct_lanes = 4;
+		return;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		fir_direct_name = "sse2";
+		fir_direct_impl = fir_direct_sse2;
+		fir_direct_lanes = 2;
+		return;
+	}
+#endif
+	fir_direct_name = "scalar";
+	fir_direct_impl = fir_direct_scalar;
+	fir_direct_lanes = 1;
+}
+
+const char * fir_filter_kernel(void) {
+
+	if (fir_direct_impl == NULL) {
+		fir_direct_resolve();
+	}
+	return fir_direct_name;
+}
+
+/**
+ * Copy len input samples starting at start (relative to in[0],
+ * may be negative, then taken from history) into dst.
+ */
+static void fir_load(const fir_filter_t *f, const double *in, ssize_t start, size_t len, double *dst) {
+
+	size_t nh = 0;
+
+	if (start < 0) {
+		nh = (size_t) -start;
+		if (nh > len) {
+			nh = len;
+		}
+		memcpy(dst, f->hist + (f->taps - 1) + start, nh * sizeof(double));
+		start += nh;
+	}
+
+	memcpy(dst + nh, in + start, (len - nh) * sizeof(double));
+}
+
+static void fir_history(fir_filter_t *f, const double *in, size_t n) {
+
+	size_t hl = f->taps - 1;
+
+	if (hl == 0) {
+		return;
+	}
+
+	if (n >= hl) {
+		memcpy(f->hist, in + n - hl, hl * sizeof(double));
+	} else {
+		memmove(f->hist, f->hist + n, (hl - n) * sizeof(double));
+		memcpy(f->hist + hl - n, in, n * sizeof(double));
+	}
+}
+
+void fir_filter_process_direct(fir_filter_t *f, const double *in, double *out, size_t n) {
+
+	size_t p = 0, m = 0, hl = f->taps - 1;
+
+	if (fir_direct_impl == NULL) {
+		fir_direct_resolve();
+	}
+
+	for (p = 0; p < n; p += m) {
+
+		m = n - p;
+		if (m > f->work_len - hl) {
+			m = f->work_len - hl;
+		}
+
+		fir_load(f, in, (ssize_t) p - (ssize_t) hl, hl + m, f->work);
+		fir_direct_impl(f->h, f->taps, f->work, out + p, m);
+	}
+
+	fir_history(f, in, n);
+}
+
+void fir_filter_process_fft(fir_filter_t *f, const double *in, double *out, size_t n) {
+
+	size_t p = 0, l1 = 0, l2 = 0, k = 0, hl = f->taps - 1, nfft = f->plan.n;
+	double r = 0, i = 0;
+
+	for (p = 0; p < n; p += l1 + l2) {
+
+		/**
+		 * Two overlap-save segments per transform: the first in
+		 * real, the second in imaginary part. Filter is real, so
+		 * both convolutions come back separated in re and im.
+		 */
+
+		l1 = n - p;
+		if (l1 > f->step) {
+			l1 = f->step;
+		}
+		l2 = n - p - l1;
+		if (l2 > f->step) {
+			l2 = f->step;
+		}
+
+		fir_load(f, in, (ssize_t) p - (ssize_t) hl, hl + l1, f->re);
+		memset(f->re + hl + l1, 0, (nfft - hl - l1) * sizeof(double));
+		if (l2 > 0) {
+			fir_load(f, in, (ssize_t) (p + l1) - (ssize_t) hl, hl + l2, f->im);
+			memset(f->im + hl + l2, 0, (nfft - hl - l2) * sizeof(double));
+		} else {
+			memset(f->im, 0, nfft * sizeof(double));
+		}
+
+		fft_forward(&f->plan, f->re, f->im);
+
+		for (k = 0; k < nfft; k++) {
+			r = f->re[k] * f->h_re[k] - f->im[k] * f->h_im[k];
+			i = f->re[k] * f->h_im[k] + f->im[k] * f->h_re[k];
+			f->re[k] = r;
+			f->im[k] = i;
+		}
+
+		fft_inverse(&f->plan, f->re, f->im);
+
+		/* first hl outputs are wrapped around, discard */
+		memcpy(out + p, f->re + hl, l1 * sizeof(double));
+		memcpy(out + p + l1, f->im + hl, l2 * sizeof(double));
+	}
+
+	fir_history(f, in, n);
+}
+
+void fir_filter_process(fir_filter_t *f, const double *in, double *out, size_t n) {
+
+	size_t full = 0;
+
+	if (n < f->crossover) {
+		fir_filter_process_direct(f, in, out, n);
+		return;
+	}
+
+	/**
+	 * Whole transforms (two segments each) with FFT, the rest
+	 * with whichever is cheaper for its length.
+	 */
+
+	full = n - n % (2 * f->step);
+	if (full > 0) {
+		fir_filter_process_fft(f, in, out, full);
+	}
+	if (n - full >= f->crossover) {
+		fir_filter_process_fft(f, in + full, out + full, n - full);
+	} else if (n > full) {
+		fir_filter_process_direct(f, in + full, out + full, n - full);
+	}
+}
+
+void fir_filter_reset(fir_filter_t *f) {
+
+	if (f->taps > 1) {
+		memset(f->hist, 0, (f->taps - 1) * sizeof(double));
+	}
+}
+
+static double now(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Estimate crossover from operation counts, so it is the same on
+ * every run: a transform (two segments) costs a forward and an
+ * inverse complex FFT, 5 n log2(n) flops each, and the spectrum
+ * product, 6 n; a directly filtered sample costs 2 taps flops,
+ * spread over the lanes of the direct kernel. If that is above
+ * two segments FFT never wins.
+ */
+static void fir_estimate(fir_filter_t *f) {
+
+	size_t n = f->plan.n, log2n = 0;
+	double tf = 0, td = 0, cross = 0;
+
+	while (((size_t) 1 << log2n) < n) {
+		log2n++;
+	}
+
+	if (fir_direct_impl == NULL) {
+		fir_direct_resolve();
+	}
+
+	tf = 10.0 * n * log2n + 6.0 * n;
+	td = 2.0 * f->taps / fir_direct_lanes;
+
+	cross = tf / td;
+	if (cross >= 2 * f->step) {
+		f->crossover = FIR_CROSSOVER_NEVER;
+	} else {
+		f->crossover = (size_t) ceil(cross);
+	}
+}
+
+/**
+ * Time both paths on a block of two segments (one transform).
+ * Direct cost grows with block length, FFT cost with number of
+ * transforms, so blocks from t_fft / t_direct_per_sample samples
+ * on are cheaper with one transform. If that is above two
+ * segments FFT never wins. Timings vary, so may the result.
+ */
+static int fir_calibrate(fir_filter_t *f) {
+
+	size_t m = 2 * f->step, i = 0, r = 0;
+	uint32_t seed = 1;
+	double *x = NULL, *y = NULL, t = 0, td = 1e9, tf = 1e9, cross = 0;
+
+	x = malloc(m * sizeof(double));
+	y = malloc(m * sizeof(double));
+	if (x == NULL || y == NULL) {
+		free(x);
+		free(y);
+		return -2;
+	}
+
+	/* own generator, rand() state belongs to the caller */
+	for (i = 0; i < m; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		x[i] = 2.0 * ((double) seed / UINT32_MAX) - 1.0;
+	}
+
+	for (r = 0; r < FIR_CALIBRATE_ROUNDS; r++) {
+
+		t = now();
+		fir_filter_process_direct(f, x, y, m);
+		t = now() - t;
+		if (t < td) td = t;
+
+		t = now();
+		fir_filter_process_fft(f, x, y, m);
+		t = now() - t;
+		if (t < tf) tf = t;
+	}
+
+	cross = tf / (td / m);
+	if (cross >= m) {
+		f->crossover = FIR_CROSSOVER_NEVER;
+	} else {
+		f->crossover = (size_t) ceil(cross);
+	}
+
+	free(x);
+	free(y);
+	fir_filter_reset(f);
+
+	return 0;
+}
+
+int fir_filter_init(fir_filter_t *f, const double *h, size_t taps, size_t crossover) {
+
+	size_t k = 0, nfft = FIR_FFT_MIN;
+	int ret = 0;
+
+	memset(f, 0, sizeof(*f));
+
+	if (taps == 0) {
+		return -1;
+	}
+
+	while (nfft < FIR_FFT_RATIO * taps) {
+		nfft *= 2;
+	}
+
+	f->taps = taps;
+	f->work_len = taps - 1 + FIR_DIRECT_BLOCK;
+	f->step = nfft - (taps - 1);
+	f->crossover = crossover;
+
+	f->h = malloc(taps * sizeof(double));
+	f->hist = calloc(taps, sizeof(double));
+	f->work = malloc(f->work_len * sizeof(double));
+	f->h_re = calloc(nfft, sizeof(double));
+	f->h_im = calloc(nfft, sizeof(double));
+	f->re = malloc(nfft * sizeof(double));
+	f->im = malloc(nfft * sizeof(double));
+	if (f->h == NULL || f->hist == NULL || f->work == NULL || f->h_re == NULL
+			|| f->h_im == NULL || f->re == NULL || f->im == NULL) {
+		fir_filter_destroy(f);
+		return -2;
+	}
+
+	if (fft_plan_init(&f->plan, nfft) != 0) {
+		fir_filter_destroy(f);
+		return -2;
+	}
+
+	for (k = 0; k < taps; k++) {
+		f->h[k] = h[taps - 1 - k];
+		f->h_re[k] = h[k];
+	}
+	fft_forward(&f->plan, f->h_re, f->h_im);
+
+	if (crossover == FIR_CROSSOVER_AUTO) {
+		fir_estimate(f);
+	} else if (crossover == FIR_CROSSOVER_MEASURE) {
+		ret = fir_calibrate(f);
+		if (ret != 0) {
+			fir_filter_destroy(f);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+void fir_filter_destroy(fir_filter_t *f) {
+
+	free(f->h);
+	free(f->hist);
+	free(f->work);
+	free(f->h_re);
+	free(f->h_im);
+	free(f->re);
+	free(f->im);
+	fft_plan_destroy(&f->plan);
+	memset(f, 0, sizeof(*f));
+}
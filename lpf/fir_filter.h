@@ -0,0 +1,100 @@
+/*
+ * @file    fir_filter.h
+ * @author  Piotr Gregor <piotr@dataandsignal.com>
+ * @brief   Windowed sinc FIR design and streaming FIR filter.
+ *
+ *          Filter keeps last (taps - 1) input samples between
+ *          calls, so a continuous stream can be fed in blocks of
+ *          any size and output is the same as filtering it whole.
+ *          Blocks shorter than crossover are filtered directly
+ *          (SIMD over consecutive outputs), longer ones with FFT
+ *          overlap-save, two segments per complex transform.
+ * @date	29 July 2018
+ */
+
+#ifndef __FIR_FILTER_H__
+#define __FIR_FILTER_H__
+
+#include <stddef.h>
+
+#include "fft.h"
+
+typedef enum {
+	FIR_WINDOW_RECTANGULAR,
+	FIR_WINDOW_HAMMING,
+	FIR_WINDOW_HANNING,
+	FIR_WINDOW_BLACKMAN
+} fir_window_t;
+
+typedef struct {
+	double			fs;			/* sampling rate, Hz */
+	double			centre;		/* centre of the pass band, Hz, 0 for low pass */
+	double			half_band;	/* half width of the pass band, Hz */
+	fir_window_t	window;
+	size_t			taps;		/* odd */
+} fir_design_t;
+
+/* block size from which FFT is used, never */
+#define FIR_CROSSOVER_NEVER	((size_t) -1)
+/* estimate from operation counts */
+#define FIR_CROSSOVER_AUTO	((size_t) 0)
+/* time both paths (result may vary between runs) */
+#define FIR_CROSSOVER_MEASURE	((size_t) -2)
+
+typedef struct {
+	size_t		taps;
+	double		*h;			/* coefficients, reversed */
+	double		*hist;		/* last taps - 1 input samples */
+	double		*work;		/* history + direct block */
+	size_t		work_len;
+
+	fft_plan_t	plan;
+	size_t		step;		/* new samples per overlap-save segment */
+	double		*h_re;		/* filter spectrum */
+	double		*h_im;
+	double		*re;
+	double		*im;
+
+	size_t		crossover;
+} fir_filter_t;
+
+/**
+ * Design band pass (or low pass if centre is 0) filter into h,
+ * which must hold d->taps coefficients.
+ * Return 0 on success, -1 on invalid parameters.
+ */
+int fir_design(const fir_design_t *d, double *h);
+
+/**
+ * Create filter with coefficients h (copied). crossover is the
+ * block length from which FFT overlap-save is used, or
+ * FIR_CROSSOVER_AUTO to estimate it (the same on every run),
+ * FIR_CROSSOVER_MEASURE to time it, or FIR_CROSSOVER_NEVER.
+ * Return 0 on success, -1 on invalid parameters, -2 if out of memory.
+ */
+int fir_filter_init(fir_filter_t *f, const double *h, size_t taps, size_t crossover);
+void fir_filter_destroy(fir_filter_t *f);
+
+/**
+ * Forget history (stream restarts with zeros).
+ */
+void fir_filter_reset(fir_filter_t *f);
+
+/**
+ * Filter n samples, out[i] = sum h[k] in[i - k], samples before
+ * in[0] taken from previous calls. in and out may not overlap.
+ */
+void fir_filter_process(fir_filter_t *f, const double *in, double *out, size_t n);
+
+/**
+ * The same, forcing direct or FFT path (for testing).
+ */
+void fir_filter_process_direct(fir_filter_t *f, const double *in, double *out, size_t n);
+void fir_filter_process_fft(fir_filter_t *f, const double *in, double *out, size_t n);
+
+/**
+ * Name of the direct kernel in use.
+ */
+const char * fir_filter_kernel(void);
+
+#endif
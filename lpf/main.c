@@ -14,6 +14,10 @@
 #include <float.h>
 #include <arpa/inet.h>
 
+#include <unistd.h>
+
+#include "fir_filter.h"
+
 #define BUF_SZ 400
 
 #define SEGMENT_LEN 16
@@ -23,110 +27,14 @@
 #define FILTER_CENTRE 0
 
 uint16_t Fs = 8000;
-double h[FILTER_LEN];
-double w[FILTER_LEN];
-
-double test_arr[16] = { 0, 0.133368129077583, 0.265840410313570, 0.396528503497067, 0.524559017724909, 0.649080821755675, 0.769272158834902, 0.884347503518051, 0.993564100303636, 1.096228126707953, 1.191700426740037, 1.279401764541372, 1.358817552205566, 1.429502010451180, 1.491081725844580, 1.543258573614740 };
-double test_res[SEGMENT_LEN + FILTER_LEN - 1] = {};
-
-#define min(a,b) ((a) < (b) ? (a) : (b))
-#define max(a,b) ((a) > (b) ? (a) : (b))
 
 void
 usage(const char *name)
 {
 	fprintf(stderr, "Usage:\n");
-	fprintf(stderr, "%s <input file>\n\n", name);
-}
-
-static double sinc(double x) {
-
-	if (abs(x) < 1.0 / Fs) {
-		return 1;
-	}
-
-	return sin(M_PI * x) / (M_PI * x);
-}
-
-static void hamming(uint16_t len) {
-
-	uint16_t half = 0;
-	int i = 0;
-
-	if (len % 2) {
-
-		// odd length window
-		half = (len + 1) / 2;	// 129
-	} else {
-		// even length window
-		half = len / 2;
-	}
-
-	while (i < half) {
-		
-		w[i] = 0.54 - 0.46 * cos(2 * M_PI * ((double) i / (double) (len - 1)));
-		w[FILTER_LEN - 1 - i] = w[i];
-		i++;
-	}
-
-}
-
-static void create_filter(uint16_t len) {
-	
-	int n = 0;
-	int L2 = (len - 1) / 2;
-	
-	
-	hamming(len);
-	
-	while (n < len) {
-
-		//shift_re[n] = cos(2 * PI * FILTER_CENTRE * dt * n);
-		//shift_im[n] = sin(2 * PI * FILTER_CENTRE * dt * n);
-
-		h[n] = (2.0 * FILTER_HALF_BAND / Fs) * sinc(2.0 * FILTER_HALF_BAND * (n - L2) / Fs);
-		n++;
-	}
-	n = 0;
-	while (n < len) {
-
-		h[n] = h[n] * w[n];
-		n++;
-	}
-}
-
-static void conv(double *a, uint16_t a_len, double *h, uint16_t h_len, double *res) {
-	
-	int t = 0, tau = 0;
-	int c_len = a_len + h_len - 1;
-	int tau_min = 0, tau_max = 0;
-
-	while (t < c_len) {
-	
-		res[t] = 0;
-/**
-		tau_min = (t >= h_len - 1) ? t - (h_len - 1) : 0;
-		tau_max = (t < h_len - 1) ? t : h_len - 1;
-
-		for (tau = tau_min; tau <= tau_max; tau++) {
-			
-			res[t] += a[tau] * h[t - tau];
-		}
-		**/
-		
-		tau_min = (t >= h_len - 1) ? t - (h_len - 1) : 0;
-		tau_max = (t < h_len - 1) ? min(a_len - 1, t) : min(a_len - 1, h_len - 1);
-		//tau_max = min(a_len - 1, h_len - 1);
-		//tau_max = (t < h_len - 1) ? t : h_len - 1;
-
-		//for (tau = tau_min; tau < a_len && (t - tau >= 0); tau++) {
-		for (tau = tau_min; tau <= tau_max; tau++) {
-
-			res[t] += a[tau] * h[t - tau];
-		}
-
-		t++;
-	}
+	fprintf(stderr, "%s [-c centre Hz] [-b half band Hz] [-t taps] [-w r|h|n|b] <input file> [s]\n\n", name);
+	fprintf(stderr, "Defaults: low pass (centre %d Hz), half band %d Hz, %d taps, Hamming window.\n", FILTER_CENTRE, FILTER_HALF_BAND, FILTER_LEN);
+	fprintf(stderr, "Window: r - rectangular, h - Hamming, n - Hanning, b - Blackman.\n\n");
 }
 
 static double energy(double *a, int a_len) {
@@ -142,15 +50,15 @@ static double energy(double *a, int a_len) {
 	return res;
 }
 
-static double energy_test(double *a, int a_len, double *h, int h_len) {
+/**
+ * Energy of filtered segment relative to energy of the input segment.
+ */
+static double energy_test(double *a, double *af, int a_len) {
 
 	double ea = 0, eaf = 0;
-	double af[SEGMENT_LEN + FILTER_LEN - 1];
-
-	conv(a, a_len, h, h_len, af);
 
-	ea = energy(a, SEGMENT_LEN);
-	eaf = energy(af, SEGMENT_LEN + FILTER_LEN - 1);
+	ea = energy(a, a_len);
+	eaf = energy(af, a_len);
 
 	if (ea < 0.0001) ea = 0.0001;
 
@@ -167,41 +75,114 @@ void int2float(int16_t *input, double *output, int length) {
 	}
 }
 
+/**
+ * Filter len samples (whole segments) of buf, test energy of each.
+ */
+static void filter_segments(fir_filter_t *f, int16_t *buf, double *a, double *af, size_t len) {
+
+	size_t i = 0;
+
+	int2float(buf, a, len);
+	fir_filter_process(f, a, af, len);
+
+	for (i = 0; i < len; i += SEGMENT_LEN) {
+		energy_test(a + i, af + i, SEGMENT_LEN);
+	}
+}
+
 
 int main(int argc, char *argv[])
 {
 	FILE    *fpin = NULL;
 	char swap = '0';
 	int16_t buf[BUF_SZ]= {0};
-	size_t	read = 0, read_now = 0, count = 0;
+	size_t	read = 0, read_now = 0, count = 0, len = 0, pending = 0;
 	size_t i = 0;
+	int opt = 0;
+
+	double a[BUF_SZ] = {};
+	double af[BUF_SZ] = {};
+	double *h = NULL;
+	fir_design_t design = { .fs = Fs, .centre = FILTER_CENTRE, .half_band = FILTER_HALF_BAND,
+							.window = FIR_WINDOW_HAMMING, .taps = FILTER_LEN };
+	fir_filter_t filter;
+
+
+	while ((opt = getopt(argc, argv, "c:b:t:w:")) != -1) {
+
+		switch (opt) {
+
+			case 'c':
+				design.centre = atof(optarg);
+				break;
+
+			case 'b':
+				design.half_band = atof(optarg);
+				break;
+
+			case 't':
+				design.taps = strtoul(optarg, NULL, 10);
+				break;
+
+			case 'w':
+				switch (*optarg) {
+					case 'r': design.window = FIR_WINDOW_RECTANGULAR; break;
+					case 'h': design.window = FIR_WINDOW_HAMMING; break;
+					case 'n': design.window = FIR_WINDOW_HANNING; break;
+					case 'b': design.window = FIR_WINDOW_BLACKMAN; break;
+					default:
+						fprintf(stderr, "\nError. Unknown window.\n\n");
+						goto bpfhelp;
+				}
+				break;
+
+			default:
+				goto bpfhelp;
+		}
+	}
 
-	double a[SEGMENT_LEN] = {};
-
-
-	if (argc < 2 || argc > 3) {
+	if (argc - optind < 1 || argc - optind > 2) {
 		fprintf(stderr, "\nProgram takes 1 argument (input file) and at most one optional (swap).\n\n");
 		goto bpfhelp;
 	}
 
-	fpin = fopen(argv[1], "r");
-	if (fpin == NULL) {
-		fprintf(stderr, "\nError opening input file.\nPlease check the file name.\n\n");
-		goto bpfhelp;
-	}
-	
-	if (argc == 3) { 
-		swap = *argv[2];
+	if (argc - optind == 2) { 
+		swap = *argv[optind + 1];
 		if (swap != 's') {
 			fprintf(stderr, "\nError. The last argument should be 's' if endiannes swapping required.\n\n");
 			goto bpfhelp;
 		}
 	}
 
-	create_filter(FILTER_LEN);
-	conv(test_arr, SEGMENT_LEN, h, FILTER_LEN, test_res);
+	h = malloc(design.taps * sizeof(double));
+	if (h == NULL || design.taps == 0 || fir_design(&design, h) != 0) {
+		fprintf(stderr, "\nError. Invalid filter (taps must be odd, band within 0 - %u Hz).\n\n", Fs / 2);
+		free(h);
+		goto bpfhelp;
+	}
 
-	while ((read_now = fread((void *) buf, sizeof(buf[0]), SEGMENT_LEN, fpin)) > 0) {
+	if (fir_filter_init(&filter, h, design.taps, FIR_CROSSOVER_AUTO) != 0) {
+		fprintf(stderr, "\nError. Can't create filter.\n\n");
+		free(h);
+		return EXIT_FAILURE;
+	}
+	free(h);
+
+	fpin = fopen(argv[optind], "r");
+	if (fpin == NULL) {
+		fprintf(stderr, "\nError opening input file.\nPlease check the file name.\n\n");
+		fir_filter_destroy(&filter);
+		goto bpfhelp;
+	}
+
+	/**
+	 * Stream is filtered continuously (filter keeps its history),
+	 * energy is tested per segment. Samples short of a whole segment
+	 * wait in front of buf for the next read; at the end of input
+	 * they are padded with zeros and flushed as the last segment.
+	 */
+
+	while ((read_now = fread((void *) (buf + pending), sizeof(buf[0]), BUF_SZ - pending, fpin)) > 0) {
 
 		/**
 		 * Optionally swap endiannes.
@@ -209,26 +190,37 @@ int main(int argc, char *argv[])
 
 		if (swap == 's') {
 
-			i = 0;
+			i = pending;
 
-			while (i < read_now) {
+			while (i < pending + read_now) {
 				buf[i] = htons(buf[i]);
 				++i;
 			}
 		}
 
 		read += read_now;						/* in items */
+		pending += read_now;
 
-		if (read_now == SEGMENT_LEN) {
+		len = pending - pending % SEGMENT_LEN;
+		if (len == 0) {
+			continue;
+		}
 
-			int2float(buf, a, SEGMENT_LEN);
-			energy_test(a, SEGMENT_LEN, h, FILTER_LEN);
+		filter_segments(&filter, buf, a, af, len);
+		count += len;
 
-			count += SEGMENT_LEN;
-		}
+		pending -= len;
+		memmove(buf, buf + len, pending * sizeof(buf[0]));
+	}
+
+	if (pending > 0) {
+		memset(buf + pending, 0, (SEGMENT_LEN - pending) * sizeof(buf[0]));
+		filter_segments(&filter, buf, a, af, SEGMENT_LEN);
+		count += pending;
 	}
 
 	fclose(fpin);
+	fir_filter_destroy(&filter);
 
 	fprintf(stderr, "\nDone. ");
 